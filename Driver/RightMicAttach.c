@@ -0,0 +1,240 @@
+/*
+ * RightMicAttach.c
+ * Maps the shared ring for the driver off the real-time IO thread.
+ *
+ * See RightMicAttach.h.
+ */
+
+#include "RightMicAttach.h"
+#include "RightMicShm.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+void RightMicAttach_Init(RightMicAttach *attach, const char *name, const char *path)
+{
+    atomic_store_explicit(&attach->current, NULL, memory_order_relaxed);
+    atomic_store_explicit(&attach->ioEpoch, 0, memory_order_relaxed);
+    pthread_mutex_init(&attach->lock, NULL);
+    attach->name = name;
+    attach->path = path;
+}
+
+/* ================================================================
+ * Background Thread
+ * ================================================================ */
+
+/* The app's shared memory object if it made one, else its file: a
+ * descriptor and the size, or a failure result. */
+static RightMicAttachResult OpenShared(const RightMicAttach *attach, int *outFd,
+                                       size_t *outSize, bool *outAnonymous)
+{
+    if (attach->name != NULL) {
+        int fd = RightMicShm_Open(attach->name, outSize);
+        if (fd >= 0) {
+            *outFd = fd;
+            *outAnonymous = true;
+            return kRightMicAttach_Attached;
+        }
+    }
+    if (attach->path == NULL) return kRightMicAttach_Missing;
+
+    int fd = open(attach->path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) return kRightMicAttach_Missing;
+
+    /* A path the app doesn't control could name anything; only a regular
+     * file is mapped. */
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return kRightMicAttach_NotRegular;
+    }
+    *outFd = fd;
+    *outSize = (size_t)st.st_size;
+    *outAnonymous = false;
+    return kRightMicAttach_Attached;
+}
+
+/* Whether the app has published a layout we understand, and if so the
+ * header as it stood.  Read through a mapping of the header page: shm
+ * objects can't be pread on Darwin. */
+static bool ReadLayout(int fd, RightMicRingBufferHeader *outHeader)
+{
+    void *p = mmap(NULL, sizeof(RightMicRingBufferHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    memcpy(outHeader, p, sizeof(*outHeader));
+    munmap(p, sizeof(RightMicRingBufferHeader));
+    return RightMicRing_IsCompatible(outHeader) &&
+           outHeader->dataOffset >= kRightMic_PagedMinDataOffset;
+}
+
+static RightMicAttachResult MapShared(const RightMicAttach *attach, RightMicMapping **outMapping)
+{
+    int fd;
+    size_t size;
+    bool anonymous;
+    RightMicAttachResult result = OpenShared(attach, &fd, &size, &anonymous);
+    if (result != kRightMicAttach_Attached) return result;
+
+    /* Too short for even the smallest ring the app could have asked for. */
+    if (size < kRightMic_PagedMinDataOffset + kRightMic_RingDataBytesFor(kRightMic_MinRingFrames, 1)) {
+        close(fd);
+        return kRightMicAttach_TooSmall;
+    }
+
+    /* Map it only once the app has published a layout we understand.  An
+     * app from before the versioned header leaves no magic here.  The
+     * geometry is taken from this one copy of the header, never reread. */
+    RightMicRingBufferHeader header;
+    if (!ReadLayout(fd, &header)) {
+        close(fd);
+        return kRightMicAttach_Unrecognized;
+    }
+    uint32_t ringFrames = header.ringFrames;
+    uint32_t channels   = RightMicRing_Channels(&header);
+    uint32_t dataOffset = header.dataOffset;
+    size_t   ringBytes  = (size_t)ringFrames * kRightMic_FrameBytesFor(channels);
+    size_t   dataBytes  = kRightMic_RingDataBytesFor(ringFrames, channels);
+    if (size < dataOffset + dataBytes) {
+        close(fd);
+        return kRightMicAttach_TooSmall;
+    }
+
+    RightMicMapping *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        close(fd);
+        return kRightMicAttach_MapFailed;
+    }
+
+    /* The ring is mapped a second time behind itself if the kernel
+     * allows and it fills its pages, so no read ever splits at the wrap. */
+    if (!RightMicMirror_Map(&m->map, fd, dataOffset + dataBytes, dataOffset, ringBytes, false)) {
+        free(m);
+        close(fd);
+        return kRightMicAttach_MapFailed;
+    }
+    /* The IO thread's first reads must not be its first touches. */
+    m->residency = RightMicMirror_Prefault(&m->map);
+    m->fd = fd;
+    m->anonymous = anonymous;
+    RightMicRing_AttachAt(&m->ring, m->map.base, dataOffset, ringFrames, channels, m->map.mirrored);
+    m->controls = (RightMicControlTable *)(m->map.base + kRightMic_PagedControlTableOffset);
+    m->clock = (const RightMicClockTable *)(m->map.base + kRightMic_PagedClockOffset);
+    *outMapping = m;
+    return kRightMicAttach_Attached;
+}
+
+RightMicAttachResult RightMicAttach_Open(RightMicAttach *attach)
+{
+    pthread_mutex_lock(&attach->lock);
+    RightMicAttachResult result = kRightMicAttach_Attached;
+    if (atomic_load_explicit(&attach->current, memory_order_relaxed) == NULL) {
+        RightMicMapping *m = NULL;
+        result = MapShared(attach, &m);
+        if (result == kRightMicAttach_Attached) {
+            /* Release: the descriptor is complete before it is visible. */
+            atomic_store_explicit(&attach->current, m, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&attach->lock);
+    return result;
+}
+
+void RightMicAttach_Close(RightMicAttach *attach)
+{
+    pthread_mutex_lock(&attach->lock);
+    RightMicMapping *m = atomic_exchange_explicit(&attach->current, NULL, memory_order_seq_cst);
+    if (m != NULL) {
+        /* Pairs with EnterIO (store epoch, then load current, both
+         * seq_cst): either that cycle sees NULL, or we see it inside and
+         * wait for it to leave.  One IO cycle at most. */
+        uint64_t epoch = atomic_load_explicit(&attach->ioEpoch, memory_order_seq_cst);
+        if (epoch & 1) {
+            const struct timespec pause = { 0, 100000 };
+            while (atomic_load_explicit(&attach->ioEpoch, memory_order_acquire) == epoch) {
+                nanosleep(&pause, NULL);
+            }
+        }
+        RightMicMirror_Unmap(&m->map);
+        close(m->fd);
+        free(m);
+    }
+    pthread_mutex_unlock(&attach->lock);
+}
+
+bool RightMicAttach_Moved(RightMicAttach *attach)
+{
+    pthread_mutex_lock(&attach->lock);
+    const RightMicMapping *m = atomic_load_explicit(&attach->current, memory_order_relaxed);
+    bool moved = false;
+    if (m != NULL && !RightMicRing_IsCompatible(m->ring.header)) {
+        /* Ours is zeroed for good or until the app reopens it; a live
+         * layout under the name can only be another object's. */
+        int fd;
+        size_t size;
+        bool anonymous;
+        RightMicRingBufferHeader header;
+        if (OpenShared(attach, &fd, &size, &anonymous) == kRightMicAttach_Attached) {
+            moved = ReadLayout(fd, &header);
+            close(fd);
+        }
+    }
+    pthread_mutex_unlock(&attach->lock);
+    return moved;
+}
+
+bool RightMicAttach_IsAttached(RightMicAttach *attach)
+{
+    return atomic_load_explicit(&attach->current, memory_order_acquire) != NULL;
+}
+
+const char *RightMicAttach_Describe(RightMicAttachResult result)
+{
+    switch (result) {
+    case kRightMicAttach_Attached:     return "attached";
+    case kRightMicAttach_Missing:      return "shared memory not yet created by companion app";
+    case kRightMicAttach_TooSmall:     return "shared memory too small";
+    case kRightMicAttach_NotRegular:   return "shared memory path is not a regular file, refusing to map";
+    case kRightMicAttach_Unrecognized: return "shared memory layout not recognized";
+    case kRightMicAttach_MapFailed:    return "failed to mmap shared memory";
+    }
+    return "unknown";
+}
+
+/* ================================================================
+ * IO Thread
+ * ================================================================ */
+
+const RightMicMapping *RightMicAttach_EnterIO(RightMicAttach *attach)
+{
+    /* Only the IO thread writes the epoch, so the relaxed load is its own value. */
+    uint64_t epoch = atomic_load_explicit(&attach->ioEpoch, memory_order_relaxed);
+    atomic_store_explicit(&attach->ioEpoch, epoch + 1, memory_order_seq_cst);
+    return atomic_load_explicit(&attach->current, memory_order_seq_cst);
+}
+
+void RightMicAttach_ExitIO(RightMicAttach *attach)
+{
+    uint64_t epoch = atomic_load_explicit(&attach->ioEpoch, memory_order_relaxed);
+    atomic_store_explicit(&attach->ioEpoch, epoch + 1, memory_order_release);
+}
+
+/* ================================================================
+ * Other Threads
+ * ================================================================ */
+
+const RightMicMapping *RightMicAttach_Lock(RightMicAttach *attach)
+{
+    pthread_mutex_lock(&attach->lock);
+    return atomic_load_explicit(&attach->current, memory_order_relaxed);
+}
+
+void RightMicAttach_Unlock(RightMicAttach *attach)
+{
+    pthread_mutex_unlock(&attach->lock);
+}
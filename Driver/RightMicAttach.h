@@ -0,0 +1,115 @@
+/*
+ * RightMicAttach.h
+ * Maps the shared ring for the driver off the real-time IO thread.
+ *
+ * The companion app may start long after a client selects RightMic, so
+ * the driver has to keep trying to open the shared ring: the shared
+ * memory object, or the file when the app fell back to one (see
+ * RightMicShm.h).  Opening, validating and mapping it (shm_open or open,
+ * fstat, mmap) and tearing it down again (munmap, close) are system
+ * calls that must never run on the HAL's IO thread, which shares a
+ * workgroup with every other device in the same IO cycle.
+ *
+ * A background thread calls Open/Close.  Open builds a complete mapping
+ * descriptor and publishes it through one atomic pointer; the IO thread
+ * brackets each cycle with EnterIO/ExitIO, which is an acquire load of
+ * that pointer and a store announcing it is done.  Close unpublishes the
+ * descriptor and waits for an IO cycle that may still be using it to
+ * finish before unmapping it.  Other non-real-time readers (property
+ * getters, the main queue) use Lock/Unlock, which exclude Close.
+ *
+ * The IO side assumes one IO thread, as the HAL runs a device's IO on
+ * a single thread.  Portable POSIX + C11, unit-tested on Linux.
+ */
+
+#ifndef RightMicAttach_h
+#define RightMicAttach_h
+
+#include "RightMicDriver.h"
+#include "RightMicMirror.h"
+#include "RightMicRing.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Mapping ──────────────────────────────────────────────────── */
+
+/* Everything the readers need, built before it is published and never */
+/* modified afterwards.                                                */
+typedef struct {
+    RightMicRing              ring;      /* header/data view                 */
+    RightMicControlTable     *controls;  /* control table in the header page */
+    const RightMicClockTable *clock;     /* capture timestamps, ditto        */
+    RightMicMirror            map;
+    int                       fd;
+    bool                      anonymous; /* shared memory object, not the file */
+    RightMicResidency         residency; /* how Open prefaulted `map`          */
+} RightMicMapping;
+
+typedef enum {
+    kRightMicAttach_Attached     = 0,  /* mapped (now or already)              */
+    kRightMicAttach_Missing      = 1,  /* neither object nor file yet          */
+    kRightMicAttach_TooSmall     = 2,  /* shorter than its header says         */
+    kRightMicAttach_NotRegular   = 3,  /* path is not a regular file; refused  */
+    kRightMicAttach_Unrecognized = 4,  /* header not published or wrong version */
+    kRightMicAttach_MapFailed    = 5,  /* mmap or allocation failed            */
+} RightMicAttachResult;
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    _Atomic(RightMicMapping *) current;  /* published mapping, NULL when detached */
+    _Atomic uint64_t           ioEpoch;  /* odd while the IO thread is inside     */
+    pthread_mutex_t            lock;     /* Open/Close and Lock/Unlock            */
+    const char                *name;     /* shared memory object, or NULL         */
+    const char                *path;     /* file, if there is no object           */
+} RightMicAttach;
+
+void RightMicAttach_Init(RightMicAttach *attach, const char *name, const char *path);
+
+/* ── Background thread ────────────────────────────────────────── */
+
+/* Map the shared object (or else the file) if it is present and       */
+/* carries a layout this driver understands.  Blocking; never call     */
+/* from the IO thread.                                                  */
+RightMicAttachResult RightMicAttach_Open(RightMicAttach *attach);
+
+/* Unpublish and unmap.  Waits for an IO cycle still using the mapping. */
+void RightMicAttach_Close(RightMicAttach *attach);
+
+/* True if the mapped header no longer describes a ring but the object  */
+/* (or else the file) the name resolves to now does: the app replaced   */
+/* the object, or moved to it from the file.  Close and Open again to   */
+/* follow it.  Blocking; never call from the IO thread.                 */
+bool RightMicAttach_Moved(RightMicAttach *attach);
+
+bool RightMicAttach_IsAttached(RightMicAttach *attach);
+
+/* Short human-readable reason for logging. */
+const char *RightMicAttach_Describe(RightMicAttachResult result);
+
+/* ── IO thread ────────────────────────────────────────────────── */
+
+/* The current mapping (NULL if detached), valid until ExitIO.  Always  */
+/* pair with ExitIO, even on NULL.  Real-time safe.                     */
+const RightMicMapping *RightMicAttach_EnterIO(RightMicAttach *attach);
+void RightMicAttach_ExitIO(RightMicAttach *attach);
+
+/* ── Other threads ────────────────────────────────────────────── */
+
+/* The current mapping (NULL if detached), valid until Unlock.  Blocks  */
+/* Close; not for the IO thread.                                        */
+const RightMicMapping *RightMicAttach_Lock(RightMicAttach *attach);
+void RightMicAttach_Unlock(RightMicAttach *attach);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicAttach_h */
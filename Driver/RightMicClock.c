@@ -0,0 +1,212 @@
+/*
+ * RightMicClock.c
+ * The capture device's sample clock, as seen by the driver.
+ *
+ * See RightMicClock.h.
+ */
+
+#include "RightMicClock.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/* ================================================================
+ * Producer
+ * ================================================================ */
+
+void RightMicClock_InitProducer(RightMicClockTable *table)
+{
+    for (uint32_t i = 0; i < kRightMic_ClockEntries; i++) {
+        atomic_store_explicit(&table->entries[i].sequence, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&table->count, 0, memory_order_release);
+}
+
+void RightMicClock_Publish(RightMicClockTable *table, uint32_t clockID, uint32_t sampleRate,
+                           double sampleTime, uint64_t hostTime)
+{
+    /* Single writer, so the relaxed load is our own last store. */
+    uint64_t index = atomic_load_explicit(&table->count, memory_order_relaxed);
+    RightMicClockEntry *entry = &table->entries[index % kRightMic_ClockEntries];
+
+    /* Invalidate the slot before any field changes: a reader that copied
+     * it under the old sequence sees 0 (or the new one) on its re-check. */
+    atomic_store_explicit(&entry->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&entry->sampleTime, sampleTime, memory_order_relaxed);
+    atomic_store_explicit(&entry->hostTime, hostTime, memory_order_relaxed);
+    atomic_store_explicit(&entry->clockID, clockID, memory_order_relaxed);
+    atomic_store_explicit(&entry->sampleRate, sampleRate, memory_order_relaxed);
+    atomic_store_explicit(&entry->sequence, index + 1, memory_order_release);
+    atomic_store_explicit(&table->count, index + 1, memory_order_release);
+}
+
+/* ================================================================
+ * Estimator
+ * ================================================================ */
+
+void RightMicClock_InitEstimator(RightMicClockEstimator *est, double ticksPerSecond)
+{
+    memset(est, 0, sizeof(*est));
+    est->ticksPerSecond = ticksPerSecond;
+}
+
+/* Start the loop over at one measurement, at the nominal rate. */
+static void Restart(RightMicClockEstimator *est, uint32_t clockID, uint32_t sampleRate,
+                    double sampleTime, uint64_t hostTime)
+{
+    if (est->sampleRate != 0) {
+        est->discontinuities++;
+    }
+    est->clockID        = clockID;
+    est->sampleRate     = sampleRate;
+    est->sampleTime     = sampleTime;
+    est->hostTime       = (double)hostTime;
+    est->ticksPerSample = est->ticksPerSecond / sampleRate;
+    est->startTime      = sampleTime;
+}
+
+void RightMicClock_Measure(RightMicClockEstimator *est, uint32_t clockID, uint32_t sampleRate,
+                           double sampleTime, uint64_t hostTime)
+{
+    if (sampleRate == 0) {
+        return;
+    }
+    if (est->sampleRate == 0 || clockID != est->clockID || sampleRate != est->sampleRate ||
+        !(sampleTime > est->sampleTime)) {
+        Restart(est, clockID, sampleRate, sampleTime, hostTime);
+        return;
+    }
+
+    double elapsed   = sampleTime - est->sampleTime;
+    double predicted = est->hostTime + elapsed * est->ticksPerSample;
+    double error     = (double)hostTime - predicted;
+
+    if (fabs(error) > kRightMicClock_MaxErrorSeconds * est->ticksPerSecond) {
+        /* The device restarted, or its sample time skipped: a new clock. */
+        Restart(est, clockID, sampleRate, sampleTime, hostTime);
+        return;
+    }
+    if (elapsed > kRightMicClock_MaxGapSeconds * sampleRate) {
+        /* Same clock after a pause; one step over the whole gap would
+         * swing the rate, so pick up from here with the rate we had. */
+        est->sampleTime = sampleTime;
+        est->hostTime   = (double)hostTime;
+        return;
+    }
+
+    /* Second-order DLL (F. Adriaensen, "Using a DLL to filter time"),
+     * with gains for the span this measurement covers. */
+    double seconds   = (sampleTime - est->startTime) / sampleRate;
+    double bandwidth = kRightMicClock_StartBandwidth / (1.0 + seconds / kRightMicClock_StartSeconds);
+    if (bandwidth < kRightMicClock_Bandwidth) {
+        bandwidth = kRightMicClock_Bandwidth;
+    }
+    double omega = 2.0 * M_PI * bandwidth * elapsed / sampleRate;
+    if (omega > 0.5) {
+        omega = 0.5;
+    }
+    est->hostTime        = predicted + M_SQRT2 * omega * error;
+    est->sampleTime      = sampleTime;
+    est->ticksPerSample += omega * omega * error / elapsed;
+
+    double nominal = est->ticksPerSecond / sampleRate;
+    if (fabs(est->ticksPerSample / nominal - 1.0) > kRightMicClock_MaxPPM * 1e-6) {
+        Restart(est, clockID, sampleRate, sampleTime, hostTime);
+    }
+}
+
+void RightMicClock_Update(RightMicClockEstimator *est, const RightMicClockTable *table)
+{
+    uint64_t count = atomic_load_explicit(&table->count, memory_order_acquire);
+    if (count < est->next) {
+        est->next = 0;  /* the app reopened the ring */
+    }
+    if (count - est->next > kRightMic_ClockEntries) {
+        est->next = count - kRightMic_ClockEntries;
+    }
+
+    for (uint64_t i = est->next; i < count; i++) {
+        const RightMicClockEntry *entry = &table->entries[i % kRightMic_ClockEntries];
+        uint64_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if (sequence != i + 1) {
+            continue;  /* overwritten since count was read */
+        }
+        double   sampleTime = atomic_load_explicit(&entry->sampleTime, memory_order_relaxed);
+        uint64_t hostTime   = atomic_load_explicit(&entry->hostTime, memory_order_relaxed);
+        uint32_t clockID    = atomic_load_explicit(&entry->clockID, memory_order_relaxed);
+        uint32_t sampleRate = atomic_load_explicit(&entry->sampleRate, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) != sequence) {
+            continue;
+        }
+        RightMicClock_Measure(est, clockID, sampleRate, sampleTime, hostTime);
+    }
+    est->next = count;
+}
+
+bool RightMicClock_IsLocked(const RightMicClockEstimator *est)
+{
+    return est->sampleRate != 0 &&
+           est->sampleTime - est->startTime >= kRightMicClock_LockSeconds * est->sampleRate;
+}
+
+double RightMicClock_Ratio(const RightMicClockEstimator *est)
+{
+    if (!RightMicClock_IsLocked(est)) {
+        return 1.0;
+    }
+    return est->ticksPerSample * est->sampleRate / est->ticksPerSecond;
+}
+
+double RightMicClock_PPM(const RightMicClockEstimator *est)
+{
+    return (1.0 / RightMicClock_Ratio(est) - 1.0) * 1e6;
+}
+
+/* ================================================================
+ * Timeline
+ * ================================================================ */
+
+void RightMicClock_StartTimeline(RightMicClockTimeline *tl, const RightMicClockEstimator *est,
+                                 uint64_t hostTime, uint32_t periodFrames, double ticksPerPeriod)
+{
+    tl->hostTime        = hostTime;
+    tl->hostFraction    = 0.0;
+    tl->sampleTime      = 0.0;
+    tl->ticksPerPeriod  = ticksPerPeriod;
+    tl->periodFrames    = periodFrames;
+    tl->seed           += 1;
+    tl->discontinuities = est->discontinuities;
+}
+
+void RightMicClock_ZeroTimeStamp(RightMicClockTimeline *tl, const RightMicClockEstimator *est,
+                                 uint64_t now, double *outSampleTime, uint64_t *outHostTime,
+                                 uint64_t *outSeed)
+{
+    if (est->discontinuities != tl->discontinuities) {
+        tl->discontinuities = est->discontinuities;
+        tl->seed += 1;
+    }
+
+    /* Periods are spaced by the rate in force when they are reached, so
+     * a new estimate bends the timeline without moving any timestamp
+     * already handed out. */
+    double period = tl->ticksPerPeriod * RightMicClock_Ratio(est);
+    if (now > tl->hostTime && period > 0.0) {
+        double elapsed = (double)(now - tl->hostTime) - tl->hostFraction;
+        double periods = floor(elapsed / period);
+        if (periods > 0.0) {
+            double advance = tl->hostFraction + periods * period;
+            double whole   = floor(advance);
+            tl->hostTime     += (uint64_t)whole;
+            tl->hostFraction  = advance - whole;
+            tl->sampleTime   += periods * tl->periodFrames;
+        }
+    }
+
+    *outSampleTime = tl->sampleTime;
+    *outHostTime   = tl->hostTime;
+    *outSeed       = tl->seed;
+}
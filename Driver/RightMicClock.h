@@ -0,0 +1,144 @@
+/*
+ * RightMicClock.h
+ * The capture device's sample clock, as seen by the driver.
+ *
+ * GetZeroTimeStamp used to run the virtual device at exactly its
+ * nominal rate on the host clock, while the app writes the ring at
+ * whatever rate the real microphone actually runs.  The two differ by
+ * tens to hundreds of ppm, which RightMicDrift then has to absorb.
+ *
+ * Instead, the capture callback publishes the sample time / host time
+ * pair of each AudioTimeStamp it receives into a small table in the
+ * header page (RightMicClockTable in RightMicDriver.h), and the driver
+ * follows that clock:
+ *
+ *   estimator  a second-order delay-locked loop over the published
+ *              pairs, giving host ticks per capture sample.  It starts
+ *              wide so it locks within a few seconds and narrows to a
+ *              fraction of a hertz, which filters callback jitter down
+ *              to a few ppm.  A new device, a sample time that jumps
+ *              or runs backwards, or a rate no real clock has restarts
+ *              the loop and counts a discontinuity.
+ *   timeline   the zero timestamps: one every ZeroTimeStampPeriod
+ *              frames, spaced by the estimated rate once the loop has
+ *              locked (nominal before).  A discontinuity bumps the
+ *              seed so the HAL drops what it learned of the old clock.
+ *
+ * The table has one writer, the callback of the device that owns the
+ * ring; the estimator and the timeline are the IO thread's alone.
+ * Portable C11 (no CoreAudio/Darwin), unit-tested on Linux.
+ */
+
+#ifndef RightMicClock_h
+#define RightMicClock_h
+
+#include "RightMicDriver.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Tuning ───────────────────────────────────────────────────── */
+
+/* Loop bandwidth (Hz): kRightMicClock_StartBandwidth at the first      */
+/* measurement, falling as start / (1 + t / kRightMicClock_StartSeconds) */
+/* to kRightMicClock_Bandwidth.  With 100 µs of timestamp jitter that   */
+/* is within ~20 ppm after the lock time and a few ppm after 20 s.      */
+#define kRightMicClock_Bandwidth       0.05
+#define kRightMicClock_StartBandwidth  2.0
+#define kRightMicClock_StartSeconds    0.5
+
+/* Seconds of a device's clock the loop must see before it is used.    */
+#define kRightMicClock_LockSeconds     4.0
+
+/* A timestamp this far (s) from where the loop expects it is a new     */
+/* clock, not jitter.                                                   */
+#define kRightMicClock_MaxErrorSeconds 0.002
+
+/* After a gap this long (s) between timestamps the loop re-anchors     */
+/* its phase (keeping the rate) rather than steer over the whole gap.   */
+#define kRightMicClock_MaxGapSeconds   1.0
+
+/* Furthest a believable estimate strays from the nominal rate.         */
+#define kRightMicClock_MaxPPM          2000.0
+
+/* ── Producer (the capture callback) ──────────────────────────── */
+
+/* Empty the table: no entry reads as valid until published again.     */
+/* Before the callback runs.                                            */
+void RightMicClock_InitProducer(RightMicClockTable *table);
+
+/* Publish one AudioTimeStamp from device `clockID`, running at a        */
+/* nominal `sampleRate`.  Only the ring's current owner may publish.    */
+/* Real-time safe.                                                      */
+void RightMicClock_Publish(RightMicClockTable *table, uint32_t clockID, uint32_t sampleRate,
+                           double sampleTime, uint64_t hostTime);
+
+/* ── Estimator (the driver's IO thread) ───────────────────────── */
+
+typedef struct {
+    double   ticksPerSecond;  /* nominal host clock rate                    */
+    uint64_t next;            /* next table entry to read                   */
+    uint32_t clockID;         /* device being tracked                       */
+    uint32_t sampleRate;      /* its nominal rate; 0 = nothing tracked yet  */
+    double   sampleTime;      /* of the last measurement                    */
+    double   hostTime;        /* loop's host time for it (ticks)            */
+    double   ticksPerSample;  /* loop's rate                                */
+    double   startTime;       /* sample time the loop (re)started at        */
+    uint64_t discontinuities; /* restarts after the first measurement       */
+} RightMicClockEstimator;
+
+/* Forget everything.  `ticksPerSecond` is the host clock's rate       */
+/* (1e9 for nanoseconds; mach ticks per second on the Mac).            */
+void RightMicClock_InitEstimator(RightMicClockEstimator *est, double ticksPerSecond);
+
+/* Feed every entry published since the last call.  Real-time safe:    */
+/* at most kRightMic_ClockEntries measurements, no locks.              */
+void RightMicClock_Update(RightMicClockEstimator *est, const RightMicClockTable *table);
+
+/* Feed one timestamp.  Exposed for tests; Update calls it.            */
+void RightMicClock_Measure(RightMicClockEstimator *est, uint32_t clockID, uint32_t sampleRate,
+                           double sampleTime, uint64_t hostTime);
+
+/* True once the loop has tracked one clock for kRightMicClock_LockSeconds. */
+bool RightMicClock_IsLocked(const RightMicClockEstimator *est);
+
+/* Length of a capture sample relative to nominal (> 1: the device     */
+/* runs slow), or exactly 1 until the loop has locked.                  */
+double RightMicClock_Ratio(const RightMicClockEstimator *est);
+
+/* Capture rate error in ppm (positive = fast), or 0 until locked. */
+double RightMicClock_PPM(const RightMicClockEstimator *est);
+
+/* ── Timeline (GetZeroTimeStamp) ──────────────────────────────── */
+
+typedef struct {
+    uint64_t hostTime;        /* of the current zero timestamp              */
+    double   hostFraction;    /* and the fraction of a tick past it         */
+    double   sampleTime;      /* its sample time                            */
+    double   ticksPerPeriod;  /* nominal host ticks per period              */
+    uint32_t periodFrames;    /* frames between zero timestamps             */
+    uint64_t seed;            /* 0 until the first Start                    */
+    uint64_t discontinuities; /* the estimator's count the seed reflects    */
+} RightMicClockTimeline;
+
+/* Begin a new timeline, under a new seed: sample time 0 at `hostTime`, */
+/* one zero timestamp every `periodFrames` frames of `ticksPerPeriod`   */
+/* nominal ticks.                                                       */
+void RightMicClock_StartTimeline(RightMicClockTimeline *tl, const RightMicClockEstimator *est,
+                                 uint64_t hostTime, uint32_t periodFrames, double ticksPerPeriod);
+
+/* The latest zero timestamp at or before `now`, its periods scaled by  */
+/* RightMicClock_Ratio.  Real-time safe.                                */
+void RightMicClock_ZeroTimeStamp(RightMicClockTimeline *tl, const RightMicClockEstimator *est,
+                                 uint64_t now, double *outSampleTime, uint64_t *outHostTime,
+                                 uint64_t *outSeed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicClock_h */
@@ -0,0 +1,287 @@
+/*
+ * RightMicConceal.c
+ * Packet-loss concealment for ring underruns.
+ *
+ * See RightMicConceal.h.
+ */
+
+#include "RightMicConceal.h"
+
+#include <math.h>
+#include <string.h>
+
+#define kHistoryMask   (kRightMicConceal_HistoryFrames - 1)
+#define kPi            3.14159265358979323846f
+
+/* Analysis window for the period search, and its 4× decimated form. */
+#define kWindowFrames  480
+#define kDecimation    4
+
+/* ================================================================
+ * Lifecycle
+ * ================================================================ */
+
+static RightMicConcealMode ResolveMode(RightMicConcealMode mode)
+{
+    switch (mode) {
+    case kRightMicConceal_FadeOut:
+    case kRightMicConceal_Crossfade:
+    case kRightMicConceal_PitchRepeat:
+    case kRightMicConceal_Silence:
+        return mode;
+    case kRightMicConceal_Default:
+    default:
+        return kRightMicConceal_PitchRepeat;
+    }
+}
+
+void RightMicConceal_Init(RightMicConceal *c, RightMicConcealMode mode)
+{
+    memset(c, 0, sizeof(*c));
+    c->mode = ResolveMode(mode);
+}
+
+void RightMicConceal_SetMode(RightMicConceal *c, RightMicConcealMode mode)
+{
+    c->mode = ResolveMode(mode);
+}
+
+/* ================================================================
+ * History
+ * ================================================================ */
+
+/* Sample `ch` of the frame played `back` frames ago (1 = most recent),
+ * or 0 if that frame has dropped out of (or never entered) the history. */
+static inline float History(const RightMicConceal *c, uint32_t back, uint32_t ch)
+{
+    if (back == 0 || back > c->played || back > kRightMicConceal_HistoryFrames) return 0.0f;
+    uint64_t frame = (c->played - back) & kHistoryMask;
+    return c->history[frame * kRightMic_ChannelCount + ch];
+}
+
+static void PushHistory(RightMicConceal *c, const float *frames, uint32_t frameCount)
+{
+    if (frameCount > kRightMicConceal_HistoryFrames) {
+        frames    += (size_t)(frameCount - kRightMicConceal_HistoryFrames) * kRightMic_ChannelCount;
+        c->played += frameCount - kRightMicConceal_HistoryFrames;
+        frameCount = kRightMicConceal_HistoryFrames;
+    }
+    while (frameCount > 0) {
+        uint32_t index = (uint32_t)(c->played & kHistoryMask);
+        uint32_t chunk = kRightMicConceal_HistoryFrames - index;
+        if (chunk > frameCount) chunk = frameCount;
+        memcpy(c->history + (size_t)index * kRightMic_ChannelCount, frames,
+               (size_t)chunk * kRightMic_BytesPerFrame);
+        frames     += (size_t)chunk * kRightMic_ChannelCount;
+        c->played  += chunk;
+        frameCount -= chunk;
+    }
+}
+
+/* ================================================================
+ * Period Detection
+ * ================================================================ */
+
+/* Normalised cross-correlation of x[0..n) with x[lag..lag+n). */
+static float Correlate(const float *x, uint32_t n, uint32_t lag)
+{
+    float xy = 0.0f, xx = 0.0f, yy = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        float a = x[i], b = x[i + lag];
+        xy += a * b;
+        xx += a * a;
+        yy += b * b;
+    }
+    float denom = sqrtf(xx * yy);
+    return denom > 1e-12f ? xy / denom : 0.0f;
+}
+
+uint32_t RightMicConceal_DetectPeriod(const RightMicConceal *c)
+{
+    enum { kSpan = kWindowFrames + kRightMicConceal_MaxPeriod + kDecimation };
+    if (c->played < kSpan) return 0;
+
+    /* Mono, newest first: mono[0] is the last frame played, so a positive
+     * lag looks further into the past. */
+    float mono[kSpan];
+    for (uint32_t i = 0; i < kSpan; i++) {
+        float sum = 0.0f;
+        for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) sum += History(c, i + 1, ch);
+        mono[i] = sum;
+    }
+
+    /* Coarse search on a 4× decimated copy. */
+    float dec[kSpan / kDecimation];
+    for (uint32_t i = 0; i < kSpan / kDecimation; i++) {
+        float sum = 0.0f;
+        for (uint32_t k = 0; k < kDecimation; k++) sum += mono[i * kDecimation + k];
+        dec[i] = sum;
+    }
+
+    const uint32_t minLag = kRightMicConceal_MinPeriod / kDecimation;
+    const uint32_t maxLag = kRightMicConceal_MaxPeriod / kDecimation;
+    float scores[kRightMicConceal_MaxPeriod / kDecimation + 1];
+    float best = 0.0f;
+    for (uint32_t lag = minLag; lag <= maxLag; lag++) {
+        scores[lag] = Correlate(dec, kWindowFrames / kDecimation, lag);
+        if (scores[lag] > best) best = scores[lag];
+    }
+    if (best < 0.5f) return 0;
+
+    /* Prefer the shortest lag that is nearly as good as the best one, so a
+     * clean voice doesn't lock onto two or three periods. */
+    uint32_t coarse = 0;
+    for (uint32_t lag = minLag; lag <= maxLag; lag++) {
+        int peak = (lag == minLag || scores[lag] >= scores[lag - 1]) &&
+                   (lag == maxLag || scores[lag] >= scores[lag + 1]);
+        if (peak && scores[lag] >= 0.85f * best) {
+            coarse = lag;
+            break;
+        }
+    }
+    if (coarse == 0) return 0;
+
+    /* Refine at full rate around the coarse estimate. */
+    uint32_t lo = coarse * kDecimation - kDecimation;
+    uint32_t hi = coarse * kDecimation + kDecimation;
+    if (lo < kRightMicConceal_MinPeriod) lo = kRightMicConceal_MinPeriod;
+    if (hi > kRightMicConceal_MaxPeriod) hi = kRightMicConceal_MaxPeriod;
+    uint32_t period = lo;
+    float    score  = -1.0f;
+    for (uint32_t lag = lo; lag <= hi; lag++) {
+        float r = Correlate(mono, kWindowFrames, lag);
+        if (r > score) {
+            score  = r;
+            period = lag;
+        }
+    }
+    return period;
+}
+
+/* ================================================================
+ * Synthesis
+ * ================================================================ */
+
+/* Raised-cosine ramp 0 → 1 over `length` frames. */
+static inline float RampUp(uint32_t j, uint32_t length)
+{
+    return 0.5f - 0.5f * cosf(kPi * ((float)j + 0.5f) / (float)length);
+}
+
+static uint32_t OverlapFor(uint32_t period)
+{
+    uint32_t overlap = kRightMicConceal_OverlapFrames;
+    if (overlap > period / 2) overlap = period / 2;
+    return overlap ? overlap : 1;
+}
+
+/* Frame `k` of the current gap, written to out[0..channels). */
+static void SynthFrame(const RightMicConceal *c, uint32_t k, float *out)
+{
+    switch (c->mode) {
+    case kRightMicConceal_FadeOut: {
+        /* Reflect the signal about the last played frame and fade it out:
+         * continuous in value at the join, silent after a few ms. */
+        float gain = k < kRightMicConceal_FadeFrames
+                   ? 1.0f - RampUp(k, kRightMicConceal_FadeFrames) : 0.0f;
+        for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) {
+            out[ch] = gain * History(c, k + 2, ch);
+        }
+        return;
+    }
+
+    case kRightMicConceal_Crossfade:
+    case kRightMicConceal_PitchRepeat: {
+        /* Loop the last `period` frames.  Each pass starts with a short
+         * crossfade from the reflected tail (the natural continuation of
+         * what was just heard) into the start of the loop. */
+        float gain;
+        if (k < kRightMicConceal_HoldFrames) {
+            gain = 1.0f;
+        } else if (k < kRightMicConceal_MaxFrames) {
+            gain = 1.0f - RampUp(k - kRightMicConceal_HoldFrames,
+                                 kRightMicConceal_MaxFrames - kRightMicConceal_HoldFrames);
+        } else {
+            gain = 0.0f;
+        }
+        uint32_t j       = k % c->period;
+        uint32_t overlap = OverlapFor(c->period);
+        for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) {
+            float v = History(c, c->period - j, ch);
+            if (j < overlap) {
+                float w = RampUp(j, overlap);
+                v = w * v + (1.0f - w) * History(c, j + 2, ch);
+            }
+            out[ch] = gain * v;
+        }
+        return;
+    }
+
+    case kRightMicConceal_Silence:
+    case kRightMicConceal_Default:
+    default:
+        for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) out[ch] = 0.0f;
+        return;
+    }
+}
+
+static uint32_t SilentAfter(const RightMicConceal *c)
+{
+    switch (c->mode) {
+    case kRightMicConceal_FadeOut:     return kRightMicConceal_FadeFrames;
+    case kRightMicConceal_Crossfade:
+    case kRightMicConceal_PitchRepeat: return kRightMicConceal_MaxFrames;
+    default:                           return 0;
+    }
+}
+
+void RightMicConceal_Fill(RightMicConceal *c, float *out, uint32_t frameCount)
+{
+    if (!c->inGap) {
+        c->inGap     = 1;
+        c->gapFrames = 0;
+        c->period    = 0;
+        if (c->mode == kRightMicConceal_PitchRepeat) c->period = RightMicConceal_DetectPeriod(c);
+        if (c->period == 0) c->period = kRightMicConceal_SegmentFrames;
+    }
+
+    uint32_t silentAfter = SilentAfter(c);
+    uint32_t i = 0;
+    for (; i < frameCount && c->gapFrames + i < silentAfter; i++) {
+        SynthFrame(c, c->gapFrames + i, out + (size_t)i * kRightMic_ChannelCount);
+    }
+    if (i < frameCount) {
+        memset(out + (size_t)i * kRightMic_ChannelCount, 0,
+               (size_t)(frameCount - i) * kRightMic_BytesPerFrame);
+    }
+    /* Saturate: a day-long gap must not wrap back into synthesis. */
+    c->gapFrames = c->gapFrames + frameCount >= silentAfter + frameCount
+                 ? silentAfter + frameCount : c->gapFrames + frameCount;
+}
+
+void RightMicConceal_Feed(RightMicConceal *c, float *frames, uint32_t frameCount)
+{
+    if (c->inGap && c->mode != kRightMicConceal_Silence) {
+        /* Crossfade from where the concealment would have gone next into
+         * the real signal, so resuming is as smooth as stopping was. */
+        uint32_t overlap = kRightMicConceal_OverlapFrames;
+        if (overlap > frameCount) overlap = frameCount;
+        uint32_t silentAfter = SilentAfter(c);
+        float cont[kRightMic_ChannelCount];
+        for (uint32_t j = 0; j < overlap; j++) {
+            uint32_t k = c->gapFrames + j;
+            if (k < silentAfter) {
+                SynthFrame(c, k, cont);
+            } else {
+                memset(cont, 0, sizeof(cont));
+            }
+            float w = RampUp(j, overlap);
+            float *f = frames + (size_t)j * kRightMic_ChannelCount;
+            for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) {
+                f[ch] = w * f[ch] + (1.0f - w) * cont[ch];
+            }
+        }
+    }
+    c->inGap = 0;
+    PushHistory(c, frames, frameCount);
+}
@@ -0,0 +1,86 @@
+/*
+ * RightMicConceal.h
+ * Packet-loss concealment for ring underruns.
+ *
+ * When the reader runs short it emits the frames that are there and asks
+ * this module to synthesise only the missing tail.  The concealer keeps a
+ * short history of what was actually played, so it can continue the
+ * signal instead of cutting to zero, and it crossfades back into real
+ * audio when the producer catches up.
+ *
+ * Modes (selected by the app through the ring header):
+ *   FadeOut     – mirror the last few ms and fade them out; fade back in.
+ *   Crossfade   – loop the last 10 ms with short crossfaded joins.
+ *   PitchRepeat – loop the last pitch period (autocorrelation search),
+ *                 which keeps voiced speech sounding natural.
+ *   Silence     – zeros for the deficit only (no smoothing).
+ * Looping modes decay to silence after kRightMicConceal_MaxFrames, so a
+ * real stall never turns into a buzzing loop.
+ *
+ * Portable C11 (no CoreAudio/Darwin), unit-tested and benchmarked on Linux.
+ */
+
+#ifndef RightMicConceal_h
+#define RightMicConceal_h
+
+#include "RightMicDriver.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Configuration ────────────────────────────────────────────── */
+
+typedef enum {
+    kRightMicConceal_Default     = 0,  /* header value 0 → PitchRepeat */
+    kRightMicConceal_FadeOut     = 1,
+    kRightMicConceal_Crossfade   = 2,
+    kRightMicConceal_PitchRepeat = 3,
+    kRightMicConceal_Silence     = 4,
+} RightMicConcealMode;
+
+#define kRightMicConceal_HistoryFrames  2048  /* played frames kept for analysis (power of 2) */
+#define kRightMicConceal_MinPeriod        96  /* 500 Hz at 48 kHz                             */
+#define kRightMicConceal_MaxPeriod       800  /* 60 Hz at 48 kHz                              */
+#define kRightMicConceal_SegmentFrames   480  /* Crossfade mode loop length (10 ms)           */
+#define kRightMicConceal_OverlapFrames    64  /* crossfade at loop joins and on resume        */
+#define kRightMicConceal_FadeFrames      240  /* FadeOut ramp (5 ms)                          */
+#define kRightMicConceal_HoldFrames      480  /* looping modes play at full level this long … */
+#define kRightMicConceal_MaxFrames      1440  /* … then decay to silence by here (30 ms)      */
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    RightMicConcealMode mode;
+    float    history[kRightMicConceal_HistoryFrames * kRightMic_ChannelCount];
+    uint64_t played;     /* real frames fed so far (history write cursor) */
+    uint32_t gapFrames;  /* frames synthesised in the current gap         */
+    uint32_t period;     /* loop length for the current gap               */
+    int      inGap;      /* last output came from Fill                    */
+} RightMicConceal;
+
+void RightMicConceal_Init(RightMicConceal *c, RightMicConcealMode mode);
+
+/* Change mode; takes effect at the next gap. */
+void RightMicConceal_SetMode(RightMicConceal *c, RightMicConcealMode mode);
+
+/* Record frames that were just played from the ring.  If they end a   */
+/* gap, the first kRightMicConceal_OverlapFrames are crossfaded in     */
+/* place from the concealment into the real signal.                    */
+void RightMicConceal_Feed(RightMicConceal *c, float *frames, uint32_t frameCount);
+
+/* Synthesise `frameCount` frames continuing the played signal (or the */
+/* current gap).                                                       */
+void RightMicConceal_Fill(RightMicConceal *c, float *out, uint32_t frameCount);
+
+/* Pitch period of the most recent history in frames, or 0 if there is */
+/* no clear periodicity.  Exposed for tests and benchmarks.            */
+uint32_t RightMicConceal_DetectPeriod(const RightMicConceal *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicConceal_h */
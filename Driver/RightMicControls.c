@@ -0,0 +1,177 @@
+/*
+ * RightMicControls.c
+ * Seqlock-protected snapshot of the app's dynamic control table.
+ *
+ * See RightMicControls.h.
+ */
+
+#include "RightMicControls.h"
+
+#include <string.h>
+
+_Static_assert(sizeof(RightMicControlEntry) == kRightMicControls_EntryWords * sizeof(uint32_t),
+               "control entry must be a whole number of words");
+
+static uint32_t FloatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* ================================================================
+ * Writer
+ * ================================================================ */
+
+void RightMicControls_Init(RightMicControlSnapshot *snapshot)
+{
+    atomic_store_explicit(&snapshot->sequence, 0, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->count, 0, memory_order_relaxed);
+    for (uint32_t i = 0; i < kRightMic_MaxControls; i++) {
+        for (uint32_t w = 0; w < kRightMicControls_EntryWords; w++) {
+            atomic_store_explicit(&snapshot->words[i][w], 0, memory_order_relaxed);
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+}
+
+static void BeginWrite(RightMicControlSnapshot *snapshot)
+{
+    uint32_t seq = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, seq + 1, memory_order_relaxed);
+    /* The odd sequence is visible before any word changes. */
+    atomic_thread_fence(memory_order_release);
+}
+
+static void EndWrite(RightMicControlSnapshot *snapshot)
+{
+    uint32_t seq = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, seq + 1, memory_order_release);
+}
+
+bool RightMicControls_CopyTable(RightMicControlSnapshot *snapshot,
+                                const RightMicControlTable *table, uint32_t *outVersion)
+{
+    /* Stage a local copy first, validated against the app's version. */
+    uint32_t version = atomic_load_explicit(&table->version, memory_order_acquire);
+    if (version & 1) return false;
+
+    uint32_t count = atomic_load_explicit(&table->count, memory_order_relaxed);
+    if (count > kRightMic_MaxControls) count = kRightMic_MaxControls;
+
+    uint32_t words[kRightMic_MaxControls][kRightMicControls_EntryWords];
+    for (uint32_t i = 0; i < count; i++) {
+        const RightMicControlEntry *e = &table->entries[i];
+        words[i][0] = e->classID;
+        words[i][1] = e->scope;
+        words[i][2] = e->element;
+        words[i][3] = atomic_load_explicit(&e->uintValue, memory_order_relaxed);
+        words[i][4] = FloatBits(atomic_load_explicit(&e->floatValue, memory_order_relaxed));
+        words[i][5] = FloatBits(e->minDB);
+        words[i][6] = FloatBits(e->maxDB);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&table->version, memory_order_relaxed) != version) return false;
+
+    BeginWrite(snapshot);
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t w = 0; w < kRightMicControls_EntryWords; w++) {
+            atomic_store_explicit(&snapshot->words[i][w], words[i][w], memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&snapshot->count, count, memory_order_relaxed);
+    EndWrite(snapshot);
+
+    if (outVersion != NULL) *outVersion = version;
+    return true;
+}
+
+void RightMicControls_Clear(RightMicControlSnapshot *snapshot)
+{
+    BeginWrite(snapshot);
+    atomic_store_explicit(&snapshot->count, 0, memory_order_relaxed);
+    EndWrite(snapshot);
+}
+
+/* ================================================================
+ * Readers
+ * ================================================================ */
+
+static void LoadEntry(const RightMicControlSnapshot *snapshot, uint32_t index,
+                      RightMicControlEntry *out)
+{
+    const _Atomic uint32_t *w = snapshot->words[index];
+    out->classID = atomic_load_explicit(&w[0], memory_order_relaxed);
+    out->scope   = atomic_load_explicit(&w[1], memory_order_relaxed);
+    out->element = atomic_load_explicit(&w[2], memory_order_relaxed);
+    atomic_store_explicit(&out->uintValue, atomic_load_explicit(&w[3], memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&out->floatValue, BitsFloat(atomic_load_explicit(&w[4], memory_order_relaxed)),
+                          memory_order_relaxed);
+    out->minDB   = BitsFloat(atomic_load_explicit(&w[5], memory_order_relaxed));
+    out->maxDB   = BitsFloat(atomic_load_explicit(&w[6], memory_order_relaxed));
+}
+
+/* The sequence to read under, or odd if the writer is mid-update. */
+static uint32_t BeginRead(const RightMicControlSnapshot *snapshot)
+{
+    return atomic_load_explicit(&snapshot->sequence, memory_order_acquire);
+}
+
+/* True if nothing was written since BeginRead returned `seq`. */
+static bool EndRead(const RightMicControlSnapshot *snapshot, uint32_t seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return (seq & 1) == 0 &&
+           atomic_load_explicit(&snapshot->sequence, memory_order_relaxed) == seq;
+}
+
+uint32_t RightMicControls_Count(const RightMicControlSnapshot *snapshot)
+{
+    /* A single word is never torn. */
+    return atomic_load_explicit(&snapshot->count, memory_order_acquire);
+}
+
+bool RightMicControls_Get(const RightMicControlSnapshot *snapshot, uint32_t index,
+                          RightMicControlEntry *outEntry)
+{
+    for (;;) {
+        uint32_t seq = BeginRead(snapshot);
+        if (seq & 1) continue;
+        bool found = index < atomic_load_explicit(&snapshot->count, memory_order_relaxed) &&
+                     index < kRightMic_MaxControls;
+        if (found) LoadEntry(snapshot, index, outEntry);
+        if (EndRead(snapshot, seq)) return found;
+    }
+}
+
+bool RightMicControls_TryRead(const RightMicControlSnapshot *snapshot, uint32_t *ioSequence,
+                              RightMicControlEntry outEntries[kRightMic_MaxControls],
+                              uint32_t *outCount)
+{
+    uint32_t seq = BeginRead(snapshot);
+    if (seq == *ioSequence || (seq & 1)) return false;
+
+    RightMicControlEntry entries[kRightMic_MaxControls];
+    uint32_t count = atomic_load_explicit(&snapshot->count, memory_order_relaxed);
+    if (count > kRightMic_MaxControls) count = kRightMic_MaxControls;
+    for (uint32_t i = 0; i < count; i++) {
+        LoadEntry(snapshot, i, &entries[i]);
+    }
+    if (!EndRead(snapshot, seq)) return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        outEntries[i] = entries[i];
+    }
+    *outCount   = count;
+    *ioSequence = seq;
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * RightMicControls.h
+ * Seqlock-protected snapshot of the app's dynamic control table.
+ *
+ * The driver exposes the real device's controls (see the control table
+ * in RightMicDriver.h) as objects on the virtual device.  Their list is
+ * read on every property call and by the IO thread's mute check, and is
+ * rewritten by a background worker whenever the app changes it, so
+ * readers need a consistent view without ever blocking the writer or
+ * each other.
+ *
+ * The snapshot is a seqlock: the single writer makes `sequence` odd,
+ * stores every field as a relaxed atomic word, then makes it even again;
+ * readers copy the words and retry if the sequence was odd or moved.  A
+ * reader can therefore never see half of one entry and half of another.
+ * The IO thread uses TryRead, a single attempt that keeps its previous
+ * copy if the writer is mid-update, so it never spins on a preempted
+ * low-priority writer.
+ *
+ * Copying from shared memory is validated the same way: the app makes
+ * the table's `version` odd while it rewrites the entries, and a copy
+ * that saw an odd or changing version is discarded and retried later.
+ *
+ * Portable C11 (no CoreAudio/Darwin), unit-tested on Linux.
+ */
+
+#ifndef RightMicControls_h
+#define RightMicControls_h
+
+#include "RightMicDriver.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kRightMicControls_EntryWords  7  /* sizeof(RightMicControlEntry) / 4 */
+
+typedef struct {
+    _Atomic uint32_t sequence;  /* odd while the writer is updating */
+    _Atomic uint32_t count;
+    _Atomic uint32_t words[kRightMic_MaxControls][kRightMicControls_EntryWords];
+} RightMicControlSnapshot;
+
+/* Empty snapshot (no controls). */
+void RightMicControls_Init(RightMicControlSnapshot *snapshot);
+
+/* ── Writer (one thread) ──────────────────────────────────────── */
+
+/* Copy the app's table into the snapshot.  Returns false, leaving the  */
+/* snapshot untouched, if the app was rewriting the table; try again    */
+/* later.  `outVersion` receives the table version that was copied.    */
+bool RightMicControls_CopyTable(RightMicControlSnapshot *snapshot,
+                                const RightMicControlTable *table, uint32_t *outVersion);
+
+/* Publish an empty list (the app went away). */
+void RightMicControls_Clear(RightMicControlSnapshot *snapshot);
+
+/* ── Readers (any thread but the IO thread) ───────────────────── */
+
+uint32_t RightMicControls_Count(const RightMicControlSnapshot *snapshot);
+
+/* Copy entry `index`.  Returns false if there is no such control.      */
+bool RightMicControls_Get(const RightMicControlSnapshot *snapshot, uint32_t index,
+                          RightMicControlEntry *outEntry);
+
+/* ── IO thread ────────────────────────────────────────────────── */
+
+/* If the snapshot changed since `*ioSequence`, copy all entries and    */
+/* their count and return true.  One attempt: returns false, leaving    */
+/* the outputs alone, if nothing changed or the writer is mid-update.   */
+/* Real-time safe.                                                      */
+bool RightMicControls_TryRead(const RightMicControlSnapshot *snapshot, uint32_t *ioSequence,
+                              RightMicControlEntry outEntries[kRightMic_MaxControls],
+                              uint32_t *outCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicControls_h */
@@ -0,0 +1,77 @@
+/*
+ * RightMicCursor.c
+ * The ring consumer's read cursor.
+ *
+ * See RightMicCursor.h.
+ */
+
+#include "RightMicCursor.h"
+
+#include <stdatomic.h>
+
+/* ================================================================
+ * Setup
+ * ================================================================ */
+
+void RightMicCursor_Init(RightMicCursor *cursor)
+{
+    atomic_store_explicit(&cursor->targetLatency,  0, memory_order_relaxed);
+    atomic_store_explicit(&cursor->minSafeLatency, 0, memory_order_relaxed);
+    atomic_store_explicit(&cursor->sampleRate, (uint32_t)kRightMic_SampleRate, memory_order_relaxed);
+    atomic_store_explicit(&cursor->ringFrames, kRightMic_RingBufferFrames, memory_order_relaxed);
+    atomic_store_explicit(&cursor->resetPending, 1, memory_order_release);
+}
+
+void RightMicCursor_SetWatermarks(RightMicCursor *cursor,
+                                  uint32_t targetFrames, uint32_t minSafeFrames)
+{
+    atomic_store_explicit(&cursor->targetLatency,  targetFrames,  memory_order_relaxed);
+    atomic_store_explicit(&cursor->minSafeLatency, minSafeFrames, memory_order_relaxed);
+}
+
+void RightMicCursor_SetSampleRate(RightMicCursor *cursor, uint32_t sampleRate)
+{
+    atomic_store_explicit(&cursor->sampleRate, sampleRate, memory_order_relaxed);
+}
+
+void RightMicCursor_SetRingFrames(RightMicCursor *cursor, uint32_t ringFrames)
+{
+    atomic_store_explicit(&cursor->ringFrames, ringFrames, memory_order_relaxed);
+}
+
+void RightMicCursor_Restart(RightMicCursor *cursor)
+{
+    atomic_store_explicit(&cursor->resetPending, 1, memory_order_release);
+}
+
+/* ================================================================
+ * IO Thread
+ * ================================================================ */
+
+void RightMicCursor_Prepare(RightMicCursor *cursor, uint32_t frameCount)
+{
+    uint32_t target  = atomic_load_explicit(&cursor->targetLatency,  memory_order_relaxed);
+    uint32_t minSafe = atomic_load_explicit(&cursor->minSafeLatency, memory_order_relaxed);
+    uint32_t rate    = atomic_load_explicit(&cursor->sampleRate, memory_order_relaxed);
+    uint32_t ring    = atomic_load_explicit(&cursor->ringFrames, memory_order_relaxed);
+    bool reset   = atomic_exchange_explicit(&cursor->resetPending, 0, memory_order_acquire) != 0;
+    bool changed = target != cursor->rawTarget || minSafe != cursor->rawMinSafe ||
+                   frameCount != cursor->frameCount || rate != cursor->appliedRate ||
+                   ring != cursor->appliedRing;
+    if (!reset && !changed) return;
+
+    cursor->rawTarget   = target;
+    cursor->rawMinSafe  = minSafe;
+    cursor->frameCount  = frameCount;
+    cursor->appliedRate = rate;
+    cursor->appliedRing = ring;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, frameCount, ring);
+    if (reset) {
+        RightMicRingReader_Reset(&cursor->reader);
+        cursor->underrunRun = 0;
+        RightMicDrift_Init(&cursor->drift, target, minSafe);
+    } else {
+        RightMicDrift_SetWatermarks(&cursor->drift, target, minSafe);
+    }
+    RightMicDrift_SetSampleRate(&cursor->drift, (double)rate);
+}
@@ -0,0 +1,75 @@
+/*
+ * RightMicCursor.h
+ * The ring consumer's read cursor.
+ *
+ * The HAL performs ReadInput once per IO cycle for the whole device and
+ * fans the result out to every client, so one cursor serves them all: a
+ * ring reader plus the drift loop and concealment state that go with it.
+ * Settings change on other threads (StartIO, configuration changes) and
+ * are applied by the IO thread at the start of its next read, so the
+ * reader and drift loop are only ever touched from IO.
+ *
+ * Portable C11 (no CoreAudio/Darwin), unit-tested on Linux.
+ */
+
+#ifndef RightMicCursor_h
+#define RightMicCursor_h
+
+#include "RightMicDrift.h"
+#include "RightMicRing.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    _Atomic uint32_t   targetLatency;   /* raw watermarks, 0 = default         */
+    _Atomic uint32_t   minSafeLatency;
+    _Atomic uint32_t   sampleRate;      /* device rate the cursor produces     */
+    _Atomic uint32_t   ringFrames;      /* capacity of the ring it reads       */
+    _Atomic uint32_t   resetPending;    /* reinitialize on next Prepare        */
+    uint32_t           rawTarget;       /* watermarks, IO size, rate and ring … */
+    uint32_t           rawMinSafe;
+    uint32_t           frameCount;
+    uint32_t           appliedRate;
+    uint32_t           appliedRing;     /* … size last applied (IO thread only) */
+    uint64_t           underrunRun;     /* frames concealed in the current underrun */
+    RightMicRingReader reader;
+    RightMicDrift      drift;
+} RightMicCursor;
+
+/* Defaults, with a restart pending. */
+void RightMicCursor_Init(RightMicCursor *cursor);
+
+/* Watermarks as found in the ring header (0 selects the default).  The */
+/* cursor clamps them for the IO buffer size it reads with.             */
+void RightMicCursor_SetWatermarks(RightMicCursor *cursor,
+                                  uint32_t targetFrames, uint32_t minSafeFrames);
+
+/* Device rate the cursor reads out at (Init selects kRightMic_SampleRate). */
+void RightMicCursor_SetSampleRate(RightMicCursor *cursor, uint32_t sampleRate);
+
+/* Capacity of the ring the cursor reads, which bounds its watermarks   */
+/* (Init selects kRightMic_RingBufferFrames).                          */
+void RightMicCursor_SetRingFrames(RightMicCursor *cursor, uint32_t ringFrames);
+
+/* Start over: the next read resyncs to the target fill with a fresh    */
+/* drift loop.  Any thread.                                             */
+void RightMicCursor_Restart(RightMicCursor *cursor);
+
+/* ── IO thread ────────────────────────────────────────────────── */
+
+/* Apply a pending restart or settings change before a read of          */
+/* `frameCount` frames.  Real-time safe.                                */
+void RightMicCursor_Prepare(RightMicCursor *cursor, uint32_t frameCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicCursor_h */
@@ -0,0 +1,326 @@
+/*
+ * RightMicDrift.c
+ * Fill-level-locked clock drift compensation for the ring consumer.
+ *
+ * See RightMicDrift.h.
+ */
+
+#include "RightMicDrift.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/* ================================================================
+ * Controller
+ * ================================================================ */
+
+void RightMicDrift_ClampWatermarks(uint32_t *targetFill, uint32_t *minSafeFill,
+                                   uint32_t frameCount, uint32_t ringFrames)
+{
+    uint32_t target  = *targetFill  ? *targetFill  : kRightMic_DefaultTargetLatencyFor(frameCount);
+    uint32_t minSafe = *minSafeFill ? *minSafeFill : kRightMic_DefaultMinSafeLatencyFor(frameCount);
+
+    uint32_t span = frameCount + kRightMicDrift_LookAhead;
+
+    if (minSafe < kRightMicDrift_LookAhead) {
+        minSafe = kRightMicDrift_LookAhead;
+    }
+    if (target < minSafe + span) {
+        target = minSafe + span;
+    }
+    if (target > ringFrames / 2) {
+        /* A ring too small for this IO size fits no cushion at all. */
+        target = ringFrames / 2;
+        uint32_t room = target > span ? target - span : 0;
+        if (minSafe > room) minSafe = room;
+    }
+
+    *targetFill  = target;
+    *minSafeFill = minSafe;
+}
+
+void RightMicDrift_Init(RightMicDrift *drift, uint32_t targetFill, uint32_t minSafeFill)
+{
+    memset(drift, 0, sizeof(*drift));
+    drift->ratio      = 1.0;
+    drift->sampleRate = kRightMic_SampleRate;
+    RightMicDrift_SetWatermarks(drift, targetFill, minSafeFill);
+    RightMicConceal_Init(&drift->conceal, kRightMicConceal_Default);
+}
+
+void RightMicDrift_SetWatermarks(RightMicDrift *drift, uint32_t targetFill, uint32_t minSafeFill)
+{
+    drift->targetFill  = targetFill;
+    drift->minSafeFill = minSafeFill;
+}
+
+void RightMicDrift_SetSampleRate(RightMicDrift *drift, double sampleRate)
+{
+    drift->sampleRate = sampleRate;
+}
+
+void RightMicDrift_Resync(RightMicDrift *drift)
+{
+    drift->primed    = 0;
+    drift->refilling = 0;
+    drift->phase     = 0.0;
+}
+
+double RightMicDrift_Update(RightMicDrift *drift, double fill,
+                            uint32_t frameCount, double sampleRate)
+{
+    double dt = (double)frameCount / sampleRate;
+
+    if (!drift->primed) {
+        drift->filteredFill = fill;
+        drift->primed = 1;
+    } else {
+        double alpha = dt / (kRightMicDrift_FillFilterTau + dt);
+        drift->filteredFill += alpha * (fill - drift->filteredFill);
+    }
+
+    /* With fill error e (frames) and correction c = ratio - 1, the loop is
+     *     de/dt = sampleRate * (drift - c)
+     * Choosing c = (Kp*e + Ki*∫e dt) / sampleRate makes it a textbook
+     * second-order system with ωn² = Ki and 2ζωn = Kp, independent of
+     * the sample rate. */
+    const double kp = 2.0 * kRightMicDrift_LoopDamping * kRightMicDrift_LoopOmega;
+    const double ki = kRightMicDrift_LoopOmega * kRightMicDrift_LoopOmega;
+    const double maxCorrection = kRightMicDrift_MaxPPM * 1e-6;
+
+    double error      = drift->filteredFill - drift->targetFill;
+    double integral   = drift->integral + error * dt;
+    double correction = (kp * error + ki * integral) / sampleRate;
+
+    /* Anti-windup: only commit the integrator while unsaturated. */
+    if (correction > maxCorrection) {
+        correction = maxCorrection;
+    } else if (correction < -maxCorrection) {
+        correction = -maxCorrection;
+    } else {
+        drift->integral = integral;
+    }
+
+    drift->ratio = 1.0 + correction;
+    return drift->ratio;
+}
+
+double RightMicDrift_PPM(const RightMicDrift *drift)
+{
+    return (drift->ratio - 1.0) * 1e6;
+}
+
+/* ================================================================
+ * Resampling Read
+ * ================================================================ */
+
+static inline const float *FrameAt(const RightMicRing *ring, uint32_t channels, uint64_t frame)
+{
+    return ring->data + (frame & (ring->frames - 1)) * channels;
+}
+
+/* Catmull-Rom cubic through x0..x3, evaluated between x1 and x2. */
+static inline float Cubic(float x0, float x1, float x2, float x3, float t)
+{
+    float a = -0.5f * x0 + 1.5f * x1 - 1.5f * x2 + 0.5f * x3;
+    float b =         x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+    float c = -0.5f * x0             + 0.5f * x2;
+    return ((a * t + b) * t + c) * t + x1;
+}
+
+/* Interpolate `frameCount` stereo output frames starting `phase` frames
+ * past `readHead`, stepping `ratio` input frames per output frame.  A
+ * mono ring is interpolated once per frame and written to both channels,
+ * so expanding it costs nothing extra. */
+static void Interpolate(const RightMicRing *ring, uint32_t channels, uint64_t readHead,
+                        double phase, double ratio, float *out, uint32_t frameCount)
+{
+    double pos = phase;
+
+    /* All taps lie in one span starting a frame before readHead (a
+     * buffer's worth of ring frames and a few more).  The mirror makes
+     * any such span contiguous when the producer writes frames of the
+     * width the view was mapped for; otherwise it is when it stops short
+     * of the end. */
+    uint64_t first = (readHead - 1) & (ring->frames - 1);
+    double   span  = phase + (double)frameCount * ratio + kRightMicDrift_LookAhead + 1.0;
+    bool contiguous = (ring->mirrored && channels == ring->channels) ||
+                      (double)first + span <= (double)ring->frames;
+
+    if (contiguous && channels == 1) {
+        const float *base = FrameAt(ring, channels, readHead - 1);
+        for (uint32_t i = 0; i < frameCount; i++, pos += ratio) {
+            uint64_t idx = (uint64_t)pos;
+            float    t   = (float)(pos - (double)idx);
+            const float *x = base + idx;
+            float v = Cubic(x[0], x[1], x[2], x[3], t);
+            out[i * kRightMic_ChannelCount]     = v;
+            out[i * kRightMic_ChannelCount + 1] = v;
+        }
+        return;
+    }
+
+    if (contiguous) {
+        const float *base = FrameAt(ring, channels, readHead - 1);
+        for (uint32_t i = 0; i < frameCount; i++, pos += ratio) {
+            uint64_t idx = (uint64_t)pos;
+            float    t   = (float)(pos - (double)idx);
+            const float *x = base + idx * kRightMic_ChannelCount;
+            for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+                out[i * kRightMic_ChannelCount + c] =
+                    Cubic(x[c], x[kRightMic_ChannelCount + c],
+                          x[2 * kRightMic_ChannelCount + c], x[3 * kRightMic_ChannelCount + c], t);
+            }
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < frameCount; i++, pos += ratio) {
+        uint64_t idx   = (uint64_t)pos;
+        float    t     = (float)(pos - (double)idx);
+        uint64_t frame = readHead + idx;
+        const float *x0 = FrameAt(ring, channels, frame - 1);
+        const float *x1 = FrameAt(ring, channels, frame);
+        const float *x2 = FrameAt(ring, channels, frame + 1);
+        const float *x3 = FrameAt(ring, channels, frame + 2);
+        for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+            /* A mono ring's one sample feeds every output channel. */
+            uint32_t s = channels == 1 ? 0 : c;
+            out[i * kRightMic_ChannelCount + c] = Cubic(x0[s], x1[s], x2[s], x3[s], t);
+        }
+    }
+}
+
+/* Conceal `frameCount` frames at `out` and account for them as an underrun. */
+static RightMicRingReadStatus Conceal(RightMicDrift *drift, RightMicRingReader *reader,
+                                      float *out, uint32_t frameCount)
+{
+    RightMicConceal_Fill(&drift->conceal, out, frameCount);
+    reader->underrunCount++;
+    reader->concealedFrames += frameCount;
+    return kRightMicRingRead_Underrun;
+}
+
+RightMicRingReadStatus RightMicDrift_Read(RightMicDrift *drift, const RightMicRing *ring,
+                                          RightMicRingReader *reader,
+                                          float *out, uint32_t frameCount)
+{
+    const RightMicRingBufferHeader *h = ring->header;
+
+    if (h == NULL || !atomic_load_explicit(&h->active, memory_order_acquire)) {
+        /* Not an underrun, but fading out beats cutting off mid-word when
+         * the app stops; the concealer goes silent within a few ms. */
+        RightMicConceal_Fill(&drift->conceal, out, frameCount);
+        return kRightMicRingRead_Inactive;
+    }
+
+    uint64_t wHead = atomic_load_explicit(&h->writeHead, memory_order_acquire);
+    RightMicRingReadStatus status = kRightMicRingRead_Filled;
+
+    /* The ring runs at the producer's rate.  When that is the device's,
+     * the drift loop's ratio is all the resampling there is.  Watermarks
+     * and the loop count output frames; positions in the ring are
+     * `scale` times as many, held to half the ring as ClampWatermarks
+     * does for a 1:1 ring. */
+    double ringRate = RightMicRing_IsSupportedRate(h->sampleRate) ? (double)h->sampleRate
+                                                                  : drift->sampleRate;
+    double scale    = ringRate / drift->sampleRate;
+    double maxFill  = (double)(ring->frames / 2) / scale;
+    double targetFill  = fmin(drift->targetFill, maxFill);
+    double minSafeFill = fmin(drift->minSafeFill, targetFill);
+    uint64_t target = (uint64_t)(targetFill * scale);
+
+    /* First read, or the app reset writeHead on a device switch: start
+     * `target` frames behind the writer so there is a cushion to absorb
+     * callback jitter from the very first cycle. */
+    if (reader->readHead == 0 || wHead < reader->readHead) {
+        if (wHead <= target) {
+            /* Still priming: stay unsynced until the cushion exists.  No
+             * frame was due yet, so this is not an underrun. */
+            reader->readHead = 0;
+            RightMicConceal_Fill(&drift->conceal, out, frameCount);
+            return kRightMicRingRead_Inactive;
+        }
+        reader->readHead = wHead - target;
+        RightMicDrift_Resync(drift);
+    }
+
+    /* The interpolator also touches the frame before readHead, so treat
+     * "writer is about to overwrite it" as the overflow condition. */
+    if (wHead - reader->readHead >= ring->frames) {
+        reader->overflowCount++;
+        reader->readHead = wHead - target;
+        RightMicDrift_Resync(drift);
+        status = kRightMicRingRead_Overflow;
+    }
+
+    uint64_t available = wHead - reader->readHead;
+    double   fill      = ((double)available - drift->phase) / scale;
+
+    /* Hysteresis: once the fill has dropped below minSafe, hold position
+     * and conceal until the producer has rebuilt the full target cushion.
+     * The loop is frozen meanwhile so the refill doesn't wind up its
+     * integrator. */
+    if (drift->refilling) {
+        if (fill < targetFill) {
+            return Conceal(drift, reader, out, frameCount);
+        }
+        drift->refilling = 0;
+    }
+
+    /* Ring frames per output frame. */
+    double step = RightMicDrift_Update(drift, fill, frameCount, drift->sampleRate) * scale;
+
+    /* Output frames the ring can supply: the last one reads up to two
+     * frames past its integer position. */
+    uint32_t framesRead = 0;
+    double   limit      = (double)available - kRightMicDrift_LookAhead;
+    if (limit >= drift->phase) {
+        double n = floor((limit - drift->phase) / step) + 1.0;
+        framesRead = n < (double)frameCount ? (uint32_t)n : frameCount;
+    }
+
+    if (framesRead > 0) {
+        Interpolate(ring, RightMicRing_Channels(h), reader->readHead, drift->phase, step,
+                    out, framesRead);
+
+        /* The overflow check ran before the copy; the writer may have
+         * lapped us during it.  Output frame i's first tap is frame
+         * readHead - 1 + floor(phase + i * step), so it is whole only
+         * from that tap on being intact; conceal the ones before. */
+        uint32_t torn   = 0;
+        uint64_t intact = RightMicRing_IntactFrom(ring);
+        if (intact + 1 > reader->readHead) {
+            double reach = ceil(((double)(intact + 1 - reader->readHead) - drift->phase) / step);
+            torn = reach < (double)framesRead ? (uint32_t)reach : framesRead;
+        }
+        if (torn > 0) {
+            RightMicConceal_Fill(&drift->conceal, out, torn);
+            reader->overflowCount++;
+            reader->tornCount++;
+            reader->concealedFrames += torn;
+            status = kRightMicRingRead_Overflow;
+        }
+
+        double   endPos  = drift->phase + (double)framesRead * step;
+        uint64_t advance = (uint64_t)endPos;
+        reader->readHead += advance;
+        drift->phase = endPos - (double)advance;
+        if (torn < framesRead) {
+            RightMicConceal_Feed(&drift->conceal, out + (size_t)torn * kRightMic_ChannelCount,
+                                 framesRead - torn);
+        }
+    }
+
+    if (fill < minSafeFill) {
+        drift->refilling = 1;
+    }
+
+    /* Short read: keep the real frames and conceal only the deficit. */
+    if (framesRead < frameCount) {
+        return Conceal(drift, reader, out + (size_t)framesRead * kRightMic_ChannelCount,
+                       frameCount - framesRead);
+    }
+    return status;
+}
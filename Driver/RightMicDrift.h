@@ -0,0 +1,136 @@
+/*
+ * RightMicDrift.h
+ * Fill-level-locked clock drift compensation for the ring consumer.
+ *
+ * The app writes at the capture device's sample clock; the driver reads
+ * at the clock it advertises from GetZeroTimeStamp.  That follows the
+ * capture clock once RightMicClock has locked to it, but not before,
+ * not across a device switch and never exactly, so a plain reader
+ * eventually laps or is lapped and has to jump.
+ *
+ * RightMicDrift is a small PLL: it watches how many frames sit between
+ * the reader and the writer, compares that with a target, and runs a
+ * PI controller whose output is the consumer's read rate (input frames
+ * per output frame, ≈ 1 ± a few hundred ppm).  A 4-point cubic
+ * interpolator reads the ring at that fractional rate, so drift is
+ * absorbed continuously instead of with a ~10 ms resync glitch.
+ *
+ * The ring carries the producer's own sample rate (the header says
+ * which).  If a client runs the device at another rate, the same
+ * interpolator also converts between the two; watermarks and fill are
+ * counted in output frames, so a latency setting means the same time
+ * whatever the ring's rate.
+ *
+ * Portable C11 (no CoreAudio/Darwin), unit-tested on Linux.
+ */
+
+#ifndef RightMicDrift_h
+#define RightMicDrift_h
+
+#include "RightMicConceal.h"
+#include "RightMicRing.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Tuning ───────────────────────────────────────────────────── */
+
+/* Hard limit on the rate correction.  Real sample clocks are within  */
+/* ±100 ppm; USB devices occasionally reach several hundred.          */
+#define kRightMicDrift_MaxPPM          2000.0
+
+/* Loop natural frequency (rad/s) and damping.  0.05 rad/s settles a   */
+/* 500 ppm step in about two minutes while keeping the ratio          */
+/* modulation caused by write-burst quantization to a few hundred ppm */
+/* (a couple of cents of pitch, well below audibility).               */
+#define kRightMicDrift_LoopOmega       0.05
+#define kRightMicDrift_LoopDamping     0.7
+
+/* Time constant (s) of the low-pass filter on the measured fill.     */
+#define kRightMicDrift_FillFilterTau   2.0
+
+/* Frames past the last output position the interpolator reads.     */
+#define kRightMicDrift_LookAhead       3
+
+/* ── Watermarks ───────────────────────────────────────────────── */
+/* targetFill is where the loop holds the fill level (and where the   */
+/* first read syncs).  A read that finds fewer frames than it needs   */
+/* plays what is there and conceals only the deficit (see             */
+/* RightMicConceal.h): late producer data still arrives, so the       */
+/* cushion recovers by itself.  If the fill drops below minSafeFill   */
+/* the producer has really stalled; the reader then holds position    */
+/* and conceals until the fill is back at targetFill, so the stall    */
+/* costs one concealed gap instead of a stutter of near-empty reads.  */
+/*                                                                    */
+/* The producer writes in callback-sized bursts, so the fill seen at  */
+/* read time is a sawtooth one producer buffer high, and targetFill   */
+/* is its mean.  Until the loop has seen drift the sawtooth can sit   */
+/* entirely below target, so targetFill must cover one producer       */
+/* burst on top of a full read or the first missed producer callback  */
+/* comes up short.                                                    */
+
+/* Apply defaults for an IO buffer of `frameCount` (0 →               */
+/* kRightMic_Default*LatencyFor) and constraints: minSafe ≥           */
+/* look-ahead, target ≥ minSafe + one IO buffer + look-ahead,         */
+/* target ≤ half of a ring of `ringFrames`.                           */
+void RightMicDrift_ClampWatermarks(uint32_t *targetFill, uint32_t *minSafeFill,
+                                   uint32_t frameCount, uint32_t ringFrames);
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    double targetFill;    /* frames the reader tries to keep behind writeHead */
+    double minSafeFill;   /* below this, stop and refill up to targetFill     */
+    double filteredFill;  /* low-passed fill measurement (frames)             */
+    double integral;      /* ∫ error dt (frame·s)                             */
+    double ratio;         /* drift correction: ring clock / device clock      */
+    double sampleRate;    /* device (output) rate, frames/s                   */
+    double phase;         /* fractional read position past reader->readHead   */
+    int    primed;        /* filteredFill has been seeded                     */
+    int    refilling;     /* concealing until fill reaches targetFill         */
+    RightMicConceal conceal;  /* fills deficits; mode set by the caller      */
+} RightMicDrift;
+
+/* Reset everything, including the learned drift.  Watermarks are used  */
+/* as given; run them through RightMicDrift_ClampWatermarks first.      */
+void RightMicDrift_Init(RightMicDrift *drift, uint32_t targetFill, uint32_t minSafeFill);
+
+/* Change watermarks without disturbing the loop's drift estimate.      */
+void RightMicDrift_SetWatermarks(RightMicDrift *drift, uint32_t targetFill, uint32_t minSafeFill);
+
+/* Device rate the reader produces (Init selects kRightMic_SampleRate). */
+/* The ring's rate comes from its header; when the two differ, reads    */
+/* resample by their ratio on top of the drift correction.             */
+void RightMicDrift_SetSampleRate(RightMicDrift *drift, double sampleRate);
+
+/* Forget the fill history and fractional phase after a resync, but    */
+/* keep the integrator: the clocks' relative drift has not changed.    */
+void RightMicDrift_Resync(RightMicDrift *drift);
+
+/* Feed one fill measurement taken before reading `frameCount` frames   */
+/* and return the new ratio.  Exposed for tests; Read calls it.         */
+double RightMicDrift_Update(RightMicDrift *drift, double fill,
+                            uint32_t frameCount, double sampleRate);
+
+/* Current correction in ppm (positive = consumer reading faster).      */
+double RightMicDrift_PPM(const RightMicDrift *drift);
+
+/* Drift-compensated replacement for RightMicRing_Read.  Same status    */
+/* codes and the same "always fills the whole buffer" contract, but the */
+/* first read syncs `targetFill` frames behind the writer (reads       */
+/* before the writer is that far ahead are Inactive, not underruns),    */
+/* overflow only occurs if the writer really laps the reader, and       */
+/* Underrun means the deficit (only) was concealed rather than the      */
+/* buffer zeroed.                                                       */
+RightMicRingReadStatus RightMicDrift_Read(RightMicDrift *drift, const RightMicRing *ring,
+                                          RightMicRingReader *reader,
+                                          float *out, uint32_t frameCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicDrift_h */
@@ -10,6 +10,13 @@
  */
 
 #include "RightMicDriver.h"
+#include "RightMicAttach.h"
+#include "RightMicClock.h"
+#include "RightMicControls.h"
+#include "RightMicCursor.h"
+#include "RightMicDrift.h"
+#include "RightMicMetrics.h"
+#include "RightMicRing.h"
 
 #include <CoreAudio/AudioServerPlugIn.h>
 #include <CoreAudio/AudioHardware.h>
@@ -18,10 +25,6 @@
 #include <os/log.h>
 #include <stdatomic.h>
 #include <string.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
 #include <dispatch/dispatch.h>
 
 /* ================================================================
@@ -48,34 +51,111 @@ static _Atomic UInt32                          sRefCount   = 0;
 static _Atomic Boolean                         sDeviceIsRunning = false;
 static _Atomic UInt32                          sClientCount = 0;
 
-/* Timestamp state */
-static mach_timebase_info_data_t sTimebaseInfo;
-static uint64_t sIO_StartHostTime        = 0;
-static uint64_t sIO_HostTicksPerPeriod   = 0;
-
-/* Shared memory */
-static int                      sShm_FD   = -1;
-static void *                   sShm_Ptr  = MAP_FAILED;
-static RightMicRingBufferHeader *sRingHeader = NULL;
-static float *                  sRingData   = NULL;
-
-/* Driver-local read head (avoids needing write access to shared memory) */
-static uint64_t sLocalReadHead = 0;
-
-/* Overflow event counter — rate-limits log messages from the IO thread */
-static uint64_t sOverflowCount = 0;
+/* Nominal sample rate (Hz, one of kRightMic_SampleRateList).  Changed
+ * only in PerformDeviceConfigurationChange, while IO is stopped. */
+static const UInt32     sSampleRates[kRightMic_SampleRateCount] = { kRightMic_SampleRateList };
+static _Atomic uint32_t sSampleRate = (uint32_t)kRightMic_SampleRate;
 
-/* Size of the currently-mapped shared memory region */
-static size_t sShm_MapSize = 0;
-
-/* Dynamic control table (V2 shared memory, may be NULL for old-format files) */
-static RightMicControlTable *sControlTable    = NULL;
+/* Timestamp state.  The estimator follows the capture device's clock
+ * from the timestamps the app publishes (see RightMicClock.h); the
+ * timeline spaces our zero timestamps by it.  Both are IO thread only,
+ * apart from StartIO restarting the timeline before IO runs. */
+static mach_timebase_info_data_t sTimebaseInfo;
+static RightMicClockEstimator    sClockEstimator;
+static RightMicClockTimeline     sClockTimeline;
+static bool                      sClockLocked = false;  /* last handed to the worker */
+
+/* The estimator as it was when the lock last changed, for the worker to
+ * log (written before sClockPending is raised). */
+static _Atomic uint32_t sClockLogLocked          = 0;
+static _Atomic float    sClockLogPPM             = 0.0f;
+static _Atomic uint64_t sClockLogDiscontinuities = 0;
+
+/* Shared memory.  Mapped and unmapped on sAttachQueue, never on the IO
+ * thread; the IO thread only looks up the published mapping.  While IO runs
+ * without one, a failed attach is retried every kRightMic_AttachRetryMs.
+ * sIOGeneration changes on every first StartIO / last StopIO so retries and
+ * worker polls scheduled for an earlier IO session lapse. */
+#define kRightMic_AttachRetryMs  500
+static RightMicAttach     sAttach;
+static dispatch_queue_t   sAttachQueue      = NULL;
+static _Atomic uint32_t   sIOGeneration     = 0;
+static int                sLastAttachResult = -1;  /* sAttachQueue only; dedupes logs */
+static const RightMicRing sNoRing;                 /* detached view: reads as inactive */
+
+/* Capacity of the ring last read (IO thread; the default until the first
+ * mapping), which bounds the latency we report.  The app picks it and
+ * may reopen the same region with another; the IO thread then reads
+ * silence and sets sRemapPending until the worker has remapped. */
+static _Atomic uint32_t   sRingFrames   = kRightMic_RingBufferFrames;
+static _Atomic uint32_t   sRemapPending = 0;
+static UInt64             sLastMovedCheck = 0;  /* sAttachQueue only; host time */
+
+/* Driver-local read cursor (avoids needing write access to shared memory).
+ * The HAL reads input once per IO cycle for the whole device and hands
+ * the same buffer to every client, so one cursor serves them all.  It
+ * holds the fill-level PLL + fractional resampler that absorbs what drift
+ * remains between the capture device's clock and the one we advertise. */
+static RightMicCursor sCursor;
+
+/* Clients between StartIO and StopIO; shared memory stays mapped while > 0. */
+static _Atomic UInt32 sIOClientCount = 0;
+
+/* Consumer-side glitch statistics in the driver's own metrics file (see
+ * RightMicMetrics.h), mapped once on sAttachQueue at initialization and
+ * kept for the life of the process; NULL until then or if that failed.
+ * The IO thread spots a new cycle by its counter and times it against
+ * the previous one (IO thread only, reset on the first StartIO). */
+static _Atomic(RightMicConsumerMetrics *) sMetrics = NULL;
+static UInt64 sLastCycleCounter  = 0;
+static UInt64 sLastCycleHostTime = 0;
+static UInt32 sLastCycleFrames   = 0;
+
+/* Latency configuration last seen in the ring header (raw, 0 = default) and
+ * the clamped values we report through kAudioDevicePropertyLatency /
+ * kAudioDevicePropertySafetyOffset.  The safety offset is the min-safe
+ * cushion and the latency is the rest of the target, so the HAL's sum of
+ * the two equals the delay the ring actually adds. */
+static uint32_t         sLastTargetLatency  = 0;
+static uint32_t         sLastMinSafeLatency = 0;
+static _Atomic uint32_t sReportedLatency      = 0;
+static _Atomic uint32_t sReportedSafetyOffset = 0;
+
+/* IO buffer size we report and clamp the reported latency for: the last
+ * one a client set, until an IO cycle shows the size the HAL actually
+ * runs (the smallest any client asked for).  The read cursor clamps
+ * its watermarks from each read's size regardless. */
+static _Atomic uint32_t sBufferFrameSize = kRightMic_BufferFrameSize;
+
+/* Dynamic control table version last seen by the IO thread.  The table
+ * itself lives in the mapped header page (RightMicMapping.controls). */
 static uint32_t              sLastCtrlVersion = 0;
 
-/* Local cache of control entries (updated from main queue on version change).
- * Read by property functions without locks; updated atomically via sLocalCtrlCount. */
-static uint32_t              sLocalCtrlCount  = 0;
-static RightMicControlEntry  sLocalControls[kRightMic_MaxControls];
+/* Local snapshot of the control entries, rewritten by the worker queue on
+ * a version change and read lock-free by property functions (seqlock, see
+ * RightMicControls.h). */
+static RightMicControlSnapshot sControls;
+
+/* The IO thread's own view of which entries are mute controls, refreshed
+ * with a single non-blocking TryRead whenever the snapshot changes. */
+static uint32_t              sIOControlsSeq = 0;
+static uint32_t              sIOMuteMask    = 0;
+
+/* Work the IO thread hands off with a plain flag store (no allocation, no
+ * locks, no syscalls).  The worker queue, at utility QoS, polls the flags
+ * every kRightMic_WorkerPollMs while IO runs. */
+#define kRightMic_WorkerPollMs  10
+static dispatch_queue_t sWorkerQueue     = NULL;
+static _Atomic uint32_t sControlsPending = 0;  /* control table version changed */
+static _Atomic uint32_t sLatencyPending  = 0;  /* reported latency changed      */
+static _Atomic uint32_t sClockPending    = 0;  /* capture clock locked or lost  */
+
+/* Glitch counts from the metrics block last logged (worker only).  The
+ * IO thread only counts; the worker logs the first of each kind and
+ * every 100th after it. */
+#define kRightMic_GlitchLogEvery  100
+static uint64_t sLoggedOverruns  = 0;
+static uint64_t sLoggedUnderruns = 0;
 
 /* Value set by macOS via SetPropertyData on the STATIC mute control (objectID 4).
  * This is separate from the dynamic table so the mute works even when the
@@ -93,7 +173,17 @@ static _Atomic UInt32 sDriverValues[kRightMic_MaxControls];
 #pragma mark - Forward Declarations
 
 /* Control table */
-static void RightMic_UpdateControlCache(void);
+static bool RightMic_UpdateControlCache(void);
+
+/* Shared memory */
+static void    RightMic_MetricsWork(void *context);
+static UInt32  RightMic_AppMuted(void);
+static UInt32  RightMic_AppControlUInt(UInt32 idx);
+static Float32 RightMic_AppControlFloat(UInt32 idx, Float32 fallback);
+
+/* Latency */
+static void RightMic_ApplyLatency(uint32_t target, uint32_t minSafe, bool notify);
+static void RightMic_NotifyLatencyChanged(void);
 
 /* IUnknown */
 static HRESULT  RightMic_QueryInterface(void *, REFIID, LPVOID *);
@@ -228,6 +318,16 @@ static OSStatus RightMic_Initialize(AudioServerPlugInDriverRef inDriver, AudioSe
     (void)inDriver;
     sHost = inHost;
     mach_timebase_info(&sTimebaseInfo);
+    RightMicClock_InitEstimator(&sClockEstimator,
+                                1000000000.0 * (Float64)sTimebaseInfo.denom / (Float64)sTimebaseInfo.numer);
+    RightMicCursor_Init(&sCursor);
+    RightMicAttach_Init(&sAttach, kRightMic_SharedMemoryName, kRightMic_SharedMemoryPath);
+    sAttachQueue = dispatch_queue_create("com.rightmic.driver.attach", DISPATCH_QUEUE_SERIAL);
+    sWorkerQueue = dispatch_queue_create("com.rightmic.driver.worker",
+        dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    RightMicControls_Init(&sControls);
+    RightMic_ApplyLatency(0, 0, false);
+    dispatch_async_f(sAttachQueue, NULL, RightMic_MetricsWork);
     LOG_INFO("Driver initialized");
     return kAudioHardwareNoError;
 }
@@ -272,9 +372,9 @@ static void RightMic_NotifyControlListChanged(void)
 static OSStatus RightMic_AddDeviceClient(AudioServerPlugInDriverRef inDriver, AudioObjectID inDeviceObjectID,
                                           const AudioServerPlugInClientInfo *inClientInfo)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inClientInfo;
+    (void)inDriver; (void)inDeviceObjectID;
     UInt32 count = atomic_fetch_add(&sClientCount, 1) + 1;
-    LOG_INFO("Client added (total: %u)", count);
+    LOG_INFO("Client %u added (total: %u)", inClientInfo->mClientID, count);
     /* First client: mute control becomes visible so macOS can route stem-button presses */
     if (count == 1) RightMic_NotifyControlListChanged();
     return kAudioHardwareNoError;
@@ -283,10 +383,10 @@ static OSStatus RightMic_AddDeviceClient(AudioServerPlugInDriverRef inDriver, Au
 static OSStatus RightMic_RemoveDeviceClient(AudioServerPlugInDriverRef inDriver, AudioObjectID inDeviceObjectID,
                                              const AudioServerPlugInClientInfo *inClientInfo)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inClientInfo;
+    (void)inDriver; (void)inDeviceObjectID;
     UInt32 old = atomic_load(&sClientCount);
     UInt32 count = (old > 0) ? (atomic_fetch_sub(&sClientCount, 1) - 1) : 0;
-    LOG_INFO("Client removed (total: %u)", count);
+    LOG_INFO("Client %u removed (total: %u)", inClientInfo->mClientID, count);
     /* Last client gone: hide mute control so stem reverts to play/pause for media */
     if (count == 0) RightMic_NotifyControlListChanged();
     return kAudioHardwareNoError;
@@ -298,10 +398,41 @@ static OSStatus RightMic_RemoveDeviceClient(AudioServerPlugInDriverRef inDriver,
 
 #pragma mark - Configuration
 
+/* The only change we request is a new nominal sample rate; the action
+ * carries it in Hz.  The HAL has stopped IO around this call. */
 static OSStatus RightMic_PerformDeviceConfigurationChange(AudioServerPlugInDriverRef inDriver, AudioObjectID inDeviceObjectID,
                                                            UInt64 inChangeAction, void *inChangeInfo)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inChangeAction; (void)inChangeInfo;
+    (void)inDriver; (void)inDeviceObjectID; (void)inChangeInfo;
+
+    uint32_t rate = (uint32_t)inChangeAction;
+    if (!RightMicRing_IsSupportedRate(rate)) return kAudioDeviceUnsupportedFormatError;
+    atomic_store_explicit(&sSampleRate, rate, memory_order_relaxed);
+    RightMicCursor_SetSampleRate(&sCursor, rate);
+    LOG_INFO("Sample rate now %u Hz", rate);
+    return kAudioHardwareNoError;
+}
+
+/* Runs on sAttachQueue: the HAL must not be asked for a configuration
+ * change from inside SetPropertyData.  `context` is the rate in Hz. */
+static void RightMic_RequestRateChangeWork(void *context)
+{
+    if (sHost == NULL) return;
+    sHost->RequestDeviceConfigurationChange(sHost, kRightMicObjectID_Device,
+                                            (UInt64)(uintptr_t)context, NULL);
+}
+
+/* Ask the HAL to switch the device to `rate` (Hz) unless it runs at it. */
+static OSStatus RightMic_RequestSampleRate(Float64 rate)
+{
+    if (rate != (Float64)(uint32_t)rate || !RightMicRing_IsSupportedRate((uint32_t)rate)) {
+        LOG_ERROR("Unsupported sample rate: %f", rate);
+        return kAudioDeviceUnsupportedFormatError;
+    }
+    if ((uint32_t)rate != atomic_load_explicit(&sSampleRate, memory_order_relaxed)) {
+        dispatch_async_f(sAttachQueue, (void *)(uintptr_t)(uint32_t)rate,
+                         RightMic_RequestRateChangeWork);
+    }
     return kAudioHardwareNoError;
 }
 
@@ -319,10 +450,10 @@ static OSStatus RightMic_AbortDeviceConfigurationChange(AudioServerPlugInDriverR
 #pragma mark - Property Helpers
 
 /* Helper to build a standard Float32 linear PCM AudioStreamBasicDescription. */
-static AudioStreamBasicDescription RightMic_ASBD(void)
+static AudioStreamBasicDescription RightMic_ASBD(Float64 sampleRate)
 {
     AudioStreamBasicDescription asbd = {0};
-    asbd.mSampleRate       = kRightMic_SampleRate;
+    asbd.mSampleRate       = sampleRate;
     asbd.mFormatID         = kAudioFormatLinearPCM;
     asbd.mFormatFlags      = kAudioFormatFlagIsFloat
                            | kAudioFormatFlagsNativeEndian
@@ -435,11 +566,10 @@ static Boolean RightMic_HasProperty(AudioServerPlugInDriverRef inDriver, AudioOb
 
     /* ── Dynamic Control Objects (objectIDs 5+) ─────────────────── */
     default: {
-        UInt32 localCount = sLocalCtrlCount;
+        RightMicControlEntry ctrl;
         if (inObjectID >= kRightMicObjectID_FirstDynControl &&
-            inObjectID < kRightMicObjectID_FirstDynControl + localCount) {
-            UInt32 idx = inObjectID - kRightMicObjectID_FirstDynControl;
-            UInt32 cls = sLocalControls[idx].classID;
+            RightMicControls_Get(&sControls, inObjectID - kRightMicObjectID_FirstDynControl, &ctrl)) {
+            UInt32 cls = ctrl.classID;
             switch (inAddress->mSelector) {
             case kAudioObjectPropertyBaseClass:
             case kAudioObjectPropertyClass:
@@ -507,11 +637,10 @@ static OSStatus RightMic_IsPropertySettable(AudioServerPlugInDriverRef inDriver,
         }
         break;
     default: {
-        UInt32 localCount = sLocalCtrlCount;
+        RightMicControlEntry ctrl;
         if (inObjectID >= kRightMicObjectID_FirstDynControl &&
-            inObjectID < kRightMicObjectID_FirstDynControl + localCount) {
-            UInt32 idx = inObjectID - kRightMicObjectID_FirstDynControl;
-            UInt32 cls = sLocalControls[idx].classID;
+            RightMicControls_Get(&sControls, inObjectID - kRightMicObjectID_FirstDynControl, &ctrl)) {
+            UInt32 cls = ctrl.classID;
             if ((inAddress->mSelector == kAudioBooleanControlPropertyValue &&
                  (cls == kAudioMuteControlClassID || cls == kAudioBooleanControlClassID)) ||
                 (inAddress->mSelector == kAudioLevelControlPropertyScalarValue &&
@@ -597,7 +726,7 @@ static OSStatus RightMic_GetPropertyDataSize(AudioServerPlugInDriverRef inDriver
                 inAddress->mScope == kAudioObjectPropertyScopeGlobal) {
                 /* stream + static mute (4, if client present) + dynamic controls (5+) */
                 UInt32 muteVisible = (atomic_load(&sClientCount) > 0) ? 1 : 0;
-                *outDataSize = (1 + muteVisible + sLocalCtrlCount) * sizeof(AudioObjectID);
+                *outDataSize = (1 + muteVisible + RightMicControls_Count(&sControls)) * sizeof(AudioObjectID);
             } else {
                 *outDataSize = 0;
             }
@@ -621,7 +750,7 @@ static OSStatus RightMic_GetPropertyDataSize(AudioServerPlugInDriverRef inDriver
         case kAudioObjectPropertyControlList: {
             /* Static mute (4, only when a client is present) + dynamic controls (5+) */
             UInt32 muteVisible = (atomic_load(&sClientCount) > 0) ? 1 : 0;
-            *outDataSize = (muteVisible + sLocalCtrlCount) * sizeof(AudioObjectID);
+            *outDataSize = (muteVisible + RightMicControls_Count(&sControls)) * sizeof(AudioObjectID);
             return kAudioHardwareNoError;
         }
         case kAudioDevicePropertyMute:
@@ -631,6 +760,8 @@ static OSStatus RightMic_GetPropertyDataSize(AudioServerPlugInDriverRef inDriver
             *outDataSize = sizeof(Float64);
             return kAudioHardwareNoError;
         case kAudioDevicePropertyAvailableNominalSampleRates:
+            *outDataSize = kRightMic_SampleRateCount * sizeof(AudioValueRange);
+            return kAudioHardwareNoError;
         case kAudioDevicePropertyBufferFrameSizeRange:
             *outDataSize = sizeof(AudioValueRange);
             return kAudioHardwareNoError;
@@ -661,7 +792,7 @@ static OSStatus RightMic_GetPropertyDataSize(AudioServerPlugInDriverRef inDriver
             return kAudioHardwareNoError;
         case kAudioStreamPropertyAvailableVirtualFormats:
         case kAudioStreamPropertyAvailablePhysicalFormats:
-            *outDataSize = sizeof(AudioStreamRangedDescription);
+            *outDataSize = kRightMic_SampleRateCount * sizeof(AudioStreamRangedDescription);
             return kAudioHardwareNoError;
         }
         break;
@@ -690,11 +821,10 @@ static OSStatus RightMic_GetPropertyDataSize(AudioServerPlugInDriverRef inDriver
 
     /* ── Dynamic Control Objects (objectIDs 5+) ─────────────────── */
     default: {
-        UInt32 localCount = sLocalCtrlCount;
+        RightMicControlEntry ctrl;
         if (inObjectID >= kRightMicObjectID_FirstDynControl &&
-            inObjectID < kRightMicObjectID_FirstDynControl + localCount) {
-            UInt32 idx = inObjectID - kRightMicObjectID_FirstDynControl;
-            UInt32 cls = sLocalControls[idx].classID;
+            RightMicControls_Get(&sControls, inObjectID - kRightMicObjectID_FirstDynControl, &ctrl)) {
+            UInt32 cls = ctrl.classID;
             switch (inAddress->mSelector) {
             case kAudioObjectPropertyBaseClass:
             case kAudioObjectPropertyClass:
@@ -901,13 +1031,13 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
         case kAudioDevicePropertyLatency:
             if (inDataSize < sizeof(UInt32)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(UInt32);
-            *(UInt32 *)outData = 0;
+            *(UInt32 *)outData = atomic_load_explicit(&sReportedLatency, memory_order_relaxed);
             return kAudioHardwareNoError;
 
         case kAudioDevicePropertySafetyOffset:
             if (inDataSize < sizeof(UInt32)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(UInt32);
-            *(UInt32 *)outData = 0;
+            *(UInt32 *)outData = atomic_load_explicit(&sReportedSafetyOffset, memory_order_relaxed);
             return kAudioHardwareNoError;
 
         case kAudioDevicePropertyStreams:
@@ -924,7 +1054,7 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
         case kAudioObjectPropertyControlList: {
             /* Static mute (4, only when a client is present) + dynamic controls (5+) */
             UInt32 muteVisible = (atomic_load(&sClientCount) > 0) ? 1 : 0;
-            UInt32 localCount = sLocalCtrlCount;
+            UInt32 localCount = RightMicControls_Count(&sControls);
             UInt32 total = muteVisible + localCount;
             UInt32 needed = total * sizeof(AudioObjectID);
             UInt32 toReturn = (inDataSize < needed) ? inDataSize : needed;
@@ -944,32 +1074,33 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
             *outDataSize = sizeof(UInt32);
             /* Effective mute = static mute OR app-side header mute */
             UInt32 staticMuted = atomic_load_explicit(&sStaticMuteValue, memory_order_relaxed);
-            UInt32 appMuted    = sRingHeader
-                                 ? atomic_load_explicit(&sRingHeader->muted, memory_order_relaxed)
-                                 : 0;
-            *(UInt32 *)outData = (staticMuted || appMuted) ? 1 : 0;
+            *(UInt32 *)outData = (staticMuted || RightMic_AppMuted()) ? 1 : 0;
             return kAudioHardwareNoError;
         }
 
         case kAudioDevicePropertyNominalSampleRate:
             if (inDataSize < sizeof(Float64)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(Float64);
-            *(Float64 *)outData = kRightMic_SampleRate;
+            *(Float64 *)outData = atomic_load_explicit(&sSampleRate, memory_order_relaxed);
             return kAudioHardwareNoError;
 
         case kAudioDevicePropertyAvailableNominalSampleRates: {
-            if (inDataSize < sizeof(AudioValueRange)) return kAudioHardwareBadPropertySizeError;
-            *outDataSize = sizeof(AudioValueRange);
-            AudioValueRange *range = (AudioValueRange *)outData;
-            range->mMinimum = kRightMic_SampleRate;
-            range->mMaximum = kRightMic_SampleRate;
+            /* As many as fit, one single-rate range each. */
+            UInt32 count = inDataSize / sizeof(AudioValueRange);
+            if (count > kRightMic_SampleRateCount) count = kRightMic_SampleRateCount;
+            AudioValueRange *ranges = (AudioValueRange *)outData;
+            for (UInt32 i = 0; i < count; i++) {
+                ranges[i].mMinimum = sSampleRates[i];
+                ranges[i].mMaximum = sSampleRates[i];
+            }
+            *outDataSize = count * sizeof(AudioValueRange);
             return kAudioHardwareNoError;
         }
 
         case kAudioDevicePropertyZeroTimeStampPeriod:
             if (inDataSize < sizeof(UInt32)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(UInt32);
-            *(UInt32 *)outData = kRightMic_BufferFrameSize;
+            *(UInt32 *)outData = kRightMic_ZeroTimeStampPeriod;
             return kAudioHardwareNoError;
 
         case kAudioDevicePropertyClockIsStable:
@@ -987,15 +1118,15 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
         case kAudioDevicePropertyBufferFrameSize:
             if (inDataSize < sizeof(UInt32)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(UInt32);
-            *(UInt32 *)outData = kRightMic_BufferFrameSize;
+            *(UInt32 *)outData = atomic_load_explicit(&sBufferFrameSize, memory_order_relaxed);
             return kAudioHardwareNoError;
 
         case kAudioDevicePropertyBufferFrameSizeRange: {
             if (inDataSize < sizeof(AudioValueRange)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(AudioValueRange);
             AudioValueRange *range = (AudioValueRange *)outData;
-            range->mMinimum = kRightMic_BufferFrameSize;
-            range->mMaximum = kRightMic_BufferFrameSize;
+            range->mMinimum = kRightMic_MinBufferFrameSize;
+            range->mMaximum = kRightMic_MaxBufferFrameSize;
             return kAudioHardwareNoError;
         }
 
@@ -1004,7 +1135,7 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                 inAddress->mScope == kAudioObjectPropertyScopeGlobal) {
                 /* Stream + static mute (4, only when client present) + dynamic controls (5+) */
                 UInt32 muteVisible = (atomic_load(&sClientCount) > 0) ? 1 : 0;
-                UInt32 localCount = sLocalCtrlCount;
+                UInt32 localCount = RightMicControls_Count(&sControls);
                 UInt32 total = 1 + muteVisible + localCount;
                 UInt32 toReturn = (inDataSize / sizeof(AudioObjectID));
                 if (toReturn > total) toReturn = total;
@@ -1086,17 +1217,21 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
         case kAudioStreamPropertyPhysicalFormat:
             if (inDataSize < sizeof(AudioStreamBasicDescription)) return kAudioHardwareBadPropertySizeError;
             *outDataSize = sizeof(AudioStreamBasicDescription);
-            *(AudioStreamBasicDescription *)outData = RightMic_ASBD();
+            *(AudioStreamBasicDescription *)outData =
+                RightMic_ASBD(atomic_load_explicit(&sSampleRate, memory_order_relaxed));
             return kAudioHardwareNoError;
 
         case kAudioStreamPropertyAvailableVirtualFormats:
         case kAudioStreamPropertyAvailablePhysicalFormats: {
-            if (inDataSize < sizeof(AudioStreamRangedDescription)) return kAudioHardwareBadPropertySizeError;
-            *outDataSize = sizeof(AudioStreamRangedDescription);
-            AudioStreamRangedDescription *desc = (AudioStreamRangedDescription *)outData;
-            desc->mFormat = RightMic_ASBD();
-            desc->mSampleRateRange.mMinimum = kRightMic_SampleRate;
-            desc->mSampleRateRange.mMaximum = kRightMic_SampleRate;
+            UInt32 count = inDataSize / sizeof(AudioStreamRangedDescription);
+            if (count > kRightMic_SampleRateCount) count = kRightMic_SampleRateCount;
+            AudioStreamRangedDescription *descs = (AudioStreamRangedDescription *)outData;
+            for (UInt32 i = 0; i < count; i++) {
+                descs[i].mFormat = RightMic_ASBD(sSampleRates[i]);
+                descs[i].mSampleRateRange.mMinimum = sSampleRates[i];
+                descs[i].mSampleRateRange.mMaximum = sSampleRates[i];
+            }
+            *outDataSize = count * sizeof(AudioStreamRangedDescription);
             return kAudioHardwareNoError;
         }
         }
@@ -1142,10 +1277,7 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
             *outDataSize = sizeof(UInt32);
             {
                 UInt32 staticMuted = atomic_load_explicit(&sStaticMuteValue, memory_order_relaxed);
-                UInt32 appMuted    = sRingHeader
-                                     ? atomic_load_explicit(&sRingHeader->muted, memory_order_relaxed)
-                                     : 0;
-                *(UInt32 *)outData = (staticMuted || appMuted) ? 1 : 0;
+                *(UInt32 *)outData = (staticMuted || RightMic_AppMuted()) ? 1 : 0;
             }
             return kAudioHardwareNoError;
         }
@@ -1153,11 +1285,11 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
 
     /* ── Dynamic Control Objects (objectIDs 5+) ─────────────────── */
     default: {
-        UInt32 localCount = sLocalCtrlCount;
+        RightMicControlEntry ctrl;
         if (inObjectID >= kRightMicObjectID_FirstDynControl &&
-            inObjectID < kRightMicObjectID_FirstDynControl + localCount) {
+            RightMicControls_Get(&sControls, inObjectID - kRightMicObjectID_FirstDynControl, &ctrl)) {
             UInt32 idx = inObjectID - kRightMicObjectID_FirstDynControl;
-            UInt32 cls = sLocalControls[idx].classID;
+            UInt32 cls = ctrl.classID;
 
             switch (inAddress->mSelector) {
             case kAudioObjectPropertyBaseClass:
@@ -1198,10 +1330,7 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                 if (cls == kAudioMuteControlClassID || cls == kAudioBooleanControlClassID) {
                     *outDataSize = sizeof(UInt32);
                     UInt32 dv = atomic_load_explicit(&sDriverValues[idx], memory_order_relaxed);
-                    UInt32 av = sControlTable
-                                ? atomic_load_explicit(&sControlTable->entries[idx].uintValue,
-                                                       memory_order_relaxed)
-                                : 0;
+                    UInt32 av = RightMic_AppControlUInt(idx);
                     *(UInt32 *)outData = (dv || av) ? 1 : 0;
                     return kAudioHardwareNoError;
                 }
@@ -1211,11 +1340,7 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                 if (cls == kAudioLevelControlClassID) {
                     if (inDataSize < sizeof(Float32)) return kAudioHardwareBadPropertySizeError;
                     *outDataSize = sizeof(Float32);
-                    Float32 av = sControlTable
-                                 ? atomic_load_explicit(&sControlTable->entries[idx].floatValue,
-                                                        memory_order_relaxed)
-                                 : 1.0f;
-                    *(Float32 *)outData = av;
+                    *(Float32 *)outData = RightMic_AppControlFloat(idx, 1.0f);
                     return kAudioHardwareNoError;
                 }
                 break;
@@ -1224,12 +1349,9 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                 if (cls == kAudioLevelControlClassID) {
                     if (inDataSize < sizeof(Float32)) return kAudioHardwareBadPropertySizeError;
                     *outDataSize = sizeof(Float32);
-                    Float32 scalar = sControlTable
-                                     ? atomic_load_explicit(&sControlTable->entries[idx].floatValue,
-                                                            memory_order_relaxed)
-                                     : 1.0f;
-                    float minDB = sLocalControls[idx].minDB;
-                    float maxDB = sLocalControls[idx].maxDB;
+                    Float32 scalar = RightMic_AppControlFloat(idx, 1.0f);
+                    float minDB = ctrl.minDB;
+                    float maxDB = ctrl.maxDB;
                     float db = minDB + scalar * (maxDB - minDB);
                     *(Float32 *)outData = db;
                     return kAudioHardwareNoError;
@@ -1241,8 +1363,8 @@ static OSStatus RightMic_GetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                     if (inDataSize < sizeof(AudioValueRange)) return kAudioHardwareBadPropertySizeError;
                     *outDataSize = sizeof(AudioValueRange);
                     AudioValueRange *r = (AudioValueRange *)outData;
-                    r->mMinimum = sLocalControls[idx].minDB;
-                    r->mMaximum = sLocalControls[idx].maxDB;
+                    r->mMinimum = ctrl.minDB;
+                    r->mMaximum = ctrl.maxDB;
                     return kAudioHardwareNoError;
                 }
                 break;
@@ -1275,17 +1397,26 @@ static OSStatus RightMic_SetPropertyData(AudioServerPlugInDriverRef inDriver, Au
     switch (inObjectID) {
     case kRightMicObjectID_Device:
         if (inAddress->mSelector == kAudioDevicePropertyNominalSampleRate) {
-            /* We only support one sample rate, so accept and ignore */
             if (inDataSize < sizeof(Float64)) return kAudioHardwareBadPropertySizeError;
-            Float64 requested = *(const Float64 *)inData;
-            if (requested != kRightMic_SampleRate) {
-                LOG_ERROR("Unsupported sample rate: %f", requested);
-                return kAudioDeviceUnsupportedFormatError;
-            }
-            return kAudioHardwareNoError;
+            return RightMic_RequestSampleRate(*(const Float64 *)inData);
         }
         if (inAddress->mSelector == kAudioDevicePropertyBufferFrameSize) {
-            /* Accept any requested buffer size (we always use our fixed size) */
+            /* The ring reads any size in range; the reported latency
+             * follows once IO runs at it. */
+            if (inDataSize < sizeof(UInt32)) return kAudioHardwareBadPropertySizeError;
+            UInt32 frames = *(const UInt32 *)inData;
+            if (frames < kRightMic_MinBufferFrameSize || frames > kRightMic_MaxBufferFrameSize) {
+                LOG_ERROR("Unsupported buffer size: %u", frames);
+                return kAudioHardwareIllegalOperationError;
+            }
+            if (atomic_exchange_explicit(&sBufferFrameSize, frames, memory_order_relaxed) != frames) {
+                AudioObjectPropertyAddress addr = {
+                    kAudioDevicePropertyBufferFrameSize,
+                    kAudioObjectPropertyScopeGlobal,
+                    kAudioObjectPropertyElementMain
+                };
+                sHost->PropertiesChanged(sHost, kRightMicObjectID_Device, 1, &addr);
+            }
             return kAudioHardwareNoError;
         }
         if (inAddress->mSelector == kAudioDevicePropertyMute) {
@@ -1315,16 +1446,15 @@ static OSStatus RightMic_SetPropertyData(AudioServerPlugInDriverRef inDriver, Au
     case kRightMicObjectID_InputStream:
         if (inAddress->mSelector == kAudioStreamPropertyVirtualFormat ||
             inAddress->mSelector == kAudioStreamPropertyPhysicalFormat) {
-            /* Accept only our exact format */
+            /* Our format at any offered rate; a new rate changes the device's. */
             if (inDataSize < sizeof(AudioStreamBasicDescription)) return kAudioHardwareBadPropertySizeError;
             const AudioStreamBasicDescription *requested = (const AudioStreamBasicDescription *)inData;
-            AudioStreamBasicDescription ours = RightMic_ASBD();
-            if (requested->mSampleRate != ours.mSampleRate ||
-                requested->mChannelsPerFrame != ours.mChannelsPerFrame ||
+            AudioStreamBasicDescription ours = RightMic_ASBD(requested->mSampleRate);
+            if (requested->mChannelsPerFrame != ours.mChannelsPerFrame ||
                 requested->mFormatID != ours.mFormatID) {
                 return kAudioDeviceUnsupportedFormatError;
             }
-            return kAudioHardwareNoError;
+            return RightMic_RequestSampleRate(requested->mSampleRate);
         }
         break;
 
@@ -1353,11 +1483,11 @@ static OSStatus RightMic_SetPropertyData(AudioServerPlugInDriverRef inDriver, Au
 
     default: {
         /* Dynamic control object */
-        UInt32 localCount = sLocalCtrlCount;
+        RightMicControlEntry ctrl;
         if (inObjectID >= kRightMicObjectID_FirstDynControl &&
-            inObjectID < kRightMicObjectID_FirstDynControl + localCount) {
+            RightMicControls_Get(&sControls, inObjectID - kRightMicObjectID_FirstDynControl, &ctrl)) {
             UInt32 idx = inObjectID - kRightMicObjectID_FirstDynControl;
-            UInt32 cls = sLocalControls[idx].classID;
+            UInt32 cls = ctrl.classID;
 
             if (inAddress->mSelector == kAudioBooleanControlPropertyValue &&
                 (cls == kAudioMuteControlClassID || cls == kAudioBooleanControlClassID)) {
@@ -1387,10 +1517,12 @@ static OSStatus RightMic_SetPropertyData(AudioServerPlugInDriverRef inDriver, Au
                 if (inDataSize < sizeof(Float32)) return kAudioHardwareBadPropertySizeError;
                 Float32 v = *(const Float32 *)inData;
                 /* Write into the shared memory entry (app-side) if available */
-                if (sControlTable) {
-                    atomic_store_explicit(&sControlTable->entries[idx].floatValue,
+                const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+                if (shm != NULL) {
+                    atomic_store_explicit(&shm->controls->entries[idx].floatValue,
                                           v, memory_order_relaxed);
                 }
+                RightMicAttach_Unlock(&sAttach);
                 AudioObjectPropertyAddress ctrlAddr = {
                     kAudioLevelControlPropertyScalarValue,
                     kAudioObjectPropertyScopeGlobal,
@@ -1414,33 +1546,23 @@ static OSStatus RightMic_SetPropertyData(AudioServerPlugInDriverRef inDriver, Au
 
 #pragma mark - Control Cache
 
-/* Called on the main queue whenever the app bumps the control table version.
- * Copies the shared memory entries into the local cache (safe to read from
- * property functions without locks) and notifies CoreAudio of the change. */
-static void RightMic_UpdateControlCache(void)
+/* Called on the worker queue whenever the app bumps the control table version.
+ * Copies the shared memory entries into the local snapshot (safe to read from
+ * property functions without locks) and notifies CoreAudio of the change.
+ * Returns false if the app was mid-update; the worker tries again later. */
+static bool RightMic_UpdateControlCache(void)
 {
-    if (sControlTable == NULL) {
-        sLocalCtrlCount = 0;
-        return;
-    }
-
-    uint32_t count = atomic_load_explicit(&sControlTable->count, memory_order_acquire);
-    if (count > kRightMic_MaxControls) count = kRightMic_MaxControls;
-
-    for (uint32_t i = 0; i < count; i++) {
-        sLocalControls[i].classID    = sControlTable->entries[i].classID;
-        sLocalControls[i].scope      = sControlTable->entries[i].scope;
-        sLocalControls[i].element    = sControlTable->entries[i].element;
-        sLocalControls[i].minDB      = sControlTable->entries[i].minDB;
-        sLocalControls[i].maxDB      = sControlTable->entries[i].maxDB;
-        /* Atomic reads for values that the app may update concurrently */
-        sLocalControls[i].uintValue  = (uint32_t)atomic_load_explicit(
-            &sControlTable->entries[i].uintValue, memory_order_relaxed);
-        sLocalControls[i].floatValue = atomic_load_explicit(
-            &sControlTable->entries[i].floatValue, memory_order_relaxed);
+    const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+    bool copied = true;
+    if (shm == NULL) {
+        RightMicControls_Clear(&sControls);
+    } else {
+        copied = RightMicControls_CopyTable(&sControls, shm->controls, NULL);
     }
-    sLocalCtrlCount = count;
+    RightMicAttach_Unlock(&sAttach);
+    if (!copied) return false;
 
+    uint32_t count = RightMicControls_Count(&sControls);
     LOG_INFO("Control cache updated: %u controls", count);
 
     if (sHost != NULL) {
@@ -1454,6 +1576,7 @@ static void RightMic_UpdateControlCache(void)
         };
         sHost->PropertiesChanged(sHost, kRightMicObjectID_Device, 2, addrs);
     }
+    return true;
 }
 
 /* ================================================================
@@ -1462,71 +1585,269 @@ static void RightMic_UpdateControlCache(void)
 
 #pragma mark - Shared Memory
 
-static void RightMic_OpenSharedMemory(void)
+/* Clamp the app's requested watermarks, hand them to the readers and
+ * publish the resulting latency / safety offset.  Called once at init and
+ * then from the IO thread when the header values change, so no locks and
+ * no HAL calls here; `notify` hands the PropertiesChanged to the worker queue. */
+static void RightMic_ApplyLatency(uint32_t target, uint32_t minSafe, bool notify)
 {
-    if (sShm_Ptr != MAP_FAILED) return; /* already open */
+    sLastTargetLatency  = target;
+    sLastMinSafeLatency = minSafe;
+
+    /* The cursor clamps the raw values on its next read, for the IO
+     * buffer size it reads with. */
+    RightMicCursor_SetWatermarks(&sCursor, target, minSafe);
+    RightMicDrift_ClampWatermarks(&target, &minSafe,
+                                  atomic_load_explicit(&sBufferFrameSize, memory_order_relaxed),
+                                  atomic_load_explicit(&sRingFrames, memory_order_relaxed));
+
+    uint32_t latency = target - minSafe;
+    bool changed = atomic_exchange_explicit(&sReportedLatency, latency, memory_order_relaxed) != latency;
+    changed |= atomic_exchange_explicit(&sReportedSafetyOffset, minSafe, memory_order_relaxed) != minSafe;
+
+    if (notify && changed) {
+        atomic_store_explicit(&sLatencyPending, 1, memory_order_release);
+    }
+}
 
-    sShm_FD = open(kRightMic_SharedMemoryPath, O_RDONLY | O_NOFOLLOW);
-    if (sShm_FD < 0) {
-        LOG_INFO("Shared memory file not yet created by companion app");
-        return;
+static void RightMic_NotifyLatencyChanged(void)
+{
+    LOG_INFO("Latency now %u frames + %u frames safety offset",
+             atomic_load_explicit(&sReportedLatency, memory_order_relaxed),
+             atomic_load_explicit(&sReportedSafetyOffset, memory_order_relaxed));
+
+    if (sHost == NULL) return;
+    AudioObjectPropertyAddress addrs[2] = {
+        { kAudioDevicePropertyLatency,      kAudioObjectPropertyScopeInput,
+          kAudioObjectPropertyElementMain },
+        { kAudioDevicePropertySafetyOffset, kAudioObjectPropertyScopeInput,
+          kAudioObjectPropertyElementMain },
+    };
+    sHost->PropertiesChanged(sHost, kRightMicObjectID_Device, 2, addrs);
+}
+
+/* Tell the app whether our view of the ring is wired.  sAttachQueue. */
+static void RightMic_PublishResidency(RightMicResidency residency)
+{
+    RightMicConsumerMetrics *metrics = atomic_load_explicit(&sMetrics, memory_order_acquire);
+    if (metrics != NULL) {
+        RightMicMetrics_SetConsumerResidency(metrics, residency);
     }
+}
 
-    /* Verify the file is the expected size and is a regular file */
-    struct stat st;
-    if (fstat(sShm_FD, &st) != 0 || st.st_size < (off_t)kRightMic_SharedMemorySize) {
-        LOG_INFO("Shared memory file too small (%lld bytes, need %lu), retrying later",
-                 (long long)st.st_size, (unsigned long)kRightMic_SharedMemorySize);
-        close(sShm_FD);
-        sShm_FD = -1;
-        return;
+/* Runs on sAttachQueue.  `context` is the attach generation it was
+ * scheduled for; it lapses once IO has stopped (or restarted) since. */
+static void RightMic_AttachWork(void *context)
+{
+    if ((uint32_t)(uintptr_t)context != atomic_load(&sIOGeneration)) return;
+
+    RightMicAttachResult result = RightMicAttach_Open(&sAttach);
+    if ((int)result != sLastAttachResult) {
+        sLastAttachResult = (int)result;
+        if (result == kRightMicAttach_Attached) {
+            const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+            bool mirrored  = shm != NULL && shm->map.mirrored;
+            bool anonymous = shm != NULL && shm->anonymous;
+            RightMicResidency residency = shm != NULL ? shm->residency : kRightMicResidency_Unknown;
+            uint32_t ringFrames = shm != NULL ? shm->ring.frames : 0;
+            RightMicAttach_Unlock(&sAttach);
+            RightMic_PublishResidency(residency);
+            LOG_INFO("Shared memory mapped (version %u, %s, %u frames, %s, %s)", kRightMic_RingVersion,
+                     anonymous ? kRightMic_SharedMemoryName : kRightMic_SharedMemoryPath, ringFrames,
+                     mirrored ? "mirrored" : "single mapping",
+                     residency == kRightMicResidency_Wired ? "wired" : "prefaulted, not wired");
+        } else if (result == kRightMicAttach_NotRegular || result == kRightMicAttach_MapFailed) {
+            LOG_ERROR("%{public}s, retrying every %u ms",
+                      RightMicAttach_Describe(result), kRightMic_AttachRetryMs);
+        } else {
+            LOG_INFO("%{public}s, retrying every %u ms",
+                     RightMicAttach_Describe(result), kRightMic_AttachRetryMs);
+        }
     }
-    if (!S_ISREG(st.st_mode)) {
-        LOG_ERROR("Shared memory path is not a regular file, refusing to map");
-        close(sShm_FD);
-        sShm_FD = -1;
-        return;
+    if (result != kRightMicAttach_Attached) {
+        dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW, (int64_t)kRightMic_AttachRetryMs * NSEC_PER_MSEC),
+                         sAttachQueue, context, RightMic_AttachWork);
     }
+}
+
+/* Runs on sAttachQueue when the IO thread found the header describing
+ * another ring than the one mapped.  Either the app reopened the region
+ * with a new geometry, or it holds no ring: the app is closed or between
+ * opens, or it now writes to another object (it replaced ours, or moved
+ * to it from the fallback file), which is looked for at the attach retry
+ * rate.  Map it afresh under the same generation.  A request queued
+ * again before the first one landed finds nothing to do. */
+static void RightMic_RemapWork(void *context)
+{
+    if ((uint32_t)(uintptr_t)context != atomic_load(&sIOGeneration)) return;
+
+    const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+    bool changed = shm != NULL && !RightMicRing_MatchesHeader(&shm->ring);
+    bool layout  = changed && RightMicRing_IsCompatible(shm->ring.header);
+    RightMicAttach_Unlock(&sAttach);
+    if (!changed) return;
 
-    /* Map V2 size if the app has already written the control table, V1 otherwise */
-    bool hasControlTable = (st.st_size >= (off_t)kRightMic_SharedMemorySizeV2);
-    sShm_MapSize = hasControlTable ? kRightMic_SharedMemorySizeV2 : kRightMic_SharedMemorySize;
+    if (layout) {
+        LOG_INFO("Ring geometry changed, remapping shared memory");
+    } else {
+        UInt64 now = mach_absolute_time();
+        UInt64 sinceNs = (now - sLastMovedCheck) * sTimebaseInfo.numer / sTimebaseInfo.denom;
+        if (sinceNs < (UInt64)kRightMic_AttachRetryMs * NSEC_PER_MSEC) return;
+        sLastMovedCheck = now;
+        if (!RightMicAttach_Moved(&sAttach)) return;
+        LOG_INFO("Ring moved to another object, remapping shared memory");
+    }
+    RightMicAttach_Close(&sAttach);
+    sLastAttachResult = -1;
+    RightMic_AttachWork(context);
+}
 
-    sShm_Ptr = mmap(NULL, sShm_MapSize, PROT_READ, MAP_SHARED, sShm_FD, 0);
-    if (sShm_Ptr == MAP_FAILED) {
-        LOG_ERROR("Failed to mmap shared memory file");
-        close(sShm_FD);
-        sShm_FD = -1;
-        sShm_MapSize = 0;
+/* Runs once on sAttachQueue after initialization. */
+static void RightMic_MetricsWork(void *context)
+{
+    (void)context;
+    RightMicConsumerMetrics *metrics = RightMicMetrics_MapConsumer(kRightMic_DriverMetricsName,
+                                                                   kRightMic_DriverMetricsPath);
+    if (metrics == NULL) {
+        LOG_ERROR("Could not create %{public}s or %{public}s; glitch statistics disabled",
+                  kRightMic_DriverMetricsName, kRightMic_DriverMetricsPath);
         return;
     }
+    atomic_store_explicit(&sMetrics, metrics, memory_order_release);
+    RightMicMetrics_SetIOClients(metrics, atomic_load(&sIOClientCount));
+    LOG_INFO("Glitch statistics in %{public}s (or %{public}s)",
+             kRightMic_DriverMetricsName, kRightMic_DriverMetricsPath);
+}
 
-    sRingHeader = (RightMicRingBufferHeader *)sShm_Ptr;
-    sRingData   = (float *)((uint8_t *)sShm_Ptr + sizeof(RightMicRingBufferHeader));
+/* Runs on sAttachQueue after every StartIO and StopIO: tells the app how
+ * many clients are listening, so it only captures while someone is.  Each
+ * run stores the count as it is now, so the last one is always right. */
+static void RightMic_PublishClientsWork(void *context)
+{
+    (void)context;
+    RightMicConsumerMetrics *metrics = atomic_load_explicit(&sMetrics, memory_order_acquire);
+    if (metrics != NULL) {
+        RightMicMetrics_SetIOClients(metrics, atomic_load(&sIOClientCount));
+    }
+}
 
-    if (hasControlTable) {
-        sControlTable = (RightMicControlTable *)((uint8_t *)sShm_Ptr + kRightMic_ControlTableOffset);
-        LOG_INFO("Shared memory mapped (V2, %zu bytes, control table present)", sShm_MapSize);
-    } else {
-        sControlTable = NULL;
-        LOG_INFO("Shared memory mapped (V1, %zu bytes, no control table)", sShm_MapSize);
+static void RightMic_DetachWork(void *context)
+{
+    (void)context;
+    if (RightMicAttach_IsAttached(&sAttach)) {
+        RightMicAttach_Close(&sAttach);
+        RightMic_PublishResidency(kRightMicResidency_Unknown);
+        LOG_INFO("Shared memory unmapped");
     }
+    sLastAttachResult = -1;
 }
 
-static void RightMic_CloseSharedMemory(void)
+/* True once `count` reaches the first glitch or the next multiple of
+ * kRightMic_GlitchLogEvery since `logged`. */
+static bool RightMic_GlitchDue(uint64_t count, uint64_t logged)
+{
+    return count > logged &&
+           (logged == 0 || count / kRightMic_GlitchLogEvery > logged / kRightMic_GlitchLogEvery);
+}
+
+/* Log overflows and underruns the IO thread counted into the metrics
+ * block.  Worker queue; without metrics there is nothing to log from. */
+static void RightMic_LogGlitches(void)
+{
+    RightMicConsumerMetrics *metrics = atomic_load_explicit(&sMetrics, memory_order_acquire);
+    if (metrics == NULL) return;
+
+    uint64_t overruns  = atomic_load_explicit(&metrics->overruns, memory_order_relaxed);
+    uint64_t underruns = atomic_load_explicit(&metrics->underruns, memory_order_relaxed);
+    if (RightMic_GlitchDue(overruns, sLoggedOverruns)) {
+        LOG_INFO("Ring buffer overflow #%llu (ring=%u). Re-synced read head.",
+                 (unsigned long long)overruns, atomic_load_explicit(&sRingFrames, memory_order_relaxed));
+    }
+    if (RightMic_GlitchDue(underruns, sLoggedUnderruns)) {
+        LOG_INFO("Ring buffer underrun #%llu (%llu frames concealed in total).",
+                 (unsigned long long)underruns,
+                 (unsigned long long)atomic_load_explicit(&metrics->concealedFrames, memory_order_relaxed));
+    }
+    sLoggedOverruns  = overruns;
+    sLoggedUnderruns = underruns;
+}
+
+/* Runs on sWorkerQueue every kRightMic_WorkerPollMs during an IO session:
+ * picks up what the IO thread flagged and does the parts it must not do
+ * itself (copying the control table, HAL notifications, logging). */
+static void RightMic_WorkerTick(void *context)
 {
-    if (sShm_Ptr != MAP_FAILED) {
-        munmap(sShm_Ptr, sShm_MapSize > 0 ? sShm_MapSize : kRightMic_SharedMemorySize);
-        sShm_Ptr = MAP_FAILED;
-        sShm_MapSize = 0;
+    if ((uint32_t)(uintptr_t)context != atomic_load(&sIOGeneration)) return;
+
+    if (atomic_exchange_explicit(&sControlsPending, 0, memory_order_acquire) &&
+        !RightMic_UpdateControlCache()) {
+        atomic_store_explicit(&sControlsPending, 1, memory_order_relaxed);  /* app mid-update */
+    }
+    if (atomic_exchange_explicit(&sLatencyPending, 0, memory_order_acquire)) {
+        RightMic_NotifyLatencyChanged();
     }
-    if (sShm_FD >= 0) {
-        close(sShm_FD);
-        sShm_FD = -1;
+    if (atomic_exchange_explicit(&sRemapPending, 0, memory_order_acquire)) {
+        dispatch_async_f(sAttachQueue, context, RightMic_RemapWork);
     }
-    sRingHeader   = NULL;
-    sRingData     = NULL;
-    sControlTable = NULL;
+    if (atomic_exchange_explicit(&sClockPending, 0, memory_order_acquire)) {
+        LOG_INFO("Capture clock %s (%.1f ppm, %llu discontinuities)",
+                 atomic_load_explicit(&sClockLogLocked, memory_order_relaxed) ? "locked" : "lost",
+                 (double)atomic_load_explicit(&sClockLogPPM, memory_order_relaxed),
+                 (unsigned long long)atomic_load_explicit(&sClockLogDiscontinuities,
+                                                          memory_order_relaxed));
+    }
+    RightMic_LogGlitches();
+
+    dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW, (int64_t)kRightMic_WorkerPollMs * NSEC_PER_MSEC),
+                     sWorkerQueue, context, RightMic_WorkerTick);
+}
+
+/* Start mapping the shared memory in the background, and the worker that
+ * serves the IO thread (first StartIO). */
+static void RightMic_OpenSharedMemory(void)
+{
+    uint32_t generation = atomic_fetch_add(&sIOGeneration, 1) + 1;
+    dispatch_async_f(sAttachQueue, (void *)(uintptr_t)generation, RightMic_AttachWork);
+    dispatch_async_f(sWorkerQueue, (void *)(uintptr_t)generation, RightMic_WorkerTick);
+}
+
+/* Cancel pending retries and worker polls and unmap in the background
+ * (last StopIO). */
+static void RightMic_CloseSharedMemory(void)
+{
+    atomic_fetch_add(&sIOGeneration, 1);
+    dispatch_async_f(sAttachQueue, NULL, RightMic_DetachWork);
+}
+
+/* App-side state read by property getters and the main queue (never the
+ * IO thread).  Each holds the attach lock so the mapping can't go away
+ * underneath; 0 / the fallback while detached. */
+static UInt32 RightMic_AppMuted(void)
+{
+    const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+    UInt32 muted = shm ? atomic_load_explicit(&shm->ring.header->muted, memory_order_relaxed) : 0;
+    RightMicAttach_Unlock(&sAttach);
+    return muted;
+}
+
+static UInt32 RightMic_AppControlUInt(UInt32 idx)
+{
+    const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+    UInt32 value = shm ? atomic_load_explicit(&shm->controls->entries[idx].uintValue,
+                                              memory_order_relaxed)
+                       : 0;
+    RightMicAttach_Unlock(&sAttach);
+    return value;
+}
+
+static Float32 RightMic_AppControlFloat(UInt32 idx, Float32 fallback)
+{
+    const RightMicMapping *shm = RightMicAttach_Lock(&sAttach);
+    Float32 value = shm ? atomic_load_explicit(&shm->controls->entries[idx].floatValue,
+                                               memory_order_relaxed)
+                        : fallback;
+    RightMicAttach_Unlock(&sAttach);
+    return value;
 }
 
 /* ================================================================
@@ -1537,16 +1858,29 @@ static void RightMic_CloseSharedMemory(void)
 
 static OSStatus RightMic_StartIO(AudioServerPlugInDriverRef inDriver, AudioObjectID inDeviceObjectID, UInt32 inClientID)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inClientID;
+    (void)inDriver; (void)inDeviceObjectID;
+
+    /* A client joining running IO shares the cycles already running: the
+     * cursor keeps its position and the device clock keeps running. */
+    UInt32 previous = atomic_fetch_add(&sIOClientCount, 1);
+    dispatch_async_f(sAttachQueue, NULL, RightMic_PublishClientsWork);
+    if (previous > 0) {
+        LOG_INFO("IO started (client %u, %u running)", inClientID, atomic_load(&sIOClientCount));
+        return kAudioHardwareNoError;
+    }
 
-    sIO_StartHostTime = mach_absolute_time();
+    sLastCycleHostTime = 0;
 
-    /* Compute host ticks per IO period */
-    Float64 nsPerPeriod = ((Float64)kRightMic_BufferFrameSize / kRightMic_SampleRate) * 1000000000.0;
-    sIO_HostTicksPerPeriod = (uint64_t)(nsPerPeriod * (Float64)sTimebaseInfo.denom / (Float64)sTimebaseInfo.numer);
+    /* Nominal host ticks between zero timestamps.  The period is fixed,
+     * whatever IO buffer size the clients pick; once the capture clock
+     * is known, GetZeroTimeStamp stretches it to that clock's rate. */
+    Float64 rate        = atomic_load_explicit(&sSampleRate, memory_order_relaxed);
+    Float64 nsPerPeriod = ((Float64)kRightMic_ZeroTimeStampPeriod / rate) * 1000000000.0;
+    RightMicClock_StartTimeline(&sClockTimeline, &sClockEstimator, mach_absolute_time(),
+                                kRightMic_ZeroTimeStampPeriod,
+                                nsPerPeriod * (Float64)sTimebaseInfo.denom / (Float64)sTimebaseInfo.numer);
 
-    sLocalReadHead = 0;
-    sOverflowCount = 0;
+    RightMicCursor_Restart(&sCursor);
     RightMic_OpenSharedMemory();
 
     atomic_store(&sDeviceIsRunning, true);
@@ -1556,7 +1890,15 @@ static OSStatus RightMic_StartIO(AudioServerPlugInDriverRef inDriver, AudioObjec
 
 static OSStatus RightMic_StopIO(AudioServerPlugInDriverRef inDriver, AudioObjectID inDeviceObjectID, UInt32 inClientID)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inClientID;
+    (void)inDriver; (void)inDeviceObjectID;
+
+    UInt32 old = atomic_load(&sIOClientCount);
+    UInt32 running = (old > 0) ? (atomic_fetch_sub(&sIOClientCount, 1) - 1) : 0;
+    dispatch_async_f(sAttachQueue, NULL, RightMic_PublishClientsWork);
+    if (running > 0) {
+        LOG_INFO("IO stopped (client %u, %u still running)", inClientID, running);
+        return kAudioHardwareNoError;
+    }
 
     atomic_store(&sDeviceIsRunning, false);
     RightMic_CloseSharedMemory();
@@ -1570,13 +1912,10 @@ static OSStatus RightMic_GetZeroTimeStamp(AudioServerPlugInDriverRef inDriver, A
 {
     (void)inDriver; (void)inDeviceObjectID; (void)inClientID;
 
-    uint64_t currentHostTime = mach_absolute_time();
-    uint64_t ticksSinceStart = currentHostTime - sIO_StartHostTime;
-    uint64_t numPeriods = ticksSinceStart / sIO_HostTicksPerPeriod;
-
-    *outSampleTime = (Float64)(numPeriods * kRightMic_BufferFrameSize);
-    *outHostTime   = sIO_StartHostTime + (numPeriods * sIO_HostTicksPerPeriod);
-    *outSeed       = 1;
+    /* Zero timestamps run on the capture device's clock as DoIO last
+     * estimated it; the seed changes whenever that clock was lost. */
+    RightMicClock_ZeroTimeStamp(&sClockTimeline, &sClockEstimator, mach_absolute_time(),
+                                outSampleTime, outHostTime, outSeed);
 
     return kAudioHardwareNoError;
 }
@@ -1615,8 +1954,8 @@ static OSStatus RightMic_DoIOOperation(AudioServerPlugInDriverRef inDriver, Audi
                                         const AudioServerPlugInIOCycleInfo *inIOCycleInfo,
                                         void *ioMainBuffer, void *ioSecondaryBuffer)
 {
-    (void)inDriver; (void)inDeviceObjectID; (void)inStreamObjectID;
-    (void)inClientID; (void)inIOCycleInfo; (void)ioSecondaryBuffer;
+    (void)inDriver; (void)inDeviceObjectID; (void)inStreamObjectID; (void)inClientID;
+    (void)ioSecondaryBuffer;
 
     if (inOperationID != kAudioServerPlugInIOOperationReadInput) {
         return kAudioHardwareNoError;
@@ -1626,76 +1965,114 @@ static OSStatus RightMic_DoIOOperation(AudioServerPlugInDriverRef inDriver, Audi
     UInt32 framesToFill = inIOBufferFrameSize;
     UInt32 samplesToFill = framesToFill * kRightMic_ChannelCount;
 
-    /* Try to re-open shared memory if not yet available */
-    if (sShm_Ptr == MAP_FAILED) {
-        RightMic_OpenSharedMemory();
+    /* The mapping published by the attach queue, or none yet: one lookup,
+     * no system calls.  It stays valid until ExitIO. */
+    const RightMicMapping *shm = RightMicAttach_EnterIO(&sAttach);
+    const RightMicRing *ring = shm ? &shm->ring : &sNoRing;
+
+    /* A header that no longer matches the view means the app resized the
+     * ring in place, or has none here (closed, or writing elsewhere):
+     * reading on could run past the mapping.  Read silence, and have the
+     * worker remap once there is a ring to map. */
+    if (shm != NULL && !RightMicRing_MatchesHeader(ring)) {
+        atomic_store_explicit(&sRemapPending, 1, memory_order_release);
+        ring = &sNoRing;
+    } else if (shm != NULL && ring->frames != atomic_load_explicit(&sRingFrames, memory_order_relaxed)) {
+        atomic_store_explicit(&sRingFrames, ring->frames, memory_order_relaxed);
+        RightMicCursor_SetRingFrames(&sCursor, ring->frames);
+        RightMic_ApplyLatency(sLastTargetLatency, sLastMinSafeLatency, true);
     }
 
-    /* Check if control table version changed; dispatch cache update on main queue.
+    /* Follow the capture clock through the timestamps the app published
+     * since the last call; GetZeroTimeStamp runs on the result. */
+    if (ring != &sNoRing) {
+        RightMicClock_Update(&sClockEstimator, shm->clock);
+        if (RightMicClock_IsLocked(&sClockEstimator) != sClockLocked) {
+            sClockLocked = !sClockLocked;
+            atomic_store_explicit(&sClockLogLocked, sClockLocked, memory_order_relaxed);
+            atomic_store_explicit(&sClockLogPPM, (float)RightMicClock_PPM(&sClockEstimator),
+                                  memory_order_relaxed);
+            atomic_store_explicit(&sClockLogDiscontinuities, sClockEstimator.discontinuities,
+                                  memory_order_relaxed);
+            atomic_store_explicit(&sClockPending, 1, memory_order_release);
+        }
+    }
+
+    /* Time each IO cycle against the previous one: the first read of a
+     * cycle records how far its wake-up strayed from one IO period. */
+    RightMicConsumerMetrics *metrics = atomic_load_explicit(&sMetrics, memory_order_acquire);
+    if (metrics != NULL && (sLastCycleHostTime == 0 ||
+                            inIOCycleInfo->mIOCycleCounter != sLastCycleCounter)) {
+        UInt64 now = mach_absolute_time();
+        UInt64 intervalNs = 0;
+        UInt64 periodNs   = (UInt64)((Float64)sLastCycleFrames * 1000000000.0 /
+                                     (Float64)atomic_load_explicit(&sSampleRate, memory_order_relaxed));
+        if (sLastCycleHostTime != 0) {
+            intervalNs = (now - sLastCycleHostTime) * sTimebaseInfo.numer / sTimebaseInfo.denom;
+        }
+        RightMicMetrics_RecordCycle(metrics, intervalNs, periodNs);
+        RightMicMetrics_SetIOBufferFrames(metrics, framesToFill,
+                                          atomic_load_explicit(&sSampleRate, memory_order_relaxed));
+        sLastCycleCounter  = inIOCycleInfo->mIOCycleCounter;
+        sLastCycleHostTime = now;
+        sLastCycleFrames   = framesToFill;
+    }
+
+    /* Check if control table version changed; flag a cache update for the worker.
      * Done before filling the buffer so it runs every IO cycle regardless of path. */
-    if (sControlTable != NULL) {
-        uint32_t newVer = (uint32_t)atomic_load_explicit(&sControlTable->version, memory_order_relaxed);
+    if (shm != NULL) {
+        uint32_t newVer = (uint32_t)atomic_load_explicit(&shm->controls->version, memory_order_relaxed);
         if (newVer != sLastCtrlVersion) {
             sLastCtrlVersion = newVer;
-            dispatch_async(dispatch_get_main_queue(), ^{ RightMic_UpdateControlCache(); });
+            atomic_store_explicit(&sControlsPending, 1, memory_order_release);
         }
     }
 
-    /* Fill output buffer: copy from ring buffer if data is available, else silence */
-    bool filledFromRing = false;
-    if (sRingHeader != NULL && atomic_load_explicit(&sRingHeader->active, memory_order_acquire)) {
-        uint64_t wHead = atomic_load_explicit(&sRingHeader->writeHead, memory_order_acquire);
-
-        /* Sync local read head to writer on first IO or after a reset.
-         * The app resets writeHead to 0 when switching devices, so if
-         * writeHead is behind our read position, re-sync immediately
-         * instead of waiting for it to catch up (which takes ~45s). */
-        if (sLocalReadHead == 0 || wHead < sLocalReadHead) {
-            if (wHead > framesToFill) {
-                sLocalReadHead = wHead - framesToFill;
-            } else {
-                sLocalReadHead = 0;
-            }
-        }
+    /* The HAL runs the device at the smallest buffer size any client asked
+     * for.  Once a cycle shows a new one, report it and the latency it
+     * gives; the cursor re-clamps its watermarks in Prepare. */
+    if (framesToFill != atomic_load_explicit(&sBufferFrameSize, memory_order_relaxed)) {
+        atomic_store_explicit(&sBufferFrameSize, framesToFill, memory_order_relaxed);
+        RightMic_ApplyLatency(sLastTargetLatency, sLastMinSafeLatency, true);
+    }
 
-        uint64_t available = wHead - sLocalReadHead;
-
-        /* Overflow: the writer has lapped the reader due to clock drift
-         * between the app's hardware sample clock and the driver's
-         * mach_absolute_time-based clock.  Re-sync the read head to just
-         * behind the write head so the next copy reads valid (recent)
-         * data.  This trades a single ~10ms glitch for preventing
-         * sustained garbled output. */
-        if (available > kRightMic_RingBufferFrames) {
-            sOverflowCount++;
-            if (sOverflowCount == 1 || (sOverflowCount % 100) == 0) {
-                LOG_INFO("Ring buffer overflow #%llu (available=%llu, ring=%d). Re-syncing read head.",
-                         (unsigned long long)sOverflowCount, (unsigned long long)available, kRightMic_RingBufferFrames);
-            }
-            sLocalReadHead = wHead - framesToFill;
-            available = framesToFill;
+    /* Pick up latency changes from the app.  Watermarks apply immediately;
+     * the HAL is told about the new latency from the main queue. */
+    if (ring->header != NULL) {
+        uint32_t target  = atomic_load_explicit(&ring->header->targetLatency, memory_order_relaxed);
+        uint32_t minSafe = atomic_load_explicit(&ring->header->minSafeLatency, memory_order_relaxed);
+        if (target != sLastTargetLatency || minSafe != sLastMinSafeLatency) {
+            RightMic_ApplyLatency(target, minSafe, true);
         }
+    }
 
-        if (available >= framesToFill) {
-            UInt32 framesRead = 0;
-            while (framesRead < framesToFill) {
-                uint64_t ringIndex = (sLocalReadHead + framesRead) % kRightMic_RingBufferFrames;
-                UInt32 contiguous = (UInt32)(kRightMic_RingBufferFrames - ringIndex);
-                UInt32 chunk = framesToFill - framesRead;
-                if (chunk > contiguous) chunk = contiguous;
-
-                memcpy(outBuffer + (framesRead * kRightMic_ChannelCount),
-                       sRingData + (ringIndex * kRightMic_ChannelCount),
-                       chunk * kRightMic_BytesPerFrame);
-                framesRead += chunk;
-            }
-            sLocalReadHead += framesToFill;
-            filledFromRing = true;
-        }
+    RightMicCursor *cursor = &sCursor;
+    RightMicCursor_Prepare(cursor, framesToFill);
+    if (ring->header != NULL) {
+        RightMicConceal_SetMode(&cursor->drift.conceal, (RightMicConcealMode)
+            atomic_load_explicit(&ring->header->concealMode, memory_order_relaxed));
     }
 
-    if (!filledFromRing) {
-        memset(outBuffer, 0, samplesToFill * sizeof(float));
+    /* Fill output buffer from the ring.  When it can't supply a full buffer the
+     * frames it has are played and only the deficit is concealed.
+     * RightMicDrift_Read resamples by a few ppm to hold the fill level at the
+     * target latency, so clock drift no longer ends in an overflow resync; that
+     * path remains only for real stalls (e.g. the app paused). */
+    RightMicRingReader *reader = &cursor->reader;
+    RightMicRingReader before = *reader;
+    RightMicDrift_Read(&cursor->drift, ring, reader, outBuffer, framesToFill);
+
+    /* Count the read's glitches; the worker logs them from the metrics. */
+    if (metrics != NULL) {
+        uint64_t fill = 0;
+        if (ring->header != NULL && reader->readHead != 0) {
+            uint64_t wHead = atomic_load_explicit(&ring->header->writeHead, memory_order_relaxed);
+            if (wHead > reader->readHead) fill = wHead - reader->readHead;
+        }
+        RightMicMetrics_RecordRead(metrics, &cursor->underrunRun, fill,
+                                   reader->underrunCount - before.underrunCount,
+                                   reader->concealedFrames - before.concealedFrames,
+                                   reader->overflowCount - before.overflowCount);
     }
 
     /* Apply mute: zero the buffer if any mute source is active.
@@ -1705,19 +2082,29 @@ static OSStatus RightMic_DoIOOperation(AudioServerPlugInDriverRef inDriver, Audi
      *   3. Dynamic mute controls (objectIDs 5+) — proxied real device mute controls
      * Read heads are always advanced even when muted to prevent stale burst on unmute. */
     bool muted = atomic_load_explicit(&sStaticMuteValue, memory_order_relaxed) != 0;
-    if (!muted && sRingHeader != NULL) {
-        muted = atomic_load_explicit(&sRingHeader->muted, memory_order_relaxed) != 0;
+    if (!muted && ring->header != NULL) {
+        muted = atomic_load_explicit(&ring->header->muted, memory_order_relaxed) != 0;
     }
-    if (!muted && sControlTable != NULL) {
-        for (uint32_t i = 0; i < sLocalCtrlCount && !muted; i++) {
-            if (sLocalControls[i].classID == kAudioMuteControlClassID) {
+    if (!muted && shm != NULL) {
+        RightMicControlEntry entries[kRightMic_MaxControls];
+        uint32_t count;
+        if (RightMicControls_TryRead(&sControls, &sIOControlsSeq, entries, &count)) {
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                if (entries[i].classID == kAudioMuteControlClassID) mask |= 1u << i;
+            }
+            sIOMuteMask = mask;
+        }
+        for (uint32_t i = 0; i < kRightMic_MaxControls && !muted; i++) {
+            if (sIOMuteMask & (1u << i)) {
                 uint32_t av = (uint32_t)atomic_load_explicit(
-                    &sControlTable->entries[i].uintValue, memory_order_relaxed);
+                    &shm->controls->entries[i].uintValue, memory_order_relaxed);
                 uint32_t dv = (uint32_t)atomic_load_explicit(&sDriverValues[i], memory_order_relaxed);
                 muted = (av != 0) || (dv != 0);
             }
         }
     }
+    RightMicAttach_ExitIO(&sAttach);
     if (muted) {
         memset(outBuffer, 0, samplesToFill * sizeof(float));
     }
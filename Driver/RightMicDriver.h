@@ -12,6 +12,7 @@
 #ifndef RightMicDriver_h
 #define RightMicDriver_h
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* ── Object IDs ───────────────────────────────────────────────── */
@@ -28,11 +29,28 @@ enum {
 };
 
 /* ── Audio Format ─────────────────────────────────────────────── */
-#define kRightMic_SampleRate        48000.0
+#define kRightMic_SampleRate        48000.0   /* until a client picks another */
 #define kRightMic_ChannelCount      2
 #define kRightMic_BitsPerChannel    32
 #define kRightMic_BytesPerFrame     (kRightMic_ChannelCount * (kRightMic_BitsPerChannel / 8))
-#define kRightMic_BufferFrameSize   512
+/* Nominal rates the device offers.  The app writes the ring at the
+ * capture device's own rate when it is one of these, so a client
+ * running RightMic at the mic's rate reads it without any conversion. */
+#define kRightMic_SampleRateList    44100, 48000, 88200, 96000
+#define kRightMic_SampleRateCount   4
+#define kRightMic_BufferFrameSize   512   /* IO buffer size until a client asks */
+
+/* IO buffer sizes clients may choose.  Low-latency hosts run at 32–64
+ * frames; the ring's watermarks follow whatever size is chosen. */
+#define kRightMic_MinBufferFrameSize  32
+#define kRightMic_MaxBufferFrameSize  4096
+
+/* Frames between the device's zero timestamps.  Independent of the IO
+ * buffer size: it must only be at least the largest one. */
+#define kRightMic_ZeroTimeStampPeriod 16384
+
+_Static_assert(kRightMic_ZeroTimeStampPeriod >= kRightMic_MaxBufferFrameSize,
+               "zero timestamps must be at least one IO buffer apart");
 
 /* ── Identifiers ──────────────────────────────────────────────── */
 #define kRightMic_DeviceUID         "com.rightmic.device"
@@ -42,40 +60,140 @@ enum {
 #define kRightMic_BundleID          "com.rightmic.driver"
 
 /* ── Shared Memory Ring Buffer ────────────────────────────────── */
-/* Both the driver and the app mmap this file for IPC. */
+/* Both the driver and the app map this shared memory object for IPC, or */
+/* the file when the app can't create the object (see RightMicShm.h).   */
+/* Object names are at most 31 characters on Darwin.                     */
+#define kRightMic_SharedMemoryName  "/com.rightmic.audio"
 #define kRightMic_SharedMemoryPath  "/tmp/com.rightmic.audio"
-#define kRightMic_RingBufferFrames  16384  /* ~341 ms at 48 kHz */
+
+/* Ring capacity.  The app picks it when it opens the ring and the      */
+/* header carries it, so the driver adopts whatever the app chose: any */
+/* power of two in [Min, Max].  1024 frames (8 KiB) stays in L1; the   */
+/* maximum holds over five seconds at 48 kHz.                          */
+#define kRightMic_RingBufferFrames  16384  /* default: ~341 ms at 48 kHz    */
+#define kRightMic_MinRingFrames     1024
+#define kRightMic_MaxRingFrames     262144
+
+/* Read-position watermarks used when the app leaves the header's
+ * targetLatency / minSafeLatency at 0, for an IO buffer of `frames`.
+ * The target covers one app callback (the app runs its capture at the
+ * driver's IO size), one IO buffer and resampler look-ahead; below
+ * min-safe the producer is treated as stalled.  However small the
+ * buffers, the target keeps kRightMic_MinDefaultTargetLatency: until the
+ * drift loop locks, the fill wanders by up to ~300 frames at the
+ * largest drift it tracks.  See RightMicDrift.h. */
+#define kRightMic_MinDefaultTargetLatency  384
+#define kRightMic_DefaultTargetLatencyFor(frames) \
+    (3 * (frames) > kRightMic_MinDefaultTargetLatency ? 3 * (frames) : kRightMic_MinDefaultTargetLatency)
+#define kRightMic_DefaultMinSafeLatencyFor(frames)  ((frames) / 4)
+#define kRightMic_DefaultTargetLatency   kRightMic_DefaultTargetLatencyFor(kRightMic_BufferFrameSize)
+#define kRightMic_DefaultMinSafeLatency  kRightMic_DefaultMinSafeLatencyFor(kRightMic_BufferFrameSize)
 
 /*
  * Layout of the memory-mapped region:
  *
- *   [ RightMicRingBufferHeader ][ audio data ... ]
+ *   [ header ][ control table ][ metrics ][ clock ][ ... ][ audio data ... ]
+ *   0         kRightMic_PagedControlTableOffset
+ *                                 kRightMic_PagedMetricsOffset
+ *                                            kRightMic_PagedClockOffset
+ *                                                           kRightMic_PagedDataOffset
+ *
+ * The audio data starts on a page boundary and ends the file, so either
+ * side can map it a second time right behind itself (see RightMicMirror.h)
+ * and never split a copy at the wrap.
  *
- * Audio data is kRightMic_RingBufferFrames * kRightMic_BytesPerFrame bytes
- * of interleaved Float32 samples arranged as a circular buffer.
+ * Audio data is ringFrames * frameBytes bytes (the header says both) of
+ * Float32 samples arranged as a circular buffer: interleaved stereo, or,
+ * when the header says the producer is mono, one sample per frame.  The
+ * driver expands mono to the stream's two channels as it reads.  The
+ * region is rounded up to whole pages; a ring that fills them exactly
+ * (all but the smallest) can be mirrored.
  *
  * The companion app writes frames and advances `writeHead`.
- * The driver reads frames in DoIOOperation and advances `readHead`.
- * Both heads are frame indices (not byte offsets) that wrap via modulo.
+ * The driver reads frames in DoIOOperation through private cursors.
+ * Heads are frame indices (not byte offsets) that wrap via
+ * ringFrames - 1.
+ *
+ * The header is split into cache lines by writer, so the producer's
+ * store to `writeHead` on every chunk never invalidates the line the
+ * driver polls for the app's settings (and vice versa):
+ *
+ *   line 0  layout        written once by the app before it goes active
+ *   line 1  producer      writeHead, writeClaim, active
+ *   line 2  consumer      reserved for the driver side
+ *   line 3  control       app settings, written rarely, read every cycle
+ *
+ * Before it touches the data for frames up to E, the producer raises
+ * `writeClaim` to E; writeHead follows once they are written.  A reader
+ * that loads writeClaim after copying knows every frame below
+ * E - ringFrames may have been overwritten under it, and conceals those
+ * rather than play them (RightMicRing_IntactFrom).
+ *
+ * `magic` and `version` identify the layout; the driver maps nothing
+ * it does not recognize.  The geometry in line 0 (capacity, bytes per
+ * frame slot, data offset) is the app's choice; the driver checks it
+ * against the file size and maps the ring it describes.
  */
+#define kRightMic_CacheLineSize  64
+#define kRightMic_RingMagic      0x43494D52u  /* "RMIC" little-endian */
+#define kRightMic_RingVersion    8
+
 typedef struct {
+    /* Line 0: layout */
+    uint32_t         magic;        /* kRightMic_RingMagic                  */
+    uint32_t         version;      /* kRightMic_RingVersion                */
+    uint32_t         headerSize;   /* sizeof(RightMicRingBufferHeader)     */
+    uint32_t         dataOffset;   /* byte offset of audio data            */
+    uint32_t         ringFrames;   /* capacity; power of 2, Min..Max       */
+    uint32_t         sampleRate;   /* producer's rate, one of the offered  */
+    uint32_t         channels;     /* per ring frame: 1, or 2 interleaved  */
+    uint32_t         frameBytes;   /* per frame: kRightMic_FrameBytesFor(channels) */
+    uint32_t         _pad0[8];
+
+    /* Line 1: producer */
     _Atomic uint64_t writeHead;    /* next frame the app will write        */
-    _Atomic uint64_t readHead;     /* next frame the driver will read      */
+    _Atomic uint64_t writeClaim;   /* end of the frames being written      */
     _Atomic uint32_t active;       /* 1 = app is actively writing audio    */
-    uint32_t         sampleRate;   /* negotiated sample rate               */
-    uint32_t         channels;     /* negotiated channel count             */
+    uint32_t         _pad1[11];
+
+    /* Line 2: consumer */
+    _Atomic uint64_t readHead;     /* unused: the driver maps read-only    */
+    uint32_t         _pad2[14];
+
+    /* Line 3: control */
     _Atomic uint32_t muted;        /* 1 = app-side mute override           */
-    uint32_t         _pad[8];      /* pad header to 64 bytes               */
-} RightMicRingBufferHeader;
+    _Atomic uint32_t targetLatency;  /* frames to keep buffered; 0 = default */
+    _Atomic uint32_t minSafeLatency; /* refill below this fill; 0 = default  */
+    _Atomic uint32_t concealMode;  /* RightMicConcealMode; 0 = default     */
+    uint32_t         _pad3[12];
+} RightMicRingBufferHeader;        /* 256 bytes                            */
+
+_Static_assert(sizeof(RightMicRingBufferHeader) == 4 * kRightMic_CacheLineSize,
+               "ring header must be four cache lines");
+_Static_assert(offsetof(RightMicRingBufferHeader, writeHead) == 1 * kRightMic_CacheLineSize &&
+               offsetof(RightMicRingBufferHeader, readHead)  == 2 * kRightMic_CacheLineSize &&
+               offsetof(RightMicRingBufferHeader, muted)     == 3 * kRightMic_CacheLineSize,
+               "ring header fields must start their cache lines");
+
+/* Bytes per ring frame for a producer of `channels` (1, else stereo). */
+#define kRightMic_FrameBytesFor(channels) \
+    ((channels) == 1 ? sizeof(float) : kRightMic_BytesPerFrame)
 
+/* Bytes of audio data in a ring of `frames` of `channels`, rounded up to */
+/* whole 16 KiB pages, and in a stereo ring of the default size.          */
+#define kRightMic_RingDataBytesFor(frames, channels) \
+    (((size_t)(frames) * kRightMic_FrameBytesFor(channels) + kRightMic_PagedDataOffset - 1) / \
+     kRightMic_PagedDataOffset * kRightMic_PagedDataOffset)
 #define kRightMic_RingBufferDataBytes \
-    (kRightMic_RingBufferFrames * kRightMic_BytesPerFrame)
+    kRightMic_RingDataBytesFor(kRightMic_RingBufferFrames, kRightMic_ChannelCount)
 
+/* Header immediately followed by the audio data, with no control table.
+ * Used by the tests and benches; the shared file uses the paged layout. */
 #define kRightMic_SharedMemorySize \
     (sizeof(RightMicRingBufferHeader) + kRightMic_RingBufferDataBytes)
 
 /* ── Dynamic Control Table ────────────────────────────────────── */
-/* Appended after the ring buffer audio data.  The companion app  */
+/* Stored in the header page.  The companion app                  */
 /* enumerates the real device's CoreAudio controls and writes     */
 /* them here; the driver reads them and dynamically exposes the   */
 /* same controls on the virtual device.                           */
@@ -100,23 +218,163 @@ typedef struct {
 /*
  * Header + 4 control slots = 128 bytes total.
  *
- * The app increments `version` after writing all control data so
- * the driver can detect changes with a single atomic read.
+ * The app increments `version` before and after writing the control
+ * data, so it is odd while an update is in progress and even once it is
+ * complete.  The driver detects changes with a single atomic read and
+ * discards any copy that saw an odd or changing version.
  */
 typedef struct {
-    _Atomic uint32_t  version;                           /* bumped by app on each update  */
+    _Atomic uint32_t  version;                           /* odd while the app updates     */
     _Atomic uint32_t  count;                             /* number of active controls 0–4 */
     RightMicControlEntry entries[kRightMic_MaxControls]; /* 4 × 28 = 112 bytes            */
     uint32_t          _pad[2];                           /* pad to 128 bytes              */
 } RightMicControlTable;            /* 128 bytes                                       */
 
-/* The control table is stored at this byte offset within the mapped file. */
-#define kRightMic_ControlTableOffset  kRightMic_SharedMemorySize
 #define kRightMic_ControlTableSize    sizeof(RightMicControlTable)
 
-/* Total size of the shared memory file including the control table. */
-#define kRightMic_SharedMemorySizeV2 \
-    (kRightMic_SharedMemorySize + kRightMic_ControlTableSize)
+/* ── Metrics ──────────────────────────────────────────────────── */
+/* Wait-free counters and histograms for diagnosing glitches on   */
+/* users' machines.  Each block has exactly one writer and may be */
+/* read by anyone at any rate (see RightMicMetrics.h):            */
+/*                                                                */
+/*   producer  written by the app's capture callback, in the      */
+/*             header page of the shared file                     */
+/*   consumer  written by the driver's IO thread, in a small      */
+/*             shared memory object (or file) the driver owns: it */
+/*             maps the app's ring read-only                      */
+/*                                                                */
+/* The consumer block also carries the number of clients running  */
+/* IO, so the app can capture only while someone is listening,    */
+/* and the IO buffer size they run at, so the app can capture in  */
+/* bursts of the same size.  Each block says whether its side got */
+/* the ring's pages wired (RightMicMirror_Prefault).              */
+
+#define kRightMic_MetricsMagic      0x54534D52u  /* "RMST" little-endian */
+#define kRightMic_MetricsVersion    5
+#define kRightMic_HistogramBuckets  16
+#define kRightMic_DriverMetricsName "/com.rightmic.metrics"
+#define kRightMic_DriverMetricsPath "/tmp/com.rightmic.driver-metrics"
+
+/*
+ * Log2 histogram.  Bucket 0 counts zeros, bucket b counts values in
+ * [2^(b-1), 2^b) and the last bucket everything from 2^14 up, which
+ * covers a whole ring of frames or 16 ms in microseconds.
+ */
+typedef struct {
+    _Atomic uint64_t counts[kRightMic_HistogramBuckets];
+} RightMicHistogram;               /* 128 bytes, two cache lines          */
+
+typedef struct {
+    /* Line 0: identity, written once */
+    uint32_t          magic;        /* kRightMic_MetricsMagic; set last    */
+    uint32_t          version;      /* kRightMic_MetricsVersion            */
+    uint32_t          size;         /* sizeof(RightMicProducerMetrics)     */
+    uint32_t          _pad0[13];
+
+    /* Line 1: counters */
+    _Atomic uint64_t  callbacks;     /* capture callbacks                  */
+    _Atomic uint64_t  frames;        /* frames those callbacks delivered   */
+    _Atomic uint64_t  maxCallbackUs; /* longest callback                   */
+    _Atomic uint64_t  residency;     /* RightMicResidency of the app's map */
+    uint64_t          _pad1[4];
+
+    /* Lines 2–3 */
+    RightMicHistogram callbackUs;    /* capture callback duration (µs)     */
+} RightMicProducerMetrics;          /* 256 bytes                           */
+
+typedef struct {
+    /* Line 0: identity, written once; the IO rate */
+    uint32_t          magic;        /* kRightMic_MetricsMagic; set last    */
+    uint32_t          version;      /* kRightMic_MetricsVersion            */
+    uint32_t          size;         /* sizeof(RightMicConsumerMetrics)     */
+    _Atomic uint32_t  ioSampleRate; /* nominal rate of the IO cycles below */
+    uint32_t          _pad0[12];
+
+    /* Line 1: counters */
+    _Atomic uint64_t  cycles;          /* IO cycles served                 */
+    _Atomic uint64_t  underruns;       /* reads the ring couldn't fill     */
+    _Atomic uint64_t  concealedFrames; /* frames those reads concealed     */
+    _Atomic uint64_t  overruns;        /* reads the writer had lapped      */
+    _Atomic uint64_t  maxJitterUs;     /* worst cycle-to-cycle jitter      */
+    _Atomic uint64_t  ioClients;       /* clients running IO right now     */
+    _Atomic uint64_t  ioBufferFrames;  /* frames per IO cycle; 0 = none yet */
+    _Atomic uint64_t  residency;       /* RightMicResidency of its ring map */
+
+    /* Lines 2–7 */
+    RightMicHistogram fillFrames;      /* ring fill after each read        */
+    RightMicHistogram underrunFrames;  /* frames concealed per underrun    */
+    RightMicHistogram jitterUs;        /* |cycle interval - IO period|     */
+} RightMicConsumerMetrics;          /* 512 bytes                           */
+
+_Static_assert(sizeof(RightMicProducerMetrics) == 4 * kRightMic_CacheLineSize &&
+               sizeof(RightMicConsumerMetrics) == 8 * kRightMic_CacheLineSize,
+               "metrics blocks must be whole cache lines");
+
+/* ── Capture Clock ────────────────────────────────────────────── */
+/* Sample time / host time pairs from the capture callback's       */
+/* AudioTimeStamps, in the header page.  The driver fits the real  */
+/* device's rate from them and runs its zero timestamps on that    */
+/* clock (see RightMicClock.h), so the ring is read as fast as it  */
+/* is written instead of at the nominal rate.                      */
+/*                                                                 */
+/* The app writes entry `count % kRightMic_ClockEntries`, then     */
+/* bumps `count`.  Each entry carries its own sequence number:     */
+/* zero while the app rewrites it, count + 1 once complete, so a   */
+/* reader that finds a different sequence after copying knows the  */
+/* entry changed under it and drops the copy.                      */
+
+#define kRightMic_ClockEntries  16   /* ~170 ms of 512-frame callbacks */
+
+typedef struct {
+    _Atomic uint64_t sequence;     /* index + 1 when complete, 0 while written */
+    _Atomic double   sampleTime;   /* AudioTimeStamp.mSampleTime           */
+    _Atomic uint64_t hostTime;     /* AudioTimeStamp.mHostTime             */
+    _Atomic uint32_t clockID;      /* capture device; a change restarts the fit */
+    _Atomic uint32_t sampleRate;   /* that device's nominal rate           */
+} RightMicClockEntry;              /* 32 bytes                             */
+
+typedef struct {
+    /* Line 0 */
+    _Atomic uint64_t   count;      /* entries published                    */
+    uint64_t           _pad[7];
+
+    /* Lines 1–8 */
+    RightMicClockEntry entries[kRightMic_ClockEntries];
+} RightMicClockTable;              /* 576 bytes                            */
+
+_Static_assert(sizeof(RightMicClockEntry) == 32 &&
+               sizeof(RightMicClockTable) == 9 * kRightMic_CacheLineSize,
+               "clock table must be whole cache lines");
+
+/* Paged layout.  16 KiB is the arm64 page size and a multiple of 4 KiB,
+ * so both offsets work on every Mac.  The control table follows the
+ * header on its own cache lines; the producer metrics start at the next
+ * 128-byte boundary, so the callback's counter stores never touch a line
+ * (or adjacent-line prefetch pair) the driver polls.  The clock table
+ * comes right after them: the same callback writes both. */
+#define kRightMic_PagedDataOffset          16384
+#define kRightMic_PagedControlTableOffset  256
+#define kRightMic_PagedMetricsOffset       512
+#define kRightMic_PagedClockOffset         768
+#define kRightMic_SharedMemorySizeFor(frames, channels) \
+    (kRightMic_PagedDataOffset + kRightMic_RingDataBytesFor(frames, channels))
+#define kRightMic_SharedMemorySizePaged \
+    kRightMic_SharedMemorySizeFor(kRightMic_RingBufferFrames, kRightMic_ChannelCount)
+
+/* Audio data can start no earlier than this: the header page's fixed
+ * blocks come first. */
+#define kRightMic_PagedMinDataOffset \
+    (kRightMic_PagedClockOffset + sizeof(RightMicClockTable))
+
+_Static_assert(kRightMic_PagedControlTableOffset == sizeof(RightMicRingBufferHeader),
+               "control table must follow the ring header");
+_Static_assert(kRightMic_PagedMetricsOffset >= kRightMic_PagedControlTableOffset + sizeof(RightMicControlTable) &&
+               kRightMic_PagedMetricsOffset % kRightMic_CacheLineSize == 0 &&
+               kRightMic_PagedMetricsOffset + sizeof(RightMicProducerMetrics) <= kRightMic_PagedDataOffset,
+               "producer metrics must sit on their own lines in the header page");
+_Static_assert(kRightMic_PagedClockOffset == kRightMic_PagedMetricsOffset + sizeof(RightMicProducerMetrics) &&
+               kRightMic_PagedClockOffset + sizeof(RightMicClockTable) <= kRightMic_PagedDataOffset,
+               "clock table must follow the producer metrics in the header page");
 
 /* ── Driver Bundle ────────────────────────────────────────────── */
 /* Installation path for the .driver bundle. */
@@ -0,0 +1,151 @@
+/*
+ * RightMicLevel.c
+ * Signal level and dead-silence detection for the capture callback.
+ *
+ * See RightMicLevel.h.
+ */
+
+#include "RightMicLevel.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Four lanes map to one SSE or NEON register; two sets of accumulators */
+/* hide the add latency.                                                */
+typedef float   Vec4  __attribute__((vector_size(16)));
+typedef int32_t Mask4 __attribute__((vector_size(16)));
+
+static inline Vec4 Load(const float *p)
+{
+    Vec4 v;
+    memcpy(&v, p, sizeof(v));  /* unaligned load */
+    return v;
+}
+
+/* Plain C has no vector min/max, and the generic blend is three extra */
+/* instructions per lane group, so use the native ones where known.    */
+static inline Vec4 Min(Vec4 a, Vec4 b)
+{
+#if defined(__SSE__)
+    return (Vec4)_mm_min_ps((__m128)a, (__m128)b);
+#elif defined(__ARM_NEON)
+    return (Vec4)vminq_f32((float32x4_t)a, (float32x4_t)b);
+#else
+    Mask4 m = a < b;
+    return (Vec4)((m & (Mask4)a) | (~m & (Mask4)b));
+#endif
+}
+
+static inline Vec4 Max(Vec4 a, Vec4 b)
+{
+#if defined(__SSE__)
+    return (Vec4)_mm_max_ps((__m128)a, (__m128)b);
+#elif defined(__ARM_NEON)
+    return (Vec4)vmaxq_f32((float32x4_t)a, (float32x4_t)b);
+#else
+    Mask4 m = a > b;
+    return (Vec4)((m & (Mask4)a) | (~m & (Mask4)b));
+#endif
+}
+
+static inline float LaneMin(Vec4 v) { return fminf(fminf(v[0], v[1]), fminf(v[2], v[3])); }
+static inline float LaneMax(Vec4 v) { return fmaxf(fmaxf(v[0], v[1]), fmaxf(v[2], v[3])); }
+static inline float LaneSum(Vec4 v) { return (v[0] + v[1]) + (v[2] + v[3]); }
+
+void RightMicLevel_Analyze(const float *samples, uint32_t count, RightMicLevelBlock *out)
+{
+    if (count == 0) {
+        *out = (RightMicLevelBlock){ 0 };
+        return;
+    }
+
+    Vec4 lo0 = { samples[0], samples[0], samples[0], samples[0] };
+    Vec4 hi0 = lo0, lo1 = lo0, hi1 = lo0;
+    Vec4 sum0 = { 0 }, sum1 = { 0 }, sq0 = { 0 }, sq1 = { 0 };
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        Vec4 a = Load(samples + i);
+        Vec4 b = Load(samples + i + 4);
+        lo0 = Min(lo0, a);
+        hi0 = Max(hi0, a);
+        lo1 = Min(lo1, b);
+        hi1 = Max(hi1, b);
+        sum0 += a;
+        sum1 += b;
+        sq0 += a * a;
+        sq1 += b * b;
+    }
+
+    float lo  = LaneMin(Min(lo0, lo1));
+    float hi  = LaneMax(Max(hi0, hi1));
+    float sum = LaneSum(sum0 + sum1);
+    float sq  = LaneSum(sq0 + sq1);
+    for (; i < count; i++) {
+        float x = samples[i];
+        lo = fminf(lo, x);
+        hi = fmaxf(hi, x);
+        sum += x;
+        sq  += x * x;
+    }
+
+    out->peak = fmaxf(fabsf(lo), fabsf(hi));
+    out->rms  = sqrtf(sq / (float)count);
+    out->dc   = sum / (float)count;
+    out->span = hi - lo;
+}
+
+void RightMicLevel_Init(RightMicLevelMeter *meter, double sampleRate, double windowSeconds)
+{
+    meter->windowFrames = (float)(sampleRate * windowSeconds);
+    meter->meanSquare   = 0.0f;
+    meter->mean         = 0.0f;
+    meter->peakHold     = 0.0f;
+    atomic_store_explicit(&meter->peak, 0.0f, memory_order_relaxed);
+    atomic_store_explicit(&meter->rms, 0.0f, memory_order_relaxed);
+    atomic_store_explicit(&meter->dc, 0.0f, memory_order_relaxed);
+    atomic_store_explicit(&meter->silentFrames, 0, memory_order_relaxed);
+    atomic_store_explicit(&meter->frames, 0, memory_order_release);
+}
+
+void RightMicLevel_Feed(RightMicLevelMeter *meter, const float *frames,
+                        uint32_t frameCount, uint32_t channels)
+{
+    if (frameCount == 0) return;
+
+    RightMicLevelBlock block;
+    RightMicLevel_Analyze(frames, frameCount * channels, &block);
+
+    /* One-pole smoothing with a per-block coefficient, so the window is
+     * the same length in time whatever the callback size. */
+    float keep = meter->windowFrames > 0.0f ? expf(-(float)frameCount / meter->windowFrames) : 0.0f;
+    meter->meanSquare = keep * meter->meanSquare + (1.0f - keep) * block.rms * block.rms;
+    meter->mean       = keep * meter->mean + (1.0f - keep) * block.dc;
+    meter->peakHold   = fmaxf(block.peak, keep * meter->peakHold);
+
+    /* The callback is the only writer, so plain stores suffice. */
+    uint64_t silent = atomic_load_explicit(&meter->silentFrames, memory_order_relaxed);
+    silent = block.span < kRightMicLevel_SilenceSpan ? silent + frameCount : 0;
+    uint64_t total = atomic_load_explicit(&meter->frames, memory_order_relaxed);
+
+    atomic_store_explicit(&meter->peak, meter->peakHold, memory_order_relaxed);
+    atomic_store_explicit(&meter->rms, sqrtf(meter->meanSquare), memory_order_relaxed);
+    atomic_store_explicit(&meter->dc, meter->mean, memory_order_relaxed);
+    atomic_store_explicit(&meter->silentFrames, silent, memory_order_relaxed);
+    atomic_store_explicit(&meter->frames, total + frameCount, memory_order_release);
+}
+
+void RightMicLevel_Read(const RightMicLevelMeter *meter, RightMicLevelReading *out)
+{
+    out->frames       = atomic_load_explicit(&meter->frames, memory_order_acquire);
+    out->peak         = atomic_load_explicit(&meter->peak, memory_order_relaxed);
+    out->rms          = atomic_load_explicit(&meter->rms, memory_order_relaxed);
+    out->dc           = atomic_load_explicit(&meter->dc, memory_order_relaxed);
+    out->silentFrames = atomic_load_explicit(&meter->silentFrames, memory_order_relaxed);
+}
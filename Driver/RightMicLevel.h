@@ -0,0 +1,88 @@
+/*
+ * RightMicLevel.h
+ * Signal level and dead-silence detection for the capture callback.
+ *
+ * Some microphones stay connected while delivering nothing: a hardware
+ * mute switch that zeroes the stream, a USB codec that holds a constant
+ * DC offset, a Bluetooth headset whose mic path never opened.  The
+ * router should treat such a device like a disconnected one.
+ *
+ * The capture callback feeds every block it writes through Feed, which
+ * measures peak, RMS, DC offset and peak-to-peak span in one vectorized
+ * pass and folds them into decaying-window estimates.  A block is dead
+ * silent when its span is below kRightMicLevel_SilenceSpan: that ignores
+ * a DC offset, yet a live mic in a quiet room (noise around -70 dBFS)
+ * always clears it.  `silentFrames` counts how long the input has been
+ * dead without a break.
+ *
+ * The callback is the only writer; other threads read the estimates with
+ * Read at any time, without locks.  Portable C11 (GCC/Clang vector
+ * extensions), unit-tested and benchmarked on Linux.
+ */
+
+#ifndef RightMicLevel_h
+#define RightMicLevel_h
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kRightMicLevel_SilenceSpan     1.0e-4f  /* peak-to-peak, -80 dBFS   */
+#define kRightMicLevel_DefaultWindow   0.3      /* seconds, VU-meter-like   */
+
+/* Statistics of one block of samples. */
+typedef struct {
+    float peak;  /* largest |sample|  */
+    float rms;
+    float dc;    /* mean sample value */
+    float span;  /* max - min         */
+} RightMicLevelBlock;
+
+/* What readers see. */
+typedef struct {
+    float    peak;          /* decaying peak |sample|                   */
+    float    rms;           /* RMS over the decaying window             */
+    float    dc;            /* mean over the decaying window            */
+    uint64_t silentFrames;  /* frames of unbroken dead silence so far   */
+    uint64_t frames;        /* frames analyzed since Init               */
+} RightMicLevelReading;
+
+typedef struct {
+    /* Published (written by Feed, read by anyone) */
+    _Atomic float    peak;
+    _Atomic float    rms;
+    _Atomic float    dc;
+    _Atomic uint64_t silentFrames;
+    _Atomic uint64_t frames;
+
+    /* Feed only */
+    float windowFrames;  /* time constant of the decaying window */
+    float meanSquare;
+    float mean;
+    float peakHold;
+} RightMicLevelMeter;
+
+/* Statistics of `count` samples (any channel layout).  Count 0 reads    */
+/* as silence.                                                           */
+void RightMicLevel_Analyze(const float *samples, uint32_t count, RightMicLevelBlock *out);
+
+/* Reset the meter, with a decaying window of `windowSeconds`.  Not      */
+/* while Feed may run.                                                   */
+void RightMicLevel_Init(RightMicLevelMeter *meter, double sampleRate, double windowSeconds);
+
+/* Analyze `frameCount` interleaved frames of `channels` and update the  */
+/* estimates.  Real-time safe.                                           */
+void RightMicLevel_Feed(RightMicLevelMeter *meter, const float *frames,
+                        uint32_t frameCount, uint32_t channels);
+
+/* Current estimates.  Any thread, never blocks. */
+void RightMicLevel_Read(const RightMicLevelMeter *meter, RightMicLevelReading *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicLevel_h */
@@ -0,0 +1,282 @@
+/*
+ * RightMicMetrics.c
+ * Glitch statistics shared between the app, the driver and diagnostics.
+ *
+ * See RightMicMetrics.h.
+ */
+
+#include "RightMicMetrics.h"
+#include "RightMicShm.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ================================================================
+ * Histograms
+ * ================================================================ */
+
+uint32_t RightMicHistogram_Bucket(uint64_t value)
+{
+    if (value == 0) return 0;
+    uint32_t bucket = 64 - (uint32_t)__builtin_clzll(value);  /* floor(log2) + 1 */
+    return bucket < kRightMic_HistogramBuckets ? bucket : kRightMic_HistogramBuckets - 1;
+}
+
+uint64_t RightMicHistogram_BucketFloor(uint32_t bucket)
+{
+    return bucket == 0 ? 0 : 1ull << (bucket - 1);
+}
+
+/* Single writer: a plain load and store, never a read-modify-write. */
+static void Add(_Atomic uint64_t *counter, uint64_t amount)
+{
+    uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    atomic_store_explicit(counter, value + amount, memory_order_relaxed);
+}
+
+static void Max(_Atomic uint64_t *counter, uint64_t value)
+{
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static void Record(RightMicHistogram *histogram, uint64_t value)
+{
+    Add(&histogram->counts[RightMicHistogram_Bucket(value)], 1);
+}
+
+static void Clear(RightMicHistogram *histogram)
+{
+    for (uint32_t b = 0; b < kRightMic_HistogramBuckets; b++) {
+        atomic_store_explicit(&histogram->counts[b], 0, memory_order_relaxed);
+    }
+}
+
+static void Copy(const RightMicHistogram *histogram, uint64_t out[kRightMic_HistogramBuckets])
+{
+    for (uint32_t b = 0; b < kRightMic_HistogramBuckets; b++) {
+        out[b] = atomic_load_explicit(&histogram->counts[b], memory_order_relaxed);
+    }
+}
+
+/* ================================================================
+ * Producer
+ * ================================================================ */
+
+void RightMicMetrics_InitProducer(RightMicProducerMetrics *metrics)
+{
+    metrics->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&metrics->callbacks, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->frames, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->maxCallbackUs, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->residency, kRightMicResidency_Unknown, memory_order_relaxed);
+    Clear(&metrics->callbackUs);
+    metrics->version = kRightMic_MetricsVersion;
+    metrics->size    = sizeof(RightMicProducerMetrics);
+    atomic_thread_fence(memory_order_release);
+    metrics->magic   = kRightMic_MetricsMagic;
+}
+
+void RightMicMetrics_SetProducerResidency(RightMicProducerMetrics *metrics,
+                                          RightMicResidency residency)
+{
+    atomic_store_explicit(&metrics->residency, residency, memory_order_relaxed);
+}
+
+void RightMicMetrics_RecordCallback(RightMicProducerMetrics *metrics,
+                                    uint32_t frames, uint64_t durationNs)
+{
+    uint64_t us = durationNs / 1000;
+    Add(&metrics->callbacks, 1);
+    Add(&metrics->frames, frames);
+    Max(&metrics->maxCallbackUs, us);
+    Record(&metrics->callbackUs, us);
+}
+
+/* ================================================================
+ * Consumer
+ * ================================================================ */
+
+void RightMicMetrics_InitConsumer(RightMicConsumerMetrics *metrics)
+{
+    metrics->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&metrics->cycles, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->concealedFrames, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->maxJitterUs, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->ioClients, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->ioBufferFrames, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->ioSampleRate, 0, memory_order_relaxed);
+    atomic_store_explicit(&metrics->residency, kRightMicResidency_Unknown, memory_order_relaxed);
+    Clear(&metrics->fillFrames);
+    Clear(&metrics->underrunFrames);
+    Clear(&metrics->jitterUs);
+    metrics->version = kRightMic_MetricsVersion;
+    metrics->size    = sizeof(RightMicConsumerMetrics);
+    atomic_thread_fence(memory_order_release);
+    metrics->magic   = kRightMic_MetricsMagic;
+}
+
+/* The metrics file at `path`, created if needed, or -1. */
+static int OpenFile(const char *path)
+{
+    int fd = open(path, O_CREAT | O_RDWR | O_NOFOLLOW, 0644);
+    if (fd < 0) return -1;
+
+    /* Someone else's file could be truncated under the mapping. */
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t)sizeof(RightMicConsumerMetrics) &&
+        ftruncate(fd, sizeof(RightMicConsumerMetrics)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fchmod(fd, 0644);
+    return fd;
+}
+
+RightMicConsumerMetrics *RightMicMetrics_MapConsumer(const char *name, const char *path)
+{
+    int fd = name != NULL ? RightMicShm_Create(name, sizeof(RightMicConsumerMetrics)) : -1;
+    if (fd < 0) fd = OpenFile(path);
+    if (fd < 0) return NULL;
+
+    void *base = mmap(NULL, sizeof(RightMicConsumerMetrics), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    RightMicConsumerMetrics *metrics = base;
+    RightMicMetrics_InitConsumer(metrics);
+    return metrics;
+}
+
+void RightMicMetrics_RecordCycle(RightMicConsumerMetrics *metrics,
+                                 uint64_t intervalNs, uint64_t periodNs)
+{
+    Add(&metrics->cycles, 1);
+    if (intervalNs == 0 || periodNs == 0) return;
+
+    uint64_t jitterUs = (intervalNs > periodNs ? intervalNs - periodNs
+                                               : periodNs - intervalNs) / 1000;
+    Max(&metrics->maxJitterUs, jitterUs);
+    Record(&metrics->jitterUs, jitterUs);
+}
+
+void RightMicMetrics_RecordRead(RightMicConsumerMetrics *metrics, uint64_t *run,
+                                uint64_t fillFrames, uint64_t underruns,
+                                uint64_t concealedFrames, uint64_t overruns)
+{
+    Record(&metrics->fillFrames, fillFrames);
+    if (overruns > 0) Add(&metrics->overruns, overruns);
+
+    if (concealedFrames > 0) {
+        Add(&metrics->underruns, underruns);
+        Add(&metrics->concealedFrames, concealedFrames);
+        *run += concealedFrames;
+    } else if (*run > 0) {
+        /* The ring caught up: one underrun, however many reads it took. */
+        Record(&metrics->underrunFrames, *run);
+        *run = 0;
+    }
+}
+
+void RightMicMetrics_SetIOClients(RightMicConsumerMetrics *metrics, uint32_t clients)
+{
+    atomic_store_explicit(&metrics->ioClients, clients, memory_order_release);
+}
+
+void RightMicMetrics_SetIOBufferFrames(RightMicConsumerMetrics *metrics, uint32_t frames,
+                                      uint32_t sampleRate)
+{
+    /* Checked first so a steady size never dirties the lines for readers. */
+    if (atomic_load_explicit(&metrics->ioSampleRate, memory_order_relaxed) != sampleRate) {
+        atomic_store_explicit(&metrics->ioSampleRate, sampleRate, memory_order_relaxed);
+    }
+    if (atomic_load_explicit(&metrics->ioBufferFrames, memory_order_relaxed) != frames) {
+        atomic_store_explicit(&metrics->ioBufferFrames, frames, memory_order_relaxed);
+    }
+}
+
+void RightMicMetrics_SetConsumerResidency(RightMicConsumerMetrics *metrics,
+                                          RightMicResidency residency)
+{
+    atomic_store_explicit(&metrics->residency, residency, memory_order_relaxed);
+}
+
+/* ================================================================
+ * Readers
+ * ================================================================ */
+
+bool RightMicMetrics_ProducerIsCompatible(const RightMicProducerMetrics *metrics)
+{
+    bool ok = metrics->magic   == kRightMic_MetricsMagic &&
+              metrics->version == kRightMic_MetricsVersion &&
+              metrics->size    == sizeof(RightMicProducerMetrics);
+    atomic_thread_fence(memory_order_acquire);
+    return ok;
+}
+
+bool RightMicMetrics_ConsumerIsCompatible(const RightMicConsumerMetrics *metrics)
+{
+    bool ok = metrics->magic   == kRightMic_MetricsMagic &&
+              metrics->version == kRightMic_MetricsVersion &&
+              metrics->size    == sizeof(RightMicConsumerMetrics);
+    atomic_thread_fence(memory_order_acquire);
+    return ok;
+}
+
+int64_t RightMicMetrics_IOClients(const RightMicConsumerMetrics *metrics)
+{
+    if (metrics == NULL || !RightMicMetrics_ConsumerIsCompatible(metrics)) return -1;
+    return (int64_t)atomic_load_explicit(&metrics->ioClients, memory_order_acquire);
+}
+
+int64_t RightMicMetrics_IOBufferFrames(const RightMicConsumerMetrics *metrics)
+{
+    if (metrics == NULL || !RightMicMetrics_ConsumerIsCompatible(metrics)) return -1;
+    return (int64_t)atomic_load_explicit(&metrics->ioBufferFrames, memory_order_relaxed);
+}
+
+int64_t RightMicMetrics_IOSampleRate(const RightMicConsumerMetrics *metrics)
+{
+    if (metrics == NULL || !RightMicMetrics_ConsumerIsCompatible(metrics)) return -1;
+    return (int64_t)atomic_load_explicit(&metrics->ioSampleRate, memory_order_relaxed);
+}
+
+void RightMicMetrics_Snapshot(const RightMicProducerMetrics *producer,
+                              const RightMicConsumerMetrics *consumer,
+                              RightMicMetricsSnapshot *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    if (producer != NULL && RightMicMetrics_ProducerIsCompatible(producer)) {
+        out->callbacks     = atomic_load_explicit(&producer->callbacks, memory_order_relaxed);
+        out->frames        = atomic_load_explicit(&producer->frames, memory_order_relaxed);
+        out->maxCallbackUs = atomic_load_explicit(&producer->maxCallbackUs, memory_order_relaxed);
+        out->appResidency  = atomic_load_explicit(&producer->residency, memory_order_relaxed);
+        Copy(&producer->callbackUs, out->callbackUs);
+    }
+
+    if (consumer != NULL && RightMicMetrics_ConsumerIsCompatible(consumer)) {
+        out->cycles          = atomic_load_explicit(&consumer->cycles, memory_order_relaxed);
+        out->underruns       = atomic_load_explicit(&consumer->underruns, memory_order_relaxed);
+        out->concealedFrames = atomic_load_explicit(&consumer->concealedFrames, memory_order_relaxed);
+        out->overruns        = atomic_load_explicit(&consumer->overruns, memory_order_relaxed);
+        out->maxJitterUs     = atomic_load_explicit(&consumer->maxJitterUs, memory_order_relaxed);
+        out->driverResidency = atomic_load_explicit(&consumer->residency, memory_order_relaxed);
+        Copy(&consumer->fillFrames, out->fillFrames);
+        Copy(&consumer->underrunFrames, out->underrunFrames);
+        Copy(&consumer->jitterUs, out->jitterUs);
+    }
+}
@@ -0,0 +1,159 @@
+/*
+ * RightMicMetrics.h
+ * Glitch statistics shared between the app, the driver and diagnostics.
+ *
+ * "Robot voice" on a user's machine is an underrun, an overrun or a
+ * late callback on one side of the ring, and logs alone can't say which.
+ * Each side keeps counters and log2 histograms in a block of shared
+ * memory (layouts in RightMicDriver.h):
+ *
+ *   producer  the app's capture callback: callbacks, frames, duration
+ *   consumer  the driver's IO thread: cycles, underruns and their
+ *             length, overruns, ring fill, cycle-to-cycle jitter;
+ *             and the driver's count of clients running IO, which
+ *             tells the app whether anyone is listening at all
+ *
+ * Every field has a single writer, so updates are a relaxed load and a
+ * relaxed store: no read-modify-write, no lock, never a retry, and safe
+ * on the real-time threads.  Readers take a relaxed snapshot whenever
+ * they like; counters are individually exact but a snapshot may be
+ * mid-update across fields, which is fine for statistics.
+ *
+ * The driver maps the app's ring read-only and coreaudiod can't open
+ * an object the user owns for writing, so the consumer block lives in
+ * its own shared memory object (kRightMic_DriverMetricsName, or the
+ * file kRightMic_DriverMetricsPath where shm_open isn't allowed) that
+ * the driver creates and the app maps read-only.
+ *
+ * Portable POSIX + C11, unit-tested on Linux.
+ */
+
+#ifndef RightMicMetrics_h
+#define RightMicMetrics_h
+
+#include "RightMicDriver.h"
+#include "RightMicMirror.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Plain copy of both blocks for readers (and Swift, which can't read   */
+/* C atomics).  A missing block reads as zeros.                         */
+typedef struct {
+    /* producer */
+    uint64_t callbacks;
+    uint64_t frames;
+    uint64_t maxCallbackUs;
+    uint64_t callbackUs[kRightMic_HistogramBuckets];
+    uint64_t appResidency;    /* RightMicResidency */
+
+    /* consumer */
+    uint64_t cycles;
+    uint64_t underruns;
+    uint64_t concealedFrames;
+    uint64_t overruns;
+    uint64_t maxJitterUs;
+    uint64_t fillFrames[kRightMic_HistogramBuckets];
+    uint64_t underrunFrames[kRightMic_HistogramBuckets];
+    uint64_t jitterUs[kRightMic_HistogramBuckets];
+    uint64_t driverResidency; /* RightMicResidency */
+} RightMicMetricsSnapshot;
+
+/* ── Histograms ───────────────────────────────────────────────── */
+
+/* Bucket that counts `value` (see RightMicHistogram). */
+uint32_t RightMicHistogram_Bucket(uint64_t value);
+
+/* Smallest value counted by `bucket`. */
+uint64_t RightMicHistogram_BucketFloor(uint32_t bucket);
+
+/* ── Producer (the capture callback) ──────────────────────────── */
+
+/* Zero the block and publish its identity.  Before the callback runs. */
+void RightMicMetrics_InitProducer(RightMicProducerMetrics *metrics);
+
+/* One capture callback that delivered `frames` in `durationNs`.        */
+/* Real-time safe.                                                      */
+void RightMicMetrics_RecordCallback(RightMicProducerMetrics *metrics,
+                                    uint32_t frames, uint64_t durationNs);
+
+/* Publish how the app's mapping of the ring was prefaulted. */
+void RightMicMetrics_SetProducerResidency(RightMicProducerMetrics *metrics,
+                                          RightMicResidency residency);
+
+/* ── Consumer (the driver's IO thread) ────────────────────────── */
+
+/* Zero the block and publish its identity.  Before IO runs. */
+void RightMicMetrics_InitConsumer(RightMicConsumerMetrics *metrics);
+
+/* Create (or reuse) the driver's metrics as the shared memory object   */
+/* `name` or, failing that (or with `name` NULL), the file at `path`,   */
+/* map it writable and initialize it.  Returns NULL if neither can be   */
+/* created, or the path is not a regular file this process owns.  The   */
+/* mapping is never unmapped: it lives as long as the driver.           */
+/* Blocking; not for the IO thread.                                     */
+RightMicConsumerMetrics *RightMicMetrics_MapConsumer(const char *name, const char *path);
+
+/* One IO cycle began `intervalNs` after the previous one, for an IO    */
+/* period of `periodNs`.  Pass 0 for the first cycle after IO starts.   */
+/* Real-time safe.                                                      */
+void RightMicMetrics_RecordCycle(RightMicConsumerMetrics *metrics,
+                                 uint64_t intervalNs, uint64_t periodNs);
+
+/* One read through a cursor that left `fillFrames` in the ring and     */
+/* counted `underruns`, `concealedFrames` and `overruns` (the changes   */
+/* in its RightMicRingReader).  `run` is the cursor's own state: frames */
+/* concealed by consecutive reads so far, recorded as one underrun's    */
+/* length once a read conceals nothing.  Real-time safe.                */
+void RightMicMetrics_RecordRead(RightMicConsumerMetrics *metrics, uint64_t *run,
+                                uint64_t fillFrames, uint64_t underruns,
+                                uint64_t concealedFrames, uint64_t overruns);
+
+/* Publish how many clients are running IO.  Not for the IO thread; */
+/* callers must be serialized (the driver uses its attach queue).    */
+void RightMicMetrics_SetIOClients(RightMicConsumerMetrics *metrics, uint32_t clients);
+
+/* Publish the frames per IO cycle and the nominal rate they run at, */
+/* if changed.  Real-time safe.                                      */
+void RightMicMetrics_SetIOBufferFrames(RightMicConsumerMetrics *metrics, uint32_t frames,
+                                      uint32_t sampleRate);
+
+/* Publish how the driver's mapping of the ring was prefaulted       */
+/* (Unknown while it has none).  Not for the IO thread.              */
+void RightMicMetrics_SetConsumerResidency(RightMicConsumerMetrics *metrics,
+                                          RightMicResidency residency);
+
+/* ── Readers (any thread, any rate) ───────────────────────────── */
+
+/* True if the block carries an identity this code understands. */
+bool RightMicMetrics_ProducerIsCompatible(const RightMicProducerMetrics *metrics);
+bool RightMicMetrics_ConsumerIsCompatible(const RightMicConsumerMetrics *metrics);
+
+/* Clients the driver reports running IO, or -1 if `metrics` is NULL  */
+/* or not (yet) compatible.                                           */
+int64_t RightMicMetrics_IOClients(const RightMicConsumerMetrics *metrics);
+
+/* Frames per IO cycle the driver last ran, 0 before its first cycle, */
+/* or -1 if `metrics` is NULL or not (yet) compatible.                */
+int64_t RightMicMetrics_IOBufferFrames(const RightMicConsumerMetrics *metrics);
+
+/* Nominal rate of those cycles (Hz), the virtual device's rather than */
+/* the ring's; 0 before the first cycle, or -1 as above.              */
+int64_t RightMicMetrics_IOSampleRate(const RightMicConsumerMetrics *metrics);
+
+/* Copy whichever blocks are given (NULL, or not yet compatible, reads  */
+/* as zeros).                                                           */
+void RightMicMetrics_Snapshot(const RightMicProducerMetrics *producer,
+                              const RightMicConsumerMetrics *consumer,
+                              RightMicMetricsSnapshot *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicMetrics_h */
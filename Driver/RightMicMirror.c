@@ -0,0 +1,91 @@
+/*
+ * RightMicMirror.c
+ * Double-mapped ("magic") view of the shared ring.
+ *
+ * See RightMicMirror.h.
+ */
+
+#include "RightMicMirror.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Reserve address space for the file plus a second copy of the data
+ * region, then map both over the reservation with MAP_FIXED.  Only the
+ * reservation is ever unmapped, which releases both file mappings. */
+static bool MapMirrored(RightMicMirror *m, int fd, size_t fileSize,
+                        size_t dataOffset, size_t dataBytes, int prot)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (page == 0 || dataOffset % page != 0 || dataBytes % page != 0 ||
+        dataBytes == 0 || dataOffset + dataBytes != fileSize) {
+        return false;
+    }
+
+    size_t reserved = fileSize + dataBytes;
+    uint8_t *base = mmap(NULL, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == MAP_FAILED) return false;
+
+    if (mmap(base, fileSize, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + fileSize, dataBytes, prot, MAP_SHARED | MAP_FIXED, fd,
+             (off_t)dataOffset) == MAP_FAILED) {
+        munmap(base, reserved);
+        return false;
+    }
+
+    m->base     = base;
+    m->reserved = reserved;
+    m->mirrored = true;
+    return true;
+}
+
+bool RightMicMirror_Map(RightMicMirror *m, int fd, size_t fileSize,
+                        size_t dataOffset, size_t dataBytes, bool writable)
+{
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+
+    m->base     = NULL;
+    m->reserved = 0;
+    m->mirrored = false;
+    m->writable = writable;
+
+    if (MapMirrored(m, fd, fileSize, dataOffset, dataBytes, prot)) return true;
+
+    uint8_t *base = mmap(NULL, fileSize, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+    m->base     = base;
+    m->reserved = fileSize;
+    return true;
+}
+
+void RightMicMirror_Unmap(RightMicMirror *m)
+{
+    if (m->base != NULL) {
+        munmap(m->base, m->reserved);
+    }
+    m->base     = NULL;
+    m->reserved = 0;
+    m->mirrored = false;
+}
+
+RightMicResidency RightMicMirror_Prefault(RightMicMirror *m)
+{
+    if (m->base == NULL) return kRightMicResidency_Unknown;
+
+    /* Each copy of the data has its own page table entries, so both are
+     * walked; the reservation is covered by the two mappings. */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < m->reserved; offset += page) {
+        volatile uint8_t *p = m->base + offset;
+        if (m->writable) {
+            *p = *p;
+        } else {
+            (void)*p;
+        }
+    }
+
+    /* Refused without the privilege or above RLIMIT_MEMLOCK; the pages
+     * are resident for now either way. */
+    return mlock(m->base, m->reserved) == 0 ? kRightMicResidency_Wired
+                                            : kRightMicResidency_Faulted;
+}
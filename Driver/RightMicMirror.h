@@ -0,0 +1,73 @@
+/*
+ * RightMicMirror.h
+ * Double-mapped ("magic") view of the shared ring.
+ *
+ * The audio region is mapped twice, back to back in virtual memory, so
+ * the frame after the last one is the first one again.  Any span of up
+ * to a whole ring starting anywhere in the first copy is contiguous:
+ * writes and reads become a single memcpy and the ring index a mask,
+ * and kernels can run over one pointer without splitting at the end.
+ *
+ * This needs the audio region to start on a page boundary and to be a
+ * whole number of pages, which the paged layout in RightMicDriver.h
+ * guarantees.  If the platform refuses the second mapping (or the
+ * layout doesn't allow it) the file is mapped once, exactly as before,
+ * and `mirrored` is false; RightMicRing then splits copies at the wrap.
+ *
+ * A fresh mapping has no pages behind it: the first touch of each one
+ * is a page fault, and the first touches happen on real-time threads
+ * (the capture callback, the IO cycle).  Prefault takes those faults up
+ * front and wires the pages where the system lets it, so they also stay
+ * resident under memory pressure.
+ *
+ * Plain POSIX mmap, so the same code runs in the app, the driver and
+ * the Linux test harness.
+ */
+
+#ifndef RightMicMirror_h
+#define RightMicMirror_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *base;       /* file offset 0; NULL when unmapped              */
+    size_t   reserved;   /* bytes of address space to unmap                */
+    bool     mirrored;   /* data region is followed by a second copy of it */
+    bool     writable;
+} RightMicMirror;
+
+/* What Prefault managed.  Published in both metrics blocks. */
+typedef enum {
+    kRightMicResidency_Unknown = 0,  /* not mapped, or not prefaulted      */
+    kRightMicResidency_Faulted = 1,  /* every page touched; lock refused   */
+    kRightMicResidency_Wired   = 2,  /* every page touched and locked      */
+} RightMicResidency;
+
+/* Map the first `fileSize` bytes of `fd` (read-only unless `writable`).  */
+/* If [dataOffset, dataOffset + dataBytes) is page-aligned and ends the   */
+/* file, map it a second time directly after itself.  Returns false      */
+/* (with `m->base` NULL) only if even the plain mapping fails.           */
+bool RightMicMirror_Map(RightMicMirror *m, int fd, size_t fileSize,
+                        size_t dataOffset, size_t dataBytes, bool writable);
+
+void RightMicMirror_Unmap(RightMicMirror *m);
+
+/* Touch every page of the mapping, both copies of the data, so later  */
+/* accesses don't fault (with a write where it is writable: a page    */
+/* read first can still fault on its first write), then try to mlock  */
+/* all of it.  Writes back what it reads, so only while nothing else  */
+/* writes through a writable mapping.  Unmap releases the lock.       */
+/* Blocking; not for a real-time thread.                              */
+RightMicResidency RightMicMirror_Prefault(RightMicMirror *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicMirror_h */
@@ -0,0 +1,286 @@
+/*
+ * RightMicResampler.c
+ * Polyphase FIR sample rate converter for the capture callback.
+ *
+ * See RightMicResampler.h.
+ */
+
+#include "RightMicResampler.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Four lanes map to one SSE or NEON register; the dot products run two */
+/* at a time so the adds don't wait on each other.                      */
+typedef float Vec4 __attribute__((vector_size(16)));
+
+static inline Vec4 Load(const float *p)
+{
+    Vec4 v;
+    memcpy(&v, p, sizeof(v));  /* unaligned load */
+    return v;
+}
+
+static inline float LaneSum(Vec4 v) { return (v[0] + v[1]) + (v[2] + v[3]); }
+
+/* ── Filter Design ────────────────────────────────────────────── */
+
+/* Per tier: taps at a ratio up to 1:1 and the Kaiser β for the stopband.
+ * Kaiser's estimate puts the transition band at (A - 8) / (14.36 N) of
+ * the input rate; the stopband starts at the lower rate's Nyquist, so
+ * the passband ends that far below it. */
+static const struct {
+    uint32_t taps;
+    double   attenuation;  /* dB */
+} kTiers[] = {
+    [kRightMicResampler_Voice]    = { 16,  60.0 },
+    [kRightMicResampler_Balanced] = { 32,  80.0 },
+    [kRightMicResampler_Max]      = { 64, 100.0 },
+};
+
+static double KaiserBeta(double attenuation)
+{
+    if (attenuation > 50.0) return 0.1102 * (attenuation - 8.7);
+    if (attenuation > 21.0) return 0.5842 * pow(attenuation - 21.0, 0.4) + 0.07886 * (attenuation - 21.0);
+    return 0.0;
+}
+
+/* Zeroth-order modified Bessel function of the first kind. */
+static double BesselI0(double x)
+{
+    double sum = 1.0, term = 1.0, half = x / 2.0;
+    for (int k = 1; k < 64 && term > sum * 1e-17; k++) {
+        term *= (half / k) * (half / k);
+        sum  += term;
+    }
+    return sum;
+}
+
+static uint32_t GCD(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Fill `phases + 1` rows of `taps`.  Row p delays by p / phases of an
+ * input frame: tap k weighs the input frame at k - (taps/2 - 1) - p/phases
+ * from the output's position.  Each row is scaled to unity DC gain, so a
+ * constant input stays constant whichever rows a ratio visits. */
+static void BuildBank(float *bank, uint32_t taps, uint32_t phases, double cutoff, double beta)
+{
+    double i0Beta = BesselI0(beta);
+    double half   = (double)taps / 2.0;
+
+    for (uint32_t p = 0; p <= phases; p++) {
+        float *row = bank + (size_t)p * taps;
+        double frac = (double)p / (double)phases;
+        double sum  = 0.0;
+        for (uint32_t k = 0; k < taps; k++) {
+            double t = (double)k - (half - 1.0) - frac;
+            double x = 2.0 * cutoff * t;
+            double sinc = fabs(x) < 1e-12 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = t / half;
+            double window = r * r < 1.0 ? BesselI0(beta * sqrt(1.0 - r * r)) / i0Beta : 0.0;
+            double h = 2.0 * cutoff * sinc * window;
+            row[k] = (float)h;
+            sum += h;
+        }
+        for (uint32_t k = 0; k < taps; k++) {
+            row[k] = (float)((double)row[k] / sum);
+        }
+    }
+}
+
+/* ── Init ─────────────────────────────────────────────────────── */
+
+bool RightMicResampler_Init(RightMicResampler *rs, float *storage,
+                            uint32_t inputRate, uint32_t outputRate,
+                            uint32_t channels, RightMicResamplerQuality quality)
+{
+    memset(rs, 0, sizeof(*rs));
+
+    if (inputRate == 0 || outputRate == 0 || storage == NULL) return false;
+    if (channels < 1 || channels > kRightMicResampler_MaxChannels) return false;
+    if ((unsigned)quality > kRightMicResampler_Max) return false;
+
+    double ratio = (double)inputRate / (double)outputRate;
+    if (ratio > kRightMicResampler_MaxRatio || ratio < 1.0 / kRightMicResampler_MaxRatio) {
+        return false;
+    }
+
+    /* Downsampling moves the stopband down to the output's Nyquist; the
+     * filter widens by the same factor to keep its transition band (and
+     * so its quality) the same relative to the output rate. */
+    double scale = ratio > 1.0 ? 1.0 / ratio : 1.0;
+    uint32_t taps = (uint32_t)ceil((double)kTiers[quality].taps / scale);
+    taps = (taps + 7) & ~7u;
+    if (taps > kRightMicResampler_MaxTaps) taps = kRightMicResampler_MaxTaps;
+
+    double attenuation = kTiers[quality].attenuation;
+    double transition  = (attenuation - 8.0) / (14.36 * (double)taps);
+    double cutoff      = 0.5 * scale - transition / 2.0;
+
+    /* Exact phases when the output side of the reduced ratio fits. */
+    uint32_t g = GCD(inputRate, outputRate);
+    uint32_t up = outputRate / g, down = inputRate / g;
+    uint32_t phases = up <= kRightMicResampler_MaxPhases ? up : kRightMicResampler_MaxPhases;
+
+    rs->bank     = storage;
+    rs->channels = channels;
+    rs->taps     = taps;
+    rs->phases   = phases;
+    rs->unit     = (uint64_t)phases << kRightMicResampler_SubBits;
+    rs->nominalStep = up <= kRightMicResampler_MaxPhases
+        ? (uint64_t)down << kRightMicResampler_SubBits
+        : (uint64_t)llround(ratio * (double)rs->unit);
+    rs->step       = rs->nominalStep;
+    rs->inputRate  = inputRate;
+    rs->outputRate = outputRate;
+
+    float *lines = storage + (size_t)(kRightMicResampler_MaxPhases + 1) * kRightMicResampler_MaxTaps;
+    for (uint32_t c = 0; c < kRightMicResampler_MaxChannels; c++) {
+        rs->line[c] = lines + (size_t)c * (kRightMicResampler_MaxTaps + kRightMicResampler_LineFrames);
+    }
+
+    BuildBank(rs->bank, taps, phases, cutoff, KaiserBeta(attenuation));
+    RightMicResampler_Reset(rs);
+    return true;
+}
+
+void RightMicResampler_Reset(RightMicResampler *rs)
+{
+    /* Lead with taps/2 - 1 frames of silence so the first output sits on
+     * the first input frame and output n on input time n × ratio. */
+    rs->lineFrames = rs->taps / 2 - 1;
+    for (uint32_t c = 0; c < rs->channels; c++) {
+        memset(rs->line[c], 0, rs->lineFrames * sizeof(float));
+    }
+    rs->index    = 0;
+    rs->fraction = 0;
+}
+
+void RightMicResampler_SetDrift(RightMicResampler *rs, double drift)
+{
+    if (drift > 0.01)  drift = 0.01;
+    if (drift < -0.01) drift = -0.01;
+    rs->step = (uint64_t)llround((double)rs->nominalStep * (1.0 + drift));
+}
+
+uint32_t RightMicResampler_MaxOutput(const RightMicResampler *rs, uint32_t inputFrames)
+{
+    /* Output windows may start anywhere up to the last full one. */
+    uint64_t frames = (uint64_t)rs->lineFrames + inputFrames;
+    if (frames < (uint64_t)rs->index + rs->taps) return 0;
+    uint64_t last = frames - rs->taps;
+    uint64_t span = (last - rs->index + 1) * rs->unit - 1 - rs->fraction;
+    uint64_t n = span / rs->step + 1;
+    return n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+}
+
+/* ── Process ──────────────────────────────────────────────────── */
+
+/* One output frame from rows `a` and `b` mixed (1 - mix) : mix.  When mix
+ * is 0 only `a` is read. */
+static inline void Convolve(const RightMicResampler *rs, const float *a, const float *b,
+                            float mix, float *out)
+{
+    const uint32_t taps = rs->taps;
+
+    for (uint32_t c = 0; c < rs->channels; c++) {
+        const float *x = rs->line[c] + rs->index;
+        Vec4 acc0 = { 0 }, acc1 = { 0 };
+
+        if (mix == 0.0f) {
+            for (uint32_t k = 0; k < taps; k += 8) {
+                acc0 += Load(a + k) * Load(x + k);
+                acc1 += Load(a + k + 4) * Load(x + k + 4);
+            }
+            out[c] = LaneSum(acc0 + acc1);
+        } else {
+            /* Both rows against the same window in one pass. */
+            for (uint32_t k = 0; k < taps; k += 8) {
+                Vec4 x0 = Load(x + k), x1 = Load(x + k + 4);
+                acc0 += Load(a + k) * x0 + Load(a + k + 4) * x1;
+                acc1 += Load(b + k) * x0 + Load(b + k + 4) * x1;
+            }
+            float ya = LaneSum(acc0), yb = LaneSum(acc1);
+            out[c] = ya + mix * (yb - ya);
+        }
+    }
+}
+
+/* Drop consumed line frames and take in up to a line's worth of `input`.
+ * Returns the input frames used. */
+static uint32_t Refill(RightMicResampler *rs, const float *input, uint32_t inputFrames)
+{
+    uint32_t used = 0;
+
+    uint32_t drop = rs->index < rs->lineFrames ? rs->index : rs->lineFrames;
+    uint32_t keep = rs->lineFrames - drop;
+    for (uint32_t c = 0; c < rs->channels; c++) {
+        memmove(rs->line[c], rs->line[c] + drop, keep * sizeof(float));
+    }
+    rs->lineFrames = keep;
+    rs->index     -= drop;
+
+    /* Downsampling can step past everything buffered: skip input the
+     * next window starts beyond. */
+    if (rs->index > 0) {
+        uint32_t skip = rs->index < inputFrames ? rs->index : inputFrames;
+        rs->index -= skip;
+        used      += skip;
+    }
+
+    uint32_t room  = kRightMicResampler_MaxTaps + kRightMicResampler_LineFrames - keep;
+    uint32_t count = inputFrames - used < room ? inputFrames - used : room;
+    const float *src = input + (size_t)used * rs->channels;
+
+    if (rs->channels == 1) {
+        memcpy(rs->line[0] + keep, src, count * sizeof(float));
+    } else {
+        float *l = rs->line[0] + keep, *r = rs->line[1] + keep;
+        for (uint32_t i = 0; i < count; i++) {
+            l[i] = src[2 * i];
+            r[i] = src[2 * i + 1];
+        }
+    }
+    rs->lineFrames += count;
+    return used + count;
+}
+
+uint32_t RightMicResampler_Process(RightMicResampler *rs,
+                                   const float *input, uint32_t inputFrames,
+                                   float *output, uint32_t outputCapacity,
+                                   uint32_t *consumed)
+{
+    const uint64_t subMask = ((uint64_t)1 << kRightMicResampler_SubBits) - 1;
+    const float    subUnit = (float)(subMask + 1);
+    uint32_t produced = 0, used = 0;
+
+    for (;;) {
+        if (rs->index + rs->taps <= rs->lineFrames) {
+            if (produced == outputCapacity) break;
+
+            uint64_t row = rs->fraction >> kRightMicResampler_SubBits;
+            uint64_t sub = rs->fraction & subMask;
+            const float *a = rs->bank + row * rs->taps;
+            Convolve(rs, a, a + rs->taps, (float)sub / subUnit,
+                     output + (size_t)produced * rs->channels);
+            produced++;
+
+            uint64_t pos = rs->fraction + rs->step;
+            rs->index   += (uint32_t)(pos / rs->unit);
+            rs->fraction = pos % rs->unit;
+            continue;
+        }
+        if (used == inputFrames) break;
+        used += Refill(rs, input + (size_t)used * rs->channels, inputFrames - used);
+    }
+
+    if (consumed != NULL) *consumed = used;
+    return produced;
+}
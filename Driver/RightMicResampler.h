@@ -0,0 +1,115 @@
+/*
+ * RightMicResampler.h
+ * Polyphase FIR sample rate converter for the capture callback.
+ *
+ * A capture device that runs at a rate the ring doesn't take is
+ * converted to the ring's rate in the app's callback.  This replaces an
+ * AudioConverter there: all storage is handed in up front, Process never
+ * allocates or locks, and every output frame costs the same one or two
+ * dot products, so the per-callback cost is known when capture starts.
+ *
+ * The filter is a Kaiser-windowed sinc, stored as a bank of phases (one
+ * row of taps per fractional input position).  For a rational ratio
+ * whose output side reduces to at most kRightMicResampler_MaxPhases
+ * (every pair of common rates: 44.1→48 is 160/147, 16→48 is 3/1, 96→48
+ * is 1/2) the bank holds the exact phases and each output frame is one
+ * row times the input window.  Other ratios, and a ratio nudged by
+ * SetDrift to follow a clock, interpolate linearly between adjacent
+ * rows.  Downsampling lowers the cutoff to the output's Nyquist and
+ * widens the filter to match, up to kRightMicResampler_MaxTaps.
+ *
+ * Three quality tiers trade passband width and stopband depth for
+ * taps; see the table in RightMicResampler.c.  Init builds the bank and
+ * is not real-time safe; Process and SetDrift are.
+ *
+ * App-side only (the driver never links it).  Portable C11 (GCC/Clang
+ * vector extensions), unit-tested and benchmarked on Linux.
+ */
+
+#ifndef RightMicResampler_h
+#define RightMicResampler_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Configuration ────────────────────────────────────────────── */
+
+#define kRightMicResampler_MaxChannels     2
+#define kRightMicResampler_MaxTaps       128  /* per phase (multiple of 8)           */
+#define kRightMicResampler_MaxPhases     256  /* rows in the bank, less the end row  */
+#define kRightMicResampler_LineFrames    256  /* input frames taken in per refill    */
+#define kRightMicResampler_MaxRatio      8.0  /* input/output rate, either way       */
+
+/* Floats of storage Init needs: the bank, then one input line per channel. */
+#define kRightMicResampler_StorageFloats                                             \
+    ((kRightMicResampler_MaxPhases + 1) * kRightMicResampler_MaxTaps +               \
+     kRightMicResampler_MaxChannels * (kRightMicResampler_MaxTaps + kRightMicResampler_LineFrames))
+
+typedef enum {
+    kRightMicResampler_Voice    = 0,  /* 16 taps, passband to ~0.27 fs, ~60 dB  */
+    kRightMicResampler_Balanced = 1,  /* 32 taps, passband to ~0.35 fs, ~80 dB  */
+    kRightMicResampler_Max      = 2,  /* 64 taps, passband to ~0.41 fs, ~100 dB */
+} RightMicResamplerQuality;
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    float   *bank;         /* phases + 1 rows of taps                    */
+    float   *line[kRightMicResampler_MaxChannels];  /* de-interleaved input */
+    uint32_t channels;
+    uint32_t taps;
+    uint32_t phases;
+    uint32_t lineFrames;   /* valid frames in each line                   */
+    uint32_t index;        /* line position of the next output's window   */
+    uint64_t fraction;     /* position past `index`, in 1/unit frames     */
+    uint64_t unit;         /* phases << kRightMicResampler_SubBits        */
+    uint64_t nominalStep;  /* input frames per output frame, in 1/unit    */
+    uint64_t step;         /* nominalStep with the drift applied          */
+    uint32_t inputRate;
+    uint32_t outputRate;
+} RightMicResampler;
+
+/* Bits of sub-phase position between adjacent rows. */
+#define kRightMicResampler_SubBits 20
+
+/* Build a converter from `inputRate` to `outputRate` for `channels`    */
+/* (1 or 2) interleaved channels.  `storage` must hold                  */
+/* kRightMicResampler_StorageFloats floats and outlive the converter.   */
+/* Returns false (and leaves `rs` unusable) for a rate of 0, a ratio     */
+/* beyond kRightMicResampler_MaxRatio or an unsupported channel count.  */
+/* Not real-time safe.                                                   */
+bool RightMicResampler_Init(RightMicResampler *rs, float *storage,
+                            uint32_t inputRate, uint32_t outputRate,
+                            uint32_t channels, RightMicResamplerQuality quality);
+
+/* Forget buffered input, as at Init.  Not while Process may run. */
+void RightMicResampler_Reset(RightMicResampler *rs);
+
+/* Consume input (1 + drift) times as fast as the nominal ratio, to     */
+/* follow a clock that runs fast (drift > 0) or slow.  0 restores the   */
+/* exact ratio.  Clamped to ±1%.  Real-time safe.                        */
+void RightMicResampler_SetDrift(RightMicResampler *rs, double drift);
+
+/* Most output frames `inputFrames` more input can produce. */
+uint32_t RightMicResampler_MaxOutput(const RightMicResampler *rs, uint32_t inputFrames);
+
+/* Convert `inputFrames` interleaved frames into `output`, which holds   */
+/* `outputCapacity` frames, and return the frames produced.  Input       */
+/* taken in but not yet needed is kept for the next call.  With          */
+/* capacity for MaxOutput(inputFrames) all input is consumed; otherwise  */
+/* `*consumed` (if non-NULL) says how much was.  The output trails the   */
+/* input by taps / 2 input frames.  Real-time safe.                      */
+uint32_t RightMicResampler_Process(RightMicResampler *rs,
+                                   const float *input, uint32_t inputFrames,
+                                   float *output, uint32_t outputCapacity,
+                                   uint32_t *consumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicResampler_h */
@@ -0,0 +1,420 @@
+/*
+ * RightMicRing.c
+ * Portable producer/consumer protocol for the shared-memory ring buffer.
+ *
+ * See RightMicRing.h.  This file must stay free of CoreAudio and Darwin
+ * dependencies: it is compiled into the HAL driver, the companion app
+ * (via the CRightMic SwiftPM target) and the Linux test harness.
+ */
+
+#include "RightMicRing.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* ================================================================
+ * Ring View
+ * ================================================================ */
+
+void RightMicRing_Attach(RightMicRing *ring, void *base)
+{
+    RightMicRing_AttachAt(ring, base, sizeof(RightMicRingBufferHeader),
+                          kRightMic_RingBufferFrames, kRightMic_ChannelCount, false);
+}
+
+void RightMicRing_AttachAt(RightMicRing *ring, void *base, uint32_t dataOffset,
+                           uint32_t frames, uint32_t channels, bool mirrored)
+{
+    ring->header   = (RightMicRingBufferHeader *)base;
+    ring->data     = (float *)((uint8_t *)base + dataOffset);
+    ring->mirrored = mirrored;
+    ring->channels = channels == 1 ? 1 : kRightMic_ChannelCount;
+    ring->frames   = frames;
+}
+
+void RightMicRing_Detach(RightMicRing *ring)
+{
+    ring->header   = NULL;
+    ring->data     = NULL;
+    ring->mirrored = false;
+    ring->channels = kRightMic_ChannelCount;
+    ring->frames   = kRightMic_RingBufferFrames;
+}
+
+bool RightMicRing_IsCompatible(const RightMicRingBufferHeader *header)
+{
+    return header->magic      == kRightMic_RingMagic &&
+           header->version    == kRightMic_RingVersion &&
+           header->headerSize == sizeof(RightMicRingBufferHeader) &&
+           header->frameBytes == kRightMic_FrameBytesFor(RightMicRing_Channels(header)) &&
+           header->ringFrames == RightMicRing_ClampFrames(header->ringFrames) &&
+           header->dataOffset >= sizeof(RightMicRingBufferHeader) &&
+           header->dataOffset % kRightMic_CacheLineSize == 0;
+}
+
+uint32_t RightMicRing_ClampFrames(uint32_t frames)
+{
+    if (frames == 0) return kRightMic_RingBufferFrames;
+    if (frames <= kRightMic_MinRingFrames) return kRightMic_MinRingFrames;
+    if (frames >= kRightMic_MaxRingFrames) return kRightMic_MaxRingFrames;
+    uint32_t capacity = kRightMic_MinRingFrames;
+    while (capacity < frames) capacity <<= 1;
+    return capacity;
+}
+
+bool RightMicRing_MatchesHeader(const RightMicRing *ring)
+{
+    const RightMicRingBufferHeader *h = ring->header;
+    return h != NULL && h->ringFrames == ring->frames &&
+           RightMicRing_Channels(h) == ring->channels &&
+           h->dataOffset == (uint32_t)((const uint8_t *)ring->data - (const uint8_t *)h);
+}
+
+bool RightMicRing_IsSupportedRate(uint32_t sampleRate)
+{
+    static const uint32_t rates[kRightMic_SampleRateCount] = { kRightMic_SampleRateList };
+    for (uint32_t i = 0; i < kRightMic_SampleRateCount; i++) {
+        if (rates[i] == sampleRate) return true;
+    }
+    return false;
+}
+
+uint32_t RightMicRing_Channels(const RightMicRingBufferHeader *header)
+{
+    return header->channels == 1 ? 1 : kRightMic_ChannelCount;
+}
+
+/* True if `frameCount` frames from any position are one contiguous span:
+ * the mirror repeats the ring the view was attached for, which only
+ * frames of that width line up with. */
+static inline bool Contiguous(const RightMicRing *ring, uint32_t channels, uint32_t frameCount)
+{
+    return ring->mirrored && channels == ring->channels &&
+           frameCount <= ring->frames;
+}
+
+/* ================================================================
+ * Copy Kernels
+ * ================================================================ */
+
+void RightMicRing_ExpandMono(float *dst, const float *src, uint32_t frameCount)
+{
+    /* Back to front, so that in place every block is loaded before the
+     * stores that overwrite it (frame i lands at 2i ≥ i). */
+    uint32_t i = frameCount;
+    while (i % 4) {
+        i--;
+        float x = src[i];
+        dst[2 * i]     = x;
+        dst[2 * i + 1] = x;
+    }
+    while (i) {
+        i -= 4;
+#if defined(__SSE__)
+        __m128 x = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(x, x));
+        _mm_storeu_ps(dst + 2 * i,     _mm_unpacklo_ps(x, x));
+#elif defined(__ARM_NEON)
+        float32x4_t x = vld1q_f32(src + i);
+        float32x4x2_t pair = { { x, x } };
+        vst2q_f32(dst + 2 * i, pair);
+#else
+        float x0 = src[i], x1 = src[i + 1], x2 = src[i + 2], x3 = src[i + 3];
+        dst[2 * i + 7] = x3; dst[2 * i + 6] = x3;
+        dst[2 * i + 5] = x2; dst[2 * i + 4] = x2;
+        dst[2 * i + 3] = x1; dst[2 * i + 2] = x1;
+        dst[2 * i + 1] = x0; dst[2 * i]     = x0;
+#endif
+    }
+}
+
+/* ================================================================
+ * Producer
+ * ================================================================ */
+
+/* Announce that frames up to `end` are about to be written, before any
+ * of their data is: the release fence keeps the claim ahead of the data
+ * stores that follow, as a seqlock writer's sequence bump does. */
+static inline void Claim(RightMicRingBufferHeader *h, uint64_t end)
+{
+    atomic_store_explicit(&h->writeClaim, end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void RightMicRing_InitProducer(RightMicRing *ring, uint32_t sampleRate, uint32_t channels)
+{
+    RightMicRingBufferHeader *h = ring->header;
+    if (h == NULL) return;
+
+    atomic_store_explicit(&h->writeHead,  0, memory_order_relaxed);
+    atomic_store_explicit(&h->writeClaim, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->readHead,   0, memory_order_relaxed);
+    atomic_store_explicit(&h->muted,     0, memory_order_relaxed);
+    atomic_store_explicit(&h->targetLatency,  0, memory_order_relaxed);
+    atomic_store_explicit(&h->minSafeLatency, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->concealMode,    0, memory_order_relaxed);
+    h->version    = kRightMic_RingVersion;
+    h->headerSize = sizeof(RightMicRingBufferHeader);
+    h->dataOffset = (uint32_t)((uint8_t *)ring->data - (uint8_t *)h);
+    h->ringFrames = ring->frames;
+    h->sampleRate = sampleRate;
+    h->channels   = channels == 1 ? 1 : kRightMic_ChannelCount;
+    h->frameBytes = (uint32_t)kRightMic_FrameBytesFor(h->channels);
+    h->magic      = kRightMic_RingMagic;
+    atomic_thread_fence(memory_order_release);
+    if (h->channels != ring->channels) {
+        /* Mapped for frames of the other width: the mirror, if any,
+         * repeats a ring that is no longer there. */
+        ring->mirrored = false;
+        ring->channels = h->channels;
+    }
+}
+
+void RightMicRing_Write(RightMicRing *ring, const float *frames, uint32_t frameCount)
+{
+    RightMicRingBufferHeader *h = ring->header;
+    if (h == NULL) return;
+
+    /* The producer is the only writer of writeHead, so a relaxed load is enough. */
+    uint64_t wHead    = atomic_load_explicit(&h->writeHead, memory_order_relaxed);
+    uint64_t mask     = ring->frames - 1;
+    uint32_t written  = 0;
+    uint32_t channels = ring->channels;
+
+    Claim(h, wHead + frameCount);
+    if (Contiguous(ring, channels, frameCount)) {
+        /* The mirror makes the wrap invisible: one copy. */
+        memcpy(ring->data + ((wHead & mask) * channels),
+               frames, (size_t)frameCount * channels * sizeof(float));
+        wHead  += frameCount;
+        written = frameCount;
+    }
+
+    while (written < frameCount) {
+        uint64_t ringIndex  = wHead & mask;
+        uint32_t contiguous = (uint32_t)(ring->frames - ringIndex);
+        uint32_t chunk      = frameCount - written;
+        if (chunk > contiguous) chunk = contiguous;
+
+        memcpy(ring->data + (ringIndex * channels),
+               frames + ((size_t)written * channels),
+               (size_t)chunk * channels * sizeof(float));
+
+        wHead   += chunk;
+        written += chunk;
+    }
+
+    /* Release pairs with the consumer's acquire load: the audio data above
+     * is visible before the new head is. */
+    atomic_store_explicit(&h->writeHead, wHead, memory_order_release);
+}
+
+float *RightMicRing_Reserve(RightMicRing *ring, uint32_t frameCount)
+{
+    RightMicRingBufferHeader *h = ring->header;
+    if (h == NULL || frameCount > ring->frames) return NULL;
+
+    uint64_t wHead     = atomic_load_explicit(&h->writeHead, memory_order_relaxed);
+    uint64_t ringIndex = wHead & (ring->frames - 1);
+    if (!Contiguous(ring, ring->channels, frameCount) &&
+        ringIndex + frameCount > ring->frames) return NULL;
+
+    /* These frames are the oldest in the ring, exactly the ones Write
+     * would overwrite; a consumer still on them sees an overflow, or
+     * through the claim, a torn read. */
+    Claim(h, wHead + frameCount);
+    return ring->data + (ringIndex * ring->channels);
+}
+
+void RightMicRing_Commit(RightMicRing *ring, uint32_t frameCount)
+{
+    RightMicRingBufferHeader *h = ring->header;
+    if (h == NULL) return;
+
+    uint64_t wHead = atomic_load_explicit(&h->writeHead, memory_order_relaxed);
+    if (frameCount > 0) {
+        atomic_store_explicit(&h->writeHead, wHead + frameCount, memory_order_release);
+    }
+    /* The rest of the reservation was never written, so the oldest
+     * frames it claimed are intact again. */
+    atomic_store_explicit(&h->writeClaim, wHead + frameCount, memory_order_relaxed);
+}
+
+void RightMicRing_WriteSilence(RightMicRing *ring, uint32_t frameCount)
+{
+    RightMicRingBufferHeader *h = ring->header;
+    if (h == NULL) return;
+
+    uint64_t wHead   = atomic_load_explicit(&h->writeHead, memory_order_relaxed);
+    uint32_t written = 0;
+    Claim(h, wHead + frameCount);
+    while (written < frameCount) {
+        uint64_t ringIndex  = wHead & (ring->frames - 1);
+        uint32_t contiguous = (uint32_t)(ring->frames - ringIndex);
+        uint32_t chunk      = frameCount - written;
+        if (chunk > contiguous) chunk = contiguous;
+
+        memset(ring->data + (ringIndex * ring->channels), 0,
+               (size_t)chunk * ring->channels * sizeof(float));
+        wHead   += chunk;
+        written += chunk;
+    }
+    atomic_store_explicit(&h->writeHead, wHead, memory_order_release);
+}
+
+void RightMicRing_Clear(RightMicRing *ring)
+{
+    if (ring->header == NULL) return;
+    /* The mirror, if any, aliases the same pages. */
+    memset(ring->data, 0, (size_t)ring->frames * kRightMic_FrameBytesFor(ring->channels));
+    atomic_thread_fence(memory_order_release);
+}
+
+void RightMicRing_SetActive(RightMicRing *ring, bool active)
+{
+    if (ring->header == NULL) return;
+    atomic_store_explicit(&ring->header->active, active ? 1u : 0u, memory_order_release);
+}
+
+void RightMicRing_SetMuted(RightMicRing *ring, bool muted)
+{
+    if (ring->header == NULL) return;
+    atomic_store_explicit(&ring->header->muted, muted ? 1u : 0u, memory_order_relaxed);
+}
+
+void RightMicRing_SetLatency(RightMicRing *ring, uint32_t targetFrames, uint32_t minSafeFrames)
+{
+    if (ring->header == NULL) return;
+    atomic_store_explicit(&ring->header->minSafeLatency, minSafeFrames, memory_order_relaxed);
+    atomic_store_explicit(&ring->header->targetLatency,  targetFrames,  memory_order_relaxed);
+}
+
+void RightMicRing_SetConcealment(RightMicRing *ring, uint32_t mode)
+{
+    if (ring->header == NULL) return;
+    atomic_store_explicit(&ring->header->concealMode, mode, memory_order_relaxed);
+}
+
+/* ================================================================
+ * Consumer
+ * ================================================================ */
+
+void RightMicRingReader_Reset(RightMicRingReader *reader)
+{
+    reader->readHead      = 0;
+    reader->overflowCount = 0;
+    reader->underrunCount = 0;
+    reader->concealedFrames = 0;
+    reader->tornCount     = 0;
+}
+
+uint64_t RightMicRing_IntactFrom(const RightMicRing *ring)
+{
+    /* Acquire fence: the copy's loads are done before the claim is read,
+     * so a claim that doesn't reach a frame's slot means the copy saw
+     * that frame whole. */
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t claim = atomic_load_explicit(&ring->header->writeClaim, memory_order_relaxed);
+    return claim > ring->frames ? claim - ring->frames : 0;
+}
+
+RightMicRingReadStatus RightMicRing_Read(const RightMicRing *ring, RightMicRingReader *reader,
+                                         float *out, uint32_t frameCount)
+{
+    const RightMicRingBufferHeader *h = ring->header;
+    size_t outBytes = (size_t)frameCount * kRightMic_BytesPerFrame;
+
+    if (h == NULL || !atomic_load_explicit(&h->active, memory_order_acquire)) {
+        memset(out, 0, outBytes);
+        return kRightMicRingRead_Inactive;
+    }
+
+    uint64_t wHead = atomic_load_explicit(&h->writeHead, memory_order_acquire);
+    RightMicRingReadStatus status = kRightMicRingRead_Filled;
+
+    /* Sync the read head to the writer on first read or after a reset.
+     * The app resets writeHead to 0 when switching devices, so if
+     * writeHead is behind our read position, re-sync immediately
+     * instead of waiting for it to catch up (which takes ~45s). */
+    if (reader->readHead == 0 || wHead < reader->readHead) {
+        if (wHead < frameCount) {
+            /* Not a buffer's worth written yet: nothing was due, so
+             * this is priming rather than an underrun. */
+            reader->readHead = 0;
+            memset(out, 0, outBytes);
+            return kRightMicRingRead_Inactive;
+        }
+        reader->readHead = wHead - frameCount;
+    }
+
+    uint64_t available = wHead - reader->readHead;
+
+    /* Overflow: the writer has lapped the reader due to clock drift
+     * between the app's hardware sample clock and the driver's
+     * mach_absolute_time-based clock.  Re-sync the read head to just
+     * behind the write head so the next copy reads valid (recent)
+     * data.  This trades a single ~10ms glitch for preventing
+     * sustained garbled output. */
+    if (available > ring->frames) {
+        reader->overflowCount++;
+        reader->readHead = wHead - frameCount;
+        available = frameCount;
+        status = kRightMicRingRead_Overflow;
+    }
+
+    if (available < frameCount) {
+        reader->underrunCount++;
+        reader->concealedFrames += frameCount;
+        memset(out, 0, outBytes);
+        return kRightMicRingRead_Underrun;
+    }
+
+    uint64_t mask       = ring->frames - 1;
+    uint32_t framesRead = 0;
+    uint32_t channels   = RightMicRing_Channels(h);
+    if (Contiguous(ring, channels, frameCount)) {
+        const float *src = ring->data + ((reader->readHead & mask) * channels);
+        if (channels == 1) {
+            RightMicRing_ExpandMono(out, src, frameCount);
+        } else {
+            memcpy(out, src, outBytes);
+        }
+        framesRead = frameCount;
+    }
+    while (framesRead < frameCount) {
+        uint64_t ringIndex  = (reader->readHead + framesRead) & mask;
+        uint32_t contiguous = (uint32_t)(ring->frames - ringIndex);
+        uint32_t chunk      = frameCount - framesRead;
+        if (chunk > contiguous) chunk = contiguous;
+
+        float       *dst = out + ((size_t)framesRead * kRightMic_ChannelCount);
+        const float *src = ring->data + (ringIndex * channels);
+        if (channels == 1) {
+            RightMicRing_ExpandMono(dst, src, chunk);
+        } else {
+            memcpy(dst, src, (size_t)chunk * kRightMic_BytesPerFrame);
+        }
+        framesRead += chunk;
+    }
+
+    /* The overflow check above ran before the copy; the writer may have
+     * lapped us during it.  Silence whatever it reached. */
+    uint64_t intact = RightMicRing_IntactFrom(ring);
+    if (intact > reader->readHead) {
+        uint64_t torn = intact - reader->readHead;
+        if (torn > frameCount) torn = frameCount;
+        memset(out, 0, (size_t)torn * kRightMic_BytesPerFrame);
+        reader->overflowCount++;
+        reader->tornCount++;
+        reader->concealedFrames += torn;
+        status = kRightMicRingRead_Overflow;
+    }
+    reader->readHead += frameCount;
+    return status;
+}
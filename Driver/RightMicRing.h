@@ -0,0 +1,165 @@
+/*
+ * RightMicRing.h
+ * Portable producer/consumer protocol for the shared-memory ring buffer.
+ *
+ * The companion app (producer) and the HAL driver (consumer) both go
+ * through these functions, so the ring semantics described in
+ * RightMicDriver.h live in exactly one place.  Nothing here depends on
+ * CoreAudio or Darwin — only C11 atomics and libc — so the same code is
+ * exercised on Linux by the harness in Tests/RingTests.
+ */
+
+#ifndef RightMicRing_h
+#define RightMicRing_h
+
+#include "RightMicDriver.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Ring View ────────────────────────────────────────────────── */
+/* Pointers into a mapped region laid out as described in          */
+/* RightMicDriver.h.  A zeroed view (header == NULL) is valid and  */
+/* reads as an inactive ring.                                      */
+typedef struct {
+    RightMicRingBufferHeader *header;
+    float                    *data;
+    bool                      mirrored;  /* data is followed by a copy of itself */
+    uint32_t                  channels;  /* per frame as the producer writes    */
+    uint32_t                  frames;    /* capacity; a power of two            */
+} RightMicRing;
+
+/* Point `ring` at a region with a default-sized ring right after the  */
+/* header (kRightMic_SharedMemorySize bytes).                          */
+void RightMicRing_Attach(RightMicRing *ring, void *base);
+
+/* Point `ring` at a region whose audio data, `frames` frames of      */
+/* `channels` samples (see RightMicRing_ClampFrames and               */
+/* kRightMic_FrameBytesFor), starts `dataOffset` bytes in.  `mirrored` */
+/* says those frames are mapped twice back to back (see               */
+/* RightMicMirror.h), so any span of up to a ring is contiguous.       */
+void RightMicRing_AttachAt(RightMicRing *ring, void *base, uint32_t dataOffset,
+                           uint32_t frames, uint32_t channels, bool mirrored);
+
+/* Detach the view; subsequent reads return silence. */
+void RightMicRing_Detach(RightMicRing *ring);
+
+/* True if `header` was written by InitProducer for this layout version: */
+/* magic, version and header size match, the frame size is the one for */
+/* its channel count, the capacity is one ClampFrames allows, and the  */
+/* audio data starts cache-line aligned after the header.  Whether the */
+/* region is large enough for that geometry is the mapper's to check.  */
+bool RightMicRing_IsCompatible(const RightMicRingBufferHeader *header);
+
+/* Ring capacity for a request of `frames`: 0 selects the default,      */
+/* anything else is rounded up to a power of two and held to           */
+/* [kRightMic_MinRingFrames, kRightMic_MaxRingFrames].                  */
+uint32_t RightMicRing_ClampFrames(uint32_t frames);
+
+/* True while the header still describes the geometry `ring` was       */
+/* attached with.  A producer that reopens the same region with another */
+/* capacity, channel count or data offset turns this false; the        */
+/* consumer must not read through the old view any more.               */
+bool RightMicRing_MatchesHeader(const RightMicRing *ring);
+
+/* True if `sampleRate` is one of kRightMic_SampleRateList. */
+bool RightMicRing_IsSupportedRate(uint32_t sampleRate);
+
+/* Channels per frame the producer declared in `header`: 1, or         */
+/* kRightMic_ChannelCount for anything else.                            */
+uint32_t RightMicRing_Channels(const RightMicRingBufferHeader *header);
+
+/* Mono → interleaved stereo: dst[2i] = dst[2i+1] = src[i].  `dst` may  */
+/* equal `src` (expanding in place, as into a ring reservation); the   */
+/* buffers must not otherwise overlap.  Vectorized; real-time safe.    */
+void RightMicRing_ExpandMono(float *dst, const float *src, uint32_t frameCount);
+
+/* ── Producer (app) ───────────────────────────────────────────── */
+
+/* Reset heads and settings and publish the layout (magic, version,  */
+/* geometry, rate, channels).  Call once after mapping, before the    */
+/* first write and before marking the ring active.  From then on the  */
+/* producer calls below take frames of `channels` samples (1, or     */
+/* kRightMic_ChannelCount interleaved); a view attached for the other */
+/* width loses its mirror.                                            */
+void RightMicRing_InitProducer(RightMicRing *ring, uint32_t sampleRate, uint32_t channels);
+
+/* Copy `frameCount` interleaved frames into the ring and publish    */
+/* the new write head.  Real-time safe: no locks, no allocation.     */
+void RightMicRing_Write(RightMicRing *ring, const float *frames, uint32_t frameCount);
+
+/* Zero-copy alternative to Write: return the ring storage for the next  */
+/* `frameCount` frames so the caller can render straight into it, or    */
+/* NULL if that span would wrap past the end of the ring (use Write).  */
+/* A mirrored ring never wraps.                                        */
+/* Nothing is visible to the consumer until RightMicRing_Commit.        */
+float *RightMicRing_Reserve(RightMicRing *ring, uint32_t frameCount);
+
+/* Publish `frameCount` (≤ the reserved count) frames filled in place   */
+/* and release the claim on the rest, which must be left unwritten.     */
+/* Commit 0 to give up a reservation.                                   */
+void RightMicRing_Commit(RightMicRing *ring, uint32_t frameCount);
+
+/* Publish `frameCount` frames of silence, as Write would. */
+void RightMicRing_WriteSilence(RightMicRing *ring, uint32_t frameCount);
+
+/* Zero the audio data so nothing captured so far can be read again,   */
+/* e.g. before idling the ring while no consumer runs.  Only with the  */
+/* ring inactive and no write in flight.                                */
+void RightMicRing_Clear(RightMicRing *ring);
+
+void RightMicRing_SetActive(RightMicRing *ring, bool active);
+void RightMicRing_SetMuted(RightMicRing *ring, bool muted);
+
+/* Ask the consumer to hold `targetFrames` buffered and to stop and      */
+/* refill below `minSafeFrames`.  0 selects the driver default; the     */
+/* consumer clamps both to what its IO buffer size allows.              */
+void RightMicRing_SetLatency(RightMicRing *ring, uint32_t targetFrames, uint32_t minSafeFrames);
+
+/* Select how the consumer fills frames the ring could not supply      */
+/* (a RightMicConcealMode; 0 selects the driver default).              */
+void RightMicRing_SetConcealment(RightMicRing *ring, uint32_t mode);
+
+/* ── Consumer (driver) ────────────────────────────────────────── */
+
+/* Consumer-private cursor.  Lives outside shared memory so the      */
+/* driver never needs write access to the mapping.                   */
+typedef struct {
+    uint64_t readHead;       /* next frame to read; 0 = not yet synced */
+    uint64_t overflowCount;  /* times the writer lapped the reader     */
+    uint64_t underrunCount;  /* reads that found too few frames        */
+    uint64_t concealedFrames; /* frames not supplied by the ring        */
+    uint64_t tornCount;      /* of those, laps caught only after a copy */
+} RightMicRingReader;
+
+typedef enum {
+    kRightMicRingRead_Filled   = 0,  /* buffer filled from the ring         */
+    kRightMicRingRead_Overflow = 1,  /* filled, after re-syncing the reader
+                                        or concealing frames torn mid-copy */
+    kRightMicRingRead_Underrun = 2,  /* not enough frames; see each reader  */
+    kRightMicRingRead_Inactive = 3,  /* no producer attached, or too little
+                                        written yet to sync to; silence    */
+} RightMicRingReadStatus;
+
+void RightMicRingReader_Reset(RightMicRingReader *reader);
+
+/* Oldest frame whose ring slot has not been overwritten (or begun to  */
+/* be) by the time of the call.  Call after copying out of the ring:   */
+/* anything copied from before it may be a mix of old and new audio.  */
+uint64_t RightMicRing_IntactFrom(const RightMicRing *ring);
+
+/* Fill `out` with `frameCount` interleaved stereo frames, expanding a */
+/* mono ring.  Always writes the whole buffer (silence when the ring   */
+/* can't supply it, or for frames the writer overwrote mid-copy).      */
+RightMicRingReadStatus RightMicRing_Read(const RightMicRing *ring, RightMicRingReader *reader,
+                                         float *out, uint32_t frameCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicRing_h */
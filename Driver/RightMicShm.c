@@ -0,0 +1,95 @@
+/*
+ * RightMicShm.c
+ * Named POSIX shared memory for the ring and the driver's metrics.
+ *
+ * See RightMicShm.h.
+ */
+
+#include "RightMicShm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* A new object sized to `size`, or -1. */
+static int CreateNew(const char *name, size_t size)
+{
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return -1;
+
+    /* The creation mode went through the umask; the driver reads as
+     * another user.  Darwin refuses fchmod on shm (the mode above then
+     * stands), so its result doesn't matter. */
+    (void)fchmod(fd, 0644);
+
+    if (ftruncate(fd, (off_t)size) != 0) {
+        int e = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+int RightMicShm_Create(const char *name, size_t size)
+{
+    int fd = CreateNew(name, size);
+    if (fd >= 0 || errno != EEXIST) return fd;
+
+    /* Ours from an earlier run, at this size: keep it.  Darwin sizes an
+     * object once, so a smaller one could not grow anyway. */
+    size_t existing;
+    fd = RightMicShm_OpenOwned(name, &existing);
+    if (fd >= 0) {
+        if (existing >= size) return fd;
+        close(fd);
+    }
+
+    if (shm_unlink(name) != 0 && errno != ENOENT) return -1;
+    return CreateNew(name, size);
+}
+
+int RightMicShm_Open(const char *name, size_t *size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    *size = (size_t)st.st_size;
+    return fd;
+}
+
+int RightMicShm_OpenOwned(const char *name, size_t *size)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    int e = 0;
+    if (fstat(fd, &st) != 0) {
+        e = errno;
+    } else if (st.st_uid != geteuid()) {
+        e = EPERM;
+    }
+    if (e != 0) {
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    *size = (size_t)st.st_size;
+    return fd;
+}
+
+void RightMicShm_Unlink(const char *name)
+{
+    shm_unlink(name);
+}
@@ -0,0 +1,56 @@
+/*
+ * RightMicShm.h
+ * Named POSIX shared memory for the ring and the driver's metrics.
+ *
+ * A regular file under /tmp lives on the boot volume: every page the
+ * capture callback dirties is eventually written back to disk, and an
+ * msync or memory pressure makes that write synchronous.  A shm_open
+ * object is plain memory with a name, so both sides share pages that
+ * never reach the filesystem.  The /tmp paths stay as the fallback for
+ * a process that may not use shm_open (a sandbox that denies it, say).
+ *
+ * An object outlives its creator until it is unlinked, like a file.
+ * Create reuses one it already owns at the right size, so a reader that
+ * mapped it earlier keeps seeing the same pages, the way reopening the
+ * file kept the same inode.  An object too small or someone else's is
+ * replaced: readers still mapping the old one keep it until they unmap
+ * (RightMicAttach_Moved notices).  The app creates the ring's object at
+ * the largest ring's size for that reason, so resizing never replaces it.
+ *
+ * Darwin's shm objects can't be read with pread and don't report a file
+ * type, so callers look at their contents through a mapping.  Portable
+ * POSIX; Swift can't call the variadic shm_open itself.
+ */
+
+#ifndef RightMicShm_h
+#define RightMicShm_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A writable object of at least `size` bytes, readable by other users  */
+/* (0644), created or reused as described above.  Returns the file      */
+/* descriptor, or -1 with errno set.                                    */
+int RightMicShm_Create(const char *name, size_t size);
+
+/* The object read-only and its size in `*size`, or -1 with errno set   */
+/* (ENOENT: not created yet).                                           */
+int RightMicShm_Open(const char *name, size_t *size);
+
+/* An existing object this user owns, writable, and its size in        */
+/* `*size`; -1 with errno set (ENOENT: none, EPERM: another user's).    */
+/* For invalidating a stale ring in place, without replacing it.       */
+int RightMicShm_OpenOwned(const char *name, size_t *size);
+
+/* Remove the name; mappings stay valid until unmapped. */
+void RightMicShm_Unlink(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicShm_h */
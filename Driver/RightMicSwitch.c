@@ -0,0 +1,201 @@
+/*
+ * RightMicSwitch.c
+ * Click-free handover between two capture sources feeding one ring.
+ *
+ * See RightMicSwitch.h.
+ */
+
+#include "RightMicSwitch.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define kFading     0x80000000u
+#define kOwnerMask  1u
+#define kStageMask  ((uint64_t)kRightMicSwitch_StageFrames - 1)
+#define kHalfPi     1.57079632679489662f
+
+/* ================================================================
+ * Control (main thread)
+ * ================================================================ */
+
+void RightMicSwitch_Init(RightMicSwitch *sw, float *stage, uint32_t owner)
+{
+    sw->stage      = stage;
+    sw->fadeFrames = 0;
+    sw->fadePos    = 0;
+    atomic_store_explicit(&sw->stageWrite, 0, memory_order_relaxed);
+    atomic_store_explicit(&sw->stageRead,  0, memory_order_relaxed);
+    atomic_store_explicit(&sw->state, owner & kOwnerMask, memory_order_release);
+}
+
+bool RightMicSwitch_Begin(RightMicSwitch *sw, uint32_t fadeFrames)
+{
+    uint32_t state = atomic_load_explicit(&sw->state, memory_order_acquire);
+    if (state & kFading) return false;
+    if (atomic_load_explicit(&sw->stageRead, memory_order_acquire) !=
+        atomic_load_explicit(&sw->stageWrite, memory_order_acquire)) {
+        return false;
+    }
+
+    sw->fadeFrames = fadeFrames ? fadeFrames : 1;
+    sw->fadePos    = 0;
+    /* Release publishes fadeFrames/fadePos to the owner's callback. */
+    atomic_store_explicit(&sw->state, state | kFading, memory_order_release);
+    return true;
+}
+
+void RightMicSwitch_Complete(RightMicSwitch *sw, uint32_t owner)
+{
+    /* The old owner has stopped, so this thread may act as the FIFO's
+     * consumer: drop what is staged rather than replaying stale audio. */
+    uint64_t w = atomic_load_explicit(&sw->stageWrite, memory_order_acquire);
+    atomic_store_explicit(&sw->stageRead, w, memory_order_release);
+    atomic_store_explicit(&sw->state, owner & kOwnerMask, memory_order_release);
+}
+
+uint32_t RightMicSwitch_Owner(const RightMicSwitch *sw)
+{
+    return atomic_load_explicit(&sw->state, memory_order_acquire) & kOwnerMask;
+}
+
+bool RightMicSwitch_IsFading(const RightMicSwitch *sw)
+{
+    return (atomic_load_explicit(&sw->state, memory_order_acquire) & kFading) != 0;
+}
+
+/* ================================================================
+ * Audio Path
+ * ================================================================ */
+
+/* Incoming source during a fade: stage frames for the owner to mix.
+ * Staged frames are as wide as the ring's. */
+static void Push(RightMicSwitch *sw, uint32_t channels, const float *frames, uint32_t frameCount)
+{
+    uint64_t w = atomic_load_explicit(&sw->stageWrite, memory_order_relaxed);
+    uint64_t r = atomic_load_explicit(&sw->stageRead,  memory_order_acquire);
+    if (frameCount > kRightMicSwitch_StageFrames - (w - r)) {
+        /* Owner has stopped consuming (device gone); the router will
+         * Complete the switch and discard the FIFO anyway. */
+        return;
+    }
+
+    uint32_t done = 0;
+    while (done < frameCount) {
+        uint32_t index = (uint32_t)(w & kStageMask);
+        uint32_t chunk = kRightMicSwitch_StageFrames - index;
+        if (chunk > frameCount - done) chunk = frameCount - done;
+        memcpy(sw->stage + (size_t)index * channels,
+               frames + (size_t)done * channels,
+               (size_t)chunk * channels * sizeof(float));
+        w    += chunk;
+        done += chunk;
+    }
+    atomic_store_explicit(&sw->stageWrite, w, memory_order_release);
+}
+
+/* New owner: flush frames staged during the fade that the old owner
+ * didn't get to, so the incoming stream stays contiguous. */
+static void Drain(RightMicSwitch *sw, RightMicRing *ring)
+{
+    uint64_t r = atomic_load_explicit(&sw->stageRead,  memory_order_relaxed);
+    uint64_t w = atomic_load_explicit(&sw->stageWrite, memory_order_acquire);
+    if (r == w) return;
+
+    while (r < w) {
+        uint32_t index = (uint32_t)(r & kStageMask);
+        uint32_t chunk = kRightMicSwitch_StageFrames - index;
+        if (chunk > w - r) chunk = (uint32_t)(w - r);
+        RightMicRing_Write(ring, sw->stage + (size_t)index * ring->channels, chunk);
+        r += chunk;
+    }
+    atomic_store_explicit(&sw->stageRead, r, memory_order_release);
+}
+
+/* Outgoing owner during a fade: mix staged incoming frames into
+ * `frames` and hand over once the fade is complete. */
+static void Mix(RightMicSwitch *sw, RightMicRing *ring, uint32_t owner,
+                float *frames, uint32_t frameCount)
+{
+    uint64_t r = atomic_load_explicit(&sw->stageRead,  memory_order_relaxed);
+    uint64_t w = atomic_load_explicit(&sw->stageWrite, memory_order_acquire);
+
+    /* Don't start until the incoming side is comfortably ahead, or
+     * callback jitter between the two devices would starve the fade. */
+    if (sw->fadePos == 0 && w - r < (uint64_t)frameCount + kRightMicSwitch_PrefillFrames) {
+        RightMicRing_Write(ring, frames, frameCount);
+        return;
+    }
+
+    uint32_t channels = ring->channels;
+    uint32_t i = 0;
+    for (; i < frameCount && sw->fadePos < sw->fadeFrames; i++, sw->fadePos++) {
+        float x     = ((float)sw->fadePos + 0.5f) / (float)sw->fadeFrames;
+        float gOut  = cosf(kHalfPi * x);
+        float gIn   = sinf(kHalfPi * x);
+        float *a    = frames + (size_t)i * channels;
+        /* If the incoming side momentarily runs dry, fade against
+         * silence rather than stalling the outgoing stream. */
+        const float *b = NULL;
+        if (r < w) {
+            b = sw->stage + (size_t)(r & kStageMask) * channels;
+            r++;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            a[c] = gOut * a[c] + (b ? gIn * b[c] : 0.0f);
+        }
+    }
+
+    RightMicRing_Write(ring, frames, i);
+    atomic_store_explicit(&sw->stageRead, r, memory_order_release);
+
+    if (sw->fadePos >= sw->fadeFrames) {
+        /* Fade done: the incoming source owns the ring from its next
+         * callback.  The rest of this buffer is dropped; the incoming
+         * stream continues from the next staged frame. */
+        atomic_store_explicit(&sw->state, (owner ^ 1u) & kOwnerMask, memory_order_release);
+    }
+}
+
+void RightMicSwitch_Write(RightMicSwitch *sw, RightMicRing *ring, uint32_t source,
+                          float *frames, uint32_t frameCount)
+{
+    if (frameCount == 0) return;
+
+    uint32_t state = atomic_load_explicit(&sw->state, memory_order_acquire);
+    uint32_t owner = state & kOwnerMask;
+
+    if ((source & kOwnerMask) == owner) {
+        if (state & kFading) {
+            Mix(sw, ring, owner, frames, frameCount);
+        } else {
+            Drain(sw, ring);
+            RightMicRing_Write(ring, frames, frameCount);
+        }
+    } else if (state & kFading) {
+        Push(sw, ring->channels, frames, frameCount);
+    }
+    /* Otherwise this is a unit that has been switched away from and is
+     * waiting to be stopped: its frames are dropped. */
+}
+
+float *RightMicSwitch_Reserve(RightMicSwitch *sw, RightMicRing *ring, uint32_t source,
+                              uint32_t frameCount)
+{
+    if (frameCount == 0) return NULL;
+
+    uint32_t state = atomic_load_explicit(&sw->state, memory_order_acquire);
+    if ((state & kFading) || (source & kOwnerMask) != (state & kOwnerMask)) return NULL;
+
+    /* Only the owner moves writeHead, and only from its own callback, so
+     * a Begin between here and Commit just starts the fade next time. */
+    Drain(sw, ring);
+    return RightMicRing_Reserve(ring, frameCount);
+}
+
+void RightMicSwitch_Commit(RightMicSwitch *sw, RightMicRing *ring, uint32_t frameCount)
+{
+    (void)sw;
+    RightMicRing_Commit(ring, frameCount);
+}
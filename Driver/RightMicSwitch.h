@@ -0,0 +1,92 @@
+/*
+ * RightMicSwitch.h
+ * Click-free handover between two capture sources feeding one ring.
+ *
+ * The ring has exactly one producer.  To switch microphones without a
+ * gap, the app runs the outgoing and the incoming capture unit side by
+ * side for a short overlap:
+ *
+ *   1. The incoming unit starts.  Its callback pushes frames into a
+ *      private staging FIFO instead of the ring.
+ *   2. Once the FIFO holds a callback's worth of frames, the outgoing
+ *      unit's callback mixes them into its own frames with an
+ *      equal-power crossfade and writes the mix to the ring.
+ *   3. When the fade completes, that same callback hands ring ownership
+ *      to the incoming source and never writes again.  The incoming
+ *      unit drains what is left in the FIFO and then writes directly.
+ *
+ * writeHead keeps counting across the switch, so the driver sees one
+ * continuous stream.  Sources are numbered 0 and 1; ownership and the
+ * fading flag share one atomic word so either callback sees a
+ * consistent pair.
+ *
+ * App-side only (the driver never links it).  Portable C11 and
+ * unit-tested on Linux.
+ */
+
+#ifndef RightMicSwitch_h
+#define RightMicSwitch_h
+
+#include "RightMicRing.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Configuration ────────────────────────────────────────────── */
+
+#define kRightMicSwitch_StageFrames      8192  /* staging FIFO (power of 2, ~170 ms) */
+#define kRightMicSwitch_PrefillFrames     256  /* jitter margin before fading starts */
+#define kRightMicSwitch_DefaultFadeFrames 2400 /* 50 ms at 48 kHz                    */
+
+/* ── State ────────────────────────────────────────────────────── */
+
+typedef struct {
+    _Atomic uint32_t state;       /* owner source | kRightMicSwitch_Fading   */
+    uint32_t         fadeFrames;  /* length of the current crossfade         */
+    uint32_t         fadePos;     /* frames faded so far (owner thread only) */
+    _Atomic uint64_t stageWrite;  /* frames pushed by the incoming source    */
+    _Atomic uint64_t stageRead;   /* frames consumed from the FIFO           */
+    float           *stage;       /* kRightMicSwitch_StageFrames frames      */
+} RightMicSwitch;
+
+/* `stage` must hold kRightMicSwitch_StageFrames stereo frames and     */
+/* outlive the switch.  `owner` (0 or 1) feeds the ring directly.       */
+void RightMicSwitch_Init(RightMicSwitch *sw, float *stage, uint32_t owner);
+
+/* Start crossfading to the other source.  Call after the incoming unit */
+/* is running.  Returns false (and changes nothing) if a switch is      */
+/* already in progress or the last one's FIFO has not been drained.     */
+bool RightMicSwitch_Begin(RightMicSwitch *sw, uint32_t fadeFrames);
+
+/* Hand the ring to `owner` immediately, discarding staged frames.      */
+/* Only safe once the previous owner's unit has stopped calling Write.  */
+void RightMicSwitch_Complete(RightMicSwitch *sw, uint32_t owner);
+
+uint32_t RightMicSwitch_Owner(const RightMicSwitch *sw);
+bool     RightMicSwitch_IsFading(const RightMicSwitch *sw);
+
+/* Called from `source`'s capture callback with frames at the ring's   */
+/* rate and width.  Real-time safe.  `frames` may be modified in place. */
+void RightMicSwitch_Write(RightMicSwitch *sw, RightMicRing *ring, uint32_t source,
+                          float *frames, uint32_t frameCount);
+
+/* Zero-copy path for the common case: if `source` owns the ring and no */
+/* switch is in progress, return ring storage for `frameCount` frames   */
+/* (see RightMicRing_Reserve) and publish it with RightMicSwitch_Commit, */
+/* which every reservation must be balanced by (with 0 if unused).      */
+/* Otherwise — or if the span wraps — return NULL; capture into a      */
+/* private buffer and call RightMicSwitch_Write instead.  Real-time    */
+/* safe.                                                               */
+float *RightMicSwitch_Reserve(RightMicSwitch *sw, RightMicRing *ring, uint32_t source,
+                              uint32_t frameCount);
+void   RightMicSwitch_Commit(RightMicSwitch *sw, RightMicRing *ring, uint32_t frameCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RightMicSwitch_h */
@@ -8,8 +8,17 @@ let package = Package(
         .macOS(.v14)
     ],
     targets: [
+        // Portable ring buffer protocol shared with the HAL driver.
+        // RightMicDriver.c is CoreAudio-only and built by scripts/build-driver.sh.
+        .target(
+            name: "CRightMic",
+            path: "Driver",
+            exclude: ["RightMicDriver.c", "Info.plist"],
+            publicHeadersPath: "."
+        ),
         .target(
             name: "RightMicCore",
+            dependencies: ["CRightMic"],
             path: "Sources/RightMicCore"
         ),
         .executableTarget(
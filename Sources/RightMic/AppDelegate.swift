@@ -10,6 +10,7 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
     private var panel: PopoverPanel?
     private let monitor = DeviceMonitor()
     private var audioRouter: AudioRouter?
+    private var deviceProber: DeviceProber?
     private var hostingView: PassthroughHostingView<MenuBarView>!
     private var eventMonitor: Any?
     private var rightClickMonitor: Any?
@@ -26,6 +27,9 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
 
         // Start audio routing (captures from resolved device → ring buffer → HAL driver)
         audioRouter = AudioRouter(monitor: monitor)
+
+        // Probe standby devices so dead ones are passed over
+        deviceProber = DeviceProber(monitor: monitor)
     }
 
     func applicationWillTerminate(_ notification: Notification) {
@@ -34,32 +38,18 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
 
     // MARK: - Stale Shared Memory Cleanup
 
-    /// Remove any leftover shared memory file from a previous crash.
-    /// Zeroes the contents before unlinking to prevent residual audio leakage.
+    /// Zero any ring left by a previous crash, in the shared memory object
+    /// or the fallback file, so no residual audio can be read from it.
+    /// Neither is removed: the HAL driver may still have it mapped, and a
+    /// new object or inode would leave it reading the old one until IO
+    /// restarts.  The zeroed header tells it there is no ring there.
     private func cleanupStaleSharedMemory() {
-        let path = RingBufferWriter.sharedMemoryPath
-        let fm = FileManager.default
-        guard fm.fileExists(atPath: path) else { return }
-
-        NSLog("[RightMic] Found stale shared memory file, cleaning up")
-        let fd = Darwin.open(path, O_RDWR | O_NOFOLLOW)
-        if fd >= 0 {
-            var st = stat()
-            if fstat(fd, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG && st.st_size > 0 {
-                let size = Int(st.st_size)
-                let ptr = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
-                if ptr != MAP_FAILED {
-                    memset(ptr, 0, size)
-                    msync(ptr, size, MS_SYNC)
-                    munmap(ptr, size)
-                }
-            }
-            Darwin.close(fd)
+        if RingBufferWriter.zeroStaleSharedMemory(named: RingBufferWriter.sharedMemoryName) {
+            NSLog("[RightMic] Found stale shared memory object, zeroed it")
+        }
+        if RingBufferWriter.zeroStaleFile(at: RingBufferWriter.sharedMemoryPath) {
+            NSLog("[RightMic] Found stale shared memory file, zeroed it")
         }
-        // Do NOT unlink the file — the HAL driver may still have it mapped.
-        // Zeroing the header above is sufficient to invalidate stale data.
-        // Unlinking would force a new inode, leaving the driver reading
-        // from the old (now deleted) file until IO restarts.
     }
 
     // MARK: - Status Item
@@ -7,58 +7,57 @@ import RightMicCore
 /// The HAL driver reads from this buffer to serve the "RightMic" virtual device.
 final class AudioRouter {
 
-    // MARK: - State (fileprivate for callback access)
-
-    fileprivate var audioUnit: AudioComponentInstance?
-    fileprivate let ringBufferWriter = RingBufferWriter()
-    fileprivate var renderBuffer: UnsafeMutablePointer<Float>?
-    fileprivate let renderBufferFrameCapacity: UInt32 = 4096
-
-    /// Atomic flag checked by the real-time callback. Set to 0 before
-    /// tearing down the audio unit so the callback can bail out safely.
-    /// Allocated on the heap so the pointer is stable across moves.
-    fileprivate let captureActiveFlag: UnsafeMutablePointer<Int32> = {
-        let ptr = UnsafeMutablePointer<Int32>.allocate(capacity: 1)
-        ptr.initialize(to: 0)
-        return ptr
-    }()
-
-    // MARK: - Sample Rate Conversion
-
-    /// AudioConverter for resampling when device rate != 48000 Hz.
-    fileprivate var audioConverter: AudioConverterRef?
-
-    /// Native channel count of the current capture device (1 = mono, 2 = stereo).
-    /// Set during configureAudioUnit before the capture callback starts.
-    fileprivate var captureChannels: UInt32 = UInt32(RingBufferWriter.channelCount)
-    /// Output buffer for the sample rate converter (48kHz data).
-    fileprivate var converterOutputBuffer: UnsafeMutablePointer<Float>?
-    fileprivate let converterOutputCapacity: UInt32 = 8192
-    /// Temporary state used by the converter's input callback.
-    fileprivate var converterInputPtr: UnsafePointer<Float>?
-    fileprivate var converterInputFramesLeft: UInt32 = 0
+    // MARK: - State
+
+    private let ringBufferWriter = RingBufferWriter()
+
+    /// Unit currently feeding the ring.
+    private var captureUnit: CaptureUnit?
+
+    /// Unit for the device being switched to while a crossfade is in flight.
+    private var incomingUnit: CaptureUnit?
+    private var incomingDeviceUID: String?
+    private var incomingDeviceName: String?
+    private var switchDeadline: CFAbsoluteTime = 0
+
+    /// Prepared unit for the device routing would fail over to.
+    private var standbyUnit: CaptureUnit?
+    private var standbyDeviceUID: String?
 
     // MARK: - Private
 
     private var cancellable: AnyCancellable?
+    private var standbyCancellable: AnyCancellable?
     private var currentDeviceUID: String?
     private weak var monitor: DeviceMonitor?
 
     /// DeviceID for which a mute property listener is currently installed.
     private var muteListenerDeviceID: AudioDeviceID?
 
+    /// The current device reports its own mute engaged, so its silence is
+    /// expected and never a reason to fail over.
+    private var currentDeviceMuted = false
+
+    /// A watchSilence poll is scheduled.
+    private var silenceWatchActive = false
+
+    /// No client is running IO on RightMic, so the current unit is paused
+    /// (still initialized) and the ring idles.  See `updateDemand`.
+    private var captureIdle = false
+
+    /// When the last client stopped, while capture still runs.
+    private var idleSince: CFAbsoluteTime?
+
+    /// Virtual device the IsRunningSomewhere listener is installed on.
+    private var demandListenerDeviceID: AudioObjectID?
+
     /// The device that was system default before we switched to RightMic.
     private var savedDefaultDeviceID: AudioDeviceID?
 
-    /// Prevents spamming render error logs from the real-time thread.
-    fileprivate var renderErrorLogged: Bool = false
-
     // MARK: - Lifecycle
 
     init(monitor: DeviceMonitor) {
         self.monitor = monitor
-        allocateRenderBuffer()
-        allocateConverterOutputBuffer()
 
         cancellable = monitor.$resolvedDevice
             .removeDuplicates { $0?.uid == $1?.uid }
@@ -66,14 +65,17 @@ final class AudioRouter {
             .sink { [weak self] entry in
                 self?.handleDeviceChange(entry)
             }
+
+        standbyCancellable = monitor.$standbyDevice
+            .removeDuplicates { $0?.uid == $1?.uid }
+            .receive(on: DispatchQueue.main)
+            .sink { [weak self] _ in
+                self?.updateStandby()
+            }
     }
 
     deinit {
         stopCapture()
-        deallocateRenderBuffer()
-        deallocateConverterOutputBuffer()
-        captureActiveFlag.deinitialize(count: 1)
-        captureActiveFlag.deallocate()
     }
 
     // MARK: - Public
@@ -109,59 +111,85 @@ final class AudioRouter {
         let t0 = CFAbsoluteTimeGetCurrent()
         NSLog("[RightMic] startCapture: begin device=%@ (%@)", deviceName, deviceUID)
 
+        // A crossfade already heading to this device finishes on its own
+        if incomingDeviceUID == deviceUID {
+            NSLog("[RightMic] startCapture: already switching to this device, skipping")
+            return
+        }
+
         // Already capturing from this device
-        if currentDeviceUID == deviceUID && audioUnit != nil {
+        if currentDeviceUID == deviceUID && captureUnit != nil && incomingUnit == nil {
             NSLog("[RightMic] startCapture: already capturing from this device, skipping")
             return
         }
 
-        // Stop existing capture first
-        stopCapture()
-
         // Look up the AudioDeviceID from the monitor's live device list
         guard let deviceID = monitor?.inputDevices.first(where: { $0.uid == deviceUID })?.deviceID else {
             NSLog("[RightMic] Cannot find deviceID for: \(deviceUID)")
             return
         }
 
-        // Open the shared ring buffer
+        // Already routing: hand over without closing the ring, so the driver
+        // sees one continuous stream instead of a reset and re-sync.
+        if captureUnit != nil && ringBufferWriter.isOpen {
+            switchCapture(deviceID: deviceID, deviceUID: deviceUID, deviceName: deviceName)
+            return
+        }
+
+        // Stop existing capture first
+        stopCapture()
+
+        // Open the shared ring buffer at the device's own rate if the driver
+        // offers it, so capture is a plain copy; devices switched to later
+        // convert to it.  A mono mic gets a mono ring, half the copying and
+        // ring traffic, and the driver expands it; later devices fit it too
+        // (a stereo device gives its first channel).
+        let deviceRate = CaptureUnit.nominalSampleRate(deviceID) ?? 0
+        let ringRate = RingBufferWriter.isSupportedSampleRate(deviceRate)
+            ? Int(deviceRate) : RingBufferWriter.defaultSampleRate
+        let ringChannels = CaptureUnit.inputChannelCount(deviceID) == 1 ? 1 : RingBufferWriter.channelCount
+        // Ring capacity in frames; unset (0) keeps the driver's default.
+        let ringFrames = UserDefaults.standard.integer(forKey: "rightmic.ringFrames")
         do {
             let t1 = CFAbsoluteTimeGetCurrent()
-            try ringBufferWriter.open()
+            try ringBufferWriter.open(sampleRate: ringRate, channels: ringChannels, ringFrames: ringFrames)
             NSLog("[RightMic] startCapture: ringBufferWriter.open took %.3fs", CFAbsoluteTimeGetCurrent() - t1)
+            // Unset keys read as 0, which selects the driver defaults.
+            ringBufferWriter.setLatency(
+                targetFrames: UserDefaults.standard.integer(forKey: "rightmic.targetLatencyFrames"),
+                minSafeFrames: UserDefaults.standard.integer(forKey: "rightmic.minSafeLatencyFrames"))
+            ringBufferWriter.setConcealment(
+                RingBufferWriter.Concealment(
+                    rawValue: UInt32(clamping: UserDefaults.standard.integer(forKey: "rightmic.concealMode")))
+                ?? .driverDefault)
         } catch {
             NSLog("[RightMic] Failed to open ring buffer: \(error)")
             return
         }
 
-        // Configure and start the AUHAL capture unit
-        let t2 = CFAbsoluteTimeGetCurrent()
-        guard configureAudioUnit(deviceID: deviceID) else {
+        // Configure the AUHAL capture unit, and start it unless nobody is
+        // reading RightMic yet.  A freshly opened ring is owned by source 0.
+        installDemandListener()
+        let idle = idleStopSeconds >= 0 && !consumersRunning()
+        let unit = CaptureUnit(deviceID: deviceID, source: ringBufferWriter.switchOwner,
+                               ringBufferWriter: ringBufferWriter)
+        guard idle ? unit.prepare() : unit.start() else {
             NSLog("[RightMic] Failed to configure audio unit for: \(deviceName)")
+            removeDemandListener()
             ringBufferWriter.close()
             return
         }
-        NSLog("[RightMic] startCapture: configureAudioUnit took %.3fs", CFAbsoluteTimeGetCurrent() - t2)
+        if idle {
+            ringBufferWriter.suspend()
+            captureIdle = true
+            NSLog("[RightMic] startCapture: no clients reading RightMic, capture idle")
+        }
 
+        captureUnit = unit
         currentDeviceUID = deviceUID
-
-        // Enumerate real device's CoreAudio controls and push to shared memory.
-        // The driver detects the version change and exposes the same controls
-        // on the virtual device so macOS can route hardware control events.
-        let controls = enumerateControls(deviceID: deviceID)
-        ringBufferWriter.setControls(controls)
-        NSLog("[RightMic] Pushed %d controls to driver for device %d", controls.count, deviceID)
-
-        // Listen for mute state changes on the real device.
-        // When the physical device reports muted, we silence the ring buffer output.
-        installMuteListener(deviceID: deviceID)
-
-        // Reset diagnostic state
-        renderErrorLogged = false
-
-        // Mark capture active (checked by the real-time callback)
-        captureActiveFlag.pointee = 1
-        OSMemoryBarrier()
+        adoptDeviceControls(deviceID: deviceID)
+        updateStandby()
+        startSilenceWatch()
 
         // Set system default input to RightMic virtual device
         let t3 = CFAbsoluteTimeGetCurrent()
@@ -176,32 +204,22 @@ final class AudioRouter {
         let t0 = CFAbsoluteTimeGetCurrent()
         NSLog("[RightMic] stopCapture: begin (currentDevice=%@)", currentDeviceUID ?? "nil")
 
-        // Signal the real-time callback to stop before tearing down
-        captureActiveFlag.pointee = 0
-        OSMemoryBarrier()
-
-        if let au = audioUnit {
-            let t1 = CFAbsoluteTimeGetCurrent()
-            AudioOutputUnitStop(au)
-            NSLog("[RightMic] stopCapture: AudioOutputUnitStop took %.3fs", CFAbsoluteTimeGetCurrent() - t1)
-
-            let t2 = CFAbsoluteTimeGetCurrent()
-            AudioUnitUninitialize(au)
-            NSLog("[RightMic] stopCapture: AudioUnitUninitialize took %.3fs", CFAbsoluteTimeGetCurrent() - t2)
-
-            let t3 = CFAbsoluteTimeGetCurrent()
-            AudioComponentInstanceDispose(au)
-            NSLog("[RightMic] stopCapture: AudioComponentInstanceDispose took %.3fs", CFAbsoluteTimeGetCurrent() - t3)
-
-            audioUnit = nil
-        }
-
-        destroyAudioConverter()
+        incomingUnit?.stop()
+        incomingUnit = nil
+        incomingDeviceUID = nil
+        incomingDeviceName = nil
+        captureUnit?.stop()
+        captureUnit = nil
+        dropStandby()
+        removeDemandListener()
+        captureIdle = false
+        idleSince = nil
 
         if currentDeviceUID != nil {
             // Remove mute listener and clear controls before closing the ring buffer
             removeMuteListener()
             ringBufferWriter.setControls([])
+            NSLog("[RightMic] Session metrics: %@", ringBufferWriter.metrics().description)
 
             let t4 = CFAbsoluteTimeGetCurrent()
             ringBufferWriter.close()
@@ -217,6 +235,389 @@ final class AudioRouter {
         NSLog("[RightMic] stopCapture: total %.3fs", CFAbsoluteTimeGetCurrent() - t0)
     }
 
+    // MARK: - Device Switch
+
+    /// Crossfade length for device switches, in ring frames.  Unset selects
+    /// the default (a duration, given in frames at the default rate); 0
+    /// disables the overlap and switches as soon as the new unit starts.
+    private var switchFadeFrames: Int {
+        let key = "rightmic.switchCrossfadeMs"
+        let rate = ringBufferWriter.sampleRate
+        guard UserDefaults.standard.object(forKey: key) != nil else {
+            return RingBufferWriter.defaultSwitchFadeFrames * rate / RingBufferWriter.defaultSampleRate
+        }
+        return max(0, UserDefaults.standard.integer(forKey: key)) * rate / 1000
+    }
+
+    /// Move routing to `deviceID` while the ring stays open.  If the current
+    /// device is still connected, both units run until the outgoing one has
+    /// crossfaded into the incoming one; otherwise the new unit takes over
+    /// as soon as it starts and the driver conceals the gap.
+    private func switchCapture(deviceID: AudioDeviceID, deviceUID: String, deviceName: String) {
+        let t0 = CFAbsoluteTimeGetCurrent()
+
+        // A switch already in flight is finished first, so there are never
+        // more than two units.
+        if incomingUnit != nil {
+            finishSwitch(force: true)
+        }
+        guard let outgoing = captureUnit else { return }
+
+        // Use the standby unit if it is for this device; otherwise it would
+        // share the incoming source number, so it has to go.
+        let unit: CaptureUnit
+        if let standby = standbyUnit, standbyDeviceUID == deviceUID,
+           standby.deviceID == deviceID, standby.source == outgoing.source ^ 1 {
+            NSLog("[RightMic] switchCapture: using %@ standby unit", standby.isRunning ? "hot" : "warm")
+            unit = standby
+            standbyUnit = nil
+            standbyDeviceUID = nil
+        } else {
+            dropStandby()
+            unit = CaptureUnit(deviceID: deviceID, source: outgoing.source ^ 1,
+                               ringBufferWriter: ringBufferWriter)
+        }
+
+        // Nobody is listening: swap the paused units, nothing to crossfade.
+        if captureIdle {
+            guard unit.prepare() else {
+                NSLog("[RightMic] Failed to configure audio unit for: \(deviceName)")
+                return
+            }
+            unit.pause()
+            outgoing.stop()
+            ringBufferWriter.completeSwitch(to: unit.source)
+            captureUnit = unit
+            currentDeviceUID = deviceUID
+            adoptDeviceControls(deviceID: deviceID)
+            NSLog("[RightMic] Routing switched while idle: \(deviceName) (id=\(deviceID)) -> RightMic")
+            updateStandby()
+            return
+        }
+
+        guard unit.start() else {
+            NSLog("[RightMic] Failed to configure audio unit for: \(deviceName)")
+            return
+        }
+        incomingUnit = unit
+        incomingDeviceUID = deviceUID
+        incomingDeviceName = deviceName
+
+        let outgoingConnected = monitor?.inputDevices.contains(where: { $0.uid == currentDeviceUID }) ?? false
+        let fadeFrames = switchFadeFrames
+        if outgoingConnected && fadeFrames > 0 && ringBufferWriter.beginSwitch(fadeFrames: fadeFrames) {
+            NSLog("[RightMic] switchCapture: crossfading to %@ over %d frames (start took %.3fs)",
+                  deviceName, fadeFrames, CFAbsoluteTimeGetCurrent() - t0)
+            switchDeadline = CFAbsoluteTimeGetCurrent() + 2.0
+            pollSwitch()
+        } else {
+            finishSwitch(force: true)
+        }
+    }
+
+    /// Wait for the outgoing unit's callback to complete the crossfade.  If
+    /// it never does (the outgoing device stopped delivering, or the new one
+    /// never did), force the handover at the deadline.
+    private func pollSwitch() {
+        guard let incoming = incomingUnit else { return }
+        if ringBufferWriter.switchOwner == incoming.source && !ringBufferWriter.isSwitching {
+            finishSwitch(force: false)
+        } else if CFAbsoluteTimeGetCurrent() >= switchDeadline {
+            NSLog("[RightMic] switchCapture: crossfade timed out, forcing switch")
+            finishSwitch(force: true)
+        } else {
+            DispatchQueue.main.asyncAfter(deadline: .now() + 0.02) { [weak self] in
+                self?.pollSwitch()
+            }
+        }
+    }
+
+    /// Retire the outgoing unit and make the incoming one current.
+    private func finishSwitch(force: Bool) {
+        guard let incoming = incomingUnit else { return }
+
+        // Stopping is synchronous: afterwards the outgoing callback can't
+        // write, so a forced handover can't race it.
+        let outgoing = captureUnit
+        let outgoingUID = currentDeviceUID
+        outgoing?.pause()
+        if force {
+            ringBufferWriter.completeSwitch(to: incoming.source)
+        }
+
+        captureUnit = incoming
+        currentDeviceUID = incomingDeviceUID
+        incomingUnit = nil
+        incomingDeviceUID = nil
+
+        adoptDeviceControls(deviceID: incoming.deviceID)
+        NSLog("[RightMic] Routing switched: \(incomingDeviceName ?? "?") (id=\(incoming.deviceID)) -> RightMic%@",
+              force ? " (hard switch)" : "")
+        incomingDeviceName = nil
+
+        // When a higher-priority mic appears, the one it replaced is usually
+        // the new fallback: keep its unit instead of rebuilding it.
+        if let outgoing, standbyMode != .off, outgoingUID != nil,
+           outgoingUID == monitor?.standbyDevice?.uid {
+            standbyUnit = outgoing
+            standbyDeviceUID = outgoingUID
+        } else {
+            outgoing?.stop()
+        }
+        updateStandby()
+
+        // Clients may have come or gone while both units ran.
+        updateDemand()
+    }
+
+    // MARK: - Silence Failover
+
+    /// Seconds of unbroken dead silence after which the current device is
+    /// passed over for the next one.  Unset selects 10; 0 disables.
+    private var silenceFailoverSeconds: Double {
+        let key = "rightmic.silenceFailoverSeconds"
+        guard UserDefaults.standard.object(forKey: key) != nil else { return 10 }
+        return max(0, UserDefaults.standard.double(forKey: key))
+    }
+
+    private func startSilenceWatch() {
+        guard !silenceWatchActive else { return }
+        silenceWatchActive = true
+        watchSilence()
+    }
+
+    /// Once a second while routing, check the current unit's level meter.
+    /// A device that is connected but delivering nothing (a hardware mute
+    /// switch, a dead Bluetooth mic path) is reported to the monitor, whose
+    /// resolution then fails over as if it had been unplugged.  The same
+    /// poll keeps the unit's buffer size matched to the driver's.
+    private func watchSilence() {
+        guard let unit = captureUnit, let uid = currentDeviceUID else {
+            silenceWatchActive = false
+            return
+        }
+        matchIOBufferSize(unit)
+        let limit = silenceFailoverSeconds
+        if limit > 0, incomingUnit == nil, !captureIdle, !currentDeviceMuted,
+           unit.level.reading.silentSeconds >= limit {
+            monitor?.markSilent(uid)
+        }
+        DispatchQueue.main.asyncAfter(deadline: .now() + 1.0) { [weak self] in
+            self?.watchSilence()
+        }
+    }
+
+    // MARK: - IO Buffer Size
+
+    /// Run the capture device at the IO buffer size clients run RightMic
+    /// at, once the driver has published it.  The driver's default
+    /// latency target is a few IO buffers, which only covers the ring
+    /// being filled in bursts of the same size: a DAW at 64 frames would
+    /// otherwise see 512-frame bursts against a 384-frame cushion.
+    private func matchIOBufferSize(_ unit: CaptureUnit) {
+        guard !captureIdle, let frames = ringBufferWriter.driverIOBufferRingFrames(),
+              unit.matchedBufferFrames != frames else { return }
+        unit.matchBufferFrameSize(frames)
+    }
+
+    // MARK: - Demand
+
+    /// Seconds capture keeps running after the last client stops, so an
+    /// app that restarts IO (a device change, a settings pane) doesn't
+    /// bounce the mic.  Unset selects 5; negative keeps capturing always.
+    private var idleStopSeconds: Double {
+        let key = "rightmic.idleStopSeconds"
+        guard UserDefaults.standard.object(forKey: key) != nil else { return 5 }
+        return UserDefaults.standard.double(forKey: key)
+    }
+
+    /// Whether any client is running IO on RightMic.  The HAL's
+    /// IsRunningSomewhere (which also wakes us through the listener) or
+    /// the driver's own client count saying so is enough; the HAL may
+    /// report first, the driver's count is published asynchronously.
+    /// Without the listener nothing would wake us, so never report idle.
+    private func consumersRunning() -> Bool {
+        guard let virtualID = demandListenerDeviceID else { return true }
+        if (ringBufferWriter.driverIOClients() ?? 0) > 0 { return true }
+
+        var addr = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyDeviceIsRunningSomewhere,
+            mScope: kAudioObjectPropertyScopeGlobal,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        var running: UInt32 = 0
+        var size = UInt32(MemoryLayout<UInt32>.size)
+        guard AudioObjectGetPropertyData(virtualID, &addr, 0, nil, &size, &running) == noErr else {
+            return true
+        }
+        return running != 0
+    }
+
+    /// Start capture as soon as a client runs IO on RightMic; pause it
+    /// once none has for `idleStopSeconds`.  Called from the listener and
+    /// when a pause falls due.
+    func updateDemand() {
+        guard let unit = captureUnit, incomingUnit == nil else { return }
+
+        let limit = idleStopSeconds
+        if limit < 0 || consumersRunning() {
+            idleSince = nil
+            if captureIdle { resumeCapture(unit) }
+            return
+        }
+        guard !captureIdle else { return }
+
+        let now = CFAbsoluteTimeGetCurrent()
+        let since = idleSince ?? now
+        idleSince = since
+        if now - since >= limit {
+            suspendCapture(unit)
+        } else {
+            DispatchQueue.main.asyncAfter(deadline: .now() + (since + limit - now)) { [weak self] in
+                self?.updateDemand()
+            }
+        }
+    }
+
+    private func suspendCapture(_ unit: CaptureUnit) {
+        unit.pause()
+        standbyUnit?.pause()
+        ringBufferWriter.suspend()
+        captureIdle = true
+        idleSince = nil
+        NSLog("[RightMic] No clients reading RightMic, capture paused")
+    }
+
+    /// The ring is primed before the unit starts, so the client's first
+    /// cycles read silence from the ring instead of being concealed while
+    /// the AUHAL comes up.  If the unit won't start, the ring is suspended
+    /// again and capture stays idle until demand next changes.
+    private func resumeCapture(_ unit: CaptureUnit) {
+        let t0 = CFAbsoluteTimeGetCurrent()
+        ringBufferWriter.resume()
+        guard unit.start() else {
+            ringBufferWriter.suspend()
+            NSLog("[RightMic] Failed to resume capture")
+            return
+        }
+        captureIdle = false
+        updateStandby()
+        NSLog("[RightMic] Client reading RightMic, capture resumed [%.3fs]", CFAbsoluteTimeGetCurrent() - t0)
+    }
+
+    private func installDemandListener() {
+        guard demandListenerDeviceID == nil, let virtualID = DriverStatus.virtualDeviceAudioID else { return }
+        var addr = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyDeviceIsRunningSomewhere,
+            mScope: kAudioObjectPropertyScopeGlobal,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        let ctx = Unmanaged.passUnretained(self).toOpaque()
+        guard AudioObjectAddPropertyListener(virtualID, &addr, demandPropertyListenerProc, ctx) == noErr else {
+            NSLog("[RightMic] Could not watch RightMic clients; capturing continuously")
+            return
+        }
+        demandListenerDeviceID = virtualID
+    }
+
+    private func removeDemandListener() {
+        guard let virtualID = demandListenerDeviceID else { return }
+        var addr = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyDeviceIsRunningSomewhere,
+            mScope: kAudioObjectPropertyScopeGlobal,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        let ctx = Unmanaged.passUnretained(self).toOpaque()
+        AudioObjectRemovePropertyListener(virtualID, &addr, demandPropertyListenerProc, ctx)
+        demandListenerDeviceID = nil
+    }
+
+    // MARK: - Standby
+
+    private enum StandbyMode: Int {
+        case off  = 0  // no standby unit
+        case warm = 1  // AUHAL initialized; failover only has to start it
+        case hot  = 2  // AUHAL running, frames dropped; failover is a flip
+    }
+
+    /// Off unless enabled: a hot standby keeps a second mic (and, for
+    /// Bluetooth headsets, the low-quality duplex profile) active.
+    private var standbyMode: StandbyMode {
+        StandbyMode(rawValue: UserDefaults.standard.integer(forKey: "rightmic.standbyMode")) ?? .off
+    }
+
+    /// Keep a prepared unit for the monitor's standby device, so failing over
+    /// to it skips the AUHAL cold start.  Called whenever the current or the
+    /// standby device changes.
+    private func updateStandby() {
+        // A switch in flight owns the spare source number; revisit afterwards.
+        guard incomingUnit == nil else { return }
+
+        let mode = standbyMode
+        guard mode != .off, let current = captureUnit,
+              let entry = monitor?.standbyDevice,
+              entry.uid != currentDeviceUID,
+              entry.uid != DriverStatus.virtualDeviceUID,
+              let deviceID = monitor?.inputDevices.first(where: { $0.uid == entry.uid })?.deviceID else {
+            dropStandby()
+            return
+        }
+
+        let source = current.source ^ 1
+        if let standby = standbyUnit, standbyDeviceUID == entry.uid,
+           standby.deviceID == deviceID, standby.source == source {
+            applyStandbyMode(standby, mode)
+            return
+        }
+
+        dropStandby()
+        let t0 = CFAbsoluteTimeGetCurrent()
+        let unit = CaptureUnit(deviceID: deviceID, source: source, ringBufferWriter: ringBufferWriter)
+        guard unit.prepare() else {
+            NSLog("[RightMic] Failed to prepare standby unit for: \(entry.name)")
+            return
+        }
+        standbyUnit = unit
+        standbyDeviceUID = entry.uid
+        applyStandbyMode(unit, mode)
+        NSLog("[RightMic] Standby ready: \(entry.name) (id=\(deviceID)) [%.3fs]", CFAbsoluteTimeGetCurrent() - t0)
+    }
+
+    private func applyStandbyMode(_ unit: CaptureUnit, _ mode: StandbyMode) {
+        switch mode {
+        case .hot where captureIdle:
+            unit.pause()
+        case .hot:
+            // Not the ring's owner and no switch in progress, so the
+            // switch stage drops everything this unit captures.
+            if !unit.start() {
+                NSLog("[RightMic] Failed to start hot standby unit")
+            }
+        case .warm, .off:
+            unit.pause()
+        }
+    }
+
+    private func dropStandby() {
+        standbyUnit?.stop()
+        standbyUnit = nil
+        standbyDeviceUID = nil
+    }
+
+    /// Mirror the current device's controls and mute state onto the virtual device.
+    private func adoptDeviceControls(deviceID: AudioDeviceID) {
+        // Enumerate real device's CoreAudio controls and push to shared memory.
+        // The driver detects the version change and exposes the same controls
+        // on the virtual device so macOS can route hardware control events.
+        let controls = enumerateControls(deviceID: deviceID)
+        ringBufferWriter.setControls(controls)
+        NSLog("[RightMic] Pushed %d controls to driver for device %d", controls.count, deviceID)
+
+        // Listen for mute state changes on the real device.
+        // When the physical device reports muted, we silence the ring buffer output.
+        installMuteListener(deviceID: deviceID)
+    }
+
     // MARK: - System Default Management
 
     private func claimSystemDefault() {
@@ -360,6 +761,7 @@ final class AudioRouter {
         let ctx = Unmanaged.passUnretained(self).toOpaque()
         AudioObjectRemovePropertyListener(deviceID, &addr, mutePropertyListenerProc, ctx)
         muteListenerDeviceID = nil
+        currentDeviceMuted = false
         ringBufferWriter.setMuted(false)
         NSLog("[RightMic] Mute listener removed for device %d", deviceID)
     }
@@ -374,388 +776,35 @@ final class AudioRouter {
         var muted: UInt32 = 0
         var size = UInt32(MemoryLayout<UInt32>.size)
         guard AudioObjectGetPropertyData(deviceID, &addr, 0, nil, &size, &muted) == noErr else { return }
+        currentDeviceMuted = muted != 0
         ringBufferWriter.setMuted(muted != 0)
         NSLog("[RightMic] Device %d mute → %@", deviceID, muted != 0 ? "muted" : "unmuted")
     }
-
-    // MARK: - AUHAL Configuration
-
-    private func configureAudioUnit(deviceID: AudioDeviceID) -> Bool {
-        // Find the HAL Output audio component
-        var desc = AudioComponentDescription(
-            componentType: kAudioUnitType_Output,
-            componentSubType: kAudioUnitSubType_HALOutput,
-            componentManufacturer: kAudioUnitManufacturer_Apple,
-            componentFlags: 0,
-            componentFlagsMask: 0
-        )
-        guard let component = AudioComponentFindNext(nil, &desc) else {
-            NSLog("[RightMic] HALOutput component not found")
-            return false
-        }
-
-        var au: AudioComponentInstance?
-        guard AudioComponentInstanceNew(component, &au) == noErr, let au else {
-            NSLog("[RightMic] Failed to create audio unit")
-            return false
-        }
-
-        // Enable input on bus 1
-        var enableIO: UInt32 = 1
-        var status = AudioUnitSetProperty(
-            au, kAudioOutputUnitProperty_EnableIO,
-            kAudioUnitScope_Input, 1,
-            &enableIO, UInt32(MemoryLayout<UInt32>.size)
-        )
-        guard status == noErr else {
-            NSLog("[RightMic] EnableIO input failed: \(status)")
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Disable output on bus 0
-        var disableIO: UInt32 = 0
-        status = AudioUnitSetProperty(
-            au, kAudioOutputUnitProperty_EnableIO,
-            kAudioUnitScope_Output, 0,
-            &disableIO, UInt32(MemoryLayout<UInt32>.size)
-        )
-        guard status == noErr else {
-            NSLog("[RightMic] EnableIO output failed: \(status)")
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Set the input device
-        var inputDevice = deviceID
-        status = AudioUnitSetProperty(
-            au, kAudioOutputUnitProperty_CurrentDevice,
-            kAudioUnitScope_Global, 0,
-            &inputDevice, UInt32(MemoryLayout<AudioDeviceID>.size)
-        )
-        guard status == noErr else {
-            NSLog("[RightMic] Set input device failed: \(status)")
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Query the device's native format on the input (hardware) side of bus 1
-        var deviceFormat = AudioStreamBasicDescription()
-        var formatSize = UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
-        let fmtStatus = AudioUnitGetProperty(
-            au, kAudioUnitProperty_StreamFormat,
-            kAudioUnitScope_Input, 1,
-            &deviceFormat, &formatSize
-        )
-        let captureRate: Float64
-        let captureChannels: UInt32
-        if fmtStatus == noErr && deviceFormat.mSampleRate > 0 {
-            captureRate = deviceFormat.mSampleRate
-            // Clamp to the ring buffer's channel count (mono or stereo).
-            // Per Apple TN2091, AUHAL silences extra client channels that have no
-            // corresponding hardware channel, so we must match the hardware channel count
-            // to avoid getting a silent right channel from a mono microphone.
-            captureChannels = deviceFormat.mChannelsPerFrame >= 1
-                ? min(deviceFormat.mChannelsPerFrame, UInt32(RingBufferWriter.channelCount))
-                : UInt32(RingBufferWriter.channelCount)
-            NSLog("[RightMic] Device native format: %.0f Hz, %d ch, %d bits, flags=0x%X",
-                  deviceFormat.mSampleRate, deviceFormat.mChannelsPerFrame,
-                  deviceFormat.mBitsPerChannel, deviceFormat.mFormatFlags)
-        } else {
-            captureRate = 48000.0
-            captureChannels = UInt32(RingBufferWriter.channelCount)
-            NSLog("[RightMic] Could not query device format (status=%d), assuming 48kHz stereo", fmtStatus)
-        }
-        self.captureChannels = captureChannels
-        let captureBytesPerFrame = captureChannels * 4  // 32-bit float
-
-        // Set our desired format on the output (client) side of bus 1.
-        // Use the device's native sample rate and channel count to avoid -10863 errors
-        // with virtual devices and to prevent channel mismatches with mono hardware.
-        // Sample rate and mono→stereo upmixing are handled after rendering.
-        var format = AudioStreamBasicDescription(
-            mSampleRate: captureRate,
-            mFormatID: kAudioFormatLinearPCM,
-            mFormatFlags: kAudioFormatFlagIsFloat
-                        | kAudioFormatFlagsNativeEndian
-                        | kAudioFormatFlagIsPacked,
-            mBytesPerPacket: captureBytesPerFrame,
-            mFramesPerPacket: 1,
-            mBytesPerFrame: captureBytesPerFrame,
-            mChannelsPerFrame: captureChannels,
-            mBitsPerChannel: 32,
-            mReserved: 0
-        )
-        status = AudioUnitSetProperty(
-            au, kAudioUnitProperty_StreamFormat,
-            kAudioUnitScope_Output, 1,
-            &format, UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
-        )
-        guard status == noErr else {
-            NSLog("[RightMic] Set stream format failed: \(status)")
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Create sample rate converter if device rate differs from 48kHz
-        destroyAudioConverter()
-        if captureRate != 48000.0 {
-            var srcFormat = format
-            var dstFormat = format
-            dstFormat.mSampleRate = 48000.0
-
-            var converter: AudioConverterRef?
-            let convStatus = AudioConverterNew(&srcFormat, &dstFormat, &converter)
-            guard convStatus == noErr, let converter else {
-                NSLog("[RightMic] Failed to create AudioConverter (%.0f -> 48000): %d",
-                      captureRate, convStatus)
-                AudioComponentInstanceDispose(au)
-                return false
-            }
-            // Use highest quality SRC to minimise audible artefacts on non-48kHz devices.
-            var quality = UInt32(kAudioConverterQuality_Max)
-            AudioConverterSetProperty(converter,
-                                      kAudioConverterSampleRateConverterQuality,
-                                      UInt32(MemoryLayout<UInt32>.size),
-                                      &quality)
-            audioConverter = converter
-            NSLog("[RightMic] Created sample rate converter: %.0f Hz -> 48000 Hz (%d ch)",
-                  captureRate, captureChannels)
-        }
-
-        // Set input callback (fires when new audio is available)
-        var callbackStruct = AURenderCallbackStruct(
-            inputProc: auInputCallback,
-            inputProcRefCon: Unmanaged.passUnretained(self).toOpaque()
-        )
-        status = AudioUnitSetProperty(
-            au, kAudioOutputUnitProperty_SetInputCallback,
-            kAudioUnitScope_Global, 0,
-            &callbackStruct, UInt32(MemoryLayout<AURenderCallbackStruct>.size)
-        )
-        guard status == noErr else {
-            NSLog("[RightMic] Set input callback failed: \(status)")
-            destroyAudioConverter()
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Initialize
-        status = AudioUnitInitialize(au)
-        guard status == noErr else {
-            NSLog("[RightMic] AudioUnitInitialize failed: \(status)")
-            destroyAudioConverter()
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        // Start
-        status = AudioOutputUnitStart(au)
-        guard status == noErr else {
-            NSLog("[RightMic] AudioOutputUnitStart failed: \(status)")
-            AudioUnitUninitialize(au)
-            destroyAudioConverter()
-            AudioComponentInstanceDispose(au)
-            return false
-        }
-
-        audioUnit = au
-        return true
-    }
-
-    // MARK: - Audio Converter
-
-    private func destroyAudioConverter() {
-        if let converter = audioConverter {
-            AudioConverterDispose(converter)
-            audioConverter = nil
-        }
-    }
-
-    // MARK: - Render Buffer
-
-    private func allocateRenderBuffer() {
-        let count = Int(renderBufferFrameCapacity) * RingBufferWriter.channelCount
-        renderBuffer = .allocate(capacity: count)
-        renderBuffer?.initialize(repeating: 0, count: count)
-    }
-
-    private func deallocateRenderBuffer() {
-        guard let buf = renderBuffer else { return }
-        let count = Int(renderBufferFrameCapacity) * RingBufferWriter.channelCount
-        buf.deinitialize(count: count)
-        buf.deallocate()
-        renderBuffer = nil
-    }
-
-    private func allocateConverterOutputBuffer() {
-        let count = Int(converterOutputCapacity) * RingBufferWriter.channelCount
-        converterOutputBuffer = .allocate(capacity: count)
-        converterOutputBuffer?.initialize(repeating: 0, count: count)
-    }
-
-    private func deallocateConverterOutputBuffer() {
-        guard let buf = converterOutputBuffer else { return }
-        let count = Int(converterOutputCapacity) * RingBufferWriter.channelCount
-        buf.deinitialize(count: count)
-        buf.deallocate()
-        converterOutputBuffer = nil
-    }
-}
-
-// MARK: - Audio Unit Callback
-
-/// C-function callback invoked by CoreAudio on the real-time audio thread
-/// when new input frames are available from the hardware device.
-private func auInputCallback(
-    inRefCon: UnsafeMutableRawPointer,
-    ioActionFlags: UnsafeMutablePointer<AudioUnitRenderActionFlags>,
-    inTimeStamp: UnsafePointer<AudioTimeStamp>,
-    inBusNumber: UInt32,
-    inNumberFrames: UInt32,
-    ioData: UnsafeMutablePointer<AudioBufferList>?
-) -> OSStatus {
-    let router = Unmanaged<AudioRouter>.fromOpaque(inRefCon).takeUnretainedValue()
-
-    // Bail out if capture is being torn down on the main thread
-    guard router.captureActiveFlag.pointee != 0,
-          let au = router.audioUnit,
-          let buffer = router.renderBuffer,
-          inNumberFrames <= router.renderBufferFrameCapacity else {
-        return noErr
-    }
-
-    let channels = router.captureChannels
-    let bytesPerFrame = channels * 4  // 32-bit float, captureChannels wide
-    let bytesNeeded = inNumberFrames * bytesPerFrame
-
-    // Point an AudioBufferList at our pre-allocated buffer
-    var bufferList = AudioBufferList(
-        mNumberBuffers: 1,
-        mBuffers: AudioBuffer(
-            mNumberChannels: channels,
-            mDataByteSize: bytesNeeded,
-            mData: UnsafeMutableRawPointer(buffer)
-        )
-    )
-
-    // Render input audio from the AUHAL into our buffer
-    let status = AudioUnitRender(au, ioActionFlags, inTimeStamp, 1, inNumberFrames, &bufferList)
-    guard status == noErr else {
-        // Log first render failure only (avoid spamming from real-time thread)
-        if router.renderErrorLogged == false {
-            router.renderErrorLogged = true
-            NSLog("[RightMic] AudioUnitRender failed: %d", status)
-        }
-        return status
-    }
-
-    // Write to ring buffer, converting sample rate if needed
-    if let converter = router.audioConverter,
-       let outBuffer = router.converterOutputBuffer {
-        // Set up converter input state (read by converterInputCallback)
-        router.converterInputPtr = UnsafePointer(buffer)
-        router.converterInputFramesLeft = inNumberFrames
-
-        var outputFrames = router.converterOutputCapacity
-
-        var outputBufferList = AudioBufferList(
-            mNumberBuffers: 1,
-            mBuffers: AudioBuffer(
-                mNumberChannels: channels,
-                mDataByteSize: outputFrames * bytesPerFrame,
-                mData: UnsafeMutableRawPointer(outBuffer)
-            )
-        )
-
-        let convStatus = AudioConverterFillComplexBuffer(
-            converter,
-            converterInputCallback,
-            inRefCon,
-            &outputFrames,
-            &outputBufferList,
-            nil
-        )
-
-        if convStatus == noErr || convStatus == 100 {
-            // Upmix mono to stereo before writing so the ring buffer always receives
-            // 2-channel interleaved audio regardless of the hardware channel count.
-            if router.captureChannels == 1 {
-                upmixMonoToStereo(buffer: outBuffer, frameCount: Int(outputFrames))
-            }
-            router.ringBufferWriter.write(frames: outBuffer, frameCount: Int(outputFrames))
-        }
-    } else {
-        // No conversion needed — write directly (with upmix for mono devices).
-        if router.captureChannels == 1 {
-            upmixMonoToStereo(buffer: buffer, frameCount: Int(inNumberFrames))
-        }
-        router.ringBufferWriter.write(frames: buffer, frameCount: Int(inNumberFrames))
-    }
-
-    return noErr
 }
 
-// MARK: - AudioConverter Input Callback
+// MARK: - Mute Property Listener Callback
 
-/// Called by AudioConverterFillComplexBuffer to pull input data for sample rate conversion.
-private func converterInputCallback(
-    inAudioConverter: AudioConverterRef,
-    ioNumberDataPackets: UnsafeMutablePointer<UInt32>,
-    ioData: UnsafeMutablePointer<AudioBufferList>,
-    outDataPacketDescription: UnsafeMutablePointer<UnsafeMutablePointer<AudioStreamPacketDescription>?>?,
-    inUserData: UnsafeMutableRawPointer?
+/// C-function callback invoked by CoreAudio when the selected real device's
+/// mute state changes.  Dispatches to the main queue to call syncMuteFromDevice.
+private func mutePropertyListenerProc(
+    objectID: AudioObjectID,
+    addressCount: UInt32,
+    addresses: UnsafePointer<AudioObjectPropertyAddress>,
+    clientData: UnsafeMutableRawPointer?
 ) -> OSStatus {
-    guard let inUserData else {
-        ioNumberDataPackets.pointee = 0
-        return -50 // paramErr
-    }
-
-    let router = Unmanaged<AudioRouter>.fromOpaque(inUserData).takeUnretainedValue()
-
-    let available = router.converterInputFramesLeft
-    if available == 0 {
-        ioNumberDataPackets.pointee = 0
-        return 100 // signal end of input data
+    guard let clientData else { return noErr }
+    let router = Unmanaged<AudioRouter>.fromOpaque(clientData).takeUnretainedValue()
+    DispatchQueue.main.async {
+        router.syncMuteFromDevice(deviceID: objectID)
     }
-
-    let toProvide = min(ioNumberDataPackets.pointee, available)
-    let channels = router.captureChannels
-    let bytesPerFrame = channels * 4  // 32-bit float, captureChannels wide
-
-    ioData.pointee.mNumberBuffers = 1
-    ioData.pointee.mBuffers.mNumberChannels = channels
-    ioData.pointee.mBuffers.mDataByteSize = toProvide * bytesPerFrame
-    ioData.pointee.mBuffers.mData = UnsafeMutableRawPointer(mutating: router.converterInputPtr!)
-
-    ioNumberDataPackets.pointee = toProvide
-    router.converterInputFramesLeft -= toProvide
-    router.converterInputPtr = router.converterInputPtr?.advanced(by: Int(toProvide * channels))
-
-    outDataPacketDescription?.pointee = nil
     return noErr
 }
 
-// MARK: - Mono to Stereo Upmix
+// MARK: - Demand Property Listener Callback
 
-/// Expands mono frames to stereo interleaved in-place by duplicating each sample.
-///
-/// The buffer must have capacity for at least `2 * frameCount` Float32 values.
-/// Works backwards through the array so source samples are never overwritten
-/// before they are read.
-private func upmixMonoToStereo(buffer: UnsafeMutablePointer<Float>, frameCount: Int) {
-    for i in stride(from: frameCount - 1, through: 0, by: -1) {
-        let sample = buffer[i]
-        buffer[i * 2 + 1] = sample  // R
-        buffer[i * 2]     = sample  // L
-    }
-}
-
-// MARK: - Mute Property Listener Callback
-
-/// C-function callback invoked by CoreAudio when the selected real device's
-/// mute state changes.  Dispatches to the main queue to call syncMuteFromDevice.
-private func mutePropertyListenerProc(
+/// C-function callback invoked by CoreAudio when a client starts or stops
+/// IO on the RightMic virtual device.  Dispatches to the main queue.
+private func demandPropertyListenerProc(
     objectID: AudioObjectID,
     addressCount: UInt32,
     addresses: UnsafePointer<AudioObjectPropertyAddress>,
@@ -764,7 +813,7 @@ private func mutePropertyListenerProc(
     guard let clientData else { return noErr }
     let router = Unmanaged<AudioRouter>.fromOpaque(clientData).takeUnretainedValue()
     DispatchQueue.main.async {
-        router.syncMuteFromDevice(deviceID: objectID)
+        router.updateDemand()
     }
     return noErr
 }
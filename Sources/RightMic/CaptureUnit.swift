@@ -0,0 +1,579 @@
+import AudioToolbox
+import CoreAudio
+import RightMicCore
+
+/// One AUHAL input unit capturing a real device into the shared ring buffer.
+///
+/// Normally the router runs a single unit.  During a device switch it runs
+/// two — the outgoing and the incoming device — and `RingBufferWriter`
+/// crossfades between them, so each unit writes as its own `source`.
+///
+/// A unit is prepared (created, configured, initialized) separately from
+/// being started, so the router can keep one warm for the standby device:
+/// the slow part of bringing up an AUHAL happens before it is needed.
+final class CaptureUnit {
+
+    // MARK: - State (fileprivate for callback access)
+
+    let deviceID: AudioDeviceID
+    let source: UInt32
+
+    fileprivate var audioUnit: AudioComponentInstance?
+    fileprivate let ringBufferWriter: RingBufferWriter
+    fileprivate var renderBuffer: UnsafeMutablePointer<Float>?
+    fileprivate let renderBufferFrameCapacity: UInt32 = 4096
+
+    /// Atomic flag checked by the real-time callback. Set to 0 before
+    /// tearing down the audio unit so the callback can bail out safely.
+    /// Allocated on the heap so the pointer is stable across moves.
+    fileprivate let captureActiveFlag: UnsafeMutablePointer<Int32> = {
+        let ptr = UnsafeMutablePointer<Int32>.allocate(capacity: 1)
+        ptr.initialize(to: 0)
+        return ptr
+    }()
+
+    // MARK: - Sample Rate Conversion
+
+    /// Converter for when the device rate differs from the ring's.  The
+    /// ring takes the first device's rate when the driver offers it, so
+    /// usually there is none and the callback is a copy.
+    fileprivate var resampler: Resampler?
+    /// Output frames per input frame of `resampler` (ring rate / device rate).
+    fileprivate var converterRatio: Double = 1.0
+    /// The device's nominal rate, which its timestamps count samples at.
+    fileprivate var captureRate: Double = 48000.0
+
+    /// Channels rendered from the device: its own count, at most the ring's
+    /// (1 = mono, 2 = stereo).  Set during configureAudioUnit before the
+    /// capture callback starts, as are the two below.
+    fileprivate var captureChannels: UInt32 = UInt32(RingBufferWriter.channelCount)
+    /// Samples per ring frame.
+    fileprivate var ringChannels: Int = RingBufferWriter.channelCount
+    /// A mono device feeding a stereo ring: duplicate each sample.  A mono
+    /// ring takes a mono device's samples as they are.
+    fileprivate var expandsMono: Bool = false
+    /// Output buffer for the sample rate converter (ring-rate data).
+    fileprivate var converterOutputBuffer: UnsafeMutablePointer<Float>?
+    fileprivate let converterOutputCapacity: UInt32 = 8192
+
+    /// Prevents spamming render error logs from the real-time thread.
+    fileprivate var renderErrorLogged: Bool = false
+
+    /// Level of the audio this unit captures, fed by the callback and read
+    /// by the router to notice a device that has gone dead silent.  It
+    /// sees ring-rate frames.
+    let level: LevelMeter
+
+    /// AUHAL exists and is initialized.
+    var isPrepared: Bool { audioUnit != nil }
+
+    /// AUHAL is started and its callback feeds the ring.
+    private(set) var isRunning: Bool = false
+
+    // MARK: - Lifecycle
+
+    init(deviceID: AudioDeviceID, source: UInt32, ringBufferWriter: RingBufferWriter) {
+        self.deviceID = deviceID
+        self.source = source
+        self.ringBufferWriter = ringBufferWriter
+        level = LevelMeter(sampleRate: Double(ringBufferWriter.sampleRate))
+        allocateRenderBuffer()
+        allocateConverterOutputBuffer()
+    }
+
+    deinit {
+        stop()
+        deallocateRenderBuffer()
+        deallocateConverterOutputBuffer()
+        captureActiveFlag.deinitialize(count: 1)
+        captureActiveFlag.deallocate()
+    }
+
+    // MARK: - Start / Stop
+
+    /// Create, configure and initialize the AUHAL without starting it.
+    /// Returns false if any step fails.  No-op if already prepared.
+    func prepare() -> Bool {
+        guard !isPrepared else { return true }
+        let t0 = CFAbsoluteTimeGetCurrent()
+        guard configureAudioUnit() else { return false }
+        NSLog("[RightMic] CaptureUnit %d: configureAudioUnit took %.3fs",
+              source, CFAbsoluteTimeGetCurrent() - t0)
+        return true
+    }
+
+    /// Start capturing, preparing first if needed.  Returns false if any
+    /// step fails.  No-op if already running.
+    func start() -> Bool {
+        guard !isRunning else { return true }
+        guard prepare(), let au = audioUnit else { return false }
+
+        renderErrorLogged = false
+        level.reset()
+        // Input held from before a pause is stale.
+        resampler?.reset()
+
+        // Mark capture active (checked by the real-time callback)
+        captureActiveFlag.pointee = 1
+        OSMemoryBarrier()
+
+        let t0 = CFAbsoluteTimeGetCurrent()
+        let status = AudioOutputUnitStart(au)
+        guard status == noErr else {
+            NSLog("[RightMic] AudioOutputUnitStart failed: \(status)")
+            captureActiveFlag.pointee = 0
+            OSMemoryBarrier()
+            return false
+        }
+        NSLog("[RightMic] CaptureUnit %d: AudioOutputUnitStart took %.3fs",
+              source, CFAbsoluteTimeGetCurrent() - t0)
+        isRunning = true
+        return true
+    }
+
+    /// Stop capturing but keep the AUHAL initialized, so `start()` is fast.
+    /// Once this returns the callback will not run again.
+    func pause() {
+        // Signal the real-time callback to stop before stopping the unit
+        captureActiveFlag.pointee = 0
+        OSMemoryBarrier()
+
+        if let au = audioUnit, isRunning {
+            let t1 = CFAbsoluteTimeGetCurrent()
+            AudioOutputUnitStop(au)
+            NSLog("[RightMic] CaptureUnit %d: AudioOutputUnitStop took %.3fs", source, CFAbsoluteTimeGetCurrent() - t1)
+        }
+        isRunning = false
+    }
+
+    /// Stop and dispose of the AUHAL.  Once this returns the callback will
+    /// not run again, so the unit no longer touches the ring.
+    func stop() {
+        pause()
+
+        if let au = audioUnit {
+            let t2 = CFAbsoluteTimeGetCurrent()
+            AudioUnitUninitialize(au)
+            NSLog("[RightMic] CaptureUnit %d: AudioUnitUninitialize took %.3fs", source, CFAbsoluteTimeGetCurrent() - t2)
+
+            let t3 = CFAbsoluteTimeGetCurrent()
+            AudioComponentInstanceDispose(au)
+            NSLog("[RightMic] CaptureUnit %d: AudioComponentInstanceDispose took %.3fs", source, CFAbsoluteTimeGetCurrent() - t3)
+
+            audioUnit = nil
+        }
+
+        resampler = nil
+    }
+
+    // MARK: - IO Buffer Size
+
+    /// Ring frames per callback last asked for with `matchBufferFrameSize`.
+    private(set) var matchedBufferFrames: Int?
+
+    /// Ask the device for callbacks of about `frames` frames at the ring's rate,
+    /// so the ring fills in bursts no larger than the driver's IO buffers
+    /// and the driver's default latency target covers them.  Clamped to
+    /// the range the device supports; the AUHAL applies it to this
+    /// process's IO on the device, running or not.
+    func matchBufferFrameSize(_ frames: Int) {
+        guard let au = audioUnit else { return }
+        matchedBufferFrames = frames
+
+        var requested = UInt32(clamping: Int((Double(frames) / converterRatio).rounded()))
+        var address = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyBufferFrameSizeRange,
+            mScope: kAudioObjectPropertyScopeGlobal,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        var range = AudioValueRange()
+        var size = UInt32(MemoryLayout<AudioValueRange>.size)
+        if AudioObjectGetPropertyData(deviceID, &address, 0, nil, &size, &range) == noErr {
+            requested = UInt32(min(max(Double(requested), range.mMinimum), range.mMaximum))
+        }
+
+        let status = AudioUnitSetProperty(
+            au, kAudioDevicePropertyBufferFrameSize,
+            kAudioUnitScope_Global, 0,
+            &requested, UInt32(MemoryLayout<UInt32>.size)
+        )
+        if status == noErr {
+            NSLog("[RightMic] CaptureUnit %d: buffer size %d frames (driver IO %d)",
+                  source, requested, frames)
+        } else {
+            NSLog("[RightMic] CaptureUnit %d: set buffer size %d failed: %d", source, requested, status)
+        }
+    }
+
+    // MARK: - AUHAL Configuration
+
+    private func configureAudioUnit() -> Bool {
+        // Find the HAL Output audio component
+        var desc = AudioComponentDescription(
+            componentType: kAudioUnitType_Output,
+            componentSubType: kAudioUnitSubType_HALOutput,
+            componentManufacturer: kAudioUnitManufacturer_Apple,
+            componentFlags: 0,
+            componentFlagsMask: 0
+        )
+        guard let component = AudioComponentFindNext(nil, &desc) else {
+            NSLog("[RightMic] HALOutput component not found")
+            return false
+        }
+
+        var au: AudioComponentInstance?
+        guard AudioComponentInstanceNew(component, &au) == noErr, let au else {
+            NSLog("[RightMic] Failed to create audio unit")
+            return false
+        }
+
+        // Enable input on bus 1
+        var enableIO: UInt32 = 1
+        var status = AudioUnitSetProperty(
+            au, kAudioOutputUnitProperty_EnableIO,
+            kAudioUnitScope_Input, 1,
+            &enableIO, UInt32(MemoryLayout<UInt32>.size)
+        )
+        guard status == noErr else {
+            NSLog("[RightMic] EnableIO input failed: \(status)")
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        // Disable output on bus 0
+        var disableIO: UInt32 = 0
+        status = AudioUnitSetProperty(
+            au, kAudioOutputUnitProperty_EnableIO,
+            kAudioUnitScope_Output, 0,
+            &disableIO, UInt32(MemoryLayout<UInt32>.size)
+        )
+        guard status == noErr else {
+            NSLog("[RightMic] EnableIO output failed: \(status)")
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        // Set the input device
+        var inputDevice = deviceID
+        status = AudioUnitSetProperty(
+            au, kAudioOutputUnitProperty_CurrentDevice,
+            kAudioUnitScope_Global, 0,
+            &inputDevice, UInt32(MemoryLayout<AudioDeviceID>.size)
+        )
+        guard status == noErr else {
+            NSLog("[RightMic] Set input device failed: \(status)")
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        // Query the device's native format on the input (hardware) side of bus 1
+        var deviceFormat = AudioStreamBasicDescription()
+        var formatSize = UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
+        let fmtStatus = AudioUnitGetProperty(
+            au, kAudioUnitProperty_StreamFormat,
+            kAudioUnitScope_Input, 1,
+            &deviceFormat, &formatSize
+        )
+        let captureRate: Float64
+        let captureChannels: UInt32
+        if fmtStatus == noErr && deviceFormat.mSampleRate > 0 {
+            captureRate = deviceFormat.mSampleRate
+            // Clamp to the ring's channel count (mono or stereo); a stereo
+            // device feeding a mono ring gives its first channel.
+            // Per Apple TN2091, AUHAL silences extra client channels that have no
+            // corresponding hardware channel, so we must match the hardware channel count
+            // to avoid getting a silent right channel from a mono microphone.
+            captureChannels = deviceFormat.mChannelsPerFrame >= 1
+                ? min(deviceFormat.mChannelsPerFrame, UInt32(ringBufferWriter.channels))
+                : UInt32(ringBufferWriter.channels)
+            NSLog("[RightMic] Device native format: %.0f Hz, %d ch, %d bits, flags=0x%X",
+                  deviceFormat.mSampleRate, deviceFormat.mChannelsPerFrame,
+                  deviceFormat.mBitsPerChannel, deviceFormat.mFormatFlags)
+        } else {
+            captureRate = 48000.0
+            captureChannels = UInt32(ringBufferWriter.channels)
+            NSLog("[RightMic] Could not query device format (status=%d), assuming 48kHz, %d ch",
+                  fmtStatus, captureChannels)
+        }
+        self.captureRate = captureRate
+        self.captureChannels = captureChannels
+        self.ringChannels = ringBufferWriter.channels
+        self.expandsMono = Int(captureChannels) < ringBufferWriter.channels
+        let captureBytesPerFrame = captureChannels * 4  // 32-bit float
+
+        // Set our desired format on the output (client) side of bus 1.
+        // Use the device's native sample rate and channel count to avoid -10863 errors
+        // with virtual devices and to prevent channel mismatches with mono hardware.
+        // Sample rate and mono→stereo expansion for a stereo ring are handled
+        // after rendering.
+        var format = AudioStreamBasicDescription(
+            mSampleRate: captureRate,
+            mFormatID: kAudioFormatLinearPCM,
+            mFormatFlags: kAudioFormatFlagIsFloat
+                        | kAudioFormatFlagsNativeEndian
+                        | kAudioFormatFlagIsPacked,
+            mBytesPerPacket: captureBytesPerFrame,
+            mFramesPerPacket: 1,
+            mBytesPerFrame: captureBytesPerFrame,
+            mChannelsPerFrame: captureChannels,
+            mBitsPerChannel: 32,
+            mReserved: 0
+        )
+        status = AudioUnitSetProperty(
+            au, kAudioUnitProperty_StreamFormat,
+            kAudioUnitScope_Output, 1,
+            &format, UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
+        )
+        guard status == noErr else {
+            NSLog("[RightMic] Set stream format failed: \(status)")
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        // Create sample rate converter if device rate differs from the ring's
+        resampler = nil
+        converterRatio = 1.0
+        let ringRate = Float64(ringBufferWriter.sampleRate)
+        if captureRate != ringRate {
+            let quality = Self.resamplerQuality
+            guard let converter = Resampler(inputRate: captureRate, outputRate: ringRate,
+                                            channels: Int(captureChannels), quality: quality) else {
+                NSLog("[RightMic] Failed to create sample rate converter (%.0f -> %.0f)",
+                      captureRate, ringRate)
+                AudioComponentInstanceDispose(au)
+                return false
+            }
+            resampler = converter
+            converterRatio = ringRate / captureRate
+            NSLog("[RightMic] Created sample rate converter: %.0f Hz -> %.0f Hz (%d ch, quality %d)",
+                  captureRate, ringRate, captureChannels, quality.rawValue)
+        }
+
+        // Set input callback (fires when new audio is available)
+        var callbackStruct = AURenderCallbackStruct(
+            inputProc: auInputCallback,
+            inputProcRefCon: Unmanaged.passUnretained(self).toOpaque()
+        )
+        status = AudioUnitSetProperty(
+            au, kAudioOutputUnitProperty_SetInputCallback,
+            kAudioUnitScope_Global, 0,
+            &callbackStruct, UInt32(MemoryLayout<AURenderCallbackStruct>.size)
+        )
+        guard status == noErr else {
+            NSLog("[RightMic] Set input callback failed: \(status)")
+            resampler = nil
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        // Initialize (started separately by start())
+        status = AudioUnitInitialize(au)
+        guard status == noErr else {
+            NSLog("[RightMic] AudioUnitInitialize failed: \(status)")
+            resampler = nil
+            AudioComponentInstanceDispose(au)
+            return false
+        }
+
+        audioUnit = au
+        return true
+    }
+
+    // MARK: - Sample Rate Conversion
+
+    /// Resampler tier for devices at a rate the ring doesn't take: 0 voice,
+    /// 1 balanced, 2 (the default) max.
+    private static var resamplerQuality: Resampler.Quality {
+        let key = "rightmic.resamplerQuality"
+        guard UserDefaults.standard.object(forKey: key) != nil else { return .max }
+        return Resampler.Quality(rawValue: UserDefaults.standard.integer(forKey: key)) ?? .max
+    }
+
+    /// The nominal sample rate `deviceID` runs at, or nil if unknown.
+    static func nominalSampleRate(_ deviceID: AudioDeviceID) -> Double? {
+        var address = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyNominalSampleRate,
+            mScope: kAudioObjectPropertyScopeGlobal,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        var rate: Float64 = 0
+        var size = UInt32(MemoryLayout<Float64>.size)
+        guard AudioObjectGetPropertyData(deviceID, &address, 0, nil, &size, &rate) == noErr,
+              rate > 0 else { return nil }
+        return rate
+    }
+
+    /// Input channels across all of `deviceID`'s input streams, or nil if
+    /// unknown.
+    static func inputChannelCount(_ deviceID: AudioDeviceID) -> Int? {
+        var address = AudioObjectPropertyAddress(
+            mSelector: kAudioDevicePropertyStreamConfiguration,
+            mScope: kAudioObjectPropertyScopeInput,
+            mElement: kAudioObjectPropertyElementMain
+        )
+        var size: UInt32 = 0
+        guard AudioObjectGetPropertyDataSize(deviceID, &address, 0, nil, &size) == noErr,
+              size > 0 else { return nil }
+
+        let bufferListRaw = UnsafeMutableRawPointer.allocate(
+            byteCount: Int(size),
+            alignment: MemoryLayout<AudioBufferList>.alignment
+        )
+        defer { bufferListRaw.deallocate() }
+
+        guard AudioObjectGetPropertyData(deviceID, &address, 0, nil, &size, bufferListRaw) == noErr else {
+            return nil
+        }
+        let buffers = UnsafeMutableAudioBufferListPointer(
+            bufferListRaw.assumingMemoryBound(to: AudioBufferList.self))
+        return buffers.reduce(0) { $0 + Int($1.mNumberChannels) }
+    }
+
+    // MARK: - Render Buffer
+
+    private func allocateRenderBuffer() {
+        let count = Int(renderBufferFrameCapacity) * RingBufferWriter.channelCount
+        renderBuffer = .allocate(capacity: count)
+        renderBuffer?.initialize(repeating: 0, count: count)
+    }
+
+    private func deallocateRenderBuffer() {
+        guard let buf = renderBuffer else { return }
+        let count = Int(renderBufferFrameCapacity) * RingBufferWriter.channelCount
+        buf.deinitialize(count: count)
+        buf.deallocate()
+        renderBuffer = nil
+    }
+
+    private func allocateConverterOutputBuffer() {
+        let count = Int(converterOutputCapacity) * RingBufferWriter.channelCount
+        converterOutputBuffer = .allocate(capacity: count)
+        converterOutputBuffer?.initialize(repeating: 0, count: count)
+    }
+
+    private func deallocateConverterOutputBuffer() {
+        guard let buf = converterOutputBuffer else { return }
+        let count = Int(converterOutputCapacity) * RingBufferWriter.channelCount
+        buf.deinitialize(count: count)
+        buf.deallocate()
+        converterOutputBuffer = nil
+    }
+}
+
+// MARK: - Audio Unit Callback
+
+/// C-function callback invoked by CoreAudio on the real-time audio thread
+/// when new input frames are available from the hardware device.
+private func auInputCallback(
+    inRefCon: UnsafeMutableRawPointer,
+    ioActionFlags: UnsafeMutablePointer<AudioUnitRenderActionFlags>,
+    inTimeStamp: UnsafePointer<AudioTimeStamp>,
+    inBusNumber: UInt32,
+    inNumberFrames: UInt32,
+    ioData: UnsafeMutablePointer<AudioBufferList>?
+) -> OSStatus {
+    let unit = Unmanaged<CaptureUnit>.fromOpaque(inRefCon).takeUnretainedValue()
+
+    // Bail out if capture is being torn down on the main thread
+    guard unit.captureActiveFlag.pointee != 0,
+          let au = unit.audioUnit,
+          let buffer = unit.renderBuffer,
+          inNumberFrames <= unit.renderBufferFrameCapacity else {
+        return noErr
+    }
+
+    let channels = unit.captureChannels
+    let bytesPerFrame = channels * 4  // 32-bit float, captureChannels wide
+    let bytesNeeded = inNumberFrames * bytesPerFrame
+    let writer = unit.ringBufferWriter
+    let startTicks = mach_absolute_time()
+    defer { writer.recordCallback(frameCount: Int(inNumberFrames), startTicks: startTicks) }
+
+    // Hand the device's clock to the driver, which runs RightMic's
+    // timestamps at the rate these show.
+    let timeStamp = inTimeStamp.pointee
+    if timeStamp.mFlags.contains(.sampleHostTimeValid) {
+        writer.publishTimestamp(sampleTime: timeStamp.mSampleTime, hostTime: timeStamp.mHostTime,
+                                sampleRate: unit.captureRate, clockID: unit.deviceID,
+                                source: unit.source)
+    }
+
+    // Without a converter, render straight into ring memory when the writer
+    // can hand it out (we own the ring and aren't crossfading).  The
+    // reservation is ring-frame sized, so a mono render into a stereo ring
+    // is expanded in place.
+    let direct = unit.resampler == nil
+        ? writer.reserve(frameCount: Int(inNumberFrames), source: unit.source)
+        : nil
+
+    // Point an AudioBufferList at the ring or our pre-allocated buffer
+    var bufferList = AudioBufferList(
+        mNumberBuffers: 1,
+        mBuffers: AudioBuffer(
+            mNumberChannels: channels,
+            mDataByteSize: bytesNeeded,
+            mData: UnsafeMutableRawPointer(direct ?? buffer)
+        )
+    )
+
+    // Render input audio from the AUHAL
+    let status = AudioUnitRender(au, ioActionFlags, inTimeStamp, 1, inNumberFrames, &bufferList)
+    guard status == noErr else {
+        // Give the reservation up; nothing was rendered into it.
+        if direct != nil {
+            writer.commit(frameCount: 0)
+        }
+        // Log first render failure only (avoid spamming from real-time thread)
+        if unit.renderErrorLogged == false {
+            unit.renderErrorLogged = true
+            NSLog("[RightMic] AudioUnitRender failed: %d", status)
+        }
+        return status
+    }
+
+    if let direct {
+        if unit.expandsMono {
+            RingBufferWriter.expandMonoToStereo(direct, frameCount: Int(inNumberFrames))
+        }
+        unit.level.feed(frames: direct, frameCount: Int(inNumberFrames), channels: unit.ringChannels)
+        writer.commit(frameCount: Int(inNumberFrames))
+        return noErr
+    }
+
+    // Write to ring buffer, converting sample rate if needed
+    if let resampler = unit.resampler,
+       let outBuffer = unit.converterOutputBuffer {
+        // The converter says exactly how much this input yields, so reserve
+        // that much of the ring and convert straight into it; fall back to
+        // our own buffer otherwise.
+        let expected = resampler.maxOutput(inputFrames: Int(inNumberFrames))
+        let convertDirect = writer.reserve(frameCount: expected, source: unit.source)
+        let convertTarget = convertDirect ?? outBuffer
+        let capacity = convertDirect != nil ? expected : Int(unit.converterOutputCapacity)
+
+        let outputFrames = resampler.process(input: buffer, frameCount: Int(inNumberFrames),
+                                             output: convertTarget, capacity: capacity)
+
+        // Expand mono to stereo before writing if the ring is stereo.
+        if unit.expandsMono {
+            RingBufferWriter.expandMonoToStereo(convertTarget, frameCount: outputFrames)
+        }
+        unit.level.feed(frames: convertTarget, frameCount: outputFrames,
+                        channels: unit.ringChannels)
+        if convertDirect != nil {
+            writer.commit(frameCount: outputFrames)
+        } else {
+            writer.write(frames: outBuffer, frameCount: outputFrames, source: unit.source)
+        }
+    } else {
+        // Ring not available in place (switching, or the span wraps) —
+        // hand the rendered frames to the writer (expanded for a stereo ring).
+        if unit.expandsMono {
+            RingBufferWriter.expandMonoToStereo(buffer, frameCount: Int(inNumberFrames))
+        }
+        unit.level.feed(frames: buffer, frameCount: Int(inNumberFrames), channels: unit.ringChannels)
+        writer.write(frames: buffer, frameCount: Int(inNumberFrames), source: unit.source)
+    }
+
+    return noErr
+}
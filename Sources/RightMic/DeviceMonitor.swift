@@ -27,9 +27,22 @@ final class DeviceMonitor: ObservableObject {
     /// The highest-priority enabled device that is currently connected.
     @Published var resolvedDevice: PriorityEntry?
 
+    /// The device routing would fail over to if `resolvedDevice` disappeared.
+    @Published var standbyDevice: PriorityEntry?
+
     /// A device the user has forced active, bypassing priority order.
     @Published var forcedDeviceUID: String?
 
+    /// Connected devices that went dead silent while routed (see
+    /// `AudioRouter`).  Passed over while any other device is available,
+    /// until they are unplugged or forced.
+    @Published private(set) var silentDeviceUIDs: Set<String> = []
+
+    /// Liveness scores from the last probe of each device (see
+    /// `DeviceProber`).  Devices scored dead are passed over like silent
+    /// ones; unprobed devices count as live.
+    @Published private(set) var livenessScores: [String: Double] = [:]
+
     // MARK: - Private
 
     private var configSaveCancellable: AnyCancellable?
@@ -61,16 +74,11 @@ final class DeviceMonitor: ObservableObject {
 
         // Resolve best device whenever devices, config, enabled state, or force override change
         resolveCancellable = Publishers.CombineLatest3($inputDevices, $priorityConfig, $isEnabled)
-            .combineLatest($forcedDeviceUID)
-            .map { combo, forcedUID -> PriorityEntry? in
+            .combineLatest($forcedDeviceUID, $silentDeviceUIDs, $livenessScores)
+            .map { combo, forcedUID, silentUIDs, scores -> (best: PriorityEntry?, standby: PriorityEntry?) in
                 let (devices, config, enabled) = combo
-                guard enabled else { return nil }
+                guard enabled else { return (nil, nil) }
                 let connectedUIDs = Set(devices.map(\.uid))
-                // If a device is forced and connected, use it directly
-                if let forcedUID, connectedUIDs.contains(forcedUID),
-                   let entry = config.entries.first(where: { $0.uid == forcedUID }) {
-                    return entry
-                }
                 // Filter out devices whose dependency is not connected
                 let connectedNames = Set(devices.map(\.name))
                 let depMissingUIDs = Set(config.entries.compactMap { entry -> String? in
@@ -78,11 +86,27 @@ final class DeviceMonitor: ObservableObject {
                     return entry.uid
                 })
                 let availableUIDs = connectedUIDs.subtracting(depMissingUIDs)
-                return config.bestDevice(availableUIDs: availableUIDs)
+                // A device that went silent while routed counts as dead
+                var liveness = scores
+                for uid in silentUIDs { liveness[uid] = 0 }
+                // If a device is forced and connected, use it directly
+                if let forcedUID, connectedUIDs.contains(forcedUID),
+                   let entry = config.entries.first(where: { $0.uid == forcedUID }) {
+                    return (entry, config.nextBestDevice(availableUIDs: availableUIDs, excludingUID: entry.uid,
+                                                         liveness: liveness))
+                }
+                let best = config.bestDevice(availableUIDs: availableUIDs, liveness: liveness)
+                return (best, config.nextBestDevice(availableUIDs: availableUIDs, excludingUID: best?.uid,
+                                                    liveness: liveness))
             }
-            .removeDuplicates { (a: PriorityEntry?, b: PriorityEntry?) in a?.uid == b?.uid }
-            .sink { [weak self] best in
+            .removeDuplicates { a, b in a.best?.uid == b.best?.uid && a.standby?.uid == b.standby?.uid }
+            .sink { [weak self] resolved in
                 guard let self else { return }
+                let best = resolved.best
+                if self.standbyDevice?.uid != resolved.standby?.uid {
+                    NSLog("[RightMic] Standby device changed: %@", resolved.standby?.name ?? "none")
+                }
+                self.standbyDevice = resolved.standby
                 if self.resolvedDevice?.uid != best?.uid {
                     if let best {
                         NSLog("[RightMic] Resolved device changed: \(best.name) (\(best.transportType.rawValue)) at %.3f", CFAbsoluteTimeGetCurrent())
@@ -133,6 +157,14 @@ final class DeviceMonitor: ObservableObject {
             guard let self else { return }
             self.inputDevices = devices
             self.defaultInputUID = defaultUID
+            // Unplugging a silent device clears it; it may come back working.
+            let connected = Set(devices.map(\.uid))
+            if !self.silentDeviceUIDs.isSubset(of: connected) {
+                self.silentDeviceUIDs.formIntersection(connected)
+            }
+            if !Set(self.livenessScores.keys).isSubset(of: connected) {
+                self.livenessScores = self.livenessScores.filter { connected.contains($0.key) }
+            }
             self.autoAddNewDevices()
         }
     }
@@ -175,9 +207,38 @@ final class DeviceMonitor: ObservableObject {
 
     /// Force a specific device active, bypassing priority order.
     func forceDevice(_ uid: String) {
+        silentDeviceUIDs.remove(uid)
         forcedDeviceUID = uid
     }
 
+    /// Pass over `uid` while other devices are available, because it has
+    /// been connected but dead silent.  Has no effect on a forced device.
+    func markSilent(_ uid: String) {
+        guard uid != forcedDeviceUID, !silentDeviceUIDs.contains(uid) else { return }
+        NSLog("[RightMic] Device went silent, failing over: %@", uid)
+        silentDeviceUIDs.insert(uid)
+    }
+
+    /// Record a probe's liveness `score` for `uid`.  A live score also
+    /// clears a silent mark: whatever silenced the device has passed.
+    func updateLiveness(_ uid: String, score: Double) {
+        if Liveness.isLive(score) && silentDeviceUIDs.contains(uid) {
+            NSLog("[RightMic] Device has signal again: %@", uid)
+            silentDeviceUIDs.remove(uid)
+        }
+        let wasLive = livenessScores[uid].map { Liveness.isLive($0) }
+        if wasLive != Liveness.isLive(score) {
+            NSLog("[RightMic] Device %@ probed %@ (score %.2f)", uid, Liveness.isLive(score) ? "live" : "dead", score)
+        }
+        livenessScores[uid] = score
+    }
+
+    /// Whether `uid` is being passed over for silence, seen while routed
+    /// or by a probe.
+    func isDeviceSilent(_ uid: String) -> Bool {
+        silentDeviceUIDs.contains(uid) || !Liveness.isLive(livenessScores[uid])
+    }
+
     /// Clear the forced device override.
     func unforceDevice() {
         forcedDeviceUID = nil
@@ -0,0 +1,163 @@
+import Combine
+import CoreAudio
+import Foundation
+import RightMicCore
+
+/// Periodically opens short captures on the devices routing could pick and
+/// publishes how live each one is to the monitor (see `Liveness`).
+///
+/// Each round probes the top few enabled, connected devices in priority
+/// order, other than the one being routed (the router watches that one
+/// itself), on a small pool of utility-QoS workers.  A probe runs the
+/// device for a quarter of a second through a plain IOProc — no AUHAL, no
+/// ring — and scores its level.  Rounds back off while nothing changes
+/// (`ProbeSchedule`), and the timer has generous leeway so the system can
+/// coalesce its wakeups.
+final class DeviceProber {
+
+    /// How long each probe captures.
+    private static let probeSeconds = 0.25
+
+    /// Probes running at once.
+    private static let maxConcurrentProbes = 2
+
+    private weak var monitor: DeviceMonitor?
+    private let probes: OperationQueue = {
+        let queue = OperationQueue()
+        queue.name = "com.rightmic.prober"
+        queue.maxConcurrentOperationCount = DeviceProber.maxConcurrentProbes
+        queue.qualityOfService = .utility
+        return queue
+    }()
+    private var schedule = ProbeSchedule()
+    private var timer: DispatchSourceTimer?
+    private var roundInFlight = false
+    private var cancellable: AnyCancellable?
+
+    /// Devices probed per round.  Unset selects 3; 0 turns probing off.
+    private var candidateLimit: Int {
+        let key = "rightmic.probeDevices"
+        guard UserDefaults.standard.object(forKey: key) != nil else { return 3 }
+        return max(0, UserDefaults.standard.integer(forKey: key))
+    }
+
+    // MARK: - Lifecycle
+
+    init(monitor: DeviceMonitor) {
+        self.monitor = monitor
+
+        // A different set of devices, or routing switched on: probe soon and
+        // at the minimum rate again.
+        cancellable = monitor.$inputDevices
+            .map { Set($0.map(\.uid)) }
+            .removeDuplicates()
+            .combineLatest(monitor.$isEnabled.removeDuplicates())
+            .debounce(for: .seconds(2), scheduler: DispatchQueue.main)
+            .sink { [weak self] _, enabled in
+                guard let self else { return }
+                self.schedule.reset()
+                if enabled {
+                    self.arm(after: 0)
+                } else {
+                    self.timer?.cancel()
+                    self.timer = nil
+                }
+            }
+    }
+
+    deinit {
+        timer?.cancel()
+        probes.cancelAllOperations()
+    }
+
+    // MARK: - Scheduling
+
+    private func arm(after delay: TimeInterval) {
+        timer?.cancel()
+        let source = DispatchSource.makeTimerSource(queue: .main)
+        source.schedule(deadline: .now() + delay, repeating: .never,
+                        leeway: .milliseconds(Int(max(delay, 1) * 100)))
+        source.setEventHandler { [weak self] in self?.runRound() }
+        timer = source
+        source.resume()
+    }
+
+    private func runRound() {
+        timer = nil
+        guard !roundInFlight, let monitor, monitor.isEnabled else { return }
+
+        let limit = candidateLimit
+        let devices = monitor.inputDevices
+        let candidates = limit > 0
+            ? monitor.priorityConfig.probeCandidates(
+                availableUIDs: Set(devices.map(\.uid)),
+                excludingUID: monitor.resolvedDevice?.uid,
+                limit: limit)
+            : []
+        guard !candidates.isEmpty else {
+            arm(after: schedule.completedRound(changed: false))
+            return
+        }
+
+        roundInFlight = true
+        var changed = false
+        let round = DispatchGroup()
+        for entry in candidates {
+            guard let deviceID = devices.first(where: { $0.uid == entry.uid })?.deviceID else { continue }
+            round.enter()
+            probes.addOperation { [weak self] in
+                let score = Self.probe(deviceID: deviceID)
+                DispatchQueue.main.async {
+                    defer { round.leave() }
+                    guard let score, let monitor = self?.monitor else { return }
+                    let before = monitor.livenessScores[entry.uid].map { Liveness.isLive($0) }
+                    if before != nil && before != Liveness.isLive(score) { changed = true }
+                    monitor.updateLiveness(entry.uid, score: score)
+                }
+            }
+        }
+        round.notify(queue: .main) { [weak self] in
+            guard let self else { return }
+            self.roundInFlight = false
+            guard self.timer == nil, self.monitor?.isEnabled == true else { return }
+            self.arm(after: self.schedule.completedRound(changed: changed))
+        }
+    }
+
+    // MARK: - Probe
+
+    /// Capture `probeSeconds` from `deviceID` and score it, or nil if the
+    /// device couldn't be started or delivered nothing.  Blocks the calling
+    /// (worker) thread for the length of the capture.
+    private static func probe(deviceID: AudioDeviceID) -> Double? {
+        let meter = LevelMeter(sampleRate: CaptureUnit.nominalSampleRate(deviceID) ?? 48000,
+                               window: probeSeconds / 4)
+        let ioQueue = DispatchQueue(label: "com.rightmic.prober.io", qos: .userInitiated)
+
+        // The HAL hands IOProcs 32-bit float in the stream's layout; every
+        // buffer (stream) feeds the same meter, so any live channel counts.
+        var procID: AudioDeviceIOProcID?
+        let status = AudioDeviceCreateIOProcIDWithBlock(&procID, deviceID, ioQueue) { _, input, _, _, _ in
+            let buffers = UnsafeMutableAudioBufferListPointer(UnsafeMutablePointer(mutating: input))
+            for buffer in buffers {
+                guard let data = buffer.mData, buffer.mNumberChannels > 0 else { continue }
+                let channels = Int(buffer.mNumberChannels)
+                meter.feed(frames: data.assumingMemoryBound(to: Float.self),
+                           frameCount: Int(buffer.mDataByteSize) / (4 * channels),
+                           channels: channels)
+            }
+        }
+        guard status == noErr, let procID else {
+            NSLog("[RightMic] Probe: AudioDeviceCreateIOProcID failed for %d: %d", deviceID, status)
+            return nil
+        }
+        defer { AudioDeviceDestroyIOProcID(deviceID, procID) }
+
+        guard AudioDeviceStart(deviceID, procID) == noErr else { return nil }
+        Thread.sleep(forTimeInterval: probeSeconds)
+        AudioDeviceStop(deviceID, procID)
+        ioQueue.sync {}  // let blocks already queued finish feeding
+
+        return Liveness.score(meter.reading)
+    }
+}
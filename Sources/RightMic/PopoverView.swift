@@ -62,7 +62,8 @@ struct PopoverView: View {
                             isActive: isActive,
                             isAvailable: isAvailable,
                             isLast: index == monitor.priorityConfig.entries.count - 1,
-                            dependencyName: depMissing ? monitor.dependencyName(for: entry.uid) : nil
+                            dependencyName: depMissing ? monitor.dependencyName(for: entry.uid) : nil,
+                            isSilent: monitor.isDeviceSilent(entry.uid)
                         )
                         .contextMenu {
                             Button(entry.enabled ? "Disable" : "Enable") {
@@ -115,6 +116,7 @@ struct PriorityDeviceRow: View {
     let isAvailable: Bool
     var isLast: Bool = false
     var dependencyName: String? = nil
+    var isSilent: Bool = false
 
     var body: some View {
         HStack(spacing: 8) {
@@ -147,6 +149,7 @@ struct PriorityDeviceRow: View {
         if !entry.enabled { return "Disabled" }
         if let depName = dependencyName { return "Needs \(depName)" }
         if !isAvailable { return "Disconnected" }
+        if isSilent { return "No signal" }
         return nil
     }
 
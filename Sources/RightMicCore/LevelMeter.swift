@@ -0,0 +1,57 @@
+import Foundation
+import CRightMic
+
+/// Input level and dead-silence tracking for one capture unit.
+///
+/// The capture callback feeds every block it writes; any other thread can
+/// read the current estimates at any time without locks (RightMicLevel.h).
+/// A device that is connected but delivering nothing — a hardware mute
+/// switch, a codec parked at a DC offset — shows up as a growing
+/// `silentSeconds`.
+public final class LevelMeter {
+
+    /// Heap-allocated so the audio thread never touches Swift stored
+    /// properties (no exclusivity checks on the real-time path).
+    private let meter: UnsafeMutablePointer<RightMicLevelMeter>
+    private let sampleRate: Double
+    private let window: Double
+
+    public struct Reading {
+        public var peak: Float           // decaying peak |sample|, 0–1
+        public var rms: Float            // RMS over the decaying window
+        public var dcOffset: Float       // mean over the decaying window
+        public var silentSeconds: Double // unbroken dead silence so far
+        public var seconds: Double       // audio analyzed since reset
+    }
+
+    /// `window` is the decaying window in seconds; shorten it to get a
+    /// settled reading from a brief capture.
+    public init(sampleRate: Double = 48000, window: Double = kRightMicLevel_DefaultWindow) {
+        self.sampleRate = sampleRate
+        self.window = window
+        meter = UnsafeMutablePointer<RightMicLevelMeter>.allocate(capacity: 1)
+        RightMicLevel_Init(meter, sampleRate, window)
+    }
+
+    deinit {
+        meter.deallocate()
+    }
+
+    /// Forget everything.  Only while the callback can't be feeding.
+    public func reset() {
+        RightMicLevel_Init(meter, sampleRate, window)
+    }
+
+    /// Analyze `frameCount` interleaved frames of `channels`.  Real-time safe.
+    public func feed(frames: UnsafePointer<Float>, frameCount: Int, channels: Int) {
+        RightMicLevel_Feed(meter, frames, UInt32(clamping: frameCount), UInt32(clamping: channels))
+    }
+
+    public var reading: Reading {
+        var r = RightMicLevelReading()
+        RightMicLevel_Read(meter, &r)
+        return Reading(peak: r.peak, rms: r.rms, dcOffset: r.dc,
+                       silentSeconds: Double(r.silentFrames) / sampleRate,
+                       seconds: Double(r.frames) / sampleRate)
+    }
+}
@@ -0,0 +1,65 @@
+import Foundation
+
+/// Whether a connected input device is actually picking anything up.
+///
+/// Priority order alone happily picks an audio interface with nothing
+/// plugged into its XLR input, or a MacBook's built-in mic with the lid
+/// closed.  A short probe capture tells them apart: a live mic in a quiet
+/// room still shows a noise floor around -70 dBFS, while a dead input is
+/// exact zeros or sits tens of dB lower.
+public enum Liveness {
+
+    /// Scores below this mark a device as dead.  Roughly -90 dBFS RMS.
+    public static let deadThreshold = 0.25
+
+    /// RMS levels mapped to scores 0 and 1.
+    static let floorDB = -100.0
+    static let liveDB = -60.0
+
+    /// Score in 0–1 for a probe capture, or nil if no audio arrived (the
+    /// device was slow to start: no evidence either way).  Dead silence
+    /// for the whole capture scores 0; otherwise the score rises with the
+    /// RMS level between `floorDB` and `liveDB`.
+    public static func score(_ reading: LevelMeter.Reading) -> Double? {
+        guard reading.seconds > 0 else { return nil }
+        if reading.silentSeconds >= reading.seconds { return 0 }
+        let db = 20 * log10(max(Double(reading.rms), 1e-10))
+        return min(1, max(0, (db - floorDB) / (liveDB - floorDB)))
+    }
+
+    /// Whether `score` counts as live.  An unprobed device (nil) does.
+    public static func isLive(_ score: Double?) -> Bool {
+        guard let score else { return true }
+        return score >= deadThreshold
+    }
+}
+
+/// When to run the next round of liveness probes.
+///
+/// A round that moves a device between live and dead is followed by
+/// another `minimumInterval` later.  Every round that changes nothing
+/// doubles the gap, up to `maximumInterval`, so a machine whose devices
+/// sit unchanged is barely woken; a new set of devices brings it back to
+/// the minimum.
+public struct ProbeSchedule {
+    public let minimumInterval: TimeInterval
+    public let maximumInterval: TimeInterval
+    public private(set) var interval: TimeInterval
+
+    public init(minimumInterval: TimeInterval = 15, maximumInterval: TimeInterval = 600) {
+        self.minimumInterval = minimumInterval
+        self.maximumInterval = maximumInterval
+        self.interval = minimumInterval
+    }
+
+    /// Record a finished round and return the delay before the next one.
+    public mutating func completedRound(changed: Bool) -> TimeInterval {
+        interval = changed ? minimumInterval : min(interval * 2, maximumInterval)
+        return interval
+    }
+
+    /// The devices changed: probe at the minimum rate again.
+    public mutating func reset() {
+        interval = minimumInterval
+    }
+}
@@ -78,8 +78,31 @@ public struct PriorityConfig: Codable, Equatable {
     // MARK: - Queries
 
     /// Returns the highest-priority enabled entry whose UID matches one of the available UIDs.
-    public func bestDevice(availableUIDs: Set<String>) -> PriorityEntry? {
-        entries.first { $0.enabled && availableUIDs.contains($0.uid) }
+    ///
+    /// Entries whose `liveness` score marks them dead (see `Liveness`) are passed over
+    /// unless no other entry is available; entries without a score count as live.
+    public func bestDevice(availableUIDs: Set<String>, liveness: [String: Double] = [:]) -> PriorityEntry? {
+        nextBestDevice(availableUIDs: availableUIDs, excludingUID: nil, liveness: liveness)
+    }
+
+    /// Returns the highest-priority enabled, available entry other than `excludingUID`:
+    /// the device routing would fall back to if that one disappeared.  Dead entries are
+    /// passed over as in `bestDevice`.
+    public func nextBestDevice(availableUIDs: Set<String>, excludingUID: String?,
+                               liveness: [String: Double] = [:]) -> PriorityEntry? {
+        let candidates = entries.filter { $0.enabled && availableUIDs.contains($0.uid) && $0.uid != excludingUID }
+        return candidates.first { Liveness.isLive(liveness[$0.uid]) } ?? candidates.first
+    }
+
+    /// The first `limit` enabled, available entries other than `excludingUID`, in priority
+    /// order: the devices whose liveness could change what routing picks.  Bluetooth
+    /// devices are left out, because opening a headset's mic switches it to its
+    /// lower-quality headset profile.
+    public func probeCandidates(availableUIDs: Set<String>, excludingUID: String?, limit: Int) -> [PriorityEntry] {
+        Array(entries.lazy
+            .filter { $0.enabled && availableUIDs.contains($0.uid) && $0.uid != excludingUID }
+            .filter { $0.transportType != .bluetooth }
+            .prefix(max(0, limit)))
     }
 
     // MARK: - Reconciliation
@@ -0,0 +1,82 @@
+import Foundation
+import CRightMic
+
+/// Sample rate converter for a capture device that runs at a rate the ring
+/// doesn't take (RightMicResampler.h).
+///
+/// Everything it needs is allocated here, up front; `process` never
+/// allocates or locks, and costs the same per frame every call, so the
+/// capture callback can run it in place of an AudioConverter.
+public final class Resampler {
+
+    /// Filter length against passband width and stopband depth.
+    public enum Quality: Int {
+        case voice    = 0  // 16 taps, ~60 dB
+        case balanced = 1  // 32 taps, ~80 dB
+        case max      = 2  // 64 taps, ~100 dB
+    }
+
+    /// The C macro for this is an expression Swift doesn't import.
+    private static let storageFloats =
+        Int((kRightMicResampler_MaxPhases + 1) * kRightMicResampler_MaxTaps +
+            kRightMicResampler_MaxChannels * (kRightMicResampler_MaxTaps + kRightMicResampler_LineFrames))
+
+    /// Heap-allocated so the audio thread never touches Swift stored
+    /// properties (no exclusivity checks on the real-time path).
+    private let state: UnsafeMutablePointer<RightMicResampler>
+    private let storage: UnsafeMutablePointer<Float>
+
+    public let inputRate: Double
+    public let outputRate: Double
+    public let channels: Int
+
+    /// Nil for a rate that isn't a positive whole number, a ratio beyond
+    /// 8:1 either way or a channel count other than 1 or 2.
+    public init?(inputRate: Double, outputRate: Double, channels: Int, quality: Quality) {
+        guard inputRate >= 1, outputRate >= 1,
+              inputRate == inputRate.rounded(), outputRate == outputRate.rounded(),
+              inputRate <= Double(UInt32.max), outputRate <= Double(UInt32.max) else { return nil }
+        self.inputRate = inputRate
+        self.outputRate = outputRate
+        self.channels = channels
+        state = .allocate(capacity: 1)
+        storage = .allocate(capacity: Self.storageFloats)
+        guard RightMicResampler_Init(state, storage, UInt32(inputRate), UInt32(outputRate),
+                                     UInt32(clamping: channels),
+                                     RightMicResamplerQuality(rawValue: UInt32(quality.rawValue))) else {
+            state.deallocate()
+            storage.deallocate()
+            return nil
+        }
+    }
+
+    deinit {
+        state.deallocate()
+        storage.deallocate()
+    }
+
+    /// Forget buffered input.  Only while the callback can't be converting.
+    public func reset() {
+        RightMicResampler_Reset(state)
+    }
+
+    /// Consume input `drift` faster (positive) or slower than the nominal
+    /// ratio, e.g. 0.0005 for a clock 500 ppm fast.  Real-time safe.
+    public func setDrift(_ drift: Double) {
+        RightMicResampler_SetDrift(state, drift)
+    }
+
+    /// Most frames `inputFrames` more input can produce.  Real-time safe.
+    public func maxOutput(inputFrames: Int) -> Int {
+        Int(RightMicResampler_MaxOutput(state, UInt32(clamping: inputFrames)))
+    }
+
+    /// Convert `frameCount` interleaved frames into `output`, which holds
+    /// `capacity` frames, and return the frames produced.  With capacity
+    /// for `maxOutput(inputFrames:)` all input is used.  Real-time safe.
+    public func process(input: UnsafePointer<Float>, frameCount: Int,
+                        output: UnsafeMutablePointer<Float>, capacity: Int) -> Int {
+        Int(RightMicResampler_Process(state, input, UInt32(clamping: frameCount),
+                                      output, UInt32(clamping: capacity), nil))
+    }
+}
@@ -1,10 +1,15 @@
 import Foundation
+import CRightMic
 
 /// Manages the app-side of the shared memory ring buffer that feeds
 /// audio data to the RightMic HAL driver.
 ///
-/// The driver (running in coreaudiod) opens the same file as read-only
-/// and serves the audio to any app that selects "RightMic" as its input.
+/// The ring lives in a named POSIX shared memory object, so the pages the
+/// capture callback dirties are never written back to disk; if that
+/// can't be created it falls back to a file under /tmp (RightMicShm.h).
+/// The driver (running in coreaudiod) opens the same object or file
+/// read-only and serves the audio to any app that selects "RightMic" as
+/// its input.
 ///
 /// Usage (Phase 5 will call this from the audio capture callback):
 ///
@@ -17,38 +22,174 @@ public final class RingBufferWriter {
 
     // MARK: - Constants (must match RightMicDriver.h)
 
+    public static let sharedMemoryName = kRightMic_SharedMemoryName
     public static let sharedMemoryPath = "/tmp/com.rightmic.audio"
-    public static let ringBufferFrames: Int = 16384
+    /// Ring capacity when `open` isn't asked for another.
+    public static let defaultRingFrames = Int(kRightMic_RingBufferFrames)
+    /// Channels the driver's stream has, and the widest ring frame.
     public static let channelCount: Int = 2
     public static let bytesPerFrame: Int = channelCount * MemoryLayout<Float32>.size
-    public static let headerSize: Int = 64   // sizeof(RightMicRingBufferHeader)
-    public static let dataSize: Int = ringBufferFrames * bytesPerFrame
+    public static let headerSize: Int = 256  // sizeof(RightMicRingBufferHeader), four cache lines
     public static let controlTableSize: Int = 128  // sizeof(RightMicControlTable)
-    public static let totalSize: Int = headerSize + dataSize + controlTableSize
+    /// Paged layout: control table in the header page, audio data on its own
+    /// page-aligned pages at the end so it can be mirrored (RightMicMirror.h).
+    public static let controlTableOffset: Int = Int(kRightMic_PagedControlTableOffset)
+    /// Producer half of the glitch statistics, on its own lines in the header page.
+    public static let metricsOffset: Int = Int(kRightMic_PagedMetricsOffset)
+    /// Capture timestamps the driver runs its clock by, after the metrics.
+    public static let clockOffset: Int = Int(kRightMic_PagedClockOffset)
+    /// Consumer half, in an object (or file) the driver creates; it maps
+    /// ours read-only.
+    public static let driverMetricsName = kRightMic_DriverMetricsName
+    public static let driverMetricsPath = kRightMic_DriverMetricsPath
+    public static let dataOffset: Int = Int(kRightMic_PagedDataOffset)
+
+    /// Capacity `open` gives a ring asked for `frames` (0 = the default):
+    /// a power of two the driver accepts.
+    public static func ringFrames(forRequested frames: Int) -> Int {
+        Int(RightMicRing_ClampFrames(UInt32(clamping: max(frames, 0))))
+    }
+
+    /// Bytes per frame of a ring of `channels` (1, otherwise stereo).
+    public static func frameBytes(channels: Int) -> Int {
+        (channels == 1 ? 1 : channelCount) * MemoryLayout<Float32>.size
+    }
+
+    /// Bytes the frames of a ring of `ringFrames` take, the audio data
+    /// region holding them (rounded up to whole pages, as
+    /// kRightMic_RingDataBytesFor), and the whole region.
+    public static func ringBytes(ringFrames: Int, channels: Int = channelCount) -> Int {
+        ringFrames * frameBytes(channels: channels)
+    }
+    public static func dataSize(ringFrames: Int, channels: Int = channelCount) -> Int {
+        (ringBytes(ringFrames: ringFrames, channels: channels) + dataOffset - 1) / dataOffset * dataOffset
+    }
+    public static func totalSize(ringFrames: Int, channels: Int = channelCount) -> Int {
+        dataOffset + dataSize(ringFrames: ringFrames, channels: channels)
+    }
+
+    /// Size the shared memory object is created at: room for the largest
+    /// ring, so reopening with any other keeps the object a driver maps.
+    /// Only the pages of the ring in use are ever touched.
+    public static let sharedMemoryObjectSize = totalSize(ringFrames: Int(kRightMic_MaxRingFrames))
+
+    /// Frames the driver keeps buffered when the app asks for its default,
+    /// at its default IO buffer size.
+    public static let defaultTargetLatencyFrames = targetLatencyFrames(
+        requested: 0, ioBufferFrames: Int(kRightMic_BufferFrameSize))
+
+    /// Frames the driver keeps buffered for a `requested` target (0 = its
+    /// default) while clients read `ioBufferFrames` per cycle from a ring
+    /// of `ringFrames`: the same clamping the driver applies.
+    public static func targetLatencyFrames(requested: Int, ioBufferFrames: Int,
+                                           ringFrames: Int = defaultRingFrames) -> Int {
+        var target = UInt32(clamping: requested)
+        var minSafe: UInt32 = 0
+        RightMicDrift_ClampWatermarks(&target, &minSafe, UInt32(clamping: ioBufferFrames),
+                                      UInt32(clamping: ringFrames))
+        return Int(target)
+    }
+
+    /// Ring sample rate when the capture device's own isn't one the driver
+    /// offers.
+    public static let defaultSampleRate = Int(kRightMic_SampleRate)
+
+    /// Whether the driver can serve a ring written at `rate` Hz (it
+    /// converts to whatever rate its clients run at).
+    public static func isSupportedSampleRate(_ rate: Double) -> Bool {
+        rate == rate.rounded() && rate > 0 && rate <= Double(UInt32.max)
+            && RightMicRing_IsSupportedRate(UInt32(rate))
+    }
+
+    /// Crossfade length used for device switches unless configured otherwise.
+    public static let defaultSwitchFadeFrames = Int(kRightMicSwitch_DefaultFadeFrames)
 
     // MARK: - State
 
     public let path: String
+    /// Shared memory object tried before `path`, or nil for the file only.
+    public let sharedMemoryName: String?
     private var fd: Int32 = -1
+    private var mapping = RightMicMirror()
     private var mappedPtr: UnsafeMutableRawPointer?
     private var header: UnsafeMutablePointer<RingBufferHeader>?
     private var audioData: UnsafeMutablePointer<Float>?
     private var controlTable: UnsafeMutablePointer<ControlTable>?
 
+    /// C view of the mapping used by the producer protocol in RightMicRing.c.
+    /// Heap-allocated so the audio thread can use it without touching `self`'s
+    /// stored properties (avoids Swift exclusivity checks on the RT path).
+    private let ring: UnsafeMutablePointer<RightMicRing>
+
+    /// Crossfade stage used while two capture units overlap during a device
+    /// switch (RightMicSwitch.c).  Heap-allocated for the same reason as `ring`.
+    private let switcher: UnsafeMutablePointer<RightMicSwitch>
+    private let switchStage: UnsafeMutablePointer<Float>
+
+    /// mach_absolute_time ticks to nanoseconds, for callback timing.
+    private let nanosPerTick: Double
+
+    /// Read-only view of the driver's metrics, mapped on first use.
+    private var driverMetrics: UnsafePointer<RightMicConsumerMetrics>?
+
+    /// Target latency last requested through `setLatency` (0 = default).
+    private var requestedTargetFrames = 0
+
     public var isOpen: Bool { mappedPtr != nil }
 
+    /// Whether the open ring is the shared memory object rather than the
+    /// fallback file.
+    public private(set) var isSharedMemoryObject = false
+
+    /// Rate the ring carries audio at, fixed from `open` until `close`.
+    /// Capture units convert to it when their device runs at another.
+    public private(set) var sampleRate: Int = RingBufferWriter.defaultSampleRate
+
+    /// Samples per ring frame (1 or `channelCount`), fixed from `open`
+    /// until `close`.  A mono ring carries a mono mic's samples once; the
+    /// driver duplicates them into its stereo stream as it reads.
+    public private(set) var channels: Int = RingBufferWriter.channelCount
+
+    /// Ring capacity in frames, fixed from `open` until the next `open`.
+    /// The driver reads it from the header and maps as much as it says.
+    public private(set) var ringFrames: Int = RingBufferWriter.defaultRingFrames
+
+    /// The same sizes at `ringFrames` and `channels`.
+    public var ringBytes: Int { Self.ringBytes(ringFrames: ringFrames, channels: channels) }
+    public var dataSize: Int { Self.dataSize(ringFrames: ringFrames, channels: channels) }
+    public var totalSize: Int { Self.totalSize(ringFrames: ringFrames, channels: channels) }
+
     // MARK: - Shared Memory Layout (matches RightMicDriver.h)
 
     /// Mirror of `RightMicRingBufferHeader` from the driver.
-    /// Uses the same memory layout so the driver and app share state.
+    /// Uses the same memory layout so the driver and app share state:
+    /// one 64-byte cache line each for layout, producer, consumer and control.
     struct RingBufferHeader {
-        var writeHead:  UInt64
-        var readHead:   UInt64
-        var active:     UInt32
+        // Layout (written once by RightMicRing_InitProducer)
+        var magic:      UInt32   // kRightMic_RingMagic
+        var version:    UInt32   // kRightMic_RingVersion
+        var headerSize: UInt32
+        var dataOffset: UInt32   // byte offset of audio data
+        var ringFrames: UInt32
         var sampleRate: UInt32
         var channels:   UInt32
-        var muted:      UInt32   // 1 = app-side mute override (was _pad[0])
-        var _pad: (UInt32, UInt32, UInt32, UInt32, UInt32, UInt32, UInt32, UInt32)  // 8 × UInt32 → total 64 bytes
+        var frameBytes: UInt32   // kRightMic_FrameBytesFor(channels)
+        var _pad0: (UInt32, UInt32, UInt32, UInt32, UInt32, UInt32, UInt32, UInt32)
+        // Producer
+        var writeHead:  UInt64
+        var writeClaim: UInt64   // end of the frames being written
+        var active:     UInt32
+        var _pad1: (UInt32, UInt32, UInt32, UInt32, UInt32, UInt32, UInt32,
+                    UInt32, UInt32, UInt32, UInt32)
+        // Consumer
+        var readHead:   UInt64
+        var _pad2: (UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64)
+        // Control
+        var muted:          UInt32   // 1 = app-side mute override
+        var targetLatency:  UInt32   // frames the driver keeps buffered; 0 = default
+        var minSafeLatency: UInt32   // driver refills below this fill; 0 = default
+        var concealMode:    UInt32   // Concealment raw value; 0 = default
+        var _pad3: (UInt64, UInt64, UInt64, UInt64, UInt64, UInt64)
     }
 
     /// One proxied control entry.  Mirrors `RightMicControlEntry` in the driver.
@@ -87,28 +228,157 @@ public final class RingBufferWriter {
 
     // MARK: - Lifecycle
 
-    public init(path: String = RingBufferWriter.sharedMemoryPath) {
+    public init(path: String = RingBufferWriter.sharedMemoryPath,
+                sharedMemoryName: String? = RingBufferWriter.sharedMemoryName) {
         self.path = path
+        self.sharedMemoryName = sharedMemoryName
+        self.ring = UnsafeMutablePointer<RightMicRing>.allocate(capacity: 1)
+        RightMicRing_Detach(ring)
+        let stageCount = Int(kRightMicSwitch_StageFrames) * Self.channelCount
+        self.switchStage = UnsafeMutablePointer<Float>.allocate(capacity: stageCount)
+        switchStage.initialize(repeating: 0, count: stageCount)
+        self.switcher = UnsafeMutablePointer<RightMicSwitch>.allocate(capacity: 1)
+        RightMicSwitch_Init(switcher, switchStage, 0)
+        var timebase = mach_timebase_info_data_t()
+        mach_timebase_info(&timebase)
+        self.nanosPerTick = Double(timebase.numer) / Double(timebase.denom)
     }
 
     deinit {
         close()
+        if let view = driverMetrics {
+            munmap(UnsafeMutableRawPointer(mutating: view), MemoryLayout<RightMicConsumerMetrics>.size)
+        }
+        ring.deallocate()
+        switcher.deallocate()
+        switchStage.deallocate()
     }
 
     // MARK: - Open / Close
 
-    /// Create and map the shared file for IPC with the driver.
-    public func open() throws {
+    /// Create and map the shared file for IPC with the driver, carrying
+    /// audio at `sampleRate` Hz (the default if the driver doesn't offer it)
+    /// in frames of `channels` samples (1 for mono, otherwise stereo), in a
+    /// ring of `ringFrames` (0 = the default; see `ringFrames(forRequested:)`).
+    public func open(sampleRate: Int = RingBufferWriter.defaultSampleRate,
+                     channels: Int = RingBufferWriter.channelCount,
+                     ringFrames: Int = 0) throws {
         guard !isOpen else { return }
         assert(MemoryLayout<RingBufferHeader>.size == Self.headerSize,
                "RingBufferHeader size mismatch with headerSize constant")
         assert(MemoryLayout<ControlTable>.size == Self.controlTableSize,
                "ControlTable size mismatch with controlTableSize constant")
 
-        // Create the backing file. O_NOFOLLOW prevents symlink attacks.
+        self.ringFrames = Self.ringFrames(forRequested: ringFrames)
+        self.channels = channels == 1 ? 1 : Self.channelCount
+
+        // The shared memory object if we may create one.  A file left by
+        // an earlier fallback stays, since a driver may still map it, but
+        // with its header zeroed it no longer describes a ring.
+        if let name = sharedMemoryName,
+           case let shm = RightMicShm_Create(name, Self.sharedMemoryObjectSize), shm >= 0 {
+            fd = shm
+            isSharedMemoryObject = true
+            Self.zeroStaleFile(at: path, bytes: Self.dataOffset)
+        } else {
+            fd = try openFile()
+            isSharedMemoryObject = false
+        }
+
+        // Map into our address space, with the ring mapped a second time
+        // right behind itself if the kernel allows and it fills its pages
+        // (single copies at the wrap); otherwise a plain mapping.
+        guard RightMicMirror_Map(&mapping, fd, totalSize, Self.dataOffset, ringBytes, true),
+              let ptr = UnsafeMutableRawPointer(mapping.base) else {
+            let e = errno
+            Darwin.close(fd)
+            fd = -1
+            throw RingBufferError.mmapFailed(errno: e)
+        }
+
+        // Take every first-touch page fault here rather than in the capture
+        // callback, and keep the pages wired if the system allows it.
+        let residency = RightMicMirror_Prefault(&mapping)
+
+        mappedPtr = ptr
+        header = ptr.assumingMemoryBound(to: RingBufferHeader.self)
+        audioData = ptr.advanced(by: Self.dataOffset).assumingMemoryBound(to: Float.self)
+        controlTable = ptr.advanced(by: Self.controlTableOffset)
+                          .assumingMemoryBound(to: ControlTable.self)
+
+        // Initialize header (publishes the geometry the driver maps by)
+        RightMicRing_AttachAt(ring, ptr, UInt32(Self.dataOffset), UInt32(self.ringFrames),
+                              UInt32(self.channels), mapping.mirrored)
+        self.sampleRate = Self.isSupportedSampleRate(Double(sampleRate)) ? sampleRate : Self.defaultSampleRate
+        RightMicRing_InitProducer(ring, UInt32(self.sampleRate), UInt32(self.channels))
+        let producerMetrics = ptr.advanced(by: Self.metricsOffset)
+                                 .assumingMemoryBound(to: RightMicProducerMetrics.self)
+        RightMicMetrics_InitProducer(producerMetrics)
+        RightMicMetrics_SetProducerResidency(producerMetrics, residency)
+        RightMicClock_InitProducer(ptr.advanced(by: Self.clockOffset)
+                                      .assumingMemoryBound(to: RightMicClockTable.self))
+        RightMicSwitch_Init(switcher, switchStage, 0)
+
+        // Initialize control table
+        controlTable!.pointee.version = 0
+        controlTable!.pointee.count = 0
+
+        setActive(true)
+
+        NSLog("[RightMic] Ring buffer opened (size: \(totalSize) bytes, \(self.ringFrames) frames, %@, %@, %@, %d Hz, %d ch)",
+              isSharedMemoryObject ? sharedMemoryName ?? "" : path,
+              mapping.mirrored ? "mirrored" : "single mapping",
+              residency == kRightMicResidency_Wired ? "wired" : "prefaulted, not wired",
+              self.sampleRate, self.channels)
+    }
+
+    /// Zero the first `bytes` (by default all) of a ring left in the file
+    /// at `path`, if there is one and it is ours; returns whether there
+    /// was.  The file itself stays: a driver still mapping it sees the
+    /// zeros, where a new inode would leave it reading the old one.
+    @discardableResult
+    public static func zeroStaleFile(at path: String, bytes: Int = .max) -> Bool {
+        let fd = Darwin.open(path, O_RDWR | O_NOFOLLOW)
+        guard fd >= 0 else { return false }
+        defer { Darwin.close(fd) }
+        var st = stat()
+        guard fstat(fd, &st) == 0, (st.st_mode & S_IFMT) == S_IFREG, st.st_uid == getuid() else {
+            return false
+        }
+        zero(fd: fd, size: Int(st.st_size), bytes: bytes)
+        return true
+    }
+
+    /// The same for a shared memory object left under `name`.
+    @discardableResult
+    public static func zeroStaleSharedMemory(named name: String, bytes: Int = .max) -> Bool {
+        var size = 0
+        let fd = RightMicShm_OpenOwned(name, &size)
+        guard fd >= 0 else { return false }
+        defer { Darwin.close(fd) }
+        zero(fd: fd, size: size, bytes: bytes)
+        return true
+    }
+
+    /// Zero through a mapping, which shm objects need.  Nothing needs
+    /// flushing: the driver maps the same pages, and the file's contents
+    /// are never read back from disk.
+    private static func zero(fd: Int32, size: Int, bytes: Int) {
+        let length = min(size, bytes)
+        guard length > 0 else { return }
+        let ptr = mmap(nil, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        if ptr != MAP_FAILED {
+            memset(ptr, 0, length)
+            munmap(ptr, length)
+        }
+    }
+
+    /// Create, validate and size the fallback file, returning its descriptor.
+    private func openFile() throws -> Int32 {
+        // O_NOFOLLOW prevents symlink attacks.
         // Permissions: owner read-write, others read-only (0644).
         // The HAL driver runs as _coreaudiod and needs read access.
-        fd = Darwin.open(path, O_CREAT | O_RDWR | O_NOFOLLOW, 0o644)
+        let fd = Darwin.open(path, O_CREAT | O_RDWR | O_NOFOLLOW, 0o644)
         guard fd >= 0 else {
             throw RingBufferError.openFailed(errno: errno)
         }
@@ -122,71 +392,44 @@ public final class RingBufferWriter {
         guard fstat(fd, &st) == 0 else {
             let e = errno
             Darwin.close(fd)
-            fd = -1
             throw RingBufferError.fstatFailed(errno: e)
         }
         guard (st.st_mode & S_IFMT) == S_IFREG else {
             Darwin.close(fd)
-            fd = -1
             throw RingBufferError.notRegularFile
         }
         guard st.st_uid == getuid() else {
             Darwin.close(fd)
-            fd = -1
             throw RingBufferError.ownerMismatch
         }
 
-        // Set size
-        guard ftruncate(fd, off_t(Self.totalSize)) == 0 else {
-            Darwin.close(fd)
-            fd = -1
-            throw RingBufferError.ftruncateFailed(errno: errno)
-        }
-
-        // Map into our address space
-        let ptr = mmap(nil, Self.totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
-        guard ptr != MAP_FAILED else {
+        // Grow it to fit, but never shrink it: a driver still mapping the
+        // previous, larger ring would fault on the pages cut off.  It
+        // remaps by the header.
+        guard st.st_size >= off_t(totalSize) || ftruncate(fd, off_t(totalSize)) == 0 else {
+            let e = errno
             Darwin.close(fd)
-            fd = -1
-            throw RingBufferError.mmapFailed(errno: errno)
+            throw RingBufferError.ftruncateFailed(errno: e)
         }
-
-        mappedPtr = ptr
-        header = ptr!.assumingMemoryBound(to: RingBufferHeader.self)
-        audioData = ptr!.advanced(by: Self.headerSize).assumingMemoryBound(to: Float.self)
-        controlTable = ptr!.advanced(by: Self.headerSize + Self.dataSize)
-                           .assumingMemoryBound(to: ControlTable.self)
-
-        // Initialize header
-        header!.pointee.writeHead = 0
-        header!.pointee.readHead = 0
-        header!.pointee.sampleRate = UInt32(48000)
-        header!.pointee.channels = UInt32(Self.channelCount)
-        header!.pointee.muted = 0
-
-        // Initialize control table
-        controlTable!.pointee.version = 0
-        controlTable!.pointee.count = 0
-
-        setActive(true)
-
-        NSLog("[RightMic] Ring buffer opened (size: \(Self.totalSize) bytes)")
+        return fd
     }
 
-    /// Unmap and close the shared file.
+    /// Unmap and close the shared memory.
     public func close() {
         if header != nil {
             setActive(false)
         }
 
         if let ptr = mappedPtr {
-            // Zero all audio data to prevent residual leakage
-            memset(ptr, 0, Self.totalSize)
-            msync(ptr, Self.totalSize, MS_SYNC)
-            munmap(ptr, Self.totalSize)
+            // Zero all audio data to prevent residual leakage.  Nothing
+            // needs flushing: the driver maps the same pages, and the
+            // fallback file's contents are never read back from disk.
+            memset(ptr, 0, totalSize)
+            RightMicMirror_Unmap(&mapping)
             mappedPtr = nil
         }
 
+        RightMicRing_Detach(ring)
         header = nil
         audioData = nil
         controlTable = nil
@@ -197,56 +440,283 @@ public final class RingBufferWriter {
         }
     }
 
-    /// Remove the shared file from disk.
+    /// Remove the shared memory object and the file.
     /// Call this when the app exits to clean up.
     public func unlink() {
+        if let name = sharedMemoryName {
+            RightMicShm_Unlink(name)
+        }
         Darwin.unlink(path)
     }
 
     // MARK: - Write
 
-    /// Write interleaved Float32 audio frames to the ring buffer.
+    /// Write Float32 audio frames to the ring buffer.
     /// Called from the audio capture callback (real-time safe path).
     ///
     /// - Parameters:
-    ///   - frames: Pointer to interleaved Float32 samples
+    ///   - frames: Pointer to frames of `channels` interleaved samples
     ///   - frameCount: Number of frames to write
     public func write(frames: UnsafePointer<Float>, frameCount: Int) {
-        guard let header = header, let audioData = audioData else { return }
-
-        let ringFrames = Self.ringBufferFrames
-        let channels = Self.channelCount
-        var wHead = header.pointee.writeHead
-        var written = 0
-
-        while written < frameCount {
-            let ringIndex = Int(wHead % UInt64(ringFrames))
-            let contiguous = ringFrames - ringIndex
-            let chunk = min(frameCount - written, contiguous)
-            let sampleOffset = written * channels
-            let ringOffset = ringIndex * channels
-
-            memcpy(audioData.advanced(by: ringOffset),
-                   frames.advanced(by: sampleOffset),
-                   chunk * Self.bytesPerFrame)
-
-            wHead += UInt64(chunk)
-            written += chunk
+        guard frameCount > 0 else { return }
+        // The copy and the release-ordered writeHead store live in RightMicRing.c
+        // so the app and the driver share one implementation of the protocol.
+        RightMicRing_Write(ring, frames, UInt32(frameCount))
+    }
+
+    /// Write frames captured by capture source `source` (0 or 1).  Outside a
+    /// device switch only the current owner's frames reach the ring; during
+    /// one, the outgoing owner crossfades in the incoming source's frames.
+    /// Real-time safe; `frames` may be modified in place.
+    public func write(frames: UnsafeMutablePointer<Float>, frameCount: Int, source: UInt32) {
+        guard frameCount > 0 else { return }
+        RightMicSwitch_Write(switcher, ring, source, frames, UInt32(frameCount))
+    }
+
+    /// Duplicate the `frameCount` mono samples at the start of `buffer`
+    /// into interleaved stereo in place; `buffer` must hold twice as many.
+    /// For a mono device feeding a stereo ring.  Real-time safe.
+    public static func expandMonoToStereo(_ buffer: UnsafeMutablePointer<Float>, frameCount: Int) {
+        RightMicRing_ExpandMono(buffer, buffer, UInt32(clamping: frameCount))
+    }
+
+    // MARK: - Zero-Copy Write
+
+    /// Ring storage for the next `frameCount` frames, so the capture callback
+    /// can render straight into shared memory instead of copying into it.
+    /// Returns nil unless `source` owns the ring, no switch is in progress
+    /// and the span doesn't wrap; then capture into a private buffer and use
+    /// `write(frames:frameCount:source:)`.  Fill it, then `commit`.
+    /// Real-time safe.
+    public func reserve(frameCount: Int, source: UInt32) -> UnsafeMutablePointer<Float>? {
+        guard frameCount > 0 else { return nil }
+        return RightMicSwitch_Reserve(switcher, ring, source, UInt32(clamping: frameCount))
+    }
+
+    /// Publish `frameCount` frames (at most the reserved count) filled in
+    /// place.  Every reservation needs a commit, of 0 if nothing was
+    /// rendered, so the frames it claimed aren't left marked as overwritten.
+    public func commit(frameCount: Int) {
+        RightMicSwitch_Commit(switcher, ring, UInt32(clamping: max(frameCount, 0)))
+    }
+
+    // MARK: - Capture Clock
+
+    /// Publish the sample time / host time pair of an AudioTimeStamp that
+    /// capture source `source` received from device `clockID`, running at a
+    /// nominal `sampleRate`.  The driver follows that device's clock with
+    /// them (RightMicClock.h); only the source that owns the ring is heard,
+    /// so a device being faded in never mixes its clock with the old one.
+    /// Real-time safe.
+    public func publishTimestamp(sampleTime: Double, hostTime: UInt64, sampleRate: Double,
+                                 clockID: UInt32, source: UInt32) {
+        guard let header = ring.pointee.header,
+              RightMicSwitch_Owner(switcher) == source else { return }
+        let table = UnsafeMutableRawPointer(header).advanced(by: Self.clockOffset)
+                        .assumingMemoryBound(to: RightMicClockTable.self)
+        RightMicClock_Publish(table, clockID, UInt32(sampleRate.rounded()), sampleTime, hostTime)
+    }
+
+    // MARK: - Metrics
+
+    /// Account one capture callback that delivered `frameCount` frames and
+    /// began at `startTicks` (mach_absolute_time).  Call as the callback
+    /// returns.  Real-time safe.
+    public func recordCallback(frameCount: Int, startTicks: UInt64) {
+        guard let header = ring.pointee.header else { return }
+        let metrics = UnsafeMutableRawPointer(header).advanced(by: Self.metricsOffset)
+                          .assumingMemoryBound(to: RightMicProducerMetrics.self)
+        let ns = Double(mach_absolute_time() &- startTicks) * nanosPerTick
+        RightMicMetrics_RecordCallback(metrics, UInt32(clamping: frameCount), UInt64(ns))
+    }
+
+    /// Glitch statistics from both sides of the ring.  Histogram bucket 0
+    /// counts zeros and bucket b values in [2^(b-1), 2^b); see
+    /// RightMicMetrics.h.
+    public struct Metrics: CustomStringConvertible {
+        /// Whether a side's mapping of the ring was prefaulted and wired
+        /// (RightMicMirror_Prefault).  Raw values match `RightMicResidency`.
+        public enum Residency: UInt64 {
+            case unknown = 0  // not mapped (the driver has no IO session)
+            case faulted = 1  // pages touched up front; the lock was refused
+            case wired   = 2
         }
 
-        // Memory barrier ensures the driver sees the audio data before the updated head.
-        // Note: the 64-bit store below is atomic at the hardware level on both arm64 and
-        // x86_64 (aligned natural-width stores).  The C-side driver reads via
-        // atomic_load_explicit with memory_order_acquire, which pairs with this barrier.
-        OSMemoryBarrier()
-        header.pointee.writeHead = wHead
+        // Producer: this app's capture callback
+        public var callbacks:         UInt64
+        public var frames:            UInt64
+        public var maxCallbackMicros: UInt64
+        public var callbackMicros:    [UInt64]
+        public var appResidency:      Residency
+        // Consumer: the driver's IO thread (zero while it has none)
+        public var cycles:            UInt64
+        public var underruns:         UInt64
+        public var concealedFrames:   UInt64
+        public var overruns:          UInt64
+        public var maxJitterMicros:   UInt64
+        public var fillFrames:        [UInt64]
+        public var underrunFrames:    [UInt64]
+        public var jitterMicros:      [UInt64]
+        public var driverResidency:   Residency
+
+        public var description: String {
+            "callbacks \(callbacks) (max \(maxCallbackMicros) µs), cycles \(cycles) " +
+            "(max jitter \(maxJitterMicros) µs), underruns \(underruns) " +
+            "(\(concealedFrames) frames concealed), overruns \(overruns), " +
+            "ring pages app \(appResidency) / driver \(driverResidency)"
+        }
+    }
+
+    /// Read the statistics.  Cheap and lock-free, so call it as often as
+    /// you like, from any thread but the audio callback.
+    public func metrics() -> Metrics {
+        if driverMetrics == nil {
+            driverMetrics = Self.mapDriverMetrics()
+        }
+        var producer: UnsafePointer<RightMicProducerMetrics>?
+        if let ptr = mappedPtr {
+            producer = UnsafePointer(ptr.advanced(by: Self.metricsOffset)
+                                        .assumingMemoryBound(to: RightMicProducerMetrics.self))
+        }
+        var snap = RightMicMetricsSnapshot()
+        RightMicMetrics_Snapshot(producer, driverMetrics, &snap)
+
+        func buckets<T>(_ tuple: T) -> [UInt64] {
+            withUnsafeBytes(of: tuple) { Array($0.bindMemory(to: UInt64.self)) }
+        }
+        return Metrics(callbacks: snap.callbacks, frames: snap.frames,
+                       maxCallbackMicros: snap.maxCallbackUs, callbackMicros: buckets(snap.callbackUs),
+                       appResidency: Metrics.Residency(rawValue: snap.appResidency) ?? .unknown,
+                       cycles: snap.cycles, underruns: snap.underruns,
+                       concealedFrames: snap.concealedFrames, overruns: snap.overruns,
+                       maxJitterMicros: snap.maxJitterUs, fillFrames: buckets(snap.fillFrames),
+                       underrunFrames: buckets(snap.underrunFrames), jitterMicros: buckets(snap.jitterUs),
+                       driverResidency: Metrics.Residency(rawValue: snap.driverResidency) ?? .unknown)
+    }
+
+    /// Map the driver's metrics object (or file) read-only, or nil if it
+    /// doesn't exist yet (the driver isn't loaded).
+    private static func mapDriverMetrics() -> UnsafePointer<RightMicConsumerMetrics>? {
+        let size = MemoryLayout<RightMicConsumerMetrics>.size
+        var objectSize = 0
+        var fd = RightMicShm_Open(driverMetricsName, &objectSize)
+        if fd >= 0 {
+            guard objectSize >= size else {
+                Darwin.close(fd)
+                return nil
+            }
+        } else {
+            fd = Darwin.open(driverMetricsPath, O_RDONLY | O_NOFOLLOW)
+            guard fd >= 0 else { return nil }
+            var st = stat()
+            guard fstat(fd, &st) == 0, (st.st_mode & S_IFMT) == S_IFREG, st.st_size >= off_t(size) else {
+                Darwin.close(fd)
+                return nil
+            }
+        }
+        defer { Darwin.close(fd) }
+        guard let ptr = mmap(nil, size, PROT_READ, MAP_SHARED, fd, 0), ptr != MAP_FAILED else {
+            return nil
+        }
+        return UnsafePointer(ptr.assumingMemoryBound(to: RightMicConsumerMetrics.self))
+    }
+
+    // MARK: - Device Switch
+
+    /// Capture source currently feeding the ring (0 after `open()`).
+    public var switchOwner: UInt32 { RightMicSwitch_Owner(switcher) }
+
+    /// True while a crossfade started by `beginSwitch` has not completed.
+    public var isSwitching: Bool { RightMicSwitch_IsFading(switcher) }
+
+    /// Crossfade from the current owner to the other source over `fadeFrames`
+    /// once that source's unit is delivering audio.  Returns false if a
+    /// switch is already in progress.
+    public func beginSwitch(fadeFrames: Int) -> Bool {
+        RightMicSwitch_Begin(switcher, UInt32(clamping: fadeFrames))
+    }
+
+    /// Make `source` the owner immediately.  Only call once the previous
+    /// owner's capture unit has stopped.
+    public func completeSwitch(to source: UInt32) {
+        RightMicSwitch_Complete(switcher, source)
     }
 
     // MARK: - Active Flag
 
     private func setActive(_ active: Bool) {
-        guard let header = header else { return }
-        header.pointee.active = active ? 1 : 0
+        RightMicRing_SetActive(ring, active)
+    }
+
+    // MARK: - Idle
+
+    /// Idle the ring while no capture unit feeds it: the driver serves
+    /// silence, and the audio captured so far is zeroed so no later read
+    /// can replay it.  Only once every capture callback has stopped.
+    public func suspend() {
+        setActive(false)
+        RightMicRing_Clear(ring)
+    }
+
+    /// Leave `suspend`: publish one latency target of silence, then go
+    /// active, so a client that has just started reads a full cushion
+    /// from its first cycle while the capture unit is still starting.
+    /// Call before starting the unit.
+    public func resume() {
+        RightMicRing_WriteSilence(ring, UInt32(clamping: primingFrames()))
+        setActive(true)
+    }
+
+    /// The driver's latency target in ring frames.  The target and its
+    /// clamping count frames at the rate the driver's IO runs at; the
+    /// cushion it keeps in the ring is that many times ring rate / IO rate.
+    func primingFrames() -> Int {
+        let scale = driverRingFramesPerIOFrame()
+        let target = Self.targetLatencyFrames(
+            requested: requestedTargetFrames,
+            ioBufferFrames: driverIOBufferFrames() ?? Int(kRightMic_BufferFrameSize),
+            ringFrames: Int(Double(ringFrames) / scale))
+        return Int(Double(target) * scale)
+    }
+
+    /// How many clients the driver reports running IO on the virtual
+    /// device, or nil if it hasn't published that (not loaded, or an
+    /// older version).
+    public func driverIOClients() -> Int? {
+        if driverMetrics == nil {
+            driverMetrics = Self.mapDriverMetrics()
+        }
+        let clients = RightMicMetrics_IOClients(driverMetrics)
+        return clients >= 0 ? Int(clients) : nil
+    }
+
+    /// Frames per IO cycle the driver last ran RightMic at, counted at the
+    /// virtual device's rate rather than the ring's, or nil if it
+    /// hasn't run a cycle or published that (not loaded, or an older
+    /// version).
+    public func driverIOBufferFrames() -> Int? {
+        if driverMetrics == nil {
+            driverMetrics = Self.mapDriverMetrics()
+        }
+        let frames = RightMicMetrics_IOBufferFrames(driverMetrics)
+        return frames > 0 ? Int(frames) : nil
+    }
+
+    /// The same IO buffer in frames at the ring's rate, which is what a
+    /// capture callback of that duration writes.
+    public func driverIOBufferRingFrames() -> Int? {
+        guard let frames = driverIOBufferFrames() else { return nil }
+        return Int((Double(frames) * driverRingFramesPerIOFrame()).rounded())
+    }
+
+    /// Ring frames per frame of the driver's IO: 1 until it has published
+    /// the rate it runs at.
+    private func driverRingFramesPerIOFrame() -> Double {
+        if driverMetrics == nil {
+            driverMetrics = Self.mapDriverMetrics()
+        }
+        let rate = RightMicMetrics_IOSampleRate(driverMetrics)
+        return rate > 0 ? Double(sampleRate) / Double(rate) : 1.0
     }
 
     // MARK: - Mute
@@ -254,8 +724,36 @@ public final class RingBufferWriter {
     /// Set the app-side mute override in the ring buffer header.
     /// The driver ORs this with its own HAL-control mute state.
     public func setMuted(_ muted: Bool) {
-        guard let header = header else { return }
-        header.pointee.muted = muted ? 1 : 0
+        RightMicRing_SetMuted(ring, muted)
+    }
+
+    // MARK: - Latency
+
+    /// Request how far behind the write head the driver reads.  The driver
+    /// holds `targetFrames` buffered and, if the fill ever drops below
+    /// `minSafeFrames`, conceals until it is back at the target.
+    /// Pass 0 for the driver defaults; the driver clamps both to what its
+    /// IO buffer size allows and reports the result as the device's
+    /// latency and safety offset.
+    public func setLatency(targetFrames: Int, minSafeFrames: Int) {
+        requestedTargetFrames = targetFrames
+        RightMicRing_SetLatency(ring, UInt32(clamping: targetFrames), UInt32(clamping: minSafeFrames))
+    }
+
+    // MARK: - Concealment
+
+    /// How the driver fills frames the ring can't supply on time.
+    /// Raw values match `RightMicConcealMode` in RightMicConceal.h.
+    public enum Concealment: UInt32 {
+        case driverDefault = 0  // pitchRepeat
+        case fadeOut       = 1
+        case crossfade     = 2
+        case pitchRepeat   = 3
+        case silence       = 4
+    }
+
+    public func setConcealment(_ mode: Concealment) {
+        RightMicRing_SetConcealment(ring, mode.rawValue)
     }
 
     // MARK: - Control Table
@@ -267,6 +765,11 @@ public final class RingBufferWriter {
         guard let ct = controlTable else { return }
         let n = min(controls.count, 4)
 
+        // Odd version: update in progress.  The driver discards any copy
+        // that overlaps this window, so it never sees a half-written entry.
+        ct.pointee.version &+= 1
+        OSMemoryBarrier()
+
         // Write all entry data first (visible to driver only after count + version update)
         let emptyEntry = ControlEntry(classID: 0, scope: 0, element: 0,
                                       uintValue: 0, floatValue: 0, minDB: 0, maxDB: 0)
@@ -278,7 +781,8 @@ public final class RingBufferWriter {
         // Barrier ensures entry data is visible before count/version
         OSMemoryBarrier()
         ct.pointee.count   = UInt32(n)
-        ct.pointee.version &+= 1
+        OSMemoryBarrier()
+        ct.pointee.version &+= 1  // even again: complete
     }
 
     // MARK: - Errors
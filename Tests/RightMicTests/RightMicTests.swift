@@ -1,4 +1,5 @@
 import XCTest
+import CRightMic
 @testable import RightMicCore
 
 // MARK: - AudioDevice Tests
@@ -186,6 +187,52 @@ final class PriorityConfigTests: XCTestCase {
         XCTAssertNil(best)
     }
 
+    func testNextBestDeviceSkipsExcluded() {
+        let config = PriorityConfig(entries: [
+            PriorityEntry(uid: "uid-1", name: "SM7B", transportType: .usb),
+            PriorityEntry(uid: "uid-2", name: "AirPods", transportType: .bluetooth, enabled: false),
+            PriorityEntry(uid: "uid-3", name: "Built-in", transportType: .builtIn),
+        ])
+        // SM7B is active, AirPods disabled → Built-in is the fallback
+        let available: Set<String> = ["uid-1", "uid-2", "uid-3"]
+        XCTAssertEqual(config.nextBestDevice(availableUIDs: available, excludingUID: "uid-1")?.uid, "uid-3")
+        XCTAssertEqual(config.nextBestDevice(availableUIDs: available, excludingUID: nil)?.uid, "uid-1")
+        XCTAssertNil(config.nextBestDevice(availableUIDs: ["uid-1"], excludingUID: "uid-1"))
+    }
+
+    func testBestDevicePassesOverDeadDevices() {
+        let config = PriorityConfig(entries: [
+            PriorityEntry(uid: "uid-1", name: "Scarlett", transportType: .usb),
+            PriorityEntry(uid: "uid-2", name: "Webcam", transportType: .usb),
+            PriorityEntry(uid: "uid-3", name: "Built-in", transportType: .builtIn),
+        ])
+        let available: Set<String> = ["uid-1", "uid-2", "uid-3"]
+        // Scarlett probed dead, Webcam unprobed → Webcam, with Built-in behind it
+        let liveness = ["uid-1": 0.0, "uid-3": 0.9]
+        XCTAssertEqual(config.bestDevice(availableUIDs: available, liveness: liveness)?.uid, "uid-2")
+        XCTAssertEqual(config.nextBestDevice(availableUIDs: available, excludingUID: "uid-2",
+                                             liveness: liveness)?.uid, "uid-3")
+        // Everything dead → priority order still picks something
+        let allDead = ["uid-1": 0.1, "uid-2": 0.0, "uid-3": 0.2]
+        XCTAssertEqual(config.bestDevice(availableUIDs: available, liveness: allDead)?.uid, "uid-1")
+    }
+
+    func testProbeCandidatesSkipBluetoothAndActive() {
+        let config = PriorityConfig(entries: [
+            PriorityEntry(uid: "uid-1", name: "Scarlett", transportType: .usb),
+            PriorityEntry(uid: "uid-2", name: "AirPods", transportType: .bluetooth),
+            PriorityEntry(uid: "uid-3", name: "Webcam", transportType: .usb, enabled: false),
+            PriorityEntry(uid: "uid-4", name: "Built-in", transportType: .builtIn),
+            PriorityEntry(uid: "uid-5", name: "Loopback", transportType: .virtual),
+        ])
+        let available: Set<String> = ["uid-1", "uid-2", "uid-3", "uid-4", "uid-5"]
+        XCTAssertEqual(config.probeCandidates(availableUIDs: available, excludingUID: "uid-1", limit: 3).map(\.uid),
+                       ["uid-4", "uid-5"])
+        XCTAssertEqual(config.probeCandidates(availableUIDs: available, excludingUID: nil, limit: 1).map(\.uid),
+                       ["uid-1"])
+        XCTAssertTrue(config.probeCandidates(availableUIDs: available, excludingUID: nil, limit: 0).isEmpty)
+    }
+
     func testPersistenceRoundTrip() throws {
         let config = PriorityConfig(entries: [
             PriorityEntry(uid: "uid-1", name: "Test Mic", transportType: .usb),
@@ -316,15 +363,31 @@ final class RingBufferWriterTests: XCTestCase {
     func testConstants() {
         XCTAssertEqual(RingBufferWriter.channelCount, 2)
         XCTAssertEqual(RingBufferWriter.bytesPerFrame, 8)  // 2 channels * 4 bytes
-        XCTAssertEqual(RingBufferWriter.ringBufferFrames, 16384)
-        XCTAssertEqual(RingBufferWriter.headerSize, 64)
-        XCTAssertEqual(RingBufferWriter.dataSize, 16384 * 8)
-        XCTAssertEqual(RingBufferWriter.totalSize, 64 + 16384 * 8 + 128) // +128 for V2 control table
+        XCTAssertEqual(RingBufferWriter.defaultRingFrames, 16384)
+        XCTAssertEqual(RingBufferWriter.headerSize, 256)
+        XCTAssertEqual(RingBufferWriter.dataSize(ringFrames: 16384), 16384 * 8)
+        XCTAssertEqual(RingBufferWriter.controlTableOffset, 256)
+        XCTAssertEqual(RingBufferWriter.metricsOffset, 512)
+        XCTAssertEqual(RingBufferWriter.clockOffset, 768)
+        XCTAssertEqual(RingBufferWriter.dataOffset, 16384)  // page-aligned for the mirror
+        XCTAssertEqual(RingBufferWriter.totalSize(ringFrames: 16384), 16384 + 16384 * 8)
+        // A mono ring is half the size, rounded up to whole pages.
+        XCTAssertEqual(RingBufferWriter.dataSize(ringFrames: 16384, channels: 1), 16384 * 4)
+        XCTAssertEqual(RingBufferWriter.ringBytes(ringFrames: 1024, channels: 1), 4096)
+        XCTAssertEqual(RingBufferWriter.dataSize(ringFrames: 1024, channels: 1), 16384)
+    }
+
+    func testRingFramesRoundToWhatTheDriverAccepts() {
+        XCTAssertEqual(RingBufferWriter.ringFrames(forRequested: 0), 16384)
+        XCTAssertEqual(RingBufferWriter.ringFrames(forRequested: -1), 16384)
+        XCTAssertEqual(RingBufferWriter.ringFrames(forRequested: 100), 1024)
+        XCTAssertEqual(RingBufferWriter.ringFrames(forRequested: 5000), 8192)
+        XCTAssertEqual(RingBufferWriter.ringFrames(forRequested: 1 << 30), 262144)
     }
 
     func testOpenAndClose() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         XCTAssertFalse(writer.isOpen)
 
         try writer.open()
@@ -339,9 +402,46 @@ final class RingBufferWriterTests: XCTestCase {
         writer.unlink()
     }
 
+    func testOpenPrefersSharedMemoryObject() throws {
+        let path = tempPath()
+        let name = "/rightmic-test-\(getpid())"
+        // A file left by an earlier fallback stays, for a driver that may
+        // still map it, but no longer carries a ring header.
+        let staleSize = RingBufferWriter.dataOffset + 4096
+        FileManager.default.createFile(atPath: path, contents: Data(repeating: 0xff, count: staleSize))
+        let writer = RingBufferWriter(path: path, sharedMemoryName: name)
+        try writer.open()
+        XCTAssertTrue(writer.isSharedMemoryObject)
+        let stale = try Data(contentsOf: URL(fileURLWithPath: path))
+        XCTAssertEqual(stale.count, staleSize)
+        XCTAssertTrue(stale.prefix(RingBufferWriter.dataOffset).allSatisfy { $0 == 0 })
+        XCTAssertTrue(stale.suffix(4096).allSatisfy { $0 == 0xff })
+
+        var size = 0
+        let fd = RightMicShm_Open(name, &size)
+        XCTAssertGreaterThanOrEqual(fd, 0)
+        XCTAssertEqual(size, RingBufferWriter.sharedMemoryObjectSize)
+        XCTAssertGreaterThanOrEqual(size, writer.totalSize)
+        Darwin.close(fd)
+
+        // Reopening with a larger ring keeps the object a driver maps.
+        writer.close()
+        try writer.open(ringFrames: Int(kRightMic_MaxRingFrames))
+        var reopened = 0
+        let fd2 = RightMicShm_Open(name, &reopened)
+        XCTAssertGreaterThanOrEqual(fd2, 0)
+        XCTAssertEqual(reopened, size)
+        Darwin.close(fd2)
+
+        writer.close()
+        writer.unlink()
+        XCTAssertLessThan(RightMicShm_Open(name, &size), 0)
+        XCTAssertFalse(FileManager.default.fileExists(atPath: path))
+    }
+
     func testDoubleOpenIsNoOp() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         try writer.open()
         try writer.open()  // should not throw
         XCTAssertTrue(writer.isOpen)
@@ -349,9 +449,26 @@ final class RingBufferWriterTests: XCTestCase {
         writer.unlink()
     }
 
+    func testOpenTakesSupportedSampleRate() throws {
+        let writer = RingBufferWriter(path: tempPath(), sharedMemoryName: nil)
+        try writer.open(sampleRate: 96000)
+        XCTAssertEqual(writer.sampleRate, 96000)
+        writer.close()
+
+        // The driver can't serve 22.05 kHz: the ring falls back to 48 kHz
+        // and the capture unit converts.
+        try writer.open(sampleRate: 22050)
+        XCTAssertEqual(writer.sampleRate, RingBufferWriter.defaultSampleRate)
+        XCTAssertEqual(RingBufferWriter.defaultSampleRate, 48000)
+        XCTAssertTrue(RingBufferWriter.isSupportedSampleRate(44100))
+        XCTAssertFalse(RingBufferWriter.isSupportedSampleRate(44100.5))
+        writer.close()
+        writer.unlink()
+    }
+
     func testWriteFrames() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         try writer.open()
 
         // Write 512 frames of silence
@@ -372,9 +489,65 @@ final class RingBufferWriterTests: XCTestCase {
         writer.unlink()
     }
 
+    func testSwitchHandsOverAfterCrossfade() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        let frameCount = 512
+        var outgoing = [Float](repeating: 0.25, count: frameCount * RingBufferWriter.channelCount)
+        var incoming = [Float](repeating: 0.5, count: frameCount * RingBufferWriter.channelCount)
+        XCTAssertEqual(writer.switchOwner, 0)
+        XCTAssertTrue(writer.beginSwitch(fadeFrames: 1024))
+        XCTAssertFalse(writer.beginSwitch(fadeFrames: 1024))
+
+        // Alternate callbacks like two running devices until the outgoing
+        // source hands over.
+        for _ in 0..<8 where writer.isSwitching {
+            writer.write(frames: &incoming, frameCount: frameCount, source: 1)
+            writer.write(frames: &outgoing, frameCount: frameCount, source: 0)
+            outgoing = [Float](repeating: 0.25, count: frameCount * RingBufferWriter.channelCount)
+        }
+        XCTAssertFalse(writer.isSwitching)
+        XCTAssertEqual(writer.switchOwner, 1)
+    }
+
+    func testReserveCommitWritesInPlace() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        let frameCount = 256
+        XCTAssertNil(writer.reserve(frameCount: frameCount, source: 1))
+        let slot = try XCTUnwrap(writer.reserve(frameCount: frameCount, source: 0))
+        slot.update(repeating: 0.75, count: frameCount * RingBufferWriter.channelCount)
+
+        func writeHead() throws -> UInt64 {
+            let data = try Data(contentsOf: URL(fileURLWithPath: path))
+            return data.withUnsafeBytes { $0.load(as: UInt64.self) }
+        }
+        XCTAssertEqual(try writeHead(), 0)
+        writer.commit(frameCount: frameCount)
+        XCTAssertEqual(try writeHead(), UInt64(frameCount))
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        let first = data.withUnsafeBytes {
+            $0.load(fromByteOffset: RingBufferWriter.dataOffset, as: Float.self)
+        }
+        XCTAssertEqual(first, 0.75)
+    }
+
     func testUnlink() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         try writer.open()
         writer.close()
         writer.unlink()
@@ -386,7 +559,7 @@ final class RingBufferWriterTests: XCTestCase {
 
     func testFilePermissionsAllowDriverRead() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         try writer.open()
         defer { writer.close(); writer.unlink() }
 
@@ -404,7 +577,7 @@ final class RingBufferWriterTests: XCTestCase {
         defer { unlink(target); unlink(link) }
         try FileManager.default.createSymbolicLink(atPath: link, withDestinationPath: target)
 
-        let writer = RingBufferWriter(path: link)
+        let writer = RingBufferWriter(path: link, sharedMemoryName: nil)
         XCTAssertThrowsError(try writer.open()) { error in
             guard let rbError = error as? RingBufferWriter.RingBufferError,
                   case .openFailed(let e) = rbError else {
@@ -417,12 +590,243 @@ final class RingBufferWriterTests: XCTestCase {
 
     func testHeaderStructSizeMatchesConstant() {
         XCTAssertEqual(MemoryLayout<RingBufferWriter.RingBufferHeader>.size, RingBufferWriter.headerSize,
-                       "Swift RingBufferHeader size must match headerSize constant (64 bytes)")
+                       "Swift RingBufferHeader size must match headerSize constant (256 bytes)")
+    }
+
+    func testHeaderFieldsOnSeparateCacheLines() {
+        typealias Header = RingBufferWriter.RingBufferHeader
+        XCTAssertEqual(MemoryLayout<Header>.offset(of: \.magic), 0)
+        XCTAssertEqual(MemoryLayout<Header>.offset(of: \.writeHead), 64)
+        XCTAssertEqual(MemoryLayout<Header>.offset(of: \.writeClaim), 72)
+        XCTAssertEqual(MemoryLayout<Header>.offset(of: \.readHead), 128)
+        XCTAssertEqual(MemoryLayout<Header>.offset(of: \.muted), 192)
+    }
+
+    func testOpenPublishesVersionedLayout() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        data.withUnsafeBytes { raw in
+            let header = raw.load(as: RingBufferWriter.RingBufferHeader.self)
+            XCTAssertEqual(header.magic, 0x4349_4D52)  // "RMIC"
+            XCTAssertEqual(header.version, 8)
+            XCTAssertEqual(Int(header.headerSize), RingBufferWriter.headerSize)
+            XCTAssertEqual(Int(header.dataOffset), RingBufferWriter.dataOffset)
+            XCTAssertEqual(Int(header.ringFrames), RingBufferWriter.defaultRingFrames)
+            XCTAssertEqual(Int(header.frameBytes), RingBufferWriter.bytesPerFrame)
+            XCTAssertEqual(Int(header.channels), RingBufferWriter.channelCount)
+        }
+    }
+
+    func testOpenSizesTheRingOnRequest() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open(ringFrames: 4096)
+        XCTAssertEqual(writer.ringFrames, 4096)
+        var data = try Data(contentsOf: URL(fileURLWithPath: path))
+        XCTAssertEqual(data.count, RingBufferWriter.totalSize(ringFrames: 4096))
+        XCTAssertEqual(data.withUnsafeBytes { $0.load(as: RingBufferWriter.RingBufferHeader.self).ringFrames }, 4096)
+        writer.close()
+
+        // Reopening larger grows the file; smaller keeps it at its size,
+        // so a driver still mapping the old ring never loses pages.
+        try writer.open(ringFrames: 65536)
+        writer.close()
+        try writer.open(ringFrames: 2048)
+        data = try Data(contentsOf: URL(fileURLWithPath: path))
+        XCTAssertEqual(data.count, RingBufferWriter.totalSize(ringFrames: 65536))
+        XCTAssertEqual(data.withUnsafeBytes { $0.load(as: RingBufferWriter.RingBufferHeader.self).ringFrames }, 2048)
+        writer.close()
+        writer.unlink()
+    }
+
+    func testOpenMonoDeclaresOneChannel() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open(channels: 1)
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+        XCTAssertEqual(writer.channels, 1)
+        XCTAssertEqual(writer.totalSize, RingBufferWriter.totalSize(ringFrames: writer.ringFrames, channels: 1))
+
+        // One sample per frame lands in the ring as written.
+        var samples: [Float] = [0.25, -0.5, 0.75]
+        writer.write(frames: &samples, frameCount: samples.count)
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        data.withUnsafeBytes { raw in
+            let header = raw.load(as: RingBufferWriter.RingBufferHeader.self)
+            XCTAssertEqual(header.channels, 1)
+            XCTAssertEqual(header.frameBytes, 4)
+            XCTAssertEqual(raw.count, writer.totalSize)
+            XCTAssertEqual(header.writeHead, 3)
+            XCTAssertEqual(raw.load(fromByteOffset: RingBufferWriter.dataOffset + 4, as: Float.self), -0.5)
+        }
+    }
+
+    func testMetricsCountCallbacks() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        XCTAssertEqual(writer.metrics().callbacks, 0)
+        writer.recordCallback(frameCount: 512, startTicks: mach_absolute_time())
+        writer.recordCallback(frameCount: 256, startTicks: mach_absolute_time())
+
+        let metrics = writer.metrics()
+        XCTAssertEqual(metrics.callbacks, 2)
+        XCTAssertEqual(metrics.frames, 768)
+        XCTAssertEqual(metrics.callbackMicros.count, 16)
+        XCTAssertEqual(metrics.callbackMicros.reduce(0, +), 2)
+        // open() prefaulted the ring, whether or not it could wire it.
+        XCTAssertNotEqual(metrics.appResidency, .unknown)
+
+        // The block sits in the header page, clear of the control table.
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        data.withUnsafeBytes { raw in
+            XCTAssertEqual(raw.load(fromByteOffset: RingBufferWriter.metricsOffset, as: UInt32.self),
+                           0x5453_4D52)  // "RMST"
+        }
+    }
+
+    func testPublishesOwnersTimestamps() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        // Source 0 owns a freshly opened ring; a device being faded in as
+        // source 1 isn't heard.
+        writer.publishTimestamp(sampleTime: 512, hostTime: 1_000_000, sampleRate: 48000,
+                                clockID: 42, source: 0)
+        writer.publishTimestamp(sampleTime: 1024, hostTime: 2_000_000, sampleRate: 44100,
+                                clockID: 43, source: 1)
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        data.withUnsafeBytes { raw in
+            let table = RingBufferWriter.clockOffset
+            XCTAssertEqual(raw.load(fromByteOffset: table, as: UInt64.self), 1)  // count
+            let entry = table + 64
+            XCTAssertEqual(raw.load(fromByteOffset: entry, as: UInt64.self), 1)  // sequence
+            XCTAssertEqual(raw.load(fromByteOffset: entry + 8, as: Double.self), 512)
+            XCTAssertEqual(raw.load(fromByteOffset: entry + 16, as: UInt64.self), 1_000_000)
+            XCTAssertEqual(raw.load(fromByteOffset: entry + 24, as: UInt32.self), 42)
+            XCTAssertEqual(raw.load(fromByteOffset: entry + 28, as: UInt32.self), 48000)
+        }
+    }
+
+    func testSetLatencyWritesHeader() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        writer.setLatency(targetFrames: 2048, minSafeFrames: 768)
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        let target = data.withUnsafeBytes {
+            $0.load(fromByteOffset: MemoryLayout<RingBufferWriter.RingBufferHeader>.offset(of: \.targetLatency)!,
+                    as: UInt32.self)
+        }
+        let minSafe = data.withUnsafeBytes {
+            $0.load(fromByteOffset: MemoryLayout<RingBufferWriter.RingBufferHeader>.offset(of: \.minSafeLatency)!,
+                    as: UInt32.self)
+        }
+        XCTAssertEqual(target, 2048)
+        XCTAssertEqual(minSafe, 768)
+    }
+
+    func testSetConcealmentWritesHeader() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        writer.setConcealment(.fadeOut)
+
+        let data = try Data(contentsOf: URL(fileURLWithPath: path))
+        let mode = data.withUnsafeBytes {
+            $0.load(fromByteOffset: MemoryLayout<RingBufferWriter.RingBufferHeader>.offset(of: \.concealMode)!,
+                    as: UInt32.self)
+        }
+        XCTAssertEqual(mode, RingBufferWriter.Concealment.fadeOut.rawValue)
+    }
+
+    func testSuspendZeroesAudioAndResumePrimesSilence() throws {
+        let path = tempPath()
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
+        try writer.open()
+        defer {
+            writer.close()
+            writer.unlink()
+        }
+
+        var samples = [Float](repeating: 1.0, count: 512 * RingBufferWriter.channelCount)
+        writer.write(frames: &samples, frameCount: 512)
+
+        func header() throws -> (active: UInt32, writeHead: UInt64, audioZero: Bool) {
+            let data = try Data(contentsOf: URL(fileURLWithPath: path))
+            let layout = MemoryLayout<RingBufferWriter.RingBufferHeader>.self
+            return data.withUnsafeBytes {
+                ($0.load(fromByteOffset: layout.offset(of: \.active)!, as: UInt32.self),
+                 $0.load(fromByteOffset: layout.offset(of: \.writeHead)!, as: UInt64.self),
+                 $0[RingBufferWriter.dataOffset...].allSatisfy { $0 == 0 })
+            }
+        }
+
+        writer.suspend()
+        var state = try header()
+        XCTAssertEqual(state.active, 0)
+        XCTAssertEqual(state.writeHead, 512)
+        XCTAssertTrue(state.audioZero)
+
+        // Primes the default target for the size and rate the driver runs
+        // at, if one is loaded on this machine.
+        let target = writer.primingFrames()
+        if writer.driverIOBufferFrames() == nil {
+            XCTAssertEqual(target, RingBufferWriter.targetLatencyFrames(requested: 0, ioBufferFrames: 512))
+        }
+        writer.resume()
+        state = try header()
+        XCTAssertEqual(state.active, 1)
+        XCTAssertEqual(state.writeHead, 512 + UInt64(target))
+        XCTAssertTrue(state.audioZero)
+    }
+
+    func testTargetLatencyScalesWithIOBufferSize() {
+        XCTAssertEqual(RingBufferWriter.defaultTargetLatencyFrames, 1536)
+        XCTAssertEqual(RingBufferWriter.targetLatencyFrames(requested: 0, ioBufferFrames: 1024), 3072)
+        // Small buffers keep the floor the drift loop needs to lock.
+        XCTAssertEqual(RingBufferWriter.targetLatencyFrames(requested: 0, ioBufferFrames: 64), 384)
+        // An explicit target only grows to what the buffer size requires.
+        XCTAssertEqual(RingBufferWriter.targetLatencyFrames(requested: 256, ioBufferFrames: 64), 256)
+        XCTAssertGreaterThan(RingBufferWriter.targetLatencyFrames(requested: 256, ioBufferFrames: 512), 512)
     }
 
     func testAudioDataZeroedOnClose() throws {
         let path = tempPath()
-        let writer = RingBufferWriter(path: path)
+        let writer = RingBufferWriter(path: path, sharedMemoryName: nil)
         try writer.open()
 
         // Write non-zero audio data
@@ -443,8 +847,8 @@ final class RingBufferWriterTests: XCTestCase {
     func testCustomPathIsolation() throws {
         let path1 = tempPath()
         let path2 = tempPath()
-        let writer1 = RingBufferWriter(path: path1)
-        let writer2 = RingBufferWriter(path: path2)
+        let writer1 = RingBufferWriter(path: path1, sharedMemoryName: nil)
+        let writer2 = RingBufferWriter(path: path2, sharedMemoryName: nil)
         defer { writer1.close(); writer1.unlink(); writer2.close(); writer2.unlink() }
 
         try writer1.open()
@@ -472,7 +876,7 @@ final class RingBufferWriterTests: XCTestCase {
             return
         }
 
-        let writer = RingBufferWriter(path: fifoPath)
+        let writer = RingBufferWriter(path: fifoPath, sharedMemoryName: nil)
         XCTAssertThrowsError(try writer.open()) { error in
             guard let rbError = error as? RingBufferWriter.RingBufferError else {
                 XCTFail("Expected RingBufferError, got \(error)")
@@ -491,6 +895,110 @@ final class RingBufferWriterTests: XCTestCase {
     }
 }
 
+// MARK: - LevelMeter Tests
+
+final class LevelMeterTests: XCTestCase {
+
+    func testSilenceAccumulatesAndToneResets() {
+        let meter = LevelMeter(sampleRate: 48000)
+        var zeros = [Float](repeating: 0, count: 480 * 2)
+        for _ in 0..<100 {
+            meter.feed(frames: &zeros, frameCount: 480, channels: 2)
+        }
+        XCTAssertEqual(meter.reading.silentSeconds, 1.0, accuracy: 0.001)
+        XCTAssertEqual(meter.reading.peak, 0)
+
+        var tone = (0..<480 * 2).map { Float(sin(Double($0 / 2) * 0.1)) * 0.5 }
+        meter.feed(frames: &tone, frameCount: 480, channels: 2)
+        XCTAssertEqual(meter.reading.silentSeconds, 0)
+        XCTAssertEqual(meter.reading.peak, 0.5, accuracy: 0.01)
+        XCTAssertGreaterThan(meter.reading.rms, 0)
+    }
+
+    func testResetClearsSilence() {
+        let meter = LevelMeter(sampleRate: 48000)
+        var zeros = [Float](repeating: 0, count: 480 * 2)
+        meter.feed(frames: &zeros, frameCount: 480, channels: 2)
+        XCTAssertGreaterThan(meter.reading.silentSeconds, 0)
+        meter.reset()
+        XCTAssertEqual(meter.reading.silentSeconds, 0)
+    }
+}
+
+// MARK: - Resampler Tests
+
+final class ResamplerTests: XCTestCase {
+
+    func testRejectsUnsupportedConfigurations() {
+        XCTAssertNil(Resampler(inputRate: 0, outputRate: 48000, channels: 2, quality: .max))
+        XCTAssertNil(Resampler(inputRate: 44100.5, outputRate: 48000, channels: 2, quality: .max))
+        XCTAssertNil(Resampler(inputRate: 4000, outputRate: 48000, channels: 2, quality: .max))
+        XCTAssertNil(Resampler(inputRate: 44100, outputRate: 48000, channels: 3, quality: .max))
+        XCTAssertNotNil(Resampler(inputRate: 44100, outputRate: 48000, channels: 1, quality: .voice))
+    }
+
+    func testConvertsEveryInputFrame() throws {
+        let resampler = try XCTUnwrap(
+            Resampler(inputRate: 44100, outputRate: 48000, channels: 2, quality: .balanced))
+        var input = [Float](repeating: 0.25, count: 441 * 2)
+        var output = [Float](repeating: 0, count: 1024 * 2)
+        var produced = 0
+        for _ in 0..<10 {
+            let capacity = resampler.maxOutput(inputFrames: 441)
+            produced += output.withUnsafeMutableBufferPointer { out in
+                resampler.process(input: &input, frameCount: 441,
+                                  output: out.baseAddress!, capacity: capacity)
+            }
+        }
+        // 4410 frames in is 4800 out, less the half window (16 input
+        // frames) held back until more input arrives.
+        XCTAssertEqual(produced, 4800 - 17, accuracy: 2)
+        XCTAssertEqual(output[0], 0.25, accuracy: 1e-5)
+    }
+}
+
+// MARK: - Liveness Tests
+
+final class LivenessTests: XCTestCase {
+
+    private func probe(_ samples: [Float]) -> Double? {
+        let meter = LevelMeter(sampleRate: 48000, window: 0.05)
+        var buffer = samples
+        meter.feed(frames: &buffer, frameCount: buffer.count, channels: 1)
+        return Liveness.score(meter.reading)
+    }
+
+    func testScoresDeadAndLiveInputs() {
+        let n = 12000
+        // Lid closed: exact zeros
+        XCTAssertEqual(probe([Float](repeating: 0, count: n)), 0)
+        // Quiet room: noise around -70 dBFS
+        var seed: UInt32 = 1
+        let noise = (0..<n).map { _ -> Float in
+            seed = seed &* 1664525 &+ 1013904223
+            return (Float(seed >> 8) / Float(1 << 24) - 0.5) * 0.001
+        }
+        XCTAssertTrue(Liveness.isLive(probe(noise)))
+        // Empty XLR input: a few LSBs of 24-bit noise, far below any mic
+        XCTAssertFalse(Liveness.isLive(probe(noise.map { $0 / 300 })))
+        // Nothing delivered: no evidence
+        XCTAssertNil(probe([]))
+        XCTAssertTrue(Liveness.isLive(nil))
+    }
+
+    func testScheduleBacksOffUntilSomethingChanges() {
+        var schedule = ProbeSchedule(minimumInterval: 15, maximumInterval: 100)
+        XCTAssertEqual(schedule.completedRound(changed: false), 30)
+        XCTAssertEqual(schedule.completedRound(changed: false), 60)
+        XCTAssertEqual(schedule.completedRound(changed: false), 100)
+        XCTAssertEqual(schedule.completedRound(changed: false), 100)
+        XCTAssertEqual(schedule.completedRound(changed: true), 15)
+        _ = schedule.completedRound(changed: false)
+        schedule.reset()
+        XCTAssertEqual(schedule.interval, 15)
+    }
+}
+
 // MARK: - DriverStatus Tests
 
 final class DriverStatusTests: XCTestCase {
@@ -0,0 +1,161 @@
+/*
+ * HeaderBench.c
+ * Cross-core cost of the ring header layout (Linux).
+ *
+ * The producer stores `writeHead` on every chunk while other threads
+ * poll the app's settings (`muted`, the latency watermarks, the
+ * concealment mode): the driver's IO thread every cycle and its HAL
+ * property threads whenever asked.  With the settings on the producer's
+ * cache line, every publish invalidates the poller's copy and every poll
+ * pulls the line back, so both sides pay a coherence miss per access.
+ *
+ * Two threads pinned to different CPUs run that pattern flat out, once
+ * on a copy of the old packed 64-byte header and once on the current
+ * header, and report the cost per publish and per poll.
+ *
+ * Build and run with ./scripts/test-ring.sh --bench.
+ */
+
+#include "RightMicRing.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define kPublishes  20000000ull
+
+/* The pre-version-3 header: everything in one cache line. */
+typedef struct {
+    _Atomic uint64_t writeHead;
+    _Atomic uint64_t readHead;
+    _Atomic uint32_t active;
+    uint32_t         sampleRate;
+    uint32_t         channels;
+    _Atomic uint32_t muted;
+    _Atomic uint32_t targetLatency;
+    _Atomic uint32_t minSafeLatency;
+    _Atomic uint32_t concealMode;
+    uint32_t         dataOffset;
+    uint32_t         _pad[4];
+} PackedHeader;
+
+_Static_assert(sizeof(PackedHeader) == kRightMic_CacheLineSize, "packed header is one line");
+
+/* The fields each side touches, wherever the layout puts them. */
+typedef struct {
+    _Atomic uint64_t *writeHead;
+    _Atomic uint32_t *settings[4];
+    _Atomic int       running;
+    _Atomic int       ready;
+    uint64_t          polls;
+    double            publishNs;
+} Shared;
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void PinToCPU(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void *Poller(void *arg)
+{
+    Shared *s = arg;
+    PinToCPU(1);
+    atomic_fetch_add(&s->ready, 1);
+
+    uint64_t polls = 0;
+    volatile uint32_t sink = 0;
+    while (atomic_load_explicit(&s->running, memory_order_relaxed)) {
+        for (int i = 0; i < 4; i++) {
+            sink += atomic_load_explicit(s->settings[i], memory_order_relaxed);
+        }
+        polls++;
+    }
+    s->polls = polls;
+    return NULL;
+}
+
+static void *Publisher(void *arg)
+{
+    Shared *s = arg;
+    PinToCPU(0);
+    atomic_fetch_add(&s->ready, 1);
+    while (atomic_load(&s->ready) < 2) { }
+
+    uint64_t t0 = NowNs();
+    for (uint64_t i = 1; i <= kPublishes; i++) {
+        atomic_store_explicit(s->writeHead, i * kRightMic_BufferFrameSize, memory_order_release);
+    }
+    s->publishNs = (double)(NowNs() - t0);
+    atomic_store(&s->running, 0);
+    return NULL;
+}
+
+static void Run(const char *name, Shared *s)
+{
+    atomic_store(&s->running, 1);
+    atomic_store(&s->ready, 0);
+    s->polls = 0;
+
+    pthread_t poller, publisher;
+    pthread_create(&poller, NULL, Poller, s);
+    pthread_create(&publisher, NULL, Publisher, s);
+    pthread_join(publisher, NULL);
+    pthread_join(poller, NULL);
+
+    printf("  %-28s publish %6.2f ns  poll %6.2f ns\n", name,
+           s->publishNs / (double)kPublishes,
+           s->polls ? s->publishNs / (double)s->polls : 0.0);
+}
+
+int main(void)
+{
+    printf("Header bench (%llu publishes, producer on CPU 0, poller on CPU 1)\n",
+           (unsigned long long)kPublishes);
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("  skipped: needs at least two CPUs\n");
+        return 0;
+    }
+
+    /* Page-aligned, as the shared mapping is. */
+    void *region = aligned_alloc(4096, 4096);
+    if (region == NULL) {
+        perror("aligned_alloc");
+        return 1;
+    }
+
+    memset(region, 0, 4096);
+    PackedHeader *packed = region;
+    Shared s = {
+        .writeHead = &packed->writeHead,
+        .settings  = { &packed->muted, &packed->targetLatency,
+                       &packed->minSafeLatency, &packed->concealMode },
+    };
+    Run("packed (one line)", &s);
+
+    memset(region, 0, 4096);
+    RightMicRingBufferHeader *split = region;
+    s = (Shared){
+        .writeHead = &split->writeHead,
+        .settings  = { &split->muted, &split->targetLatency,
+                       &split->minSafeLatency, &split->concealMode },
+    };
+    Run("split (version 3)", &s);
+
+    free(region);
+    return 0;
+}
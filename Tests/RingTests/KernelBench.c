@@ -0,0 +1,250 @@
+/*
+ * KernelBench.c
+ * Single-threaded microbenchmarks for the per-cycle kernels that run on
+ * the driver's IO thread and in the app's capture callback.
+ *
+ * RingBench measures the whole producer/consumer pipeline at audio
+ * cadence; this times the individual pieces back to back so a change to
+ * one of them shows up as a number rather than as noise in a wakeup
+ * histogram.  Each kernel runs a fixed number of iterations and reports
+ * the median and worst call time.
+ *
+ * Build and run with ./scripts/test-ring.sh --bench.
+ */
+
+#include "RightMicConceal.h"
+#include "RightMicDrift.h"
+#include "RightMicLevel.h"
+#include "RightMicRing.h"
+#include "RightMicSwitch.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kIterations 2000
+#define kFrames     kRightMic_BufferFrameSize
+
+/* ── Time ─────────────────────────────────────────────────────── */
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void Report(const char *name, uint64_t *ns, uint32_t count, uint32_t frames)
+{
+    qsort(ns, count, sizeof(ns[0]), CompareU64);
+    uint64_t median = ns[count / 2];
+    printf("  %-28s median %7.2f us  max %8.2f us  (%5.2f ns/frame)\n",
+           name, (double)median / 1e3, (double)ns[count - 1] / 1e3,
+           frames ? (double)median / frames : 0.0);
+}
+
+/* ── Fixtures ─────────────────────────────────────────────────── */
+
+static float sTone[kFrames * kRightMic_ChannelCount];
+static float sOut[kFrames * kRightMic_ChannelCount];
+static uint64_t sSamples[kIterations];
+
+/* A voiced-speech stand-in: 140 Hz fundamental plus two harmonics. */
+static void MakeTone(uint64_t first)
+{
+    for (uint32_t i = 0; i < kFrames; i++) {
+        double t = (double)(first + i) / kRightMic_SampleRate;
+        float v = (float)(0.3 * sin(6.283185307179586 * 140.0 * t) +
+                          0.15 * sin(6.283185307179586 * 280.0 * t) +
+                          0.05 * sin(6.283185307179586 * 420.0 * t));
+        for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+            sTone[i * kRightMic_ChannelCount + c] = v;
+        }
+    }
+}
+
+/* ── Kernels ──────────────────────────────────────────────────── */
+
+static void BenchConcealFill(const char *name, RightMicConcealMode mode)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, mode);
+    uint64_t frame = 0;
+    for (uint32_t i = 0; i < kIterations; i++) {
+        /* Feed real audio so every Fill starts a fresh gap (and, for
+         * PitchRepeat, runs the period search). */
+        MakeTone(frame);
+        RightMicConceal_Feed(&c, sTone, kFrames);
+        frame += kFrames;
+
+        uint64_t t0 = NowNs();
+        RightMicConceal_Fill(&c, sOut, kFrames);
+        sSamples[i] = NowNs() - t0;
+    }
+    Report(name, sSamples, kIterations, kFrames);
+}
+
+static void BenchDetectPeriod(void)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, kRightMicConceal_PitchRepeat);
+    for (uint64_t frame = 0; frame < kRightMicConceal_HistoryFrames; frame += kFrames) {
+        MakeTone(frame);
+        RightMicConceal_Feed(&c, sTone, kFrames);
+    }
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < kIterations; i++) {
+        uint64_t t0 = NowNs();
+        sink += RightMicConceal_DetectPeriod(&c);
+        sSamples[i] = NowNs() - t0;
+    }
+    (void)sink;
+    Report("conceal detect period", sSamples, kIterations, 0);
+}
+
+static void BenchDriftRead(uint32_t channels)
+{
+    void *base = calloc(1, kRightMic_SharedMemorySize);
+    if (base == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, (uint32_t)kRightMic_SampleRate, channels);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    uint32_t target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, kFrames, kRightMic_RingBufferFrames);
+    RightMicDrift_Init(&drift, target, minSafe);
+
+    MakeTone(0);
+    for (uint32_t i = 0; i < 4; i++) RightMicRing_Write(&ring, sTone, kFrames);
+    for (uint32_t i = 0; i < kIterations; i++) {
+        RightMicRing_Write(&ring, sTone, kFrames);
+        uint64_t t0 = NowNs();
+        RightMicDrift_Read(&drift, &ring, &reader, sOut, kFrames);
+        sSamples[i] = NowNs() - t0;
+    }
+    Report(channels == 1 ? "drift read (mono ring)" : "drift read (resampling)",
+           sSamples, kIterations, kFrames);
+    free(base);
+}
+
+/* The capture callback's write path.  The "render" is a memcpy from a
+ * stand-in device buffer, which is what AudioUnitRender amounts to for
+ * a float device; the buffered variant then copies again into the ring,
+ * the in-place one renders straight into a reservation. */
+static void BenchCaptureWrite(int inPlace, uint32_t channels)
+{
+    static float sStage[kRightMicSwitch_StageFrames * kRightMic_ChannelCount];
+    static float sRender[kFrames * kRightMic_ChannelCount];
+    void *base = calloc(1, kRightMic_SharedMemorySize);
+    if (base == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, (uint32_t)kRightMic_SampleRate, channels);
+    RightMicSwitch sw;
+    RightMicSwitch_Init(&sw, sStage, 0);
+    MakeTone(0);
+
+    for (uint32_t i = 0; i < kIterations; i++) {
+        uint64_t t0 = NowNs();
+        float *slot = inPlace ? RightMicSwitch_Reserve(&sw, &ring, 0, kFrames) : NULL;
+        if (slot != NULL) {
+            memcpy(slot, sTone, (size_t)kFrames * channels * sizeof(float));
+            RightMicSwitch_Commit(&sw, &ring, kFrames);
+        } else {
+            memcpy(sRender, sTone, (size_t)kFrames * channels * sizeof(float));
+            RightMicSwitch_Write(&sw, &ring, 0, sRender, kFrames);
+        }
+        sSamples[i] = NowNs() - t0;
+    }
+    static const char *names[2][2] = {
+        { "capture write (buffered)",   "capture write (in place)" },
+        { "mono write (buffered)",      "mono write (in place)" },
+    };
+    Report(names[channels == 1][inPlace != 0], sSamples, kIterations, kFrames);
+    free(base);
+}
+
+/* Mono → stereo in place, as the capture callback does for a mono mic
+ * feeding a stereo ring: the scalar back-to-front loop it used to run
+ * against the vectorized kernel. */
+static void ExpandMonoScalar(float *buffer, uint32_t frameCount)
+{
+    for (uint32_t i = frameCount; i-- > 0;) {
+        float sample = buffer[i];
+        buffer[i * 2 + 1] = sample;
+        buffer[i * 2]     = sample;
+    }
+}
+
+static void BenchExpandMono(int vectorized)
+{
+    static float sBuffer[kFrames * kRightMic_ChannelCount];
+    MakeTone(0);
+    for (uint32_t i = 0; i < kIterations; i++) {
+        for (uint32_t f = 0; f < kFrames; f++) sBuffer[f] = sTone[f * kRightMic_ChannelCount];
+        uint64_t t0 = NowNs();
+        if (vectorized) {
+            RightMicRing_ExpandMono(sBuffer, sBuffer, kFrames);
+        } else {
+            ExpandMonoScalar(sBuffer, kFrames);
+        }
+        sSamples[i] = NowNs() - t0;
+        __asm__ __volatile__("" : : "r"(sBuffer) : "memory");  /* keep the scalar loop */
+    }
+    Report(vectorized ? "expand mono (vectorized)" : "expand mono (scalar)",
+           sSamples, kIterations, kFrames);
+}
+
+/* The level meter the capture callback runs on every block it writes. */
+static void BenchLevelFeed(void)
+{
+    static RightMicLevelMeter meter;
+    RightMicLevel_Init(&meter, kRightMic_SampleRate, kRightMicLevel_DefaultWindow);
+    MakeTone(0);
+    for (uint32_t i = 0; i < kIterations; i++) {
+        uint64_t t0 = NowNs();
+        RightMicLevel_Feed(&meter, sTone, kFrames, kRightMic_ChannelCount);
+        sSamples[i] = NowNs() - t0;
+    }
+    Report("level meter feed", sSamples, kIterations, kFrames);
+}
+
+/* ── Main ─────────────────────────────────────────────────────── */
+
+int main(void)
+{
+    printf("Kernel bench (%u frames per call, %u iterations)\n", kFrames, kIterations);
+    BenchCaptureWrite(0, kRightMic_ChannelCount);
+    BenchCaptureWrite(1, kRightMic_ChannelCount);
+    BenchCaptureWrite(0, 1);
+    BenchCaptureWrite(1, 1);
+    BenchExpandMono(0);
+    BenchExpandMono(1);
+    BenchLevelFeed();
+    BenchDriftRead(kRightMic_ChannelCount);
+    BenchDriftRead(1);
+    BenchDetectPeriod();
+    BenchConcealFill("conceal fill (fade out)",     kRightMicConceal_FadeOut);
+    BenchConcealFill("conceal fill (crossfade)",    kRightMicConceal_Crossfade);
+    BenchConcealFill("conceal fill (pitch repeat)", kRightMicConceal_PitchRepeat);
+    BenchConcealFill("conceal fill (silence)",      kRightMicConceal_Silence);
+    return 0;
+}
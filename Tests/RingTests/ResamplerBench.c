@@ -0,0 +1,233 @@
+/*
+ * ResamplerBench.c
+ * Cost and quality of the capture resampler (Driver/RightMicResampler.c)
+ * at each quality tier and for the device rates RightMic meets.
+ *
+ * Cost is the time per 512-frame stereo callback, median and worst, as
+ * in KernelBench.  Quality is measured against the ideal signal, which
+ * for a pure tone is known exactly at any rate:
+ *
+ *   THD+N    what is left of a 1 kHz tone once the tone itself is fitted
+ *            and removed, relative to the tone
+ *   ripple   spread of the gain over the tier's passband (peak-to-peak)
+ *   edge     gain at the passband's upper edge
+ *   leak     downsampling: the worst tone above the output's Nyquist
+ *            that gets through (aliases); upsampling: the worst THD+N
+ *            over the passband (images of the input spectrum)
+ *
+ * A Catmull-Rom cubic, the interpolator the driver's drift reader uses,
+ * is measured alongside as the baseline.
+ *
+ * Build and run with ./scripts/test-ring.sh --bench.
+ */
+
+#include "RightMicResampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kIterations 2000
+#define kFrames     512
+#define kToneFrames 32768
+#define kOutputRate 48000
+
+/* ── Time ─────────────────────────────────────────────────────── */
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* ── Converters ───────────────────────────────────────────────── */
+
+static float sStorage[kRightMicResampler_StorageFloats];
+
+/* The cubic baseline, as a converter with the same contract: output n
+ * sits on input time n × ratio.  Whole-signal only, which is all the
+ * quality measurements need. */
+static uint32_t CubicConvert(const float *in, uint32_t inFrames, double ratio,
+                             float *out, uint32_t outCapacity)
+{
+    uint32_t n = 0;
+    for (; n < outCapacity; n++) {
+        double   pos = (double)n * ratio;
+        uint32_t i   = (uint32_t)pos;
+        if (i + 2 >= inFrames) break;
+        float t  = (float)(pos - i);
+        float x0 = i > 0 ? in[i - 1] : 0.0f, x1 = in[i], x2 = in[i + 1], x3 = in[i + 2];
+        float a = -0.5f * x0 + 1.5f * x1 - 1.5f * x2 + 0.5f * x3;
+        float b =         x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+        float c = -0.5f * x0             + 0.5f * x2;
+        out[n] = ((a * t + b) * t + c) * t + x1;
+    }
+    return n;
+}
+
+/* Convert a mono signal with tier `quality`, or the cubic when < 0. */
+static uint32_t Convert(int quality, uint32_t inputRate, const float *in, uint32_t inFrames,
+                        float *out, uint32_t outCapacity, uint32_t *skip)
+{
+    if (quality < 0) {
+        *skip = 4;
+        return CubicConvert(in, inFrames, (double)inputRate / kOutputRate, out, outCapacity);
+    }
+    RightMicResampler rs;
+    RightMicResampler_Init(&rs, sStorage, inputRate, kOutputRate, 1, (RightMicResamplerQuality)quality);
+    *skip = (uint32_t)ceil((double)rs.taps * kOutputRate / inputRate);
+    return RightMicResampler_Process(&rs, in, inFrames, out, outCapacity, NULL);
+}
+
+/* ── Measurements ─────────────────────────────────────────────── */
+
+static float sIn[kToneFrames];
+static float sOut[kToneFrames * 4];
+
+/* Gain of `freq` through the converter (least-squares fit of the output
+ * to the ideal sine and cosine), and the THD+N left after removing the
+ * fit when `residual` is non-NULL.  Both in dB. */
+static double ToneGain(int quality, uint32_t inputRate, double freq, double *residual)
+{
+    for (uint32_t i = 0; i < kToneFrames; i++) {
+        sIn[i] = (float)(0.5 * sin(2.0 * M_PI * freq * i / inputRate));
+    }
+    uint32_t skip;
+    uint32_t n = Convert(quality, inputRate, sIn, kToneFrames, sOut, kToneFrames * 4, &skip);
+    n -= skip;  /* trailing window is as short as the leading one */
+
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    for (uint32_t i = skip; i < n; i++) {
+        double w = 2.0 * M_PI * freq * i / kOutputRate;
+        double s = sin(w), c = cos(w);
+        ss += s * s; sc += s * c; cc += c * c;
+        ys += sOut[i] * s; yc += sOut[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    double gain = sqrt(a * a + b * b) / 0.5;
+
+    if (residual != NULL) {
+        double err = 0, sig = 0;
+        for (uint32_t i = skip; i < n; i++) {
+            double w = 2.0 * M_PI * freq * i / kOutputRate;
+            double fit = a * sin(w) + b * cos(w);
+            err += (sOut[i] - fit) * (sOut[i] - fit);
+            sig += fit * fit;
+        }
+        *residual = 10.0 * log10(err / sig);
+    }
+    return 20.0 * log10(gain);
+}
+
+/* Level of a tone above the output's Nyquist after downsampling, in dB
+ * relative to the tone: what aliases through. */
+static double AliasLevel(int quality, uint32_t inputRate, double freq)
+{
+    for (uint32_t i = 0; i < kToneFrames; i++) {
+        sIn[i] = (float)(0.5 * sin(2.0 * M_PI * freq * i / inputRate));
+    }
+    uint32_t skip;
+    uint32_t n = Convert(quality, inputRate, sIn, kToneFrames, sOut, kToneFrames * 4, &skip);
+    n -= skip;
+    double sq = 0;
+    for (uint32_t i = skip; i < n; i++) sq += (double)sOut[i] * sOut[i];
+    return 10.0 * log10(sq / (n - skip) / (0.5 * 0.5 / 2.0));
+}
+
+/* Upper passband edge of a tier, as a fraction of the lower rate. */
+static double PassbandEdge(int quality)
+{
+    static const double edges[] = { 0.27, 0.35, 0.41 };
+    return quality < 0 ? 0.2 : edges[quality];
+}
+
+static void MeasureQuality(int quality, uint32_t inputRate)
+{
+    double lower = inputRate < kOutputRate ? inputRate : kOutputRate;
+    double edge  = PassbandEdge(quality) * lower;
+
+    double thdn;
+    ToneGain(quality, inputRate, 1000.0, &thdn);
+
+    double lo = INFINITY, hi = -INFINITY, edgeGain = 0, leak = -INFINITY;
+    for (int i = 0; i <= 16; i++) {
+        double freq = 50.0 + (edge - 50.0) * i / 16.0;
+        double images;
+        double g = ToneGain(quality, inputRate, freq, &images);
+        lo = fmin(lo, g);
+        hi = fmax(hi, g);
+        if (i == 16) edgeGain = g;
+        if (inputRate < kOutputRate) leak = fmax(leak, images);
+    }
+
+    /* Tones from just past the output's Nyquist to the input's. */
+    if (inputRate > kOutputRate) {
+        for (int i = 0; i < 8; i++) {
+            double freq = 0.52 * kOutputRate + (0.48 * inputRate - 0.52 * kOutputRate) * i / 7.0;
+            leak = fmax(leak, AliasLevel(quality, inputRate, freq));
+        }
+    }
+
+    static const char *names[] = { "voice", "balanced", "max" };
+    printf("  %6u Hz  %-8s  THD+N %7.1f dB  ripple %6.3f dB  edge %6.2f dB  leak %7.1f dB\n",
+           inputRate, quality < 0 ? "cubic" : names[quality], thdn, hi - lo, edgeGain, leak);
+}
+
+static void MeasureCost(int quality, uint32_t inputRate)
+{
+    static float in[kFrames * 8 * 2], out[kFrames * 8 * 2];
+    static uint64_t samples[kIterations];
+
+    RightMicResampler rs;
+    RightMicResampler_Init(&rs, sStorage, inputRate, kOutputRate, 2, (RightMicResamplerQuality)quality);
+    /* A device callback's worth of input that yields about kFrames out. */
+    uint32_t frames = (uint32_t)((double)kFrames * inputRate / kOutputRate);
+    for (uint32_t i = 0; i < frames * 2; i++) in[i] = (float)sin(i * 0.01);
+
+    uint64_t produced = 0;
+    for (uint32_t i = 0; i < kIterations; i++) {
+        uint64_t t0 = NowNs();
+        produced += RightMicResampler_Process(&rs, in, frames, out, kFrames * 8, NULL);
+        samples[i] = NowNs() - t0;
+    }
+    qsort(samples, kIterations, sizeof(samples[0]), CompareU64);
+    static const char *names[] = { "voice", "balanced", "max" };
+    double perFrame = (double)samples[kIterations / 2] * kIterations / (double)produced;
+    printf("  %6u Hz  %-8s  %3u taps %3u phases  median %7.2f us  max %8.2f us  (%5.2f ns/frame)\n",
+           inputRate, names[quality], rs.taps, rs.phases,
+           (double)samples[kIterations / 2] / 1e3, (double)samples[kIterations - 1] / 1e3, perFrame);
+}
+
+/* ── Main ─────────────────────────────────────────────────────── */
+
+int main(void)
+{
+    static const uint32_t rates[] = { 44100, 16000, 24000, 96000, 11025 };
+    const size_t count = sizeof(rates) / sizeof(rates[0]);
+
+    printf("Resampler cost (stereo, ~%u output frames per call, %u iterations)\n",
+           kFrames, kIterations);
+    for (size_t r = 0; r < count; r++) {
+        for (int q = kRightMicResampler_Voice; q <= kRightMicResampler_Max; q++) {
+            MeasureCost(q, rates[r]);
+        }
+    }
+
+    printf("Resampler quality (to %u Hz, against the ideal signal)\n", kOutputRate);
+    for (size_t r = 0; r < count; r++) {
+        for (int q = -1; q <= kRightMicResampler_Max; q++) {
+            MeasureQuality(q, rates[r]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+/*
+ * RingBench.c
+ * Real-time producer/consumer benchmark for the portable ring buffer core.
+ *
+ * Forks a producer process (standing in for the app's auInputCallback)
+ * and a consumer process (standing in for the driver's DoIOOperation).
+ * Both map the same file in the paged layout — mirrored where the kernel
+ * allows, the consumer read-only, exactly like the app and the driver —
+ * and run at audio cadence on absolute deadlines.  The consumer
+ * reads through RightMicDrift like the driver does, and --drift skews the
+ * producer's clock to exercise it.  At the end the parent reports
+ * throughput, wakeup jitter, per-call hot-path cost, underruns, overruns,
+ * stream discontinuities, the drift correction the consumer settled on and
+ * the end-to-end latency: from when a frame was captured to when the
+ * consumer hands it to its client.  Run it with --period 512 and with
+ * --period 64 to see what small IO buffers save.
+ *
+ * Build and run with ./scripts/test-ring.sh --bench [options].
+ */
+
+#include "RightMicDrift.h"
+#include "RightMicMirror.h"
+#include "RightMicRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define kMaxSamples (1u << 18)  /* per-role timing samples kept for percentiles */
+#define kIndexWrap  (1u << 20)  /* keeps ≥ 1/8-frame precision for interpolated values */
+
+/* ── Options ──────────────────────────────────────────────────── */
+
+typedef struct {
+    double      seconds;
+    uint32_t    period;          /* consumer frames per IO cycle       */
+    uint32_t    producerPeriod;  /* producer frames per callback       */
+    double      sampleRate;
+    double      driftPPM;        /* producer clock offset              */
+    const char *path;
+} BenchOptions;
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--seconds S] [--period N] [--producer-period N] [--rate HZ]\n"
+            "          [--drift PPM] [--file PATH]\n",
+            argv0);
+    exit(2);
+}
+
+static BenchOptions ParseOptions(int argc, char **argv)
+{
+    BenchOptions o = { 10.0, kRightMic_BufferFrameSize, 0, kRightMic_SampleRate, 0.0, NULL };
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) Usage(argv[0]);
+        const char *val = argv[++i];
+        if      (strcmp(arg, "--seconds") == 0)         o.seconds = atof(val);
+        else if (strcmp(arg, "--period") == 0)          o.period = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--producer-period") == 0) o.producerPeriod = (uint32_t)atoi(val);
+        else if (strcmp(arg, "--rate") == 0)            o.sampleRate = atof(val);
+        else if (strcmp(arg, "--drift") == 0)           o.driftPPM = atof(val);
+        else if (strcmp(arg, "--file") == 0)            o.path = val;
+        else Usage(argv[0]);
+    }
+    if (o.producerPeriod == 0) o.producerPeriod = o.period;
+    if (o.seconds <= 0 || o.period == 0 || o.period > 4096 || o.producerPeriod > 4096 ||
+        o.sampleRate <= 0 || fabs(o.driftPPM) >= kRightMicDrift_MaxPPM) {
+        Usage(argv[0]);
+    }
+    return o;
+}
+
+/* ── Shared Results ───────────────────────────────────────────── */
+
+typedef struct {
+    uint64_t frames;
+    uint64_t wakeups;
+    uint64_t underruns;
+    uint64_t concealed;               /* frames the consumer synthesised  */
+    uint64_t overruns;
+    uint64_t torn;                    /* of those, caught after the copy  */
+    uint64_t inactive;
+    uint64_t discontinuities;
+    uint64_t elapsedNs;
+    double   driftPPM;                /* consumer's final correction      */
+    double   minPPM, maxPPM;          /* range after the first second     */
+    double   fill;                    /* consumer's filtered fill level   */
+    double   target;                  /* consumer's target fill level     */
+    uint32_t samples;                 /* entries used in the arrays below */
+    uint32_t latenessNs[kMaxSamples]; /* wakeup minus deadline            */
+    uint32_t callNs[kMaxSamples];     /* time spent inside Write / Read   */
+    uint32_t latencies;               /* entries used in latencyNs        */
+    uint32_t latencyNs[kMaxSamples];  /* capture to delivery, oldest frame */
+} RoleStats;
+
+typedef struct {
+    RoleStats producer;
+    RoleStats consumer;
+} BenchResults;
+
+/* ── Time ─────────────────────────────────────────────────────── */
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void SleepUntil(uint64_t deadlineNs)
+{
+    struct timespec ts = {
+        .tv_sec  = (time_t)(deadlineNs / 1000000000ull),
+        .tv_nsec = (long)(deadlineNs % 1000000000ull),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static void RecordSample(RoleStats *s, uint64_t lateness, uint64_t call)
+{
+    if (s->samples >= kMaxSamples) return;
+    s->latenessNs[s->samples] = lateness > UINT32_MAX ? UINT32_MAX : (uint32_t)lateness;
+    s->callNs[s->samples]     = call > UINT32_MAX ? UINT32_MAX : (uint32_t)call;
+    s->samples++;
+}
+
+static void RecordLatency(RoleStats *s, double latencyNs)
+{
+    if (s->latencies >= kMaxSamples || latencyNs < 0) return;
+    s->latencyNs[s->latencies++] = latencyNs > UINT32_MAX ? UINT32_MAX : (uint32_t)latencyNs;
+}
+
+/* ── Mapping ──────────────────────────────────────────────────── */
+
+static void MapRegion(const char *path, int writable, RightMicMirror *map, RightMicRing *ring)
+{
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        exit(1);
+    }
+    bool ok = RightMicMirror_Map(map, fd, kRightMic_SharedMemorySizePaged,
+                                 kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, writable);
+    close(fd);
+    if (!ok) {
+        perror("mmap");
+        exit(1);
+    }
+    RightMicRing_AttachAt(ring, map->base, kRightMic_PagedDataOffset,
+                          kRightMic_RingBufferFrames, kRightMic_ChannelCount, map->mirrored);
+}
+
+/* ── Producer ─────────────────────────────────────────────────── */
+
+static void RunProducer(const BenchOptions *o, uint64_t startNs, RoleStats *stats)
+{
+    RightMicMirror map;
+    RightMicRing ring;
+    MapRegion(o->path, 1, &map, &ring);
+    RightMicRing_InitProducer(&ring, (uint32_t)o->sampleRate, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    float *buf = calloc((size_t)o->producerPeriod * kRightMic_ChannelCount, sizeof(float));
+    double periodNs = (double)o->producerPeriod / (o->sampleRate * (1.0 + o->driftPPM * 1e-6)) * 1e9;
+    uint64_t endNs  = startNs + (uint64_t)(o->seconds * 1e9);
+    uint64_t frame  = 0;
+
+    for (uint64_t n = 0;; n++) {
+        uint64_t deadline = startNs + (uint64_t)((double)n * periodNs);
+        if (deadline >= endNs) break;
+        SleepUntil(deadline);
+        uint64_t woke = NowNs();
+
+        for (uint32_t i = 0; i < o->producerPeriod; i++) {
+            float v = (float)((frame + i) % kIndexWrap);
+            for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+                buf[i * kRightMic_ChannelCount + c] = v;
+            }
+        }
+        uint64_t t0 = NowNs();
+        RightMicRing_Write(&ring, buf, o->producerPeriod);
+        uint64_t t1 = NowNs();
+
+        frame += o->producerPeriod;
+        stats->wakeups++;
+        RecordSample(stats, woke - deadline, t1 - t0);
+    }
+
+    stats->frames    = frame;
+    stats->elapsedNs = NowNs() - startNs;
+    RightMicRing_SetActive(&ring, false);
+    free(buf);
+    RightMicMirror_Unmap(&map);
+}
+
+/* ── Consumer ─────────────────────────────────────────────────── */
+
+static void RunConsumer(const BenchOptions *o, uint64_t startNs, RoleStats *stats)
+{
+    RightMicMirror map;
+    RightMicRing ring;
+    MapRegion(o->path, 0, &map, &ring);
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    uint32_t target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, o->period, kRightMic_RingBufferFrames);
+    RightMicDrift_Init(&drift, target, minSafe);
+
+    float *out = calloc((size_t)o->period * kRightMic_ChannelCount, sizeof(float));
+    double periodNs = (double)o->period / o->sampleRate * 1e9;
+    /* The producer's frame clock: frame f was sampled one frame period
+     * after f - 1, and the callback that writes it runs once the rest of
+     * its burst has been sampled too. */
+    double frameNs  = 1e9 / (o->sampleRate * (1.0 + o->driftPPM * 1e-6));
+    /* Start half a period behind the producer so the two never wake in lock-step. */
+    uint64_t firstNs = startNs + (uint64_t)(periodNs / 2);
+    uint64_t endNs   = startNs + (uint64_t)(o->seconds * 1e9);
+    double   prev    = -1;  /* last sample value, -1 after a gap */
+    uint32_t blend   = 0;   /* frames still crossfading out of concealment */
+    stats->minPPM = INFINITY;
+    stats->maxPPM = -INFINITY;
+
+    for (uint64_t n = 0;; n++) {
+        uint64_t deadline = firstNs + (uint64_t)((double)n * periodNs);
+        if (deadline >= endNs) break;
+        SleepUntil(deadline);
+        uint64_t woke = NowNs();
+
+        uint64_t t0 = NowNs();
+        RightMicRingReadStatus st = RightMicDrift_Read(&drift, &ring, &reader, out, o->period);
+        uint64_t t1 = NowNs();
+
+        stats->wakeups++;
+        RecordSample(stats, woke - deadline, t1 - t0);
+
+        switch (st) {
+        case kRightMicRingRead_Inactive: stats->inactive++;  blend = kRightMicConceal_OverlapFrames; continue;
+        case kRightMicRingRead_Underrun: stats->underruns++; blend = kRightMicConceal_OverlapFrames; continue;
+        case kRightMicRingRead_Overflow: stats->overruns++; prev = -1; break;
+        case kRightMicRingRead_Filled:   break;
+        }
+
+        /* The first frame of the buffer is its oldest.  Samples carry their
+         * frame index modulo kIndexWrap; unwrap it against the producer's
+         * clock, which is far closer than half a wrap. */
+        if (blend == 0) {
+            double now      = (double)(t1 - startNs);
+            double expected = now / frameNs;
+            double v        = out[0];
+            double index    = v + kIndexWrap * floor((expected - v) / kIndexWrap + 0.5);
+            RecordLatency(stats, now - (index + 1.0 - o->producerPeriod) * frameNs);
+        }
+
+        /* Samples carry their frame index, so consecutive outputs should step
+         * by the resampling ratio.  Skip the few frames around the index wrap,
+         * where the interpolator straddles it, and the crossfade out of a gap. */
+        for (uint32_t i = 0; i < o->period; i++) {
+            double v = out[i * kRightMic_ChannelCount];
+            if (blend > 0) {
+                blend--;
+                prev = -1;
+                continue;
+            }
+            int nearWrap = v < 4 || v > kIndexWrap - 4 || prev < 4 || prev > kIndexWrap - 4;
+            if (prev >= 0 && !nearWrap && fabs(v - prev - drift.ratio) > 0.5) {
+                stats->discontinuities++;
+            }
+            prev = v;
+        }
+        stats->frames += o->period;
+
+        if ((double)(deadline - firstNs) > 1e9) {
+            double ppm = RightMicDrift_PPM(&drift);
+            if (ppm < stats->minPPM) stats->minPPM = ppm;
+            if (ppm > stats->maxPPM) stats->maxPPM = ppm;
+        }
+    }
+
+    stats->elapsedNs = NowNs() - startNs;
+    stats->concealed = reader.concealedFrames;
+    stats->torn      = reader.tornCount;
+    stats->driftPPM  = RightMicDrift_PPM(&drift);
+    stats->fill      = drift.filteredFill;
+    stats->target    = drift.targetFill;
+    free(out);
+    RightMicMirror_Unmap(&map);
+}
+
+/* ── Report ───────────────────────────────────────────────────── */
+
+static int CompareU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void PrintDistribution(const char *label, uint32_t *values, uint32_t n)
+{
+    if (n == 0) {
+        printf("  %-16s (no samples)\n", label);
+        return;
+    }
+    qsort(values, n, sizeof(uint32_t), CompareU32);
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++) sum += values[i];
+    printf("  %-16s mean %8.2f us  p50 %8.2f us  p99 %8.2f us  max %8.2f us\n", label,
+           sum / n / 1000.0, values[n / 2] / 1000.0, values[(uint32_t)((n - 1) * 0.99)] / 1000.0,
+           values[n - 1] / 1000.0);
+}
+
+static void PrintRole(const char *name, RoleStats *s, double sampleRate)
+{
+    double secs = (double)s->elapsedNs / 1e9;
+    double fps  = secs > 0 ? (double)s->frames / secs : 0;
+    printf("%s: %llu frames in %.2f s = %.0f frames/s (%.4fx real time), %llu wakeups\n", name,
+           (unsigned long long)s->frames, secs, fps, fps / sampleRate,
+           (unsigned long long)s->wakeups);
+    PrintDistribution("wakeup jitter", s->latenessNs, s->samples);
+    PrintDistribution("call cost", s->callNs, s->samples);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions o = ParseOptions(argc, argv);
+
+    char tmpPath[] = "/tmp/rightmic-bench.XXXXXX";
+    int ownsFile = (o.path == NULL);
+    if (ownsFile) {
+        int fd = mkstemp(tmpPath);
+        if (fd < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+        close(fd);
+        o.path = tmpPath;
+    }
+    int fd = open(o.path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)kRightMic_SharedMemorySizePaged) != 0) {
+        perror(o.path);
+        return 1;
+    }
+    close(fd);
+
+    BenchResults *results = mmap(NULL, sizeof(BenchResults), PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        perror("mmap results");
+        return 1;
+    }
+    memset(results, 0, sizeof(*results));
+
+    printf("RightMicRing bench: %.1f s, %.0f Hz, consumer period %u, producer period %u, "
+           "producer drift %+.0f ppm, ring %u frames\n",
+           o.seconds, o.sampleRate, o.period, o.producerPeriod, o.driftPPM,
+           kRightMic_RingBufferFrames);
+
+    /* Common start time so both processes run on the same deadline grid. */
+    uint64_t startNs = NowNs() + 100000000ull;
+
+    pid_t producer = fork();
+    if (producer == 0) {
+        RunProducer(&o, startNs, &results->producer);
+        _exit(0);
+    }
+    pid_t consumer = fork();
+    if (consumer == 0) {
+        RunConsumer(&o, startNs, &results->consumer);
+        _exit(0);
+    }
+
+    int status = 0, failed = 0;
+    waitpid(producer, &status, 0);
+    failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    waitpid(consumer, &status, 0);
+    failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    if (ownsFile) unlink(tmpPath);
+    if (failed) {
+        fprintf(stderr, "bench child failed\n");
+        return 1;
+    }
+
+    PrintRole("producer", &results->producer, o.sampleRate);
+    PrintRole("consumer", &results->consumer, o.sampleRate);
+    printf("consumer: %llu underruns (%llu frames concealed), %llu overruns (%llu torn mid-copy), "
+           "%llu inactive, %llu discontinuities\n",
+           (unsigned long long)results->consumer.underruns,
+           (unsigned long long)results->consumer.concealed,
+           (unsigned long long)results->consumer.overruns,
+           (unsigned long long)results->consumer.torn,
+           (unsigned long long)results->consumer.inactive,
+           (unsigned long long)results->consumer.discontinuities);
+    printf("consumer: drift correction %+.1f ppm (range %+.1f .. %+.1f), fill %.0f frames (target %.0f)\n",
+           results->consumer.driftPPM, results->consumer.minPPM, results->consumer.maxPPM,
+           results->consumer.fill, results->consumer.target);
+    /* A client's buffer is complete once its last frame has been sampled,
+     * so its oldest frame has been waiting one period by then at best. */
+    printf("end-to-end latency (capture to client, oldest frame of each buffer; buffers alone %.2f ms):\n",
+           (double)(o.producerPeriod + o.period) / o.sampleRate * 1000.0);
+    PrintDistribution("latency", results->consumer.latencyNs, results->consumer.latencies);
+    return 0;
+}
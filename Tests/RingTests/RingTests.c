@@ -0,0 +1,3083 @@
+/*
+ * RingTests.c
+ * Unit tests for the portable ring buffer core (Driver/RightMicRing.c),
+ * drift compensation, underrun concealment, device-switch crossfades,
+ * the driver's read cursor, the mirrored mapping, the driver's
+ * background attach, its control snapshot, the glitch metrics, the
+ * capture level meter, the capture resampler and the capture clock
+ * estimator.
+ *
+ * Plain C with no test framework so it runs anywhere a C11 compiler does.
+ * Build and run with ./scripts/test-ring.sh.
+ */
+
+#include "RightMicAttach.h"
+#include "RightMicClock.h"
+#include "RightMicControls.h"
+#include "RightMicCursor.h"
+#include "RightMicDrift.h"
+#include "RightMicLevel.h"
+#include "RightMicMetrics.h"
+#include "RightMicMirror.h"
+#include "RightMicResampler.h"
+#include "RightMicRing.h"
+#include "RightMicShm.h"
+#include "RightMicSwitch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static int sFailures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        sFailures++; \
+    } \
+} while (0)
+
+#define RUN(test) do { printf("  %s\n", #test); test(); } while (0)
+
+/* ── Helpers ──────────────────────────────────────────────────── */
+
+/* Heap-backed stand-in for the shared mapping, cache-line aligned like it. */
+static void *AllocRegion(void)
+{
+    void *base = aligned_alloc(kRightMic_CacheLineSize, kRightMic_SharedMemorySize);
+    if (base == NULL) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    memset(base, 0, kRightMic_SharedMemorySize);
+    return base;
+}
+
+/* Write `frameCount` frames whose samples encode their absolute frame index. */
+static void WriteIndexed(RightMicRing *ring, uint64_t firstFrame, uint32_t frameCount)
+{
+    float buf[1024 * kRightMic_ChannelCount];
+    while (frameCount > 0) {
+        uint32_t chunk = frameCount > 1024 ? 1024 : frameCount;
+        for (uint32_t i = 0; i < chunk; i++) {
+            for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+                buf[i * kRightMic_ChannelCount + c] = (float)(firstFrame + i);
+            }
+        }
+        RightMicRing_Write(ring, buf, chunk);
+        firstFrame += chunk;
+        frameCount -= chunk;
+    }
+}
+
+/* WriteIndexed for a ring the producer declared mono. */
+static void WriteIndexedMono(RightMicRing *ring, uint64_t firstFrame, uint32_t frameCount)
+{
+    float buf[1024];
+    while (frameCount > 0) {
+        uint32_t chunk = frameCount > 1024 ? 1024 : frameCount;
+        for (uint32_t i = 0; i < chunk; i++) buf[i] = (float)(firstFrame + i);
+        RightMicRing_Write(ring, buf, chunk);
+        firstFrame += chunk;
+        frameCount -= chunk;
+    }
+}
+
+static int IsSilent(const float *buf, uint32_t frameCount)
+{
+    for (uint32_t i = 0; i < frameCount * kRightMic_ChannelCount; i++) {
+        if (buf[i] != 0.0f) return 0;
+    }
+    return 1;
+}
+
+static int IsSequential(const float *buf, uint32_t frameCount, uint64_t firstFrame)
+{
+    for (uint32_t i = 0; i < frameCount; i++) {
+        for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+            if (buf[i * kRightMic_ChannelCount + c] != (float)(firstFrame + i)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* ── Ring Protocol ────────────────────────────────────────────── */
+
+static void testDetachedRingReadsSilence(void)
+{
+    RightMicRing ring = {0};
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+
+    float out[512 * kRightMic_ChannelCount];
+    memset(out, 0xff, sizeof(out));
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Inactive);
+    CHECK(IsSilent(out, 512));
+}
+
+static void testInactiveRingReadsSilence(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    WriteIndexed(&ring, 0, 1024);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Inactive);
+    CHECK(IsSilent(out, 512));
+    free(base);
+}
+
+static void testInitProducerWritesFormat(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 44100, 1);
+    CHECK(ring.header->sampleRate == 44100);
+    CHECK(ring.header->channels == 1);
+    CHECK(ring.header->writeHead == 0);
+    CHECK((uint8_t *)ring.data == (uint8_t *)base + sizeof(RightMicRingBufferHeader));
+    free(base);
+}
+
+static void testHeaderLayoutIsVersioned(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRingBufferHeader *h = ring.header;
+    CHECK(!RightMicRing_IsCompatible(h));  /* zeroed: nothing published yet */
+
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    CHECK(RightMicRing_IsCompatible(h));
+    CHECK(h->dataOffset == sizeof(RightMicRingBufferHeader));
+    CHECK(((uintptr_t)ring.data % kRightMic_CacheLineSize) == 0);
+
+    /* Producer, consumer and control fields never share a line. */
+    uintptr_t producer = (uintptr_t)&h->writeHead / kRightMic_CacheLineSize;
+    CHECK((uintptr_t)&h->active / kRightMic_CacheLineSize == producer);
+    CHECK((uintptr_t)&h->readHead / kRightMic_CacheLineSize != producer);
+    CHECK((uintptr_t)&h->muted / kRightMic_CacheLineSize != producer);
+    CHECK((uintptr_t)&h->concealMode / kRightMic_CacheLineSize ==
+          (uintptr_t)&h->muted / kRightMic_CacheLineSize);
+    CHECK((uintptr_t)&h->sampleRate / kRightMic_CacheLineSize !=
+          (uintptr_t)&h->muted / kRightMic_CacheLineSize);
+
+    h->version = 2;
+    CHECK(!RightMicRing_IsCompatible(h));
+    h->version = kRightMic_RingVersion;
+    h->dataOffset = sizeof(RightMicRingBufferHeader) + 4;
+    CHECK(!RightMicRing_IsCompatible(h));
+    free(base);
+}
+
+static void testSteadyStateRoundTrip(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+
+    /* First read syncs one buffer behind the writer. */
+    WriteIndexed(&ring, 0, 1024);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 512, 512));
+
+    /* Lock-step producer/consumer stays sequential across many wraps. */
+    uint64_t next = 1024;
+    int sequential = 1;
+    for (int i = 0; i < 200; i++) {
+        WriteIndexed(&ring, next, 512);
+        next += 512;
+        if (RightMicRing_Read(&ring, &reader, out, 512) != kRightMicRingRead_Filled ||
+            !IsSequential(out, 512, next - 512)) {
+            sequential = 0;
+        }
+    }
+    CHECK(sequential);
+    CHECK(reader.overflowCount == 0);
+    CHECK(reader.underrunCount == 0);
+    free(base);
+}
+
+static void testWrapAroundSplitsCopy(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    /* Park the writer 100 frames before the physical end of the ring. */
+    uint64_t start = kRightMic_RingBufferFrames - 100;
+    atomic_store(&ring.header->writeHead, start);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = start;
+
+    WriteIndexed(&ring, start, 300);
+    float out[300 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 300) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 300, start));
+    CHECK(reader.readHead == start + 300);
+    free(base);
+}
+
+static void testSmallRingWrapsAtItsCapacity(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, base, sizeof(RightMicRingBufferHeader),
+                          kRightMic_MinRingFrames, kRightMic_ChannelCount, false);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    CHECK(ring.header->ringFrames == kRightMic_MinRingFrames);
+    CHECK(ring.header->frameBytes == kRightMic_BytesPerFrame);
+    CHECK(RightMicRing_IsCompatible(ring.header));
+    CHECK(RightMicRing_MatchesHeader(&ring));
+
+    /* Writes and reads wrap at the header's capacity, not the default. */
+    uint64_t start = kRightMic_MinRingFrames - 100;
+    atomic_store(&ring.header->writeHead, start);
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = start;
+    WriteIndexed(&ring, start, 300);
+    float out[300 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 300) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 300, start));
+    CHECK(((float *)ring.data)[0] == (float)kRightMic_MinRingFrames);
+    CHECK(RightMicRing_Reserve(&ring, 900) == NULL);  /* 200 + 900 > 1024 */
+
+    /* Falling more than a ring behind is an overflow at this size already. */
+    WriteIndexed(&ring, start + 300, kRightMic_MinRingFrames + 1);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 256) == kRightMicRingRead_Overflow);
+    free(base);
+}
+
+static void testRingFramesAreClamped(void)
+{
+    CHECK(RightMicRing_ClampFrames(0) == kRightMic_RingBufferFrames);
+    CHECK(RightMicRing_ClampFrames(1) == kRightMic_MinRingFrames);
+    CHECK(RightMicRing_ClampFrames(1024) == 1024);
+    CHECK(RightMicRing_ClampFrames(1025) == 2048);
+    CHECK(RightMicRing_ClampFrames(65536) == 65536);
+    CHECK(RightMicRing_ClampFrames(100000) == 131072);
+    CHECK(RightMicRing_ClampFrames(UINT32_MAX) == kRightMic_MaxRingFrames);
+
+    /* A header naming a capacity ClampFrames would not pick, or another */
+    /* frame size, is not one this driver can read. */
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRingBufferHeader *h = ring.header;
+    h->ringFrames = 3000;
+    CHECK(!RightMicRing_IsCompatible(h));
+    h->ringFrames = kRightMic_MaxRingFrames * 2;
+    CHECK(!RightMicRing_IsCompatible(h));
+    h->ringFrames = kRightMic_RingBufferFrames;
+    h->frameBytes = sizeof(float);
+    CHECK(!RightMicRing_IsCompatible(h));
+    h->frameBytes = kRightMic_BytesPerFrame;
+    CHECK(RightMicRing_IsCompatible(h));
+    free(base);
+}
+
+static void testReserveCommitPublishesInPlace(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = 0;
+
+    /* Frames rendered into the reservation read back like a Write, but
+     * only once committed. */
+    float *slot = RightMicRing_Reserve(&ring, 512);
+    CHECK(slot == ring.data);
+    for (uint32_t i = 0; i < 512 * kRightMic_ChannelCount; i++) {
+        slot[i] = (float)(i / kRightMic_ChannelCount);
+    }
+    CHECK(atomic_load(&ring.header->writeHead) == 0);
+    RightMicRing_Commit(&ring, 512);
+    CHECK(atomic_load(&ring.header->writeHead) == 512);
+
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 512, 0));
+
+    /* A span that would wrap can't be handed out contiguously. */
+    atomic_store(&ring.header->writeHead, kRightMic_RingBufferFrames - 100);
+    CHECK(RightMicRing_Reserve(&ring, 101) == NULL);
+    CHECK(RightMicRing_Reserve(&ring, 100) != NULL);
+    free(base);
+}
+
+static void testExpandMonoMatchesScalar(void)
+{
+    float src[67], dst[2 * 67], inPlace[2 * 67];
+    for (uint32_t i = 0; i < 67; i++) src[i] = (float)i - 33.5f;
+
+    /* Every tail length, out of place and in place. */
+    int ok = 1;
+    for (uint32_t n = 0; n <= 67; n++) {
+        memset(dst, 0xff, sizeof(dst));
+        RightMicRing_ExpandMono(dst, src, n);
+        memcpy(inPlace, src, n * sizeof(float));
+        RightMicRing_ExpandMono(inPlace, inPlace, n);
+        for (uint32_t i = 0; i < n; i++) {
+            if (dst[2 * i] != src[i] || dst[2 * i + 1] != src[i] ||
+                inPlace[2 * i] != src[i] || inPlace[2 * i + 1] != src[i]) ok = 0;
+        }
+        if (n < 67 && !isnan(dst[2 * n])) ok = 0;  /* nothing past the end */
+    }
+    CHECK(ok);
+}
+
+static void testMonoRingReadsAsStereo(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, 1);
+    RightMicRing_SetActive(&ring, true);
+    CHECK(ring.channels == 1);
+    CHECK(RightMicRing_Channels(ring.header) == 1);
+
+    /* One sample per frame in the ring, two per frame out of it, across
+     * the physical end. */
+    uint64_t start = kRightMic_RingBufferFrames - 100;
+    atomic_store(&ring.header->writeHead, start);
+    WriteIndexedMono(&ring, start, 300);
+    CHECK(ring.data[0] == (float)(start + 100));
+    CHECK(ring.data[kRightMic_RingBufferFrames - 1] == (float)(start + 99));
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = start;
+    float out[300 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 300) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 300, start));
+
+    /* Reservations are mono-sized and still can't wrap. */
+    atomic_store(&ring.header->writeHead, kRightMic_RingBufferFrames - 100);
+    CHECK(RightMicRing_Reserve(&ring, 100) == ring.data + kRightMic_RingBufferFrames - 100);
+    CHECK(RightMicRing_Reserve(&ring, 101) == NULL);
+
+    /* Anything but mono in the header means full-width frames. */
+    ring.header->channels = 0;
+    CHECK(RightMicRing_Channels(ring.header) == kRightMic_ChannelCount);
+    free(base);
+}
+
+static void testUnderrunWritesSilenceAndHoldsCursor(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+
+    /* Less than a buffer before the first sync is priming, not an underrun. */
+    WriteIndexed(&ring, 0, 256);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Inactive);
+    CHECK(IsSilent(out, 512));
+    CHECK(reader.readHead == 0 && reader.underrunCount == 0 && reader.concealedFrames == 0);
+
+    WriteIndexed(&ring, 256, 768);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    uint64_t head = reader.readHead;
+
+    /* Writer stalls: nothing new to read. */
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Underrun);
+    CHECK(IsSilent(out, 512));
+    CHECK(reader.readHead == head);
+    CHECK(reader.underrunCount == 1);
+    free(base);
+}
+
+static void testOverflowResyncsBehindWriter(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+
+    WriteIndexed(&ring, 0, 1024);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+
+    /* Writer laps the reader by more than a full ring. */
+    uint64_t next = 1024;
+    for (int i = 0; i < (kRightMic_RingBufferFrames / 512) + 2; i++) {
+        WriteIndexed(&ring, next, 512);
+        next += 512;
+    }
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Overflow);
+    CHECK(IsSequential(out, 512, next - 512));
+    CHECK(reader.overflowCount == 1);
+    free(base);
+}
+
+static void testWriterResetResyncs(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+
+    WriteIndexed(&ring, 0, 8192);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+
+    /* Device switch: the app re-initialises the ring and starts over at 0. */
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    WriteIndexed(&ring, 0, 1024);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 512, 512));
+    free(base);
+}
+
+static void testMuteFlag(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetMuted(&ring, true);
+    CHECK(ring.header->muted == 1);
+    RightMicRing_SetMuted(&ring, false);
+    CHECK(ring.header->muted == 0);
+    free(base);
+}
+
+/* ── Drift Compensation ───────────────────────────────────────── */
+
+static void testDriftSyncsAtTargetAndPassesThrough(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+
+    /* Fill exactly at target → zero error → ratio 1 → samples unchanged. */
+    WriteIndexed(&ring, 0, 2048);
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(drift.ratio == 1.0);
+    CHECK(IsSequential(out, 512, 512));
+    CHECK(reader.readHead == 1024);
+    free(base);
+}
+
+/* Until the writer is a target ahead there is nothing to play yet: the
+ * reader serves silence without counting underruns, so every IO start
+ * doesn't show up in the glitch statistics. */
+static void testDriftPrimingIsNotAnUnderrun(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+
+    float out[512 * kRightMic_ChannelCount];
+    for (uint32_t i = 0; i < 3; i++) {
+        WriteIndexed(&ring, 512 * (uint64_t)i, 512);
+        CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Inactive);
+        CHECK(IsSilent(out, 512));
+    }
+    CHECK(reader.underrunCount == 0);
+    CHECK(reader.concealedFrames == 0);
+
+    WriteIndexed(&ring, 1536, 512);
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    uint32_t k = kRightMicConceal_OverlapFrames;  /* fading in from the silence */
+    CHECK(IsSequential(out + k * kRightMic_ChannelCount, 512 - k, 512 + k));
+    CHECK(reader.underrunCount == 0);
+    free(base);
+}
+
+static void testDriftPartialReadConcealsDeficit(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+
+    /* 1536 behind → two full reads, then 512 frames remain: the
+     * interpolator's look-ahead leaves 510 playable and 2 to conceal. */
+    WriteIndexed(&ring, 0, 2048);
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    double pos = (double)reader.readHead + drift.phase;
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Underrun);
+    for (uint32_t i = 0; i < 510; i++) {
+        CHECK(fabs(out[i * kRightMic_ChannelCount] - (pos + i * drift.ratio)) < 0.01);
+    }
+    CHECK(reader.underrunCount == 1);
+    CHECK(reader.concealedFrames == 2);
+    CHECK(!drift.refilling);
+    free(base);
+}
+
+static void testDriftRefillsToTargetAfterStall(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+
+    float out[512 * kRightMic_ChannelCount];
+    WriteIndexed(&ring, 0, 2048);
+    for (int i = 0; i < 3; i++) RightMicDrift_Read(&drift, &ring, &reader, out, 512);
+
+    /* Producer stalls: the fill falls below minSafe, so the reader holds
+     * position and conceals. */
+    uint64_t head = reader.readHead;
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Underrun);
+    CHECK(drift.refilling);
+    CHECK(reader.readHead == head);
+    double resumeAt = (double)reader.readHead + drift.phase;
+
+    /* Back above minSafe but still short of target: keep concealing. */
+    WriteIndexed(&ring, 2048, 512);
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Underrun);
+    CHECK(reader.readHead == head);
+
+    /* Target reached: resume where playback stopped, crossfading out of
+     * the concealment over the first kRightMicConceal_OverlapFrames. */
+    WriteIndexed(&ring, 2560, 1024);
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(!drift.refilling);
+    uint32_t k = kRightMicConceal_OverlapFrames;
+    CHECK(fabs(out[k * kRightMic_ChannelCount] - (resumeAt + k * drift.ratio)) < 0.01);
+    CHECK(reader.underrunCount == 3);
+    free(base);
+}
+
+static void testDriftServesPrimedSilenceAfterIdle(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    WriteIndexed(&ring, 0, 8192);
+
+    /* Nobody listening: the app stops capturing and idles the ring. */
+    RightMicRing_SetActive(&ring, false);
+    RightMicRing_Clear(&ring);
+    CHECK(IsSilent(ring.data, kRightMic_RingBufferFrames));
+
+    /* A client starts.  The app primes a target's worth of silence and
+     * goes active before its capture unit delivers anything, so the first
+     * cycles are served from the ring rather than concealed. */
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+    RightMicRing_WriteSilence(&ring, 1536);
+    RightMicRing_SetActive(&ring, true);
+
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(IsSilent(out, 512));
+
+    /* Capture follows the silence without a gap. */
+    for (int i = 0; i < 3; i++) {
+        WriteIndexed(&ring, 9728 + 512 * (uint64_t)i, 512);
+        CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Filled);
+        CHECK(i < 2 ? IsSilent(out, 512) : IsSequential(out, 512, 9728));
+    }
+    CHECK(reader.underrunCount == 0);
+    free(base);
+}
+
+/* The resampler expands a mono ring as it interpolates, both where its
+ * taps wrap and where they don't. */
+static void testDriftExpandsMonoRing(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, 1);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+
+    /* The first read syncs 1536 behind the writer, 100 before the end,
+     * so it wraps; the second doesn't. */
+    uint64_t first = kRightMic_RingBufferFrames - 612;
+    atomic_store(&ring.header->writeHead, first);
+    WriteIndexedMono(&ring, first, 2048);
+
+    float out[256 * kRightMic_ChannelCount];
+    int ok = 1;
+    for (uint64_t i = 0; i < 2; i++) {
+        if (RightMicDrift_Read(&drift, &ring, &reader, out, 256) != kRightMicRingRead_Filled ||
+            !IsSequential(out, 256, first + 512 + i * 256)) ok = 0;
+    }
+    CHECK(ok);
+    free(base);
+}
+
+static void testDriftClampsWatermarks(void)
+{
+    uint32_t target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 512, kRightMic_RingBufferFrames);
+    CHECK(target == kRightMic_DefaultTargetLatency);
+    CHECK(minSafe == kRightMic_DefaultMinSafeLatency);
+
+    /* Defaults follow the IO buffer size down, the target only as far as
+     * the drift loop's acquisition allows. */
+    target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 256, kRightMic_RingBufferFrames);
+    CHECK(target == 768);
+    CHECK(minSafe == 64);
+    target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, kRightMic_MinBufferFrameSize,
+                                  kRightMic_RingBufferFrames);
+    CHECK(target == kRightMic_MinDefaultTargetLatency);
+    CHECK(minSafe == kRightMic_MinBufferFrameSize / 4);
+
+    target = 100, minSafe = 1;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 512, kRightMic_RingBufferFrames);
+    CHECK(minSafe == kRightMicDrift_LookAhead);
+    CHECK(target == minSafe + 512 + kRightMicDrift_LookAhead);
+
+    target = 20000, minSafe = 9000;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 512, kRightMic_RingBufferFrames);
+    CHECK(target == kRightMic_RingBufferFrames / 2);
+    CHECK(minSafe == target - 512 - kRightMicDrift_LookAhead);
+
+    /* A smaller ring holds less, down to no cushion at all. */
+    target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 512, 2048);
+    CHECK(target == 1024);
+    CHECK(minSafe == kRightMic_DefaultMinSafeLatency);
+    target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, 512, kRightMic_MinRingFrames);
+    CHECK(target == kRightMic_MinRingFrames / 2);
+    CHECK(minSafe == 0);
+}
+
+typedef struct {
+    uint64_t underruns;     /* after the first successful read */
+    uint64_t overflows;
+    double   meanPPM;       /* mean correction over the second half */
+    double   meanFill;      /* mean filtered fill over the second half */
+    double   target;        /* default target fill for the period      */
+    float    maxStep;       /* largest sample-to-sample step in the output */
+} DriftRun;
+
+/* Event-driven simulation: the producer writes callbacks of the same
+ * duration as the consumer's at `ringRate`, on a clock `ppm` faster than
+ * the consumer's; the consumer reads `period`-frame cycles at 48 kHz half
+ * a period out of phase with the default watermarks for that size.  The
+ * signal is a 440 Hz sine, so any resync or dropped chunk shows up as an
+ * oversized sample step. */
+static DriftRun SimulateDrift(double ppm, double seconds, uint32_t period, uint32_t ringRate)
+{
+    const double   rate   = 48000.0;
+    const double   twoPi  = 6.283185307179586;
+    const uint32_t writes = (uint32_t)lround(period * ringRate / rate);
+
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, ringRate, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    uint32_t target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, period, kRightMic_RingBufferFrames);
+    RightMicDrift_Init(&drift, target, minSafe);
+
+    float in[1024 * kRightMic_ChannelCount];
+    float out[512 * kRightMic_ChannelCount];
+    double producerPeriod = writes / (ringRate * (1.0 + ppm * 1e-6));
+    double consumerPeriod = period / rate;
+    double tp = 0, tc = consumerPeriod / 2;
+    uint64_t produced = 0;
+
+    DriftRun run = { .target = target };
+    int started = 0;
+    float prev = 0;
+    double ppmSum = 0, fillSum = 0;
+    uint64_t settledCount = 0;
+
+    while (tc < seconds) {
+        if (tp <= tc) {
+            for (uint32_t i = 0; i < writes; i++) {
+                float v = (float)(0.5 * sin(twoPi * 440.0 * (double)(produced + i) / ringRate));
+                for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+                    in[i * kRightMic_ChannelCount + c] = v;
+                }
+            }
+            RightMicRing_Write(&ring, in, writes);
+            produced += writes;
+            tp += producerPeriod;
+            continue;
+        }
+
+        RightMicRingReadStatus st = RightMicDrift_Read(&drift, &ring, &reader, out, period);
+        tc += consumerPeriod;
+        if (st == kRightMicRingRead_Inactive) {
+            continue;  /* priming */
+        }
+        if (st == kRightMicRingRead_Underrun) {
+            if (started) run.underruns++;
+            continue;
+        }
+        if (st == kRightMicRingRead_Overflow) run.overflows++;
+        for (uint32_t i = 0; i < period; i++) {
+            float v = out[i * kRightMic_ChannelCount];
+            if (started || i > 0) {
+                float step = fabsf(v - prev);
+                if (step > run.maxStep) run.maxStep = step;
+            }
+            prev = v;
+        }
+        started = 1;
+        if (tc > seconds / 2) {
+            ppmSum  += RightMicDrift_PPM(&drift);
+            fillSum += drift.filteredFill;
+            settledCount++;
+        }
+    }
+
+    run.meanPPM  = settledCount ? ppmSum / (double)settledCount : 0;
+    run.meanFill = settledCount ? fillSum / (double)settledCount : 0;
+    free(base);
+    return run;
+}
+
+static void CheckDriftRun(double ppm, uint32_t period, uint32_t ringRate)
+{
+    DriftRun run = SimulateDrift(ppm, 600.0, period, ringRate);
+    printf("    %+5.0f ppm, %3u frames, %5u Hz ring: correction %+7.1f ppm, fill %.0f, "
+           "max step %.4f, %llu underruns, %llu overflows\n",
+           ppm, period, ringRate, run.meanPPM, run.meanFill, run.maxStep,
+           (unsigned long long)run.underruns, (unsigned long long)run.overflows);
+    CHECK(run.underruns == 0);
+    CHECK(run.overflows == 0);
+    CHECK(fabs(run.meanPPM - ppm) < 25.0);
+    CHECK(fabs(run.meanFill - run.target) < 64.0);
+    /* 440 Hz at amplitude 0.5 moves at most 0.029 per sample. */
+    CHECK(run.maxStep < 0.032f);
+}
+
+static void testDriftLocksToFastProducer(void)  { CheckDriftRun(+500.0, 512, 48000); }
+static void testDriftLocksToSlowProducer(void)  { CheckDriftRun(-500.0, 512, 48000); }
+static void testDriftHoldsWithoutDrift(void)    { CheckDriftRun(0.0, 512, 48000); }
+
+/* A low-latency host's buffers, with the watermarks scaled down to them. */
+static void testDriftLocksAtSmallBuffers(void)
+{
+    CheckDriftRun(+500.0, 64, 48000);
+    CheckDriftRun(-500.0, kRightMic_MinBufferFrameSize, 48000);
+}
+
+/* A ring at the capture device's own rate, read by a 48 kHz client: the
+ * reader converts on top of the drift correction, which still measures
+ * only the clock offset. */
+static void testDriftConvertsRingRate(void)
+{
+    CheckDriftRun(+500.0, 512, 44100);
+    CheckDriftRun(-500.0, 512, 96000);
+    CheckDriftRun(+500.0, 64, 88200);
+}
+
+/* ── Lapped Reads ─────────────────────────────────────────────── */
+
+static void testWritesClaimBeforePublishing(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRingBufferHeader *h = ring.header;
+
+    WriteIndexed(&ring, 0, 300);
+    CHECK(atomic_load(&h->writeClaim) == 300);
+    RightMicRing_WriteSilence(&ring, 100);
+    CHECK(atomic_load(&h->writeClaim) == 400);
+
+    /* A reservation claims its frames while they are rendered, before */
+    /* the commit publishes them.                                      */
+    CHECK(RightMicRing_Reserve(&ring, 256) != NULL);
+    CHECK(atomic_load(&h->writeClaim) == 656);
+    CHECK(atomic_load(&h->writeHead) == 400);
+    RightMicRing_Commit(&ring, 256);
+    CHECK(atomic_load(&h->writeHead) == 656);
+
+    /* Nothing is suspect until the claim is a ring ahead of a frame. */
+    CHECK(RightMicRing_IntactFrom(&ring) == 0);
+    WriteIndexed(&ring, 656, kRightMic_RingBufferFrames);
+    CHECK(RightMicRing_IntactFrom(&ring) == 656);
+
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    CHECK(atomic_load(&h->writeClaim) == 0);
+    free(base);
+}
+
+static void testCommitReleasesUnwrittenClaim(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRingBufferHeader *h = ring.header;
+    WriteIndexed(&ring, 0, kRightMic_RingBufferFrames);
+    CHECK(RightMicRing_IntactFrom(&ring) == 0);
+
+    /* A render that failed gives its reservation up with a commit of 0; */
+    /* the oldest frames must not stay marked as overwritten.            */
+    CHECK(RightMicRing_Reserve(&ring, 512) != NULL);
+    CHECK(RightMicRing_IntactFrom(&ring) == 512);
+    RightMicRing_Commit(&ring, 0);
+    CHECK(atomic_load(&h->writeHead) == kRightMic_RingBufferFrames);
+    CHECK(atomic_load(&h->writeClaim) == kRightMic_RingBufferFrames);
+    CHECK(RightMicRing_IntactFrom(&ring) == 0);
+
+    /* A short commit keeps the claim only on what it published. */
+    CHECK(RightMicRing_Reserve(&ring, 512) != NULL);
+    RightMicRing_Commit(&ring, 100);
+    CHECK(atomic_load(&h->writeHead) == kRightMic_RingBufferFrames + 100);
+    CHECK(RightMicRing_IntactFrom(&ring) == 100);
+    free(base);
+}
+
+static void testReadConcealsFramesTornMidCopy(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, base, sizeof(RightMicRingBufferHeader), 1024,
+                          kRightMic_ChannelCount, false);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    WriteIndexed(&ring, 0, 2048);
+
+    /* The reader is 924 frames behind, inside the ring, so the check  */
+    /* before the copy passes.  Meanwhile the writer has claimed 200    */
+    /* more frames, whose slots hold the reader's first 100.            */
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = 2048 - 924;
+    atomic_store(&ring.header->writeClaim, 2048 + 200);
+
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Overflow);
+    CHECK(IsSilent(out, 100));
+    CHECK(IsSequential(out + 100 * kRightMic_ChannelCount, 412, 2048 - 924 + 100));
+    CHECK(reader.tornCount == 1);
+    CHECK(reader.overflowCount == 1);
+    CHECK(reader.concealedFrames == 100);
+    CHECK(reader.readHead == 2048 - 924 + 512);
+
+    /* With the write done, the next copy is whole again. */
+    WriteIndexed(&ring, 2048, 200);
+    CHECK(RightMicRing_Read(&ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 512, 2048 - 924 + 512));
+    CHECK(reader.tornCount == 1);
+    free(base);
+}
+
+static void testDriftConcealsFramesTornMidCopy(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, base, sizeof(RightMicRingBufferHeader), 1024,
+                          kRightMic_ChannelCount, false);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    WriteIndexed(&ring, 0, 2048);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 512, 64);
+    RightMicConceal_SetMode(&drift.conceal, kRightMicConceal_Silence);
+    reader.readHead = 2048 - 1000;
+    atomic_store(&ring.header->writeClaim, 2048 + 100);
+
+    /* Frames from 1124 on are intact.  An output frame is only if all */
+    /* its taps are, the first one being a frame before its position.  */
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 512) == kRightMicRingRead_Overflow);
+    CHECK(reader.tornCount == 1);
+    uint64_t torn = reader.concealedFrames;
+    CHECK(torn >= 76 && torn <= 77);
+    CHECK(IsSilent(out, (uint32_t)torn));
+    CHECK(out[torn * kRightMic_ChannelCount] >= 1124.0f + 1.0f);
+    CHECK(out[(torn - 1) * kRightMic_ChannelCount] == 0.0f);
+    free(base);
+}
+
+/* Stress: a producer at 10x real time and a consumer whose clock runs */
+/* 10% slow on their own cores, over a 1024-frame ring, so the writer  */
+/* keeps lapping the reader, often while it copies.  Every sample      */
+/* played must be one the producer wrote for that position (the ring   */
+/* carries frame indices), or silence where a read was concealed.      */
+#define kLapRate     (10.0 * 48000.0)
+#define kLapSeconds  0.5
+#define kLapChunk    16
+#define kLapPeriod   256
+
+typedef struct {
+    RightMicRing *ring;
+    bool          drift;     /* consumer reads through RightMicDrift_Read */
+    _Atomic int   started;
+    _Atomic int   done;
+    uint64_t      reads;
+    uint64_t      bad;       /* samples that were neither right nor silent */
+    uint64_t      torn;
+    uint64_t      overflows;
+} LapRun;
+
+static uint64_t LapNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void LapPin(int cpu)
+{
+#ifdef __linux__
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+static void *LapProducer(void *arg)
+{
+    LapRun *run = arg;
+    LapPin(0);
+    float buf[kLapChunk * kRightMic_ChannelCount];
+    uint64_t written = 1;  /* frame 0 would read as silence */
+    atomic_store(&run->ring->header->writeHead, written);
+    uint64_t start = LapNowNs();
+    for (;;) {
+        double elapsed = (double)(LapNowNs() - start) * 1e-9;
+        if (elapsed >= kLapSeconds) break;
+        uint64_t due = 1 + (uint64_t)(elapsed * kLapRate);
+        while (written + kLapChunk <= due) {
+            for (uint32_t i = 0; i < kLapChunk; i++) {
+                for (uint32_t c = 0; c < kRightMic_ChannelCount; c++) {
+                    buf[i * kRightMic_ChannelCount + c] = (float)(written + i);
+                }
+            }
+            RightMicRing_Write(run->ring, buf, kLapChunk);
+            written += kLapChunk;
+            if (written > 4 * 1024) atomic_store(&run->started, 1);
+        }
+    }
+    atomic_store(&run->done, 1);
+    return NULL;
+}
+
+static void *LapConsumer(void *arg)
+{
+    LapRun *run = arg;
+    LapPin(1);
+    while (!atomic_load(&run->started)) {}
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    uint32_t target = 0, minSafe = 0;
+    RightMicDrift_ClampWatermarks(&target, &minSafe, kLapPeriod, run->ring->frames);
+    RightMicDrift_Init(&drift, target, minSafe);
+    RightMicConceal_SetMode(&drift.conceal, kRightMicConceal_Silence);
+
+    float out[kLapPeriod * kRightMic_ChannelCount];
+    uint64_t start = LapNowNs();
+    for (uint64_t n = 0; !atomic_load(&run->done); n++) {
+        /* Next read at 90% of the producer's rate. */
+        uint64_t due = start + (uint64_t)((double)n * kLapPeriod / (0.9 * kLapRate) * 1e9);
+        while (LapNowNs() < due && !atomic_load(&run->done)) {}
+
+        if (run->drift) {
+            RightMicDrift_Read(&drift, run->ring, &reader, out, kLapPeriod);
+        } else {
+            RightMicRing_Read(run->ring, &reader, out, kLapPeriod);
+        }
+        run->reads++;
+
+        /* Ring_Read plays frame readHead - period + i as sample i;    */
+        /* the interpolator moves about one frame per sample.           */
+        uint64_t first = reader.readHead - kLapPeriod;
+        for (uint32_t i = 0; i < kLapPeriod; i++) {
+            float l = out[i * kRightMic_ChannelCount];
+            float r = out[i * kRightMic_ChannelCount + 1];
+            if (l != r) {
+                run->bad++;
+            } else if (l == 0.0f) {
+                continue;
+            } else if (!run->drift) {
+                if (l != (float)(first + i)) run->bad++;
+            } else if (i > 0 && out[(i - 1) * kRightMic_ChannelCount] != 0.0f) {
+                float step = l - out[(i - 1) * kRightMic_ChannelCount];
+                if (step < 0.9f || step > 1.1f) run->bad++;
+            }
+        }
+    }
+    run->torn      = reader.tornCount;
+    run->overflows = reader.overflowCount;
+    return NULL;
+}
+
+static void CheckLappedReads(bool drift)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, base, sizeof(RightMicRingBufferHeader), 1024,
+                          kRightMic_ChannelCount, false);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    LapRun run = { .ring = &ring, .drift = drift };
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, LapConsumer, &run);
+    pthread_create(&producer, NULL, LapProducer, &run);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    printf("    %s: %llu reads, %llu overflows, %llu torn mid-copy, %llu bad samples\n",
+           drift ? "drift reader" : "plain reader", (unsigned long long)run.reads,
+           (unsigned long long)run.overflows, (unsigned long long)run.torn,
+           (unsigned long long)run.bad);
+    CHECK(run.reads > 0);
+    CHECK(run.overflows > 0);
+    CHECK(run.bad == 0);
+    free(base);
+}
+
+static void testLappedReadsNeverPlayTornFrames(void)
+{
+    CheckLappedReads(false);
+    CheckLappedReads(true);
+}
+
+/* ── Concealment ──────────────────────────────────────────────── */
+
+#define kToneAmplitude 0.5f
+
+/* Feed `frameCount` frames of a sine at `hz`, continuing from `*phase`. */
+static void FeedTone(RightMicConceal *c, double hz, uint64_t *phase, uint32_t frameCount)
+{
+    float buf[512 * kRightMic_ChannelCount];
+    while (frameCount > 0) {
+        uint32_t chunk = frameCount > 512 ? 512 : frameCount;
+        for (uint32_t i = 0; i < chunk; i++) {
+            float v = kToneAmplitude * (float)sin(6.283185307179586 * hz * (double)(*phase + i) / 48000.0);
+            for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) {
+                buf[i * kRightMic_ChannelCount + ch] = v;
+            }
+        }
+        RightMicConceal_Feed(c, buf, chunk);
+        *phase     += chunk;
+        frameCount -= chunk;
+    }
+}
+
+/* Largest sample-to-sample step in `buf`, starting from `prev`. */
+static float MaxStep(const float *buf, uint32_t frameCount, float prev)
+{
+    float maxStep = 0.0f;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        float v = buf[i * kRightMic_ChannelCount];
+        if (fabsf(v - prev) > maxStep) maxStep = fabsf(v - prev);
+        prev = v;
+    }
+    return maxStep;
+}
+
+static void testConcealDetectsPitch(void)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, kRightMicConceal_PitchRepeat);
+    CHECK(RightMicConceal_DetectPeriod(&c) == 0);
+
+    uint64_t phase = 0;
+    FeedTone(&c, 200.0, &phase, 2048);
+    uint32_t period = RightMicConceal_DetectPeriod(&c);
+    CHECK(period >= 239 && period <= 241);
+
+    /* 100 Hz's period is inside the search range too; don't double up. */
+    RightMicConceal_Init(&c, kRightMicConceal_PitchRepeat);
+    phase = 0;
+    FeedTone(&c, 100.0, &phase, 2048);
+    period = RightMicConceal_DetectPeriod(&c);
+    CHECK(period >= 479 && period <= 481);
+}
+
+/* Each smoothing mode must join the played signal without a click. */
+static void CheckConcealJoin(RightMicConcealMode mode)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, mode);
+    uint64_t phase = 0;
+    FeedTone(&c, 200.0, &phase, 2048);
+
+    float last = kToneAmplitude * (float)sin(6.283185307179586 * 200.0 * (double)(phase - 1) / 48000.0);
+    float out[480 * kRightMic_ChannelCount];
+    RightMicConceal_Fill(&c, out, 480);
+    /* 200 Hz at amplitude 0.5 moves at most 0.013 per sample. */
+    CHECK(MaxStep(out, 480, last) < 0.02f);
+}
+
+static void testConcealJoinsFadeOut(void)     { CheckConcealJoin(kRightMicConceal_FadeOut); }
+static void testConcealJoinsCrossfade(void)   { CheckConcealJoin(kRightMicConceal_Crossfade); }
+static void testConcealJoinsPitchRepeat(void) { CheckConcealJoin(kRightMicConceal_PitchRepeat); }
+
+static void testConcealSilenceMode(void)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, kRightMicConceal_Silence);
+    uint64_t phase = 0;
+    FeedTone(&c, 200.0, &phase, 2048);
+
+    float out[256 * kRightMic_ChannelCount];
+    RightMicConceal_Fill(&c, out, 256);
+    CHECK(IsSilent(out, 256));
+}
+
+static void testConcealDecaysToSilence(void)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, kRightMicConceal_Default);
+    uint64_t phase = 0;
+    FeedTone(&c, 200.0, &phase, 2048);
+
+    float out[512 * kRightMic_ChannelCount];
+    for (uint32_t done = 0; done < kRightMicConceal_MaxFrames; done += 512) {
+        RightMicConceal_Fill(&c, out, 512);
+    }
+    RightMicConceal_Fill(&c, out, 512);
+    CHECK(IsSilent(out, 512));
+}
+
+static void testConcealResumesSmoothly(void)
+{
+    static RightMicConceal c;
+    RightMicConceal_Init(&c, kRightMicConceal_PitchRepeat);
+    uint64_t phase = 0;
+    FeedTone(&c, 200.0, &phase, 2048);
+
+    float gap[100 * kRightMic_ChannelCount];
+    RightMicConceal_Fill(&c, gap, 100);
+    float last = gap[99 * kRightMic_ChannelCount];
+
+    /* The producer's late frames pick up where it left off, so the real
+     * signal is 100 frames "behind" the concealment. */
+    float buf[256 * kRightMic_ChannelCount];
+    for (uint32_t i = 0; i < 256; i++) {
+        float v = kToneAmplitude * (float)sin(6.283185307179586 * 200.0 * (double)(phase + i) / 48000.0);
+        for (uint32_t ch = 0; ch < kRightMic_ChannelCount; ch++) buf[i * kRightMic_ChannelCount + ch] = v;
+    }
+    RightMicConceal_Feed(&c, buf, 256);
+    CHECK(MaxStep(buf, 256, last) < 0.03f);
+}
+
+/* ── Device Switch ────────────────────────────────────────────── */
+
+static float sStage[kRightMicSwitch_StageFrames * kRightMic_ChannelCount];
+
+static void FillConstant(float *buf, uint32_t frameCount, float value)
+{
+    for (uint32_t i = 0; i < frameCount * kRightMic_ChannelCount; i++) buf[i] = value;
+}
+
+static void testSwitchPassesThroughOwner(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicSwitch sw;
+    RightMicSwitch_Init(&sw, sStage, 0);
+
+    float buf[256 * kRightMic_ChannelCount];
+    FillConstant(buf, 256, 1.0f);
+    RightMicSwitch_Write(&sw, &ring, 0, buf, 256);
+    /* Not fading: the other source is dropped. */
+    RightMicSwitch_Write(&sw, &ring, 1, buf, 256);
+    CHECK(atomic_load(&ring.header->writeHead) == 256);
+    CHECK(atomic_load(&sw.stageWrite) == 0);
+    free(base);
+}
+
+static void testSwitchReservesOnlyForIdleOwner(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicSwitch sw;
+    RightMicSwitch_Init(&sw, sStage, 0);
+
+    CHECK(RightMicSwitch_Reserve(&sw, &ring, 1, 256) == NULL);
+    float *slot = RightMicSwitch_Reserve(&sw, &ring, 0, 256);
+    CHECK(slot != NULL);
+    if (slot == NULL) return;
+    FillConstant(slot, 256, 1.0f);
+    RightMicSwitch_Commit(&sw, &ring, 256);
+    CHECK(atomic_load(&ring.header->writeHead) == 256);
+
+    /* During a fade both sources go through Write. */
+    CHECK(RightMicSwitch_Begin(&sw, 64));
+    CHECK(RightMicSwitch_Reserve(&sw, &ring, 0, 256) == NULL);
+    CHECK(RightMicSwitch_Reserve(&sw, &ring, 1, 256) == NULL);
+
+    /* A short fade hands over with 448 staged frames left; the new
+     * owner's first reservation comes after them. */
+    float in[512 * kRightMic_ChannelCount];
+    float out[256 * kRightMic_ChannelCount];
+    FillConstant(in, 512, 2.0f);
+    FillConstant(out, 256, 1.0f);
+    RightMicSwitch_Write(&sw, &ring, 1, in, 512);
+    RightMicSwitch_Write(&sw, &ring, 0, out, 256);
+    CHECK(RightMicSwitch_Owner(&sw) == 1);
+    CHECK(atomic_load(&ring.header->writeHead) == 320);
+
+    slot = RightMicSwitch_Reserve(&sw, &ring, 1, 256);
+    CHECK(atomic_load(&ring.header->writeHead) == 768);
+    CHECK(slot == ring.data + 768 * kRightMic_ChannelCount);
+    CHECK(ring.data[320 * kRightMic_ChannelCount] == 2.0f);
+    free(base);
+}
+
+static void testSwitchCrossfadesAndHandsOver(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicSwitch sw;
+    RightMicSwitch_Init(&sw, sStage, 0);
+
+    const uint32_t fade = 300;
+    float out[512 * kRightMic_ChannelCount];
+    float in[512 * kRightMic_ChannelCount];
+    CHECK(RightMicSwitch_Begin(&sw, fade));
+    CHECK(!RightMicSwitch_Begin(&sw, fade));
+
+    /* Incoming hasn't delivered its prefill yet: outgoing passes through. */
+    FillConstant(out, 256, 1.0f);
+    RightMicSwitch_Write(&sw, &ring, 0, out, 256);
+    CHECK(RightMicSwitch_IsFading(&sw));
+    CHECK(sw.fadePos == 0);
+
+    /* Incoming (all 2.0) stages two callbacks; outgoing (all 1.0) fades. */
+    FillConstant(in, 512, 2.0f);
+    RightMicSwitch_Write(&sw, &ring, 1, in, 512);
+    RightMicSwitch_Write(&sw, &ring, 1, in, 512);
+    FillConstant(out, 512, 1.0f);
+    RightMicSwitch_Write(&sw, &ring, 0, out, 512);
+
+    /* The fade ends mid-callback: only `fade` frames were written and
+     * ownership moved to source 1. */
+    CHECK(atomic_load(&ring.header->writeHead) == 256 + fade);
+    CHECK(!RightMicSwitch_IsFading(&sw));
+    CHECK(RightMicSwitch_Owner(&sw) == 1);
+    for (uint32_t i = 0; i < fade; i++) {
+        float x = ((float)i + 0.5f) / (float)fade;
+        float expect = cosf(1.5707963f * x) + 2.0f * sinf(1.5707963f * x);
+        CHECK(fabsf(ring.data[(256 + i) * kRightMic_ChannelCount] - expect) < 1e-4f);
+    }
+
+    /* The old owner is now ignored; the new one drains its residue first. */
+    RightMicSwitch_Write(&sw, &ring, 0, out, 512);
+    CHECK(atomic_load(&ring.header->writeHead) == 256 + fade);
+    FillConstant(in, 512, 3.0f);
+    RightMicSwitch_Write(&sw, &ring, 1, in, 512);
+    CHECK(atomic_load(&ring.header->writeHead) == 256 + 1024 + 512);
+    CHECK(ring.data[(256 + fade) * kRightMic_ChannelCount] == 2.0f);
+    CHECK(ring.data[(256 + 1024) * kRightMic_ChannelCount] == 3.0f);
+    free(base);
+}
+
+static void testSwitchCompleteDiscardsStage(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicSwitch sw;
+    RightMicSwitch_Init(&sw, sStage, 1);
+
+    /* Outgoing device vanished mid-switch: the router stops it and
+     * forces the handover.  Stale staged audio must not be replayed. */
+    float in[512 * kRightMic_ChannelCount];
+    FillConstant(in, 512, 2.0f);
+    CHECK(RightMicSwitch_Begin(&sw, kRightMicSwitch_DefaultFadeFrames));
+    RightMicSwitch_Write(&sw, &ring, 0, in, 512);
+    RightMicSwitch_Complete(&sw, 0);
+    CHECK(RightMicSwitch_Owner(&sw) == 0);
+    CHECK(!RightMicSwitch_IsFading(&sw));
+
+    FillConstant(in, 512, 3.0f);
+    RightMicSwitch_Write(&sw, &ring, 0, in, 512);
+    CHECK(atomic_load(&ring.header->writeHead) == 512);
+    CHECK(ring.data[0] == 3.0f);
+    CHECK(RightMicSwitch_Begin(&sw, kRightMicSwitch_DefaultFadeFrames));
+    free(base);
+}
+
+/* ── Read Cursor ──────────────────────────────────────────────── */
+
+static RightMicCursor sCursor;
+
+static void testCursorKeepsPositionAcrossIOSizes(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    RightMicCursor_Init(&sCursor);
+    /* The HAL drops to 128-frame cycles partway through, so the cushion
+     * is sized for the writer's 512-frame bursts, not the reads. */
+    RightMicCursor_SetWatermarks(&sCursor, kRightMic_DefaultTargetLatency,
+                                 kRightMic_DefaultMinSafeLatency);
+
+    /* The stream is a ramp of frame indices, so it must step by ~1 frame
+     * throughout: a new IO size re-clamps the watermarks in place. */
+    float out[512 * kRightMic_ChannelCount];
+    float prev = -1.0f;
+    int continuous = 1;
+    uint64_t written = 2048;
+    WriteIndexed(&ring, 0, (uint32_t)written);
+    for (uint32_t cycle = 0; cycle < 200; cycle++) {
+        WriteIndexed(&ring, written, 512);
+        written += 512;
+
+        uint32_t frames = cycle < 100 ? 512 : 128;
+        for (uint32_t done = 0; done < 512; done += frames) {
+            RightMicCursor_Prepare(&sCursor, frames);
+            RightMicDrift_Read(&sCursor.drift, &ring, &sCursor.reader, out, frames);
+            if (prev >= 0.0f) {
+                float step = out[0] - prev;
+                if (step < 0.99f || step > 1.01f) continuous = 0;
+            }
+            prev = out[(frames - 1) * kRightMic_ChannelCount];
+        }
+    }
+    CHECK(continuous);
+    CHECK(sCursor.frameCount == 128);
+    CHECK(sCursor.reader.overflowCount == 0);
+    CHECK(sCursor.reader.underrunCount == 0);
+
+    /* Lapped while IO was stopped: a restart resyncs behind the writer,
+     * as a fresh read. */
+    WriteIndexed(&ring, written, 512 * 100);
+    written += 512 * 100;
+    RightMicCursor_Restart(&sCursor);
+    RightMicCursor_Prepare(&sCursor, 128);
+    CHECK(sCursor.reader.readHead == 0);
+    RightMicDrift_Read(&sCursor.drift, &ring, &sCursor.reader, out, 128);
+    uint64_t fill = written - sCursor.reader.readHead;
+    CHECK(fill > 128 && fill < 4096);
+    CHECK(sCursor.reader.overflowCount == 0);
+    free(base);
+}
+
+/* ── Mirrored Mapping ─────────────────────────────────────────── */
+
+/* Unlinked temp file of `size` bytes; the caller closes it. */
+static int TempFile(size_t size)
+{
+    char path[] = "/tmp/rightmic-test.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+        perror("temp file");
+        exit(1);
+    }
+    unlink(path);
+    return fd;
+}
+
+static void testMirrorMapsDataTwice(void)
+{
+    int fd = TempFile(kRightMic_SharedMemorySizePaged);
+    RightMicMirror map;
+    CHECK(RightMicMirror_Map(&map, fd, kRightMic_SharedMemorySizePaged,
+                             kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, true));
+    CHECK(map.mirrored);
+    if (!map.mirrored) {
+        RightMicMirror_Unmap(&map);
+        close(fd);
+        return;
+    }
+
+    /* Same physical pages: a store through either copy shows in both.
+     * volatile, since the compiler can't know the two addresses alias. */
+    volatile float *data = (volatile float *)(map.base + kRightMic_PagedDataOffset);
+    volatile float *mirror = data + kRightMic_RingBufferFrames * kRightMic_ChannelCount;
+    data[5] = 1.5f;
+    CHECK(mirror[5] == 1.5f);
+    mirror[kRightMic_RingBufferFrames * kRightMic_ChannelCount - 1] = 2.5f;
+    CHECK(data[kRightMic_RingBufferFrames * kRightMic_ChannelCount - 1] == 2.5f);
+
+    /* A second, read-only mapping (the driver's) sees the producer. */
+    RightMicMirror reader;
+    CHECK(RightMicMirror_Map(&reader, fd, kRightMic_SharedMemorySizePaged,
+                             kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, false));
+    const volatile float *seen = (const volatile float *)(reader.base + kRightMic_PagedDataOffset);
+    CHECK(seen[kRightMic_RingBufferFrames * kRightMic_ChannelCount + 5] == 1.5f);
+    RightMicMirror_Unmap(&reader);
+    RightMicMirror_Unmap(&map);
+    CHECK(map.base == NULL);
+    close(fd);
+}
+
+static void testMirroredRingCrossesWrap(void)
+{
+    int fd = TempFile(kRightMic_SharedMemorySizePaged);
+    RightMicMirror map;
+    CHECK(RightMicMirror_Map(&map, fd, kRightMic_SharedMemorySizePaged,
+                             kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, true));
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, map.base, kRightMic_PagedDataOffset,
+                          kRightMic_RingBufferFrames, kRightMic_ChannelCount, map.mirrored);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    CHECK(ring.header->dataOffset == kRightMic_PagedDataOffset);
+
+    /* Write, reserve and read straddling the physical end of the ring. */
+    uint64_t start = kRightMic_RingBufferFrames - 100;
+    atomic_store(&ring.header->writeHead, start);
+    WriteIndexed(&ring, start, 300);
+    CHECK(ring.data[0] == (float)(start + 100));
+
+    float *slot = RightMicRing_Reserve(&ring, 512);
+    CHECK(slot != NULL);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    reader.readHead = start;
+    float out[300 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&ring, &reader, out, 300) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 300, start));
+
+    /* The resampler's contiguous fast path agrees with the ring. */
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+    RightMicRingReader_Reset(&reader);
+    atomic_store(&ring.header->writeHead, kRightMic_RingBufferFrames - 1200);
+    WriteIndexed(&ring, kRightMic_RingBufferFrames - 1200, 2048);
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 256) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 256, kRightMic_RingBufferFrames - 1200 + 2048 - 1536));
+    CHECK(RightMicDrift_Read(&drift, &ring, &reader, out, 256) == kRightMicRingRead_Filled);
+    CHECK(IsSequential(out, 256, kRightMic_RingBufferFrames - 1200 + 2048 - 1536 + 256));
+
+    RightMicMirror_Unmap(&map);
+    close(fd);
+}
+
+static void testMirrorFallsBackToSingleMapping(void)
+{
+    /* The compact layout's data region isn't page-aligned: still mapped,
+     * just not mirrored, and the ring splits copies as before. */
+    int fd = TempFile(kRightMic_SharedMemorySize);
+    RightMicMirror map;
+    CHECK(RightMicMirror_Map(&map, fd, kRightMic_SharedMemorySize,
+                             sizeof(RightMicRingBufferHeader), kRightMic_RingBufferDataBytes, true));
+    CHECK(map.base != NULL);
+    CHECK(!map.mirrored);
+
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, map.base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    atomic_store(&ring.header->writeHead, kRightMic_RingBufferFrames - 100);
+    CHECK(RightMicRing_Reserve(&ring, 101) == NULL);
+    WriteIndexed(&ring, kRightMic_RingBufferFrames - 100, 200);
+    CHECK(ring.data[0] == (float)kRightMic_RingBufferFrames);
+    RightMicMirror_Unmap(&map);
+    close(fd);
+}
+
+/* Page faults this process has taken so far. */
+static long MinorFaults(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static void testMirrorPrefaultLeavesNothingToFault(void)
+{
+    int fd = TempFile(kRightMic_SharedMemorySizePaged);
+    RightMicMirror writer, reader;
+    CHECK(RightMicMirror_Map(&writer, fd, kRightMic_SharedMemorySizePaged,
+                             kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, true));
+    CHECK(RightMicMirror_Map(&reader, fd, kRightMic_SharedMemorySizePaged,
+                             kRightMic_PagedDataOffset, kRightMic_RingBufferDataBytes, false));
+    close(fd);
+
+    RightMicResidency w = RightMicMirror_Prefault(&writer);
+    RightMicResidency r = RightMicMirror_Prefault(&reader);
+    CHECK(w != kRightMicResidency_Unknown && r != kRightMicResidency_Unknown);
+
+    RightMicRing producer, consumer;
+    RightMicRing_AttachAt(&producer, writer.base, kRightMic_PagedDataOffset,
+                          kRightMic_RingBufferFrames, kRightMic_ChannelCount, writer.mirrored);
+    RightMicRing_AttachAt(&consumer, reader.base, kRightMic_PagedDataOffset,
+                          kRightMic_RingBufferFrames, kRightMic_ChannelCount, reader.mirrored);
+    RightMicRing_InitProducer(&producer, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&producer, true);
+
+    /* Two laps through the whole ring, both copies of it, on both
+     * sides, as the callback and the IO cycle would: no faults.  The
+     * buffers are touched first so only the ring can fault. */
+    static float in[512 * kRightMic_ChannelCount], out[512 * kRightMic_ChannelCount];
+    memset(in, 0, sizeof(in));
+    memset(out, 0, sizeof(out));
+    RightMicRingReader cursor;
+    RightMicRingReader_Reset(&cursor);
+    long before = MinorFaults();
+    for (uint32_t i = 0; i < 2 * kRightMic_RingBufferFrames / 512; i++) {
+        RightMicRing_Write(&producer, in, 512);
+        (void)RightMicRing_Read(&consumer, &cursor, out, 512);
+        float *slot = RightMicRing_Reserve(&producer, 512);
+        if (slot != NULL) slot[0] = 1.0f;
+    }
+    CHECK(MinorFaults() == before);
+
+    RightMicMirror_Unmap(&reader);
+    RightMicMirror_Unmap(&writer);
+    CHECK(RightMicMirror_Prefault(&writer) == kRightMicResidency_Unknown);
+}
+
+/* ── Background Attach ────────────────────────────────────────── */
+
+/* Do what the app's open() does to `fd`: size it for a ring of `frames` */
+/* of `channels` at `dataOffset`, map it writable and publish the layout. */
+/* Closes `fd`; the caller unmaps `map`.                                  */
+static RightMicRing PublishGeometryFd(int fd, RightMicMirror *map, uint32_t dataOffset,
+                                      uint32_t frames, uint32_t channels)
+{
+    size_t ringBytes = (size_t)frames * kRightMic_FrameBytesFor(channels);
+    size_t dataBytes = kRightMic_RingDataBytesFor(frames, channels);
+    if (fd < 0 || ftruncate(fd, (off_t)(dataOffset + dataBytes)) != 0 ||
+        !RightMicMirror_Map(map, fd, dataOffset + dataBytes, dataOffset, ringBytes, true)) {
+        perror("publish layout");
+        exit(1);
+    }
+    close(fd);
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, map->base, dataOffset, frames, channels, map->mirrored);
+    RightMicRing_InitProducer(&ring, 48000, channels);
+    RightMicRing_SetActive(&ring, true);
+    return ring;
+}
+
+static RightMicRing PublishLayoutFd(int fd, RightMicMirror *map)
+{
+    return PublishGeometryFd(fd, map, kRightMic_PagedDataOffset, kRightMic_RingBufferFrames,
+                             kRightMic_ChannelCount);
+}
+
+static RightMicRing PublishLayout(const char *path, RightMicMirror *map)
+{
+    return PublishLayoutFd(open(path, O_CREAT | O_RDWR, 0644), map);
+}
+
+static void testAttachWaitsForPublishedLayout(void)
+{
+    char path[] = "/tmp/rightmic-attach.XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    unlink(path);
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, NULL, path);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Missing);
+
+    fd = open(path, O_CREAT | O_RDWR, 0644);
+    CHECK(ftruncate(fd, 4096) == 0);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_TooSmall);
+    CHECK(ftruncate(fd, kRightMic_SharedMemorySizePaged) == 0);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Unrecognized);
+    close(fd);
+
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    CHECK(m == NULL);
+    RightMicAttach_ExitIO(&attach);
+
+    /* Once the app publishes, the IO side sees a complete mapping. */
+    RightMicMirror producerMap;
+    RightMicRing producer = PublishLayout(path, &producerMap);
+    WriteIndexed(&producer, 0, 2048);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    CHECK(RightMicAttach_IsAttached(&attach));
+
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL);
+    if (m != NULL) {
+        CHECK(m->ring.mirrored == producerMap.mirrored);
+        CHECK(m->residency != kRightMicResidency_Unknown);
+        CHECK((uint8_t *)m->controls == m->map.base + kRightMic_PagedControlTableOffset);
+        RightMicRingReader reader;
+        RightMicRingReader_Reset(&reader);
+        float out[512 * kRightMic_ChannelCount];
+        CHECK(RightMicRing_Read(&m->ring, &reader, out, 512) == kRightMicRingRead_Filled);
+        CHECK(IsSequential(out, 512, 2048 - 512));
+    }
+    RightMicAttach_ExitIO(&attach);
+
+    /* Opening again keeps the published mapping. */
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    CHECK(RightMicAttach_EnterIO(&attach) == m);
+    RightMicAttach_ExitIO(&attach);
+
+    RightMicAttach_Close(&attach);
+    CHECK(!RightMicAttach_IsAttached(&attach));
+    CHECK(RightMicAttach_EnterIO(&attach) == NULL);
+    RightMicAttach_ExitIO(&attach);
+
+    RightMicMirror_Unmap(&producerMap);
+    unlink(path);
+}
+
+static void testAttachAdoptsPublishedGeometry(void)
+{
+    char path[] = "/tmp/rightmic-attach.XXXXXX";
+    close(mkstemp(path));
+
+    /* A larger ring further into the file than the default layout. */
+    const uint32_t dataOffset = 2 * kRightMic_PagedDataOffset;
+    const uint32_t frames     = 65536;
+    RightMicMirror producerMap;
+    RightMicRing producer = PublishGeometryFd(open(path, O_RDWR), &producerMap,
+                                              dataOffset, frames, kRightMic_ChannelCount);
+    WriteIndexed(&producer, 0, 40000);
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, NULL, path);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL);
+    if (m != NULL) {
+        CHECK(m->ring.frames == frames);
+        CHECK((uint8_t *)m->ring.data == m->map.base + dataOffset);
+        CHECK(RightMicRing_MatchesHeader(&m->ring));
+        RightMicRingReader reader;
+        RightMicRingReader_Reset(&reader);
+        reader.readHead = 20000;
+        float out[512 * kRightMic_ChannelCount];
+        CHECK(RightMicRing_Read(&m->ring, &reader, out, 512) == kRightMicRingRead_Filled);
+        CHECK(IsSequential(out, 512, 20000));
+
+        /* The app reopening the same file with another capacity leaves */
+        /* the old view stale; a fresh attach picks up the new one.     */
+        RightMicMirror_Unmap(&producerMap);
+        producer = PublishGeometryFd(open(path, O_RDWR), &producerMap,
+                                     kRightMic_PagedDataOffset, 4096, kRightMic_ChannelCount);
+        CHECK(!RightMicRing_MatchesHeader(&m->ring));
+    }
+    RightMicAttach_ExitIO(&attach);
+    RightMicAttach_Close(&attach);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL && m->ring.frames == 4096 && RightMicRing_MatchesHeader(&m->ring));
+    RightMicAttach_ExitIO(&attach);
+    RightMicAttach_Close(&attach);
+
+    /* A header promising more ring than the file holds is never mapped. */
+    producer.header->ringFrames = 8192;
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_TooSmall);
+    CHECK(!RightMicAttach_IsAttached(&attach));
+
+    RightMicMirror_Unmap(&producerMap);
+    unlink(path);
+}
+
+static void testAttachMapsMonoRingAtItsSize(void)
+{
+    char path[] = "/tmp/rightmic-attach.XXXXXX";
+    close(mkstemp(path));
+
+    /* Half a stereo ring, rounded up to whole pages. */
+    const uint32_t frames = kRightMic_RingBufferFrames;
+    CHECK(kRightMic_RingDataBytesFor(frames, 1) * 2 == kRightMic_RingDataBytesFor(frames, 2));
+    CHECK(kRightMic_RingDataBytesFor(kRightMic_MinRingFrames, 1) == kRightMic_PagedDataOffset);
+
+    RightMicMirror producerMap;
+    RightMicRing producer = PublishGeometryFd(open(path, O_RDWR), &producerMap,
+                                              kRightMic_PagedDataOffset, frames, 1);
+    CHECK(producer.header->frameBytes == sizeof(float));
+    CHECK(RightMicRing_IsCompatible(producer.header));
+    CHECK(producer.mirrored);
+    struct stat st;
+    CHECK(stat(path, &st) == 0 && (size_t)st.st_size == kRightMic_SharedMemorySizeFor(frames, 1));
+
+    /* One copy across the physical end, on both sides. */
+    uint64_t start = frames - 100;
+    atomic_store(&producer.header->writeHead, start);
+    WriteIndexedMono(&producer, start, 300);
+    CHECK(producer.data[0] == (float)(start + 100));
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, NULL, path);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL);
+    if (m != NULL) {
+        CHECK(m->ring.channels == 1);
+        CHECK(m->ring.mirrored);
+        CHECK(m->map.reserved == kRightMic_SharedMemorySizeFor(frames, 1) + frames * sizeof(float));
+        RightMicRingReader reader;
+        RightMicRingReader_Reset(&reader);
+        reader.readHead = start;
+        float out[300 * kRightMic_ChannelCount];
+        CHECK(RightMicRing_Read(&m->ring, &reader, out, 300) == kRightMicRingRead_Filled);
+        CHECK(IsSequential(out, 300, start));
+
+        /* Stereo frames would not fit the view. */
+        producer.header->channels = kRightMic_ChannelCount;
+        CHECK(!RightMicRing_MatchesHeader(&m->ring));
+    }
+    RightMicAttach_ExitIO(&attach);
+    RightMicAttach_Close(&attach);
+
+    /* Nor the file: a stereo header over it is never mapped. */
+    producer.header->frameBytes = kRightMic_BytesPerFrame;
+    CHECK(RightMicRing_IsCompatible(producer.header));
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_TooSmall);
+
+    RightMicMirror_Unmap(&producerMap);
+    unlink(path);
+}
+
+typedef struct {
+    RightMicAttach *attach;
+    _Atomic int     closed;
+} CloseJob;
+
+static void *CloseInBackground(void *arg)
+{
+    CloseJob *job = arg;
+    RightMicAttach_Close(job->attach);
+    atomic_store(&job->closed, 1);
+    return NULL;
+}
+
+static void testAttachCloseWaitsForIOCycle(void)
+{
+    char path[] = "/tmp/rightmic-attach.XXXXXX";
+    close(mkstemp(path));
+    RightMicMirror producerMap;
+    RightMicRing producer = PublishLayout(path, &producerMap);
+    WriteIndexed(&producer, 0, 2048);
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, NULL, path);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+
+    /* An IO cycle is inside when the app goes away: the unmap must wait
+     * for it, and the cycle keeps reading valid memory meanwhile. */
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    CloseJob job = { .attach = &attach };
+    pthread_t closer;
+    pthread_create(&closer, NULL, CloseInBackground, &job);
+
+    const struct timespec pause = { 0, 20 * 1000 * 1000 };
+    nanosleep(&pause, NULL);
+    CHECK(!atomic_load(&job.closed));
+    CHECK(!RightMicAttach_IsAttached(&attach));  /* already unpublished */
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    float out[512 * kRightMic_ChannelCount];
+    CHECK(RightMicRing_Read(&m->ring, &reader, out, 512) == kRightMicRingRead_Filled);
+    RightMicAttach_ExitIO(&attach);
+
+    pthread_join(closer, NULL);
+    CHECK(atomic_load(&job.closed));
+    CHECK(RightMicAttach_EnterIO(&attach) == NULL);
+    RightMicAttach_ExitIO(&attach);
+
+    RightMicMirror_Unmap(&producerMap);
+    unlink(path);
+}
+
+static void testAttachPrefersSharedMemoryObject(void)
+{
+    char name[32], path[] = "/tmp/rightmic-attach.XXXXXX";
+    snprintf(name, sizeof(name), "/rightmic-test-%d", (int)getpid());
+    RightMicShm_Unlink(name);
+    close(mkstemp(path));
+
+    /* A stale file from an app that fell back to one... */
+    RightMicMirror fileMap;
+    RightMicRing stale = PublishLayout(path, &fileMap);
+    WriteIndexed(&stale, 0, 1024);
+
+    /* ...loses to the object the app creates now. */
+    RightMicMirror shmMap;
+    RightMicRing producer = PublishLayoutFd(
+        RightMicShm_Create(name, kRightMic_SharedMemorySizePaged), &shmMap);
+    WriteIndexed(&producer, 100000, 2048);
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, name, path);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL && m->anonymous);
+    if (m != NULL) {
+        RightMicRingReader reader;
+        RightMicRingReader_Reset(&reader);
+        float out[512 * kRightMic_ChannelCount];
+        CHECK(RightMicRing_Read(&m->ring, &reader, out, 512) == kRightMicRingRead_Filled);
+        CHECK(IsSequential(out, 512, 100000 + 2048 - 512));
+    }
+    RightMicAttach_ExitIO(&attach);
+    RightMicAttach_Close(&attach);
+
+    /* Without the object the file still works. */
+    RightMicShm_Unlink(name);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL && !m->anonymous);
+    RightMicAttach_ExitIO(&attach);
+    RightMicAttach_Close(&attach);
+
+    RightMicMirror_Unmap(&shmMap);
+    RightMicMirror_Unmap(&fileMap);
+    unlink(path);
+}
+
+/* What the app's open() does with the shared memory object: create it */
+/* once at the largest ring's size, then map and publish a ring of      */
+/* `frames` in it.  The caller unmaps `map`.                            */
+static RightMicRing PublishInObject(const char *name, RightMicMirror *map, uint32_t frames)
+{
+    int fd = RightMicShm_Create(name, kRightMic_SharedMemorySizeFor(kRightMic_MaxRingFrames,
+                                                                    kRightMic_ChannelCount));
+    size_t ringBytes = (size_t)frames * kRightMic_BytesPerFrame;
+    size_t dataBytes = kRightMic_RingDataBytesFor(frames, kRightMic_ChannelCount);
+    if (fd < 0 || !RightMicMirror_Map(map, fd, kRightMic_PagedDataOffset + dataBytes,
+                                      kRightMic_PagedDataOffset, ringBytes, true)) {
+        perror("publish in object");
+        exit(1);
+    }
+    close(fd);
+    RightMicRing ring;
+    RightMicRing_AttachAt(&ring, map->base, kRightMic_PagedDataOffset, frames,
+                          kRightMic_ChannelCount, map->mirrored);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+    return ring;
+}
+
+/* The app's close(): everything it mapped is zeroed, the header too. */
+static void CloseProducer(RightMicMirror *map, uint32_t frames)
+{
+    memset(map->base, 0, kRightMic_SharedMemorySizeFor(frames, kRightMic_ChannelCount));
+    RightMicMirror_Unmap(map);
+}
+
+static void testShmRingGrowsUnderAttachedReader(void)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/rightmic-test-%d", (int)getpid());
+    RightMicShm_Unlink(name);
+
+    RightMicMirror producerMap;
+    RightMicRing producer = PublishInObject(name, &producerMap, 4096);
+    WriteIndexed(&producer, 0, 2048);
+
+    RightMicAttach attach;
+    RightMicAttach_Init(&attach, name, NULL);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    const RightMicMapping *m = RightMicAttach_EnterIO(&attach);
+    struct stat before;
+    CHECK(m != NULL && m->ring.frames == 4096 && fstat(m->fd, &before) == 0);
+    RightMicAttach_ExitIO(&attach);
+
+    /* The app closes and reopens with a larger ring.  While it is closed
+     * there is nothing to follow; once it has reopened, the reader's old
+     * view sees the new layout in the same object. */
+    CloseProducer(&producerMap, 4096);
+    CHECK(!RightMicAttach_Moved(&attach));
+    producer = PublishInObject(name, &producerMap, 65536);
+    WriteIndexed(&producer, 100000, 40000);
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL && !RightMicRing_MatchesHeader(&m->ring) &&
+          RightMicRing_IsCompatible(m->ring.header));
+    RightMicAttach_ExitIO(&attach);
+
+    /* What the driver's worker does on that cue. */
+    RightMicAttach_Close(&attach);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL);
+    if (m != NULL) {
+        struct stat after;
+        CHECK(fstat(m->fd, &after) == 0 && after.st_ino == before.st_ino);
+        CHECK(m->ring.frames == 65536 && RightMicRing_MatchesHeader(&m->ring));
+        RightMicRingReader reader;
+        RightMicRingReader_Reset(&reader);
+        reader.readHead = 100000 + 40000 - 512;
+        float out[512 * kRightMic_ChannelCount];
+        CHECK(RightMicRing_Read(&m->ring, &reader, out, 512) == kRightMicRingRead_Filled);
+        CHECK(IsSequential(out, 512, 100000 + 40000 - 512));
+    }
+    RightMicAttach_ExitIO(&attach);
+
+    /* An object replaced under the name instead (by an app from before
+     * this sizing, say) leaves the reader holding a zeroed copy: it
+     * follows the name once the new one carries a ring. */
+    CloseProducer(&producerMap, 65536);
+    RightMicShm_Unlink(name);
+    CHECK(!RightMicAttach_Moved(&attach));
+    producer = PublishInObject(name, &producerMap, 8192);
+    WriteIndexed(&producer, 500000, 4096);
+    CHECK(RightMicAttach_Moved(&attach));
+    RightMicAttach_Close(&attach);
+    CHECK(RightMicAttach_Open(&attach) == kRightMicAttach_Attached);
+    m = RightMicAttach_EnterIO(&attach);
+    CHECK(m != NULL && m->ring.frames == 8192 && RightMicRing_MatchesHeader(&m->ring));
+    RightMicAttach_ExitIO(&attach);
+    CHECK(!RightMicAttach_Moved(&attach));
+
+    RightMicAttach_Close(&attach);
+    RightMicMirror_Unmap(&producerMap);
+    RightMicShm_Unlink(name);
+}
+
+static void testShmCreateReusesOwnObject(void)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/rightmic-test-%d", (int)getpid());
+    RightMicShm_Unlink(name);
+
+    size_t size = 0;
+    CHECK(RightMicShm_Open(name, &size) < 0 && errno == ENOENT);
+
+    int fd = RightMicShm_Create(name, 8192);
+    CHECK(fd >= 0);
+    uint32_t *first = mmap(NULL, 8192, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(first != MAP_FAILED);
+    first[1000] = 0xfeedu;
+
+    /* Reopening at the same or a smaller size keeps the pages a reader
+     * may already have mapped. */
+    fd = RightMicShm_Create(name, 4096);
+    CHECK(fd >= 0);
+    const uint32_t *again = mmap(NULL, 8192, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(again != MAP_FAILED && again[1000] == 0xfeedu);
+    first[1001] = 7;
+    CHECK(again[1001] == 7);
+
+    fd = RightMicShm_Open(name, &size);
+    CHECK(fd >= 0 && size == 8192);
+    close(fd);
+
+    /* A stale ring can be cleared in place: a reader keeps its pages. */
+    size = 0;
+    fd = RightMicShm_OpenOwned(name, &size);
+    CHECK(fd >= 0 && size == 8192);
+    uint32_t *owned = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(owned != MAP_FAILED);
+    memset(owned, 0, size);
+    CHECK(again[1000] == 0 && first[1001] == 0);
+    munmap(owned, 8192);
+    first[1000] = 0xfeedu;
+
+    /* A larger one replaces it; the old mapping stays valid. */
+    fd = RightMicShm_Create(name, 16384);
+    CHECK(fd >= 0);
+    const uint32_t *fresh = mmap(NULL, 16384, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(fresh != MAP_FAILED && fresh[1000] == 0);
+    CHECK(first[1000] == 0xfeedu);
+
+    munmap((void *)fresh, 16384);
+    munmap((void *)again, 8192);
+    munmap(first, 8192);
+    RightMicShm_Unlink(name);
+    CHECK(RightMicShm_Open(name, &size) < 0);
+    CHECK(RightMicShm_OpenOwned(name, &size) < 0 && errno == ENOENT);
+}
+
+/* ── Control Snapshot ─────────────────────────────────────────── */
+
+/* Fill `table` with `count` entries whose every field derives from `tag`. */
+static void FillControlTable(RightMicControlTable *table, uint32_t count, uint32_t tag)
+{
+    for (uint32_t i = 0; i < kRightMic_MaxControls; i++) {
+        RightMicControlEntry *e = &table->entries[i];
+        e->classID = tag;
+        e->scope   = tag + 1;
+        e->element = tag + 2;
+        atomic_store(&e->uintValue, tag + 3);
+        atomic_store(&e->floatValue, (float)tag + 0.5f);
+        e->minDB   = -(float)tag;
+        e->maxDB   = (float)tag;
+    }
+    atomic_store(&table->count, count);
+}
+
+static bool EntryMatchesTag(const RightMicControlEntry *e, uint32_t tag)
+{
+    return e->classID == tag && e->scope == tag + 1 && e->element == tag + 2 &&
+           atomic_load(&e->uintValue) == tag + 3 &&
+           atomic_load(&e->floatValue) == (float)tag + 0.5f &&
+           e->minDB == -(float)tag && e->maxDB == (float)tag;
+}
+
+static void testControlsCopyOnlyCompleteUpdates(void)
+{
+    static RightMicControlTable table;
+    RightMicControlSnapshot snapshot;
+    RightMicControls_Init(&snapshot);
+    CHECK(RightMicControls_Count(&snapshot) == 0);
+
+    /* The app makes the version odd while it writes the entries. */
+    atomic_store(&table.version, 1);
+    FillControlTable(&table, 2, 100);
+    uint32_t version = 0;
+    CHECK(!RightMicControls_CopyTable(&snapshot, &table, &version));
+    CHECK(RightMicControls_Count(&snapshot) == 0);
+
+    atomic_store(&table.version, 2);
+    CHECK(RightMicControls_CopyTable(&snapshot, &table, &version));
+    CHECK(version == 2);
+    CHECK(RightMicControls_Count(&snapshot) == 2);
+
+    RightMicControlEntry entry;
+    CHECK(RightMicControls_Get(&snapshot, 1, &entry));
+    CHECK(EntryMatchesTag(&entry, 100));
+    CHECK(!RightMicControls_Get(&snapshot, 2, &entry));
+
+    RightMicControls_Clear(&snapshot);
+    CHECK(RightMicControls_Count(&snapshot) == 0);
+    CHECK(!RightMicControls_Get(&snapshot, 0, &entry));
+}
+
+static void testControlsTryReadNeverWaits(void)
+{
+    static RightMicControlTable table;
+    RightMicControlSnapshot snapshot;
+    RightMicControls_Init(&snapshot);
+
+    RightMicControlEntry entries[kRightMic_MaxControls];
+    uint32_t count = 99, seq = 0;
+    CHECK(!RightMicControls_TryRead(&snapshot, &seq, entries, &count));  /* unchanged */
+    CHECK(count == 99);
+
+    FillControlTable(&table, 3, 7);
+    CHECK(RightMicControls_CopyTable(&snapshot, &table, NULL));
+    CHECK(RightMicControls_TryRead(&snapshot, &seq, entries, &count));
+    CHECK(count == 3);
+    CHECK(EntryMatchesTag(&entries[2], 7));
+    CHECK(!RightMicControls_TryRead(&snapshot, &seq, entries, &count));
+
+    /* Writer preempted mid-update: one attempt, previous copy kept. */
+    uint32_t before = atomic_load(&snapshot.sequence);
+    atomic_store(&snapshot.sequence, before + 1);
+    count = 99;
+    CHECK(!RightMicControls_TryRead(&snapshot, &seq, entries, &count));
+    CHECK(count == 99);
+    atomic_store(&snapshot.sequence, before + 2);
+    CHECK(RightMicControls_TryRead(&snapshot, &seq, entries, &count));
+    CHECK(count == 3);
+}
+
+typedef struct {
+    RightMicControlSnapshot *snapshot;
+    _Atomic int              done;
+} ControlsWriter;
+
+static void *RewriteControls(void *arg)
+{
+    ControlsWriter *w = arg;
+    static RightMicControlTable a, b;
+    FillControlTable(&a, kRightMic_MaxControls, 1000);
+    FillControlTable(&b, kRightMic_MaxControls, 2000);
+    for (uint32_t i = 0; i < 200000; i++) {
+        RightMicControls_CopyTable(w->snapshot, (i & 1) ? &b : &a, NULL);
+    }
+    atomic_store(&w->done, 1);
+    return NULL;
+}
+
+static void testControlsNeverTearUnderRewrite(void)
+{
+    static RightMicControlTable initial;
+    RightMicControlSnapshot snapshot;
+    RightMicControls_Init(&snapshot);
+    FillControlTable(&initial, kRightMic_MaxControls, 1000);
+    RightMicControls_CopyTable(&snapshot, &initial, NULL);
+
+    ControlsWriter writer = { .snapshot = &snapshot };
+    pthread_t thread;
+    pthread_create(&thread, NULL, RewriteControls, &writer);
+
+    uint32_t torn = 0, seq = 0;
+    RightMicControlEntry entries[kRightMic_MaxControls];
+    uint32_t count = 0;
+    while (!atomic_load(&writer.done)) {
+        RightMicControlEntry entry;
+        if (RightMicControls_Get(&snapshot, 3, &entry) &&
+            !EntryMatchesTag(&entry, 1000) && !EntryMatchesTag(&entry, 2000)) {
+            torn++;
+        }
+        if (RightMicControls_TryRead(&snapshot, &seq, entries, &count)) {
+            /* All entries come from the same table. */
+            for (uint32_t i = 1; i < count; i++) {
+                if (entries[i].classID != entries[0].classID ||
+                    (!EntryMatchesTag(&entries[i], 1000) && !EntryMatchesTag(&entries[i], 2000))) {
+                    torn++;
+                }
+            }
+        }
+    }
+    pthread_join(thread, NULL);
+    CHECK(torn == 0);
+}
+
+/* ── Metrics ──────────────────────────────────────────────────── */
+
+static void testHistogramBuckets(void)
+{
+    CHECK(RightMicHistogram_Bucket(0) == 0);
+    CHECK(RightMicHistogram_Bucket(1) == 1);
+    CHECK(RightMicHistogram_Bucket(2) == 2);
+    CHECK(RightMicHistogram_Bucket(3) == 2);
+    CHECK(RightMicHistogram_Bucket(512) == 10);
+    CHECK(RightMicHistogram_Bucket(kRightMic_RingBufferFrames - 1) == 14);
+    CHECK(RightMicHistogram_Bucket(kRightMic_RingBufferFrames) == kRightMic_HistogramBuckets - 1);
+    CHECK(RightMicHistogram_Bucket(UINT64_MAX) == kRightMic_HistogramBuckets - 1);
+    for (uint32_t b = 0; b < kRightMic_HistogramBuckets; b++) {
+        CHECK(RightMicHistogram_Bucket(RightMicHistogram_BucketFloor(b)) == b);
+    }
+}
+
+/* One driver read: DoIOOperation's bookkeeping around RightMicDrift_Read. */
+static void ReadRecorded(RightMicConsumerMetrics *metrics, uint64_t *run, RightMicDrift *drift,
+                         const RightMicRing *ring, RightMicRingReader *reader, float *out)
+{
+    RightMicRingReader before = *reader;
+    RightMicDrift_Read(drift, ring, reader, out, 512);
+    uint64_t wHead = atomic_load(&ring->header->writeHead);
+    uint64_t fill  = reader->readHead != 0 && wHead > reader->readHead ? wHead - reader->readHead : 0;
+    RightMicMetrics_RecordRead(metrics, run, fill,
+                               reader->underrunCount - before.underrunCount,
+                               reader->concealedFrames - before.concealedFrames,
+                               reader->overflowCount - before.overflowCount);
+}
+
+static uint64_t HistogramTotal(const uint64_t counts[kRightMic_HistogramBuckets])
+{
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < kRightMic_HistogramBuckets; b++) total += counts[b];
+    return total;
+}
+
+static void testMetricsCountStallAsOneUnderrun(void)
+{
+    void *base = AllocRegion();
+    RightMicRing ring;
+    RightMicRing_Attach(&ring, base);
+    RightMicRing_InitProducer(&ring, 48000, kRightMic_ChannelCount);
+    RightMicRing_SetActive(&ring, true);
+
+    RightMicRingReader reader;
+    RightMicRingReader_Reset(&reader);
+    RightMicDrift drift;
+    RightMicDrift_Init(&drift, 1536, 128);
+    static RightMicConsumerMetrics metrics;
+    RightMicMetrics_InitConsumer(&metrics);
+    uint64_t run = 0;
+
+    float out[512 * kRightMic_ChannelCount];
+    uint64_t written = 2048;
+    WriteIndexed(&ring, 0, written);
+    ReadRecorded(&metrics, &run, &drift, &ring, &reader, out);
+
+    /* The producer stalls for several cycles, then catches up: every read
+     * in between conceals, but it is one underrun. */
+    for (int i = 0; i < 5; i++) ReadRecorded(&metrics, &run, &drift, &ring, &reader, out);
+    CHECK(run > 0);
+    WriteIndexed(&ring, written, 2048);
+    written += 2048;
+    for (int i = 0; i < 4; i++) {
+        WriteIndexed(&ring, written, 512);
+        written += 512;
+        ReadRecorded(&metrics, &run, &drift, &ring, &reader, out);
+    }
+    CHECK(run == 0);
+
+    RightMicMetricsSnapshot snap;
+    RightMicMetrics_Snapshot(NULL, &metrics, &snap);
+    CHECK(snap.underruns == reader.underrunCount);
+    CHECK(snap.underruns > 1);
+    CHECK(snap.concealedFrames == reader.concealedFrames);
+    CHECK(HistogramTotal(snap.underrunFrames) == 1);
+    CHECK(snap.underrunFrames[RightMicHistogram_Bucket(reader.concealedFrames)] == 1);
+    CHECK(HistogramTotal(snap.fillFrames) == 10);
+    CHECK(snap.overruns == 0);
+    CHECK(snap.callbacks == 0);  /* no producer block given */
+    free(base);
+}
+
+static void testMetricsFileIsReadableByOthers(void)
+{
+    char path[] = "/tmp/rightmic-metrics.XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    unlink(path);
+
+    /* The driver creates its file and counts into it... */
+    RightMicConsumerMetrics *metrics = RightMicMetrics_MapConsumer(NULL, path);
+    CHECK(metrics != NULL);
+    if (metrics == NULL) return;
+    RightMicMetrics_RecordCycle(metrics, 0, 0);
+    RightMicMetrics_RecordCycle(metrics, 10900000, 10666666);  /* 233 µs late */
+    RightMicMetrics_RecordCycle(metrics, 10666000, 10666666);  /* on time     */
+
+    /* ...and the app maps it read-only and reads it whenever it likes. */
+    fd = open(path, O_RDONLY);
+    CHECK(fd >= 0);
+    const RightMicConsumerMetrics *view = mmap(NULL, sizeof(*view), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(view != MAP_FAILED);
+    CHECK(RightMicMetrics_ConsumerIsCompatible(view));
+
+    static RightMicProducerMetrics producer;
+    RightMicMetricsSnapshot snap;
+    RightMicMetrics_Snapshot(&producer, view, &snap);
+    CHECK(snap.callbacks == 0);  /* producer block not published yet */
+    CHECK(snap.cycles == 3);
+    CHECK(snap.maxJitterUs == 233);
+    CHECK(snap.jitterUs[0] == 1);
+    CHECK(snap.jitterUs[RightMicHistogram_Bucket(233)] == 1);
+    CHECK(HistogramTotal(snap.jitterUs) == 2);
+
+    RightMicMetrics_InitProducer(&producer);
+    RightMicMetrics_RecordCallback(&producer, 512, 150000);
+    RightMicMetrics_RecordCallback(&producer, 512, 40000);
+    RightMicMetrics_Snapshot(&producer, NULL, &snap);
+    CHECK(snap.callbacks == 2);
+    CHECK(snap.frames == 1024);
+    CHECK(snap.maxCallbackUs == 150);
+    CHECK(snap.callbackUs[RightMicHistogram_Bucket(40)] == 1);
+    CHECK(snap.cycles == 0);
+
+    /* Never follows a link planted at the path. */
+    char link[] = "/tmp/rightmic-metrics-link.XXXXXX";
+    fd = mkstemp(link);
+    close(fd);
+    unlink(link);
+    CHECK(symlink(path, link) == 0);
+    CHECK(RightMicMetrics_MapConsumer(NULL, link) == NULL);
+    unlink(link);
+
+    munmap((void *)view, sizeof(*view));
+    munmap(metrics, sizeof(*metrics));
+    unlink(path);
+}
+
+static void testMetricsPreferSharedMemoryObject(void)
+{
+    char name[32], path[] = "/tmp/rightmic-metrics.XXXXXX";
+    snprintf(name, sizeof(name), "/rightmic-test-%d", (int)getpid());
+    RightMicShm_Unlink(name);
+    close(mkstemp(path));
+    unlink(path);
+
+    RightMicConsumerMetrics *metrics = RightMicMetrics_MapConsumer(name, path);
+    CHECK(metrics != NULL);
+    if (metrics == NULL) return;
+    RightMicMetrics_RecordCycle(metrics, 0, 0);
+    CHECK(access(path, F_OK) != 0);  /* no file needed */
+
+    size_t size = 0;
+    int fd = RightMicShm_Open(name, &size);
+    CHECK(fd >= 0 && size >= sizeof(RightMicConsumerMetrics));
+    const RightMicConsumerMetrics *view = mmap(NULL, sizeof(*view), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(view != MAP_FAILED);
+    CHECK(RightMicMetrics_ConsumerIsCompatible(view));
+    RightMicMetricsSnapshot snap;
+    RightMicMetrics_Snapshot(NULL, view, &snap);
+    CHECK(snap.cycles == 1);
+
+    munmap((void *)view, sizeof(*view));
+    munmap(metrics, sizeof(*metrics));
+    RightMicShm_Unlink(name);
+}
+
+static void testMetricsPublishIOClients(void)
+{
+    static RightMicConsumerMetrics metrics;
+    CHECK(RightMicMetrics_IOClients(NULL) == -1);
+    CHECK(RightMicMetrics_IOClients(&metrics) == -1);  /* not published yet */
+
+    RightMicMetrics_InitConsumer(&metrics);
+    CHECK(RightMicMetrics_IOClients(&metrics) == 0);
+    RightMicMetrics_SetIOClients(&metrics, 2);
+    CHECK(RightMicMetrics_IOClients(&metrics) == 2);
+
+    /* The IO thread publishes the buffer size and rate it runs at. */
+    CHECK(RightMicMetrics_IOBufferFrames(NULL) == -1);
+    CHECK(RightMicMetrics_IOSampleRate(NULL) == -1);
+    CHECK(RightMicMetrics_IOBufferFrames(&metrics) == 0);
+    CHECK(RightMicMetrics_IOSampleRate(&metrics) == 0);
+    RightMicMetrics_SetIOBufferFrames(&metrics, 64, 44100);
+    CHECK(RightMicMetrics_IOBufferFrames(&metrics) == 64);
+    CHECK(RightMicMetrics_IOSampleRate(&metrics) == 44100);
+
+    /* Each side says whether its view of the ring is wired. */
+    static RightMicProducerMetrics producer;
+    RightMicMetrics_InitProducer(&producer);
+    RightMicMetrics_SetProducerResidency(&producer, kRightMicResidency_Faulted);
+    RightMicMetrics_SetConsumerResidency(&metrics, kRightMicResidency_Wired);
+    RightMicMetricsSnapshot snap;
+    RightMicMetrics_Snapshot(&producer, &metrics, &snap);
+    CHECK(snap.appResidency == kRightMicResidency_Faulted);
+    CHECK(snap.driverResidency == kRightMicResidency_Wired);
+
+    /* coreaudiod restarted: nobody is running IO any more. */
+    RightMicMetrics_InitConsumer(&metrics);
+    CHECK(RightMicMetrics_IOClients(&metrics) == 0);
+    CHECK(RightMicMetrics_IOBufferFrames(&metrics) == 0);
+    CHECK(RightMicMetrics_IOSampleRate(&metrics) == 0);
+    RightMicMetrics_Snapshot(NULL, &metrics, &snap);
+    CHECK(snap.driverResidency == kRightMicResidency_Unknown);
+}
+
+/* ── Level Meter ──────────────────────────────────────────────── */
+
+/* Deterministic uniform noise in [-amplitude, amplitude). */
+static float Noise(uint32_t *state, float amplitude)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return amplitude * ((float)(*state >> 8) / 8388608.0f - 1.0f);
+}
+
+static void testLevelAnalyzeMatchesScalar(void)
+{
+    /* Odd length, so the vector loop and the scalar tail both run. */
+    enum { kCount = 1021 };
+    static float samples[kCount];
+    uint32_t seed = 7;
+    for (uint32_t i = 0; i < kCount; i++) {
+        samples[i] = 0.05f + 0.4f * sinf((float)i * 0.037f) + Noise(&seed, 0.01f);
+    }
+    samples[500] = -0.93f;
+
+    double lo = samples[0], hi = samples[0], sum = 0, sq = 0;
+    for (uint32_t i = 0; i < kCount; i++) {
+        lo = fmin(lo, samples[i]);
+        hi = fmax(hi, samples[i]);
+        sum += samples[i];
+        sq  += (double)samples[i] * samples[i];
+    }
+
+    RightMicLevelBlock block;
+    RightMicLevel_Analyze(samples, kCount, &block);
+    CHECK(block.peak == 0.93f);
+    CHECK(fabs(block.span - (hi - lo)) < 1e-6);
+    CHECK(fabs(block.dc - sum / kCount) < 1e-5);
+    CHECK(fabs(block.rms - sqrt(sq / kCount)) < 1e-5);
+
+    RightMicLevel_Analyze(samples, 0, &block);
+    CHECK(block.peak == 0.0f && block.span == 0.0f);
+}
+
+/* What muted hardware actually delivers, one 512-frame stereo buffer at a
+ * time: a switch that zeroes the stream, a USB codec that parks at a DC
+ * offset with the bottom bit of a 24-bit converter toggling, and a 16-bit
+ * path that dithers between -1, 0 and +1 LSB. */
+typedef enum { kMutedZeros, kMutedDCOffset, kMuted16BitDither } MutedKind;
+
+static void MakeMutedBuffer(float *out, MutedKind kind, uint32_t *seed)
+{
+    for (uint32_t i = 0; i < 512 * kRightMic_ChannelCount; i++) {
+        switch (kind) {
+        case kMutedZeros:       out[i] = 0.0f; break;
+        case kMutedDCOffset:    out[i] = -0.0031f + (float)(*seed & 1) / 8388608.0f; break;
+        case kMuted16BitDither: out[i] = (float)((int)(*seed % 3) - 1) / 32768.0f; break;
+        }
+        *seed = *seed * 1664525u + 1013904223u;
+    }
+}
+
+static void testLevelDetectsMutedHardware(void)
+{
+    static float buf[512 * kRightMic_ChannelCount];
+    for (int kind = kMutedZeros; kind <= kMuted16BitDither; kind++) {
+        RightMicLevelMeter meter;
+        RightMicLevel_Init(&meter, kRightMic_SampleRate, kRightMicLevel_DefaultWindow);
+        uint32_t seed = 1;
+        for (int i = 0; i < 300; i++) {  /* 3.2 s */
+            MakeMutedBuffer(buf, (MutedKind)kind, &seed);
+            RightMicLevel_Feed(&meter, buf, 512, kRightMic_ChannelCount);
+        }
+        RightMicLevelReading r;
+        RightMicLevel_Read(&meter, &r);
+        CHECK(r.frames == 300 * 512);
+        CHECK(r.silentFrames == r.frames);
+        if (kind == kMutedDCOffset) CHECK(fabsf(r.dc + 0.0031f) < 1e-4f);
+    }
+}
+
+static void testLevelQuietRoomIsNotSilent(void)
+{
+    static float buf[512 * kRightMic_ChannelCount];
+    RightMicLevelMeter meter;
+    RightMicLevel_Init(&meter, kRightMic_SampleRate, kRightMicLevel_DefaultWindow);
+    RightMicLevelReading r;
+
+    /* Room noise at about -66 dBFS never counts as dead. */
+    uint32_t seed = 3;
+    for (int i = 0; i < 100; i++) {
+        for (uint32_t s = 0; s < 512 * kRightMic_ChannelCount; s++) buf[s] = Noise(&seed, 0.0005f);
+        RightMicLevel_Feed(&meter, buf, 512, kRightMic_ChannelCount);
+        RightMicLevel_Read(&meter, &r);
+        CHECK(r.silentFrames == 0);
+    }
+
+    /* Muted for a while, then one buffer of speech breaks the run. */
+    for (int i = 0; i < 50; i++) {
+        MakeMutedBuffer(buf, kMutedZeros, &seed);
+        RightMicLevel_Feed(&meter, buf, 512, kRightMic_ChannelCount);
+    }
+    RightMicLevel_Read(&meter, &r);
+    CHECK(r.silentFrames == 50 * 512);
+    CHECK(r.rms < 0.0005f);
+
+    for (int i = 0; i < 100; i++) {
+        for (uint32_t f = 0; f < 512; f++) {
+            float v = 0.5f * sinf(6.2831853f * 220.0f * (float)(i * 512 + f) / 48000.0f);
+            buf[f * 2] = buf[f * 2 + 1] = v;
+        }
+        RightMicLevel_Feed(&meter, buf, 512, kRightMic_ChannelCount);
+    }
+    RightMicLevel_Read(&meter, &r);
+    CHECK(r.silentFrames == 0);
+    CHECK(fabsf(r.rms - 0.5f / sqrtf(2.0f)) < 0.01f);  /* settled after 1 s */
+    CHECK(fabsf(r.peak - 0.5f) < 0.01f);
+}
+
+/* ── Resampler ────────────────────────────────────────────────── */
+
+static float sResamplerStorage[kRightMicResampler_StorageFloats];
+
+/* Sine of `freq` Hz at `rate`, `frameCount` interleaved frames of `channels`. */
+static void MakeSine(float *out, uint32_t frameCount, uint32_t channels,
+                     double freq, double rate, double amplitude)
+{
+    for (uint32_t i = 0; i < frameCount; i++) {
+        float v = (float)(amplitude * sin(2.0 * M_PI * freq * (double)i / rate));
+        for (uint32_t c = 0; c < channels; c++) out[i * channels + c] = v;
+    }
+}
+
+/* Error of `output` against the ideal band-limited sine at the output
+ * rate, in dB relative to the signal, skipping the filter's start-up. */
+static double SineErrorDB(const float *output, uint32_t frameCount, uint32_t channels,
+                          double freq, double rate, double amplitude, uint32_t skip)
+{
+    double err = 0.0, sig = 0.0;
+    for (uint32_t i = skip; i < frameCount; i++) {
+        double ideal = amplitude * sin(2.0 * M_PI * freq * (double)i / rate);
+        for (uint32_t c = 0; c < channels; c++) {
+            double d = output[i * channels + c] - ideal;
+            err += d * d;
+            sig += ideal * ideal;
+        }
+    }
+    return 10.0 * log10(err / sig);
+}
+
+static void testResamplerRejectsBadConfig(void)
+{
+    RightMicResampler rs;
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 0, 48000, 2, kRightMicResampler_Max));
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 48000, 0, 2, kRightMicResampler_Max));
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 48000, 48000, 0, kRightMicResampler_Max));
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 48000, 48000, 3, kRightMicResampler_Max));
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 8000, 96000, 2, kRightMicResampler_Max));
+    CHECK(!RightMicResampler_Init(&rs, sResamplerStorage, 48000, 48000, 2, (RightMicResamplerQuality)3));
+    CHECK(RightMicResampler_Init(&rs, sResamplerStorage, 384000, 48000, 2, kRightMicResampler_Max));
+    CHECK(rs.taps == kRightMicResampler_MaxTaps);
+}
+
+static void testResamplerExactPhasesForCommonRates(void)
+{
+    static const struct { uint32_t in, phases, taps; } cases[] = {
+        { 44100, 160, 64 }, { 16000, 3, 64 }, { 24000, 2, 64 }, { 96000, 1, 128 },
+        { 48000, 1, 64 },   { 11025, kRightMicResampler_MaxPhases, 64 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        RightMicResampler rs;
+        CHECK(RightMicResampler_Init(&rs, sResamplerStorage, cases[i].in, 48000, 2,
+                                     kRightMicResampler_Max));
+        CHECK(rs.phases == cases[i].phases);
+        CHECK(rs.taps == cases[i].taps);
+        /* An exact ratio steps by whole rows. */
+        if (cases[i].phases < kRightMicResampler_MaxPhases) {
+            CHECK((rs.step & ((1u << kRightMicResampler_SubBits) - 1)) == 0);
+        }
+    }
+}
+
+static void testResamplerPassesDC(void)
+{
+    static const uint32_t rates[] = { 16000, 44100, 48000, 96000, 11025 };
+    static float in[4096 * 2], out[16384 * 2];
+    for (uint32_t i = 0; i < 4096 * 2; i++) in[i] = 0.25f;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (int q = kRightMicResampler_Voice; q <= kRightMicResampler_Max; q++) {
+            RightMicResampler rs;
+            RightMicResampler_Init(&rs, sResamplerStorage, rates[r], 48000, 2,
+                                   (RightMicResamplerQuality)q);
+            uint32_t n = RightMicResampler_Process(&rs, in, 4096, out, 16384, NULL);
+            CHECK(n > 0);
+            /* Past the leading silence the output is flat. */
+            uint32_t skip = (uint32_t)((double)rs.taps * 48000.0 / rates[r]) + 1;
+            float worst = 0.0f;
+            for (uint32_t i = skip; i < n * 2; i++) worst = fmaxf(worst, fabsf(out[i] - 0.25f));
+            CHECK(worst < 1e-5f);
+        }
+    }
+}
+
+static void testResamplerChunkingIsInvariant(void)
+{
+    enum { kFrames = 6000 };
+    static float in[kFrames * 2], whole[kFrames * 2 * 2], pieces[kFrames * 2 * 2];
+    uint32_t seed = 11;
+    for (uint32_t i = 0; i < kFrames * 2; i++) in[i] = Noise(&seed, 0.5f);
+
+    RightMicResampler rs;
+    RightMicResampler_Init(&rs, sResamplerStorage, 44100, 48000, 2, kRightMicResampler_Balanced);
+    uint32_t consumed = 0;
+    uint32_t total = RightMicResampler_Process(&rs, in, kFrames, whole, kFrames * 2, &consumed);
+    CHECK(consumed == kFrames);
+
+    /* Odd, tiny and over-a-line chunk sizes: the output must not depend on them. */
+    RightMicResampler_Reset(&rs);
+    uint32_t at = 0, made = 0;
+    static const uint32_t sizes[] = { 1, 7, 300, 2, 511, 33, 1024 };
+    for (uint32_t i = 0; at < kFrames; i++) {
+        uint32_t chunk = sizes[i % 7];
+        if (chunk > kFrames - at) chunk = kFrames - at;
+        uint32_t cap = RightMicResampler_MaxOutput(&rs, chunk);
+        made += RightMicResampler_Process(&rs, in + at * 2, chunk, pieces + made * 2, cap, &consumed);
+        CHECK(consumed == chunk);
+        at += chunk;
+    }
+    CHECK(made == total);
+    CHECK(memcmp(whole, pieces, (size_t)total * 2 * sizeof(float)) == 0);
+}
+
+static void testResamplerHoldsInputBeyondCapacity(void)
+{
+    static float in[1000 * 2], out[2000 * 2];
+    MakeSine(in, 1000, 2, 440.0, 44100.0, 0.5);
+    RightMicResampler rs;
+    RightMicResampler_Init(&rs, sResamplerStorage, 44100, 48000, 2, kRightMicResampler_Voice);
+
+    uint32_t consumed = 0;
+    uint32_t n = RightMicResampler_Process(&rs, in, 1000, out, 100, &consumed);
+    CHECK(n == 100);
+    CHECK(consumed < 1000);
+    n += RightMicResampler_Process(&rs, in + consumed * 2, 1000 - consumed, out + n * 2,
+                                   2000 - n, NULL);
+    /* Behind 7 frames of lead-in, a 16-tap window can start on any of the
+     * first 992 frames, and outputs fall 147/160 of a frame apart. */
+    CHECK(n == (992 * 160 - 1) / 147 + 1);
+}
+
+static void testResamplerToneQuality(void)
+{
+    enum { kFrames = 8192 };
+    static float in[kFrames], out[kFrames * 3];
+    /* A 1 kHz tone converted to 48 kHz, against the ideal sine. */
+    static const double limits[] = {
+        [kRightMicResampler_Voice] = -50.0, [kRightMicResampler_Balanced] = -75.0,
+        [kRightMicResampler_Max]   = -85.0,
+    };
+    static const uint32_t rates[] = { 44100, 16000, 96000, 11025 };
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        MakeSine(in, kFrames, 1, 1000.0, rates[r], 0.5);
+        for (int q = kRightMicResampler_Voice; q <= kRightMicResampler_Max; q++) {
+            RightMicResampler rs;
+            RightMicResampler_Init(&rs, sResamplerStorage, rates[r], 48000, 1,
+                                   (RightMicResamplerQuality)q);
+            uint32_t n = RightMicResampler_Process(&rs, in, kFrames, out, kFrames * 3, NULL);
+            uint32_t skip = (uint32_t)((double)rs.taps * 48000.0 / rates[r]) + 1;
+            double db = SineErrorDB(out, n, 1, 1000.0, 48000.0, 0.5, skip);
+            CHECK(db < limits[q]);
+        }
+    }
+}
+
+static void testResamplerRejectsAliases(void)
+{
+    enum { kFrames = 8192 };
+    static float in[kFrames], out[kFrames];
+    /* 30 kHz at 96 kHz would fold to 18 kHz at 48 kHz. */
+    static const double limits[] = {
+        [kRightMicResampler_Voice] = -55.0, [kRightMicResampler_Balanced] = -75.0,
+        [kRightMicResampler_Max]   = -90.0,
+    };
+    MakeSine(in, kFrames, 1, 30000.0, 96000.0, 0.5);
+    for (int q = kRightMicResampler_Voice; q <= kRightMicResampler_Max; q++) {
+        RightMicResampler rs;
+        RightMicResampler_Init(&rs, sResamplerStorage, 96000, 48000, 1, (RightMicResamplerQuality)q);
+        uint32_t n = RightMicResampler_Process(&rs, in, kFrames, out, kFrames, NULL);
+        double sq = 0.0;
+        for (uint32_t i = rs.taps; i < n; i++) sq += (double)out[i] * out[i];
+        double db = 10.0 * log10(sq / (n - rs.taps) / (0.5 * 0.5 / 2.0));
+        CHECK(db < limits[q]);
+    }
+}
+
+static void testResamplerDriftChangesConsumption(void)
+{
+    static float in[4096 * 2], out[4096 * 2];
+    MakeSine(in, 4096, 2, 440.0, 48000.0, 0.5);
+
+    static const double drifts[] = { 0.002, -0.002, 0.05 };
+    for (size_t d = 0; d < 3; d++) {
+        RightMicResampler rs;
+        RightMicResampler_Init(&rs, sResamplerStorage, 48000, 48000, 2, kRightMicResampler_Balanced);
+        RightMicResampler_SetDrift(&rs, drifts[d]);
+
+        uint64_t inFrames = 0, outFrames = 0;
+        /* Long enough that the line's buffered input doesn't count. */
+        for (int i = 0; i < 2000; i++) {
+            uint32_t consumed = 0;
+            outFrames += RightMicResampler_Process(&rs, in, 4096, out, 4096, &consumed);
+            inFrames  += consumed;
+        }
+        /* Clamped to 1%. */
+        double expected = 1.0 + fmin(drifts[d], 0.01);
+        CHECK(fabs((double)inFrames / (double)outFrames - expected) < 1e-4);
+    }
+}
+
+/* ── Capture Clock ────────────────────────────────────────────── */
+
+/* A capture device `ppm` fast at a nominal `rate`, timestamping every
+ * `period` frames with up to ±`jitterUs` of triangular noise on the host
+ * time, against a host clock of `ticksPerSecond` that has been up for
+ * days (so precision lost to large host times shows). */
+typedef struct {
+    double   rate;
+    double   ppm;
+    double   ticksPerSecond;
+    double   jitterUs;
+    uint32_t period;
+    uint32_t clockID;
+    double   origin;      /* host ticks at sample time 0 */
+    double   sampleTime;  /* of the next timestamp       */
+    uint32_t noise;
+} FakeCapture;
+
+static void FakeCapture_Init(FakeCapture *fc, double rate, double ppm, double ticksPerSecond,
+                             double jitterUs, uint32_t period, uint32_t clockID)
+{
+    memset(fc, 0, sizeof(*fc));
+    fc->rate           = rate;
+    fc->ppm            = ppm;
+    fc->ticksPerSecond = ticksPerSecond;
+    fc->jitterUs       = jitterUs;
+    fc->period         = period;
+    fc->clockID        = clockID;
+    fc->origin         = 3.0 * 86400.0 * ticksPerSecond;
+    fc->noise          = clockID;
+}
+
+/* Publish the next timestamp. */
+static void FakeCapture_Publish(FakeCapture *fc, RightMicClockTable *table)
+{
+    double seconds = fc->sampleTime / (fc->rate * (1.0 + fc->ppm * 1e-6));
+    double jitter  = (double)(Noise(&fc->noise, 0.5f) + Noise(&fc->noise, 0.5f)) * fc->jitterUs * 1e-6;
+    uint64_t host  = (uint64_t)llround(fc->origin + (seconds + jitter) * fc->ticksPerSecond);
+    RightMicClock_Publish(table, fc->clockID, (uint32_t)fc->rate, fc->sampleTime, host);
+    fc->sampleTime += fc->period;
+}
+
+/* `seconds` of capture, read by the estimator every third callback as an
+ * IO thread running at another period would. */
+static void FakeCapture_Run(FakeCapture *fc, RightMicClockTable *table,
+                            RightMicClockEstimator *est, double seconds)
+{
+    uint32_t callbacks = (uint32_t)(seconds * fc->rate / fc->period);
+    for (uint32_t i = 0; i < callbacks; i++) {
+        FakeCapture_Publish(fc, table);
+        if (i % 3 == 2) RightMicClock_Update(est, table);
+    }
+    RightMicClock_Update(est, table);
+}
+
+static void testClockTracksJitteredCapture(void)
+{
+    /* ns host ticks (Intel) and 24 MHz ones (Apple silicon). */
+    static const struct { double rate, ppm, ticks, jitterUs; uint32_t period; } cases[] = {
+        { 48000.0,  300.0, 1e9,  100.0,  512 },
+        { 44100.0, -150.0, 24e6, 100.0,  441 },
+        { 16000.0,   40.0, 24e6, 250.0,  160 },
+        { 96000.0, 1500.0, 1e9,   20.0, 1024 },
+    };
+    static RightMicClockTable table;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        RightMicClock_InitProducer(&table);
+        RightMicClockEstimator est;
+        RightMicClock_InitEstimator(&est, cases[c].ticks);
+        FakeCapture fc;
+        FakeCapture_Init(&fc, cases[c].rate, cases[c].ppm, cases[c].ticks,
+                         cases[c].jitterUs, cases[c].period, 7);
+
+        /* Nominal until locked. */
+        FakeCapture_Run(&fc, &table, &est, kRightMicClock_LockSeconds - 0.5);
+        CHECK(!RightMicClock_IsLocked(&est));
+        CHECK(RightMicClock_Ratio(&est) == 1.0);
+
+        FakeCapture_Run(&fc, &table, &est, 1.0);
+        CHECK(RightMicClock_IsLocked(&est));
+        double early = RightMicClock_PPM(&est);
+        CHECK(fabs(early - cases[c].ppm) < 40.0);
+
+        /* Settled: the worst estimate over the next minute. */
+        FakeCapture_Run(&fc, &table, &est, 25.0);
+        double worst = 0;
+        for (int s = 0; s < 60; s++) {
+            FakeCapture_Run(&fc, &table, &est, 1.0);
+            double err = fabs(RightMicClock_PPM(&est) - cases[c].ppm);
+            if (err > worst) worst = err;
+        }
+        printf("    %.0f Hz %+.0f ppm, ±%.0f µs: %.1f ppm after lock, worst %.2f ppm settled\n",
+               cases[c].rate, cases[c].ppm, cases[c].jitterUs, early - cases[c].ppm, worst);
+        CHECK(worst < 5.0);
+        CHECK(est.discontinuities == 0);
+    }
+}
+
+static void testClockRestartsOnDiscontinuity(void)
+{
+    static RightMicClockTable table;
+    RightMicClock_InitProducer(&table);
+    RightMicClockEstimator est;
+    RightMicClock_InitEstimator(&est, 1e9);
+    FakeCapture fc;
+    FakeCapture_Init(&fc, 48000.0, 200.0, 1e9, 50.0, 512, 1);
+    FakeCapture_Run(&fc, &table, &est, 8.0);
+    CHECK(RightMicClock_IsLocked(&est));
+
+    /* A pause with the clock running on is not a new clock. */
+    fc.sampleTime += 3.0 * 48000.0;
+    FakeCapture_Run(&fc, &table, &est, 1.0);
+    CHECK(RightMicClock_IsLocked(&est));
+    CHECK(est.discontinuities == 0);
+    CHECK(fabs(RightMicClock_PPM(&est) - 200.0) < 20.0);
+
+    /* Another device. */
+    FakeCapture next;
+    FakeCapture_Init(&next, 48000.0, -80.0, 1e9, 50.0, 512, 2);
+    next.origin = fc.origin + 20.0 * 1e9;
+    FakeCapture_Run(&next, &table, &est, 1.0);
+    CHECK(est.discontinuities == 1);
+    CHECK(!RightMicClock_IsLocked(&est));
+    CHECK(RightMicClock_Ratio(&est) == 1.0);
+    FakeCapture_Run(&next, &table, &est, 8.0);
+    CHECK(RightMicClock_IsLocked(&est));
+    CHECK(fabs(RightMicClock_PPM(&est) + 80.0) < 20.0);
+
+    /* The same device restarting its sample time... */
+    next.sampleTime = 0;
+    next.origin += 30.0 * 1e9;
+    FakeCapture_Run(&next, &table, &est, 0.1);
+    CHECK(est.discontinuities == 2);
+
+    /* ...or its sample time slipping 10 ms against its host time... */
+    FakeCapture_Run(&next, &table, &est, 1.0);
+    next.origin -= 0.010 * 1e9;
+    FakeCapture_Run(&next, &table, &est, 0.1);
+    CHECK(est.discontinuities == 3);
+
+    /* ...or coming back at another rate. */
+    FakeCapture third;
+    FakeCapture_Init(&third, 44100.0, 0.0, 1e9, 50.0, 441, 2);
+    third.origin = next.origin + 60.0 * 1e9;
+    FakeCapture_Run(&third, &table, &est, 0.1);
+    CHECK(est.discontinuities == 4);
+    CHECK(est.sampleRate == 44100);
+
+    /* A rate no real clock runs at is never believed. */
+    FakeCapture wild;
+    FakeCapture_Init(&wild, 48000.0, 5000.0, 1e9, 0.0, 512, 3);
+    wild.origin = third.origin + 60.0 * 1e9;
+    FakeCapture_Run(&wild, &table, &est, 10.0);
+    CHECK(!RightMicClock_IsLocked(&est));
+}
+
+static void testClockReadsOnlyCompleteEntries(void)
+{
+    static RightMicClockTable table;
+    RightMicClock_InitProducer(&table);
+    RightMicClockEstimator est;
+    RightMicClock_InitEstimator(&est, 1e9);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        RightMicClock_Publish(&table, 1, 48000, 512.0 * i, 1000000000ull + 10666667ull * i);
+    }
+    /* Entry 2 caught mid-rewrite. */
+    atomic_store(&table.entries[2].sequence, 0);
+    RightMicClock_Update(&est, &table);
+    CHECK(est.sampleTime == 512.0);
+    CHECK(est.next == 3);
+
+    /* More than a table's worth since the last look: only the newest count. */
+    for (uint32_t i = 3; i < 40; i++) {
+        RightMicClock_Publish(&table, 1, 48000, 512.0 * i, 1000000000ull + 10666667ull * i);
+    }
+    RightMicClock_Update(&est, &table);
+    CHECK(est.next == 40);
+    CHECK(est.sampleTime == 512.0 * 39);
+    CHECK(est.discontinuities == 0);
+
+    /* The app reopened the ring: read the new table from its start. */
+    RightMicClock_InitProducer(&table);
+    RightMicClock_Publish(&table, 1, 48000, 512.0 * 40, 1000000000ull + 10666667ull * 40);
+    RightMicClock_Update(&est, &table);
+    CHECK(est.next == 1);
+    CHECK(est.sampleTime == 512.0 * 40);
+}
+
+static void testClockZeroTimeStampsFollowEstimate(void)
+{
+    static RightMicClockTable table;
+    RightMicClock_InitProducer(&table);
+    RightMicClockEstimator est;
+    RightMicClock_InitEstimator(&est, 1e9);
+    const uint32_t period  = kRightMic_ZeroTimeStampPeriod;
+    const double   nominal = period / 48000.0 * 1e9;
+
+    /* Before lock: nominal periods, first seed. */
+    RightMicClockTimeline tl;
+    memset(&tl, 0, sizeof(tl));
+    RightMicClock_StartTimeline(&tl, &est, 5000000000ull, period, nominal);
+    double sampleTime;
+    uint64_t hostTime, seed;
+    RightMicClock_ZeroTimeStamp(&tl, &est, 5000000000ull + (uint64_t)(nominal * 10.5),
+                                &sampleTime, &hostTime, &seed);
+    CHECK(sampleTime == 10.0 * period);
+    CHECK(llabs((long long)(hostTime - 5000000000ull) - llround(nominal * 10.0)) <= 1);
+    CHECK(seed == 1);
+
+    /* Locked to a device 500 ppm slow: periods stretch to match. */
+    FakeCapture fc;
+    FakeCapture_Init(&fc, 48000.0, -500.0, 1e9, 30.0, 512, 1);
+    FakeCapture_Run(&fc, &table, &est, 30.0);
+    CHECK(RightMicClock_IsLocked(&est));
+    double ratio = RightMicClock_Ratio(&est);
+    CHECK(fabs(ratio - 1.0 / (1.0 - 500e-6)) < 10e-6);
+
+    uint64_t from = hostTime;
+    double   fromSample = sampleTime;
+    uint64_t now = hostTime + (uint64_t)(nominal * ratio * 1000.5);
+    RightMicClock_ZeroTimeStamp(&tl, &est, now, &sampleTime, &hostTime, &seed);
+    CHECK(sampleTime - fromSample == 1000.0 * period);
+    CHECK(llabs((long long)(hostTime - from) - llround(nominal * ratio * 1000.0)) <= 1);
+    CHECK(seed == 1);
+
+    /* Asking again at the same time changes nothing; later never goes back. */
+    uint64_t again;
+    double againSample;
+    RightMicClock_ZeroTimeStamp(&tl, &est, now, &againSample, &again, &seed);
+    CHECK(again == hostTime && againSample == sampleTime);
+
+    /* A device switch bumps the seed once; the timeline carries on. */
+    FakeCapture next;
+    FakeCapture_Init(&next, 48000.0, 100.0, 1e9, 30.0, 512, 2);
+    FakeCapture_Run(&next, &table, &est, 0.5);
+    RightMicClock_ZeroTimeStamp(&tl, &est, now + (uint64_t)nominal, &againSample, &again, &seed);
+    CHECK(seed == 2);
+    CHECK(again > hostTime && againSample == sampleTime + period);
+    RightMicClock_ZeroTimeStamp(&tl, &est, now + (uint64_t)(2 * nominal), &againSample, &again, &seed);
+    CHECK(seed == 2);
+
+    /* A new IO session is a new timeline. */
+    RightMicClock_StartTimeline(&tl, &est, now + (uint64_t)(5 * nominal), period, nominal);
+    RightMicClock_ZeroTimeStamp(&tl, &est, now + (uint64_t)(5 * nominal), &sampleTime, &hostTime, &seed);
+    CHECK(sampleTime == 0 && seed == 3);
+}
+
+/* ── Main ─────────────────────────────────────────────────────── */
+
+int main(void)
+{
+    printf("RightMicRing tests\n");
+    RUN(testDetachedRingReadsSilence);
+    RUN(testInactiveRingReadsSilence);
+    RUN(testInitProducerWritesFormat);
+    RUN(testHeaderLayoutIsVersioned);
+    RUN(testSteadyStateRoundTrip);
+    RUN(testWrapAroundSplitsCopy);
+    RUN(testSmallRingWrapsAtItsCapacity);
+    RUN(testRingFramesAreClamped);
+    RUN(testReserveCommitPublishesInPlace);
+    RUN(testExpandMonoMatchesScalar);
+    RUN(testMonoRingReadsAsStereo);
+    RUN(testUnderrunWritesSilenceAndHoldsCursor);
+    RUN(testOverflowResyncsBehindWriter);
+    RUN(testWriterResetResyncs);
+    RUN(testMuteFlag);
+    RUN(testDriftSyncsAtTargetAndPassesThrough);
+    RUN(testDriftPrimingIsNotAnUnderrun);
+    RUN(testDriftPartialReadConcealsDeficit);
+    RUN(testDriftRefillsToTargetAfterStall);
+    RUN(testDriftServesPrimedSilenceAfterIdle);
+    RUN(testDriftExpandsMonoRing);
+    RUN(testDriftClampsWatermarks);
+    RUN(testDriftLocksToFastProducer);
+    RUN(testDriftLocksToSlowProducer);
+    RUN(testDriftHoldsWithoutDrift);
+    RUN(testDriftLocksAtSmallBuffers);
+    RUN(testDriftConvertsRingRate);
+    RUN(testWritesClaimBeforePublishing);
+    RUN(testCommitReleasesUnwrittenClaim);
+    RUN(testReadConcealsFramesTornMidCopy);
+    RUN(testDriftConcealsFramesTornMidCopy);
+    RUN(testLappedReadsNeverPlayTornFrames);
+    RUN(testConcealDetectsPitch);
+    RUN(testConcealJoinsFadeOut);
+    RUN(testConcealJoinsCrossfade);
+    RUN(testConcealJoinsPitchRepeat);
+    RUN(testConcealSilenceMode);
+    RUN(testConcealDecaysToSilence);
+    RUN(testConcealResumesSmoothly);
+    RUN(testSwitchPassesThroughOwner);
+    RUN(testSwitchReservesOnlyForIdleOwner);
+    RUN(testSwitchCrossfadesAndHandsOver);
+    RUN(testSwitchCompleteDiscardsStage);
+    RUN(testCursorKeepsPositionAcrossIOSizes);
+    RUN(testMirrorMapsDataTwice);
+    RUN(testMirroredRingCrossesWrap);
+    RUN(testMirrorFallsBackToSingleMapping);
+    RUN(testMirrorPrefaultLeavesNothingToFault);
+    RUN(testAttachWaitsForPublishedLayout);
+    RUN(testAttachAdoptsPublishedGeometry);
+    RUN(testAttachMapsMonoRingAtItsSize);
+    RUN(testAttachCloseWaitsForIOCycle);
+    RUN(testAttachPrefersSharedMemoryObject);
+    RUN(testShmCreateReusesOwnObject);
+    RUN(testShmRingGrowsUnderAttachedReader);
+    RUN(testControlsCopyOnlyCompleteUpdates);
+    RUN(testControlsTryReadNeverWaits);
+    RUN(testControlsNeverTearUnderRewrite);
+    RUN(testHistogramBuckets);
+    RUN(testMetricsCountStallAsOneUnderrun);
+    RUN(testMetricsFileIsReadableByOthers);
+    RUN(testMetricsPreferSharedMemoryObject);
+    RUN(testMetricsPublishIOClients);
+    RUN(testLevelAnalyzeMatchesScalar);
+    RUN(testLevelDetectsMutedHardware);
+    RUN(testLevelQuietRoomIsNotSilent);
+    RUN(testResamplerRejectsBadConfig);
+    RUN(testResamplerExactPhasesForCommonRates);
+    RUN(testResamplerPassesDC);
+    RUN(testResamplerChunkingIsInvariant);
+    RUN(testResamplerHoldsInputBeyondCapacity);
+    RUN(testResamplerToneQuality);
+    RUN(testResamplerRejectsAliases);
+    RUN(testResamplerDriftChangesConsumption);
+    RUN(testClockTracksJitteredCapture);
+    RUN(testClockRestartsOnDiscontinuity);
+    RUN(testClockReadsOnlyCompleteEntries);
+    RUN(testClockZeroTimeStampsFollowEstimate);
+
+    if (sFailures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", sFailures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
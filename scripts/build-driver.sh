@@ -41,7 +41,17 @@ clang \
     -framework CoreFoundation \
     -I "$DRIVER_SRC" \
     -o "$DRIVER_BUNDLE/Contents/MacOS/RightMicDriver" \
-    "$DRIVER_SRC/RightMicDriver.c"
+    "$DRIVER_SRC/RightMicDriver.c" \
+    "$DRIVER_SRC/RightMicRing.c" \
+    "$DRIVER_SRC/RightMicAttach.c" \
+    "$DRIVER_SRC/RightMicCursor.c" \
+    "$DRIVER_SRC/RightMicControls.c" \
+    "$DRIVER_SRC/RightMicMetrics.c" \
+    "$DRIVER_SRC/RightMicMirror.c" \
+    "$DRIVER_SRC/RightMicShm.c" \
+    "$DRIVER_SRC/RightMicDrift.c" \
+    "$DRIVER_SRC/RightMicConceal.c" \
+    "$DRIVER_SRC/RightMicClock.c"
 
 # Copy Info.plist
 cp "$DRIVER_SRC/Info.plist" "$DRIVER_BUNDLE/Contents/Info.plist"
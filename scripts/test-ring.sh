@@ -0,0 +1,84 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Build and run the portable ring buffer tests on any POSIX host.
+# No CoreAudio, Xcode or installed driver is required, so this also runs on Linux.
+#
+# Usage:
+#   ./scripts/test-ring.sh                       # unit tests
+#   ./scripts/test-ring.sh --bench [OPTIONS]     # unit tests + kernel, resampler, header and real-time benchmarks
+#
+# Benchmark options are passed through to RingBench (see Tests/RingTests/RingBench.c),
+# e.g. ./scripts/test-ring.sh --bench --seconds 30 --period 256
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+DRIVER_SRC="$PROJECT_DIR/Driver"
+TEST_SRC="$PROJECT_DIR/Tests/RingTests"
+BUILD_DIR="$PROJECT_DIR/build/ring-tests"
+
+CC="${CC:-cc}"
+CFLAGS=(-std=c11 -D_GNU_SOURCE -O2 -g -Wall -Wextra -Werror -I "$DRIVER_SRC")
+LDLIBS=(-lm -lpthread)
+
+# Portable sources shared by the driver, the app and these tests.
+SHARED_SOURCES=(
+    "$DRIVER_SRC/RightMicRing.c"
+    "$DRIVER_SRC/RightMicAttach.c"
+    "$DRIVER_SRC/RightMicCursor.c"
+    "$DRIVER_SRC/RightMicControls.c"
+    "$DRIVER_SRC/RightMicLevel.c"
+    "$DRIVER_SRC/RightMicMetrics.c"
+    "$DRIVER_SRC/RightMicMirror.c"
+    "$DRIVER_SRC/RightMicDrift.c"
+    "$DRIVER_SRC/RightMicConceal.c"
+    "$DRIVER_SRC/RightMicClock.c"
+    "$DRIVER_SRC/RightMicSwitch.c"
+    "$DRIVER_SRC/RightMicResampler.c"
+    "$DRIVER_SRC/RightMicShm.c"
+)
+
+RUN_BENCH=false
+if [[ $# -gt 0 && "$1" == "--bench" ]]; then
+    RUN_BENCH=true
+    shift
+fi
+
+mkdir -p "$BUILD_DIR"
+
+echo "==> Building ring tests..."
+"$CC" "${CFLAGS[@]}" -o "$BUILD_DIR/RingTests" \
+    "$TEST_SRC/RingTests.c" "${SHARED_SOURCES[@]}" "${LDLIBS[@]}"
+
+echo "==> Running ring tests..."
+"$BUILD_DIR/RingTests"
+
+if [[ "$RUN_BENCH" == true ]]; then
+    echo "==> Building kernel bench..."
+    "$CC" "${CFLAGS[@]}" -o "$BUILD_DIR/KernelBench" \
+        "$TEST_SRC/KernelBench.c" "${SHARED_SOURCES[@]}" "${LDLIBS[@]}"
+
+    echo "==> Running kernel bench..."
+    "$BUILD_DIR/KernelBench"
+
+    echo "==> Building resampler bench..."
+    "$CC" "${CFLAGS[@]}" -o "$BUILD_DIR/ResamplerBench" \
+        "$TEST_SRC/ResamplerBench.c" "${SHARED_SOURCES[@]}" "${LDLIBS[@]}"
+
+    echo "==> Running resampler bench..."
+    "$BUILD_DIR/ResamplerBench"
+
+    echo "==> Building header bench..."
+    "$CC" "${CFLAGS[@]}" -o "$BUILD_DIR/HeaderBench" \
+        "$TEST_SRC/HeaderBench.c" "${SHARED_SOURCES[@]}" "${LDLIBS[@]}"
+
+    echo "==> Running header bench..."
+    "$BUILD_DIR/HeaderBench"
+
+    echo "==> Building ring bench..."
+    "$CC" "${CFLAGS[@]}" -o "$BUILD_DIR/RingBench" \
+        "$TEST_SRC/RingBench.c" "${SHARED_SOURCES[@]}" "${LDLIBS[@]}"
+
+    echo "==> Running ring bench..."
+    "$BUILD_DIR/RingBench" "$@"
+fi